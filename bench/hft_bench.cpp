@@ -0,0 +1,712 @@
+// hft_bench: microbenchmarks for the market data -> strategy hot path.
+//
+//   hft_bench [--filter substr] [--min-time-ms N] [--list]
+//             [--bybit-frames f.frames] [--binance-frames f.frames]
+//             [--json out.json] [--compare baseline.json]
+//
+// Every case is timed in calibrated batches (~min-time / SAMPLES each) and
+// reports the median batch: ns/op, allocs/op (calls to any global operator new; SQLite's
+// own malloc is not counted) and ops/s, plus MB/s or items/s where an op has a
+// size. --json saves the run; --compare prints the change against a saved run,
+// so two commits can be compared on the same machine.
+//
+// Feed cases replay recorded frames when given (frame_dump / FrameRecorder
+// files), otherwise synthetic frames shaped like mock_exchange output.
+
+#include "BinanceL2Feed.hpp"
+#include "BybitL2Feed.hpp"
+#include "OrderBook.hpp"
+#include "SnapshotSerializer.hpp"
+#include "StateDB.hpp"
+#include "FrameLog.hpp"
+
+#include "imbalance_taker.hpp"
+#include "packed_market_state.hpp"
+#include "spsc_ring.hpp"
+#include "virtual_wallet.hpp"
+#include "zmq_market_subscriber.hpp"
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+using json = nlohmann::json;
+
+// ------------------------------------------------------------
+// Allocation counting: every C++ heap allocation in the process.
+// The whole replaceable new/delete family is replaced, so every form is
+// counted and every delete matches the malloc / aligned_alloc behind it.
+// ------------------------------------------------------------
+static std::atomic<std::uint64_t> g_allocs{0};
+
+static void* counted_alloc(std::size_t n, std::size_t align) noexcept {
+    g_allocs.fetch_add(1, std::memory_order_relaxed);
+    if (n == 0) n = 1;
+    if (align <= alignof(std::max_align_t)) return std::malloc(n);
+    return std::aligned_alloc(align, (n + align - 1) / align * align);   // size: multiple of align
+}
+
+static void* counted_alloc_or_throw(std::size_t n, std::size_t align) {
+    if (void* p = counted_alloc(n, align)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t n) { return counted_alloc_or_throw(n, 0); }
+void* operator new[](std::size_t n) { return counted_alloc_or_throw(n, 0); }
+void* operator new(std::size_t n, std::align_val_t a) { return counted_alloc_or_throw(n, static_cast<std::size_t>(a)); }
+void* operator new[](std::size_t n, std::align_val_t a) { return counted_alloc_or_throw(n, static_cast<std::size_t>(a)); }
+
+void* operator new(std::size_t n, const std::nothrow_t&) noexcept { return counted_alloc(n, 0); }
+void* operator new[](std::size_t n, const std::nothrow_t&) noexcept { return counted_alloc(n, 0); }
+void* operator new(std::size_t n, std::align_val_t a, const std::nothrow_t&) noexcept {
+    return counted_alloc(n, static_cast<std::size_t>(a));
+}
+void* operator new[](std::size_t n, std::align_val_t a, const std::nothrow_t&) noexcept {
+    return counted_alloc(n, static_cast<std::size_t>(a));
+}
+
+// malloc and aligned_alloc memory are both released by free
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept { std::free(p); }
+
+// Keeps a result alive without the compiler being able to see through it
+template <class T>
+static inline void do_not_optimize(const T& v) {
+    asm volatile("" : : "r"(&v) : "memory");
+}
+
+// ------------------------------------------------------------
+// Harness
+// ------------------------------------------------------------
+struct BenchCase {
+    std::string name;
+    std::function<void(std::uint64_t n)> run;   // n ops
+    double bytes_per_op = 0.0;                  // MB/s column when > 0
+    double items_per_op = 0.0;                  // items/s column when > 0 (rows, levels)
+};
+
+struct BenchResult {
+    std::string name;
+    double ns_per_op = 0.0;
+    double allocs_per_op = 0.0;
+    double ops_per_sec = 0.0;
+    double bytes_per_op = 0.0;
+    double items_per_op = 0.0;
+    std::uint64_t iterations = 0;
+};
+
+static constexpr int SAMPLES = 5;
+
+static double time_batch_ns(const BenchCase& c, std::uint64_t n) {
+    const auto t0 = std::chrono::steady_clock::now();
+    c.run(n);
+    const auto t1 = std::chrono::steady_clock::now();
+    return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count());
+}
+
+static BenchResult run_case(const BenchCase& c, double min_time_ms) {
+    const double target_ns = min_time_ms * 1e6 / SAMPLES;
+
+    // Grow the batch until it is long enough to time, then size it to the target
+    c.run(1);   // warm caches / lazy init outside the measurement
+    std::uint64_t n = 1;
+    double ns = time_batch_ns(c, n);
+    while (ns < target_ns / 10 && n < (1ull << 40)) {
+        n *= 10;
+        ns = time_batch_ns(c, n);
+    }
+    n = std::max<std::uint64_t>(1, static_cast<std::uint64_t>(n * (target_ns / std::max(ns, 1.0))));
+
+    std::vector<double> per_op;
+    const std::uint64_t allocs0 = g_allocs.load(std::memory_order_relaxed);
+    for (int s = 0; s < SAMPLES; ++s)
+        per_op.push_back(time_batch_ns(c, n) / static_cast<double>(n));
+    const std::uint64_t allocs = g_allocs.load(std::memory_order_relaxed) - allocs0;
+
+    std::sort(per_op.begin(), per_op.end());
+
+    BenchResult r;
+    r.name = c.name;
+    r.ns_per_op = per_op[SAMPLES / 2];
+    r.allocs_per_op = static_cast<double>(allocs) / static_cast<double>(n * SAMPLES);
+    r.ops_per_sec = r.ns_per_op > 0 ? 1e9 / r.ns_per_op : 0.0;
+    r.bytes_per_op = c.bytes_per_op;
+    r.items_per_op = c.items_per_op;
+    r.iterations = n * SAMPLES;
+    return r;
+}
+
+static void print_header() {
+    std::printf("%-36s %12s %10s %12s %14s\n", "case", "ns/op", "allocs/op", "ops/s", "throughput");
+}
+
+static void print_result(const BenchResult& r) {
+    char tput[32] = "";
+    if (r.bytes_per_op > 0)
+        std::snprintf(tput, sizeof(tput), "%.1f MB/s", r.ops_per_sec * r.bytes_per_op / 1e6);
+    else if (r.items_per_op > 0)
+        std::snprintf(tput, sizeof(tput), "%.2fM it/s", r.ops_per_sec * r.items_per_op / 1e6);
+
+    std::printf("%-36s %12.1f %10.2f %12.0f %14s\n",
+                r.name.c_str(), r.ns_per_op, r.allocs_per_op, r.ops_per_sec, tput);
+    std::fflush(stdout);
+}
+
+// ------------------------------------------------------------
+// Synthetic inputs
+// ------------------------------------------------------------
+using Levels = std::vector<std::pair<double, double>>;
+
+static const char* kSymbol = "ETHUSDT";
+
+static void make_levels(int depth, std::mt19937_64& rng, Levels& bids, Levels& asks) {
+    std::uniform_real_distribution<double> qty(0.01, 25.0);
+    bids.clear();
+    asks.clear();
+    for (int i = 0; i < depth; ++i) {
+        bids.emplace_back(3000.00 - 0.01 * i, qty(rng));
+        asks.emplace_back(3000.01 + 0.01 * i, qty(rng));
+    }
+}
+
+// Random walk over the top depth*5/4 ticks: update, insert or delete one
+// level per side, so the book stays around its starting depth
+static std::vector<std::pair<Levels, Levels>> make_deltas(int depth, std::size_t count, std::mt19937_64& rng) {
+    std::uniform_real_distribution<double> qty(0.01, 25.0);
+    std::uniform_real_distribution<double> coin(0.0, 1.0);
+    std::uniform_int_distribution<int> tick(0, depth + depth / 4);
+
+    std::vector<bool> bid_live(depth + depth / 4 + 1, false), ask_live(bid_live.size(), false);
+    for (int i = 0; i < depth; ++i) bid_live[i] = ask_live[i] = true;
+
+    auto level = [&](std::vector<bool>& live) {
+        const int t = tick(rng);
+        double q = qty(rng);
+        if (live[t] && coin(rng) < 0.3) q = 0.0;   // delete
+        live[t] = q > 0.0;
+        return std::make_pair(t, q);
+    };
+
+    std::vector<std::pair<Levels, Levels>> out(count);
+    for (auto& d : out) {
+        auto b = level(bid_live);
+        auto a = level(ask_live);
+        d.first.emplace_back(3000.00 - 0.01 * b.first, b.second);
+        d.second.emplace_back(3000.01 + 0.01 * a.first, a.second);
+    }
+    return out;
+}
+
+static void append_levels(std::string& s, const Levels& lv) {
+    char buf[64];
+    s += '[';
+    for (std::size_t i = 0; i < lv.size(); ++i) {
+        std::snprintf(buf, sizeof(buf), "%s[\"%.2f\",\"%.3f\"]", i ? "," : "", lv[i].first, lv[i].second);
+        s += buf;
+    }
+    s += ']';
+}
+
+// Bybit: snapshot (u=1), then 4 deltas per ticker; starting over from the
+// snapshot keeps the update ids contiguous when the set wraps
+static std::vector<std::string> synthetic_bybit_frames(std::size_t count) {
+    std::mt19937_64 rng(7);
+    Levels bids, asks;
+    make_levels(50, rng, bids, asks);
+    auto deltas = make_deltas(50, count, rng);
+
+    std::vector<std::string> out;
+    char buf[512];
+    long long ts = 1700000000000LL;
+    std::uint64_t u = 1;
+
+    std::string f;
+    std::snprintf(buf, sizeof(buf), "{\"topic\":\"orderbook.50.%s\",\"type\":\"snapshot\",\"ts\":%lld,\"data\":{\"s\":\"%s\",\"b\":",
+                  kSymbol, ts, kSymbol);
+    f = buf;
+    append_levels(f, bids);
+    f += ",\"a\":";
+    append_levels(f, asks);
+    std::snprintf(buf, sizeof(buf), ",\"u\":%llu,\"seq\":1},\"cts\":%lld}", static_cast<unsigned long long>(u), ts);
+    f += buf;
+    out.push_back(f);
+
+    for (std::size_t i = 1; out.size() < count; ++i) {
+        ++ts;
+        if (i % 5 == 0) {
+            std::snprintf(buf, sizeof(buf),
+                          "{\"topic\":\"tickers.%s\",\"ts\":%lld,\"type\":\"snapshot\",\"cs\":%zu,\"data\":{\"symbol\":\"%s\","
+                          "\"lastPrice\":\"3000.01\",\"bid1Price\":\"3000.00\",\"bid1Size\":\"1.250\","
+                          "\"ask1Price\":\"3000.01\",\"ask1Size\":\"0.800\"}}",
+                          kSymbol, ts, i, kSymbol);
+            out.emplace_back(buf);
+            continue;
+        }
+        const auto& d = deltas[i % deltas.size()];
+        std::snprintf(buf, sizeof(buf), "{\"topic\":\"orderbook.50.%s\",\"type\":\"delta\",\"ts\":%lld,\"data\":{\"s\":\"%s\",\"b\":",
+                      kSymbol, ts, kSymbol);
+        f = buf;
+        append_levels(f, d.first);
+        f += ",\"a\":";
+        append_levels(f, d.second);
+        std::snprintf(buf, sizeof(buf), ",\"u\":%llu,\"seq\":%zu},\"cts\":%lld}",
+                      static_cast<unsigned long long>(++u), i + 1, ts);
+        f += buf;
+        out.push_back(f);
+    }
+    return out;
+}
+
+// Binance: bookTicker, with a depth20 snapshot every 5th and a 24hrTicker every 10th
+static std::vector<std::string> synthetic_binance_frames(std::size_t count) {
+    std::mt19937_64 rng(11);
+    Levels bids, asks;
+    std::vector<std::string> out;
+    char buf[512];
+    long long ts = 1700000000000LL;
+
+    for (std::size_t k = 1; out.size() < count; ++k) {
+        ++ts;
+        if (k % 10 == 0) {
+            std::snprintf(buf, sizeof(buf),
+                          "{\"e\":\"24hrTicker\",\"E\":%lld,\"s\":\"%s\",\"c\":\"3000.01\",\"b\":\"3000.00\","
+                          "\"B\":\"1.250\",\"a\":\"3000.01\",\"A\":\"0.800\"}", ts, kSymbol);
+            out.emplace_back(buf);
+        } else if (k % 5 == 0) {
+            make_levels(20, rng, bids, asks);
+            std::string f = "{\"lastUpdateId\":" + std::to_string(k) + ",\"bids\":";
+            append_levels(f, bids);
+            f += ",\"asks\":";
+            append_levels(f, asks);
+            f += '}';
+            out.push_back(f);
+        } else {
+            std::snprintf(buf, sizeof(buf),
+                          "{\"u\":%zu,\"s\":\"%s\",\"b\":\"3000.00\",\"B\":\"1.250\",\"a\":\"3000.01\",\"A\":\"0.800\"}",
+                          k, kSymbol);
+            out.emplace_back(buf);
+        }
+    }
+    return out;
+}
+
+// Recorded frames (copied: the reader's views die with it)
+static bool load_frames(const std::string& path, std::vector<std::string>& out, std::string& instrument) {
+    FrameReader rd(path);
+    if (!rd.open()) {
+        std::cerr << "[hft_bench] cannot open " << path << "\n";
+        return false;
+    }
+    instrument = rd.instrument();
+    FrameView v;
+    while (out.size() < 200000 && rd.next(v)) out.emplace_back(v.data);
+    if (out.empty()) {
+        std::cerr << "[hft_bench] no frames in " << path << "\n";
+        return false;
+    }
+    return true;
+}
+
+static double avg_size(const std::vector<std::string>& v) {
+    double total = 0;
+    for (const auto& s : v) total += static_cast<double>(s.size());
+    return v.empty() ? 0.0 : total / static_cast<double>(v.size());
+}
+
+static StateSnapshot make_state(std::uint64_t ts_ms) {
+    StateSnapshot s;
+    s.exchange = "bybit";
+    s.instrument = kSymbol;
+    s.ts_ms = ts_ms;
+    s.mid = 3000.005;
+    s.spread = 0.01;
+    s.r1 = 1.2e-5;
+    s.r5 = -3.4e-5;
+    s.r10 = 5.6e-5;
+    s.imbalance = 0.12;
+    for (int i = 0; i < 5; ++i) {
+        s.bid_vol[i] = 1.5 + i;
+        s.ask_vol[i] = 1.25 + i;
+    }
+    return s;
+}
+
+// ------------------------------------------------------------
+// Cases
+// ------------------------------------------------------------
+struct BenchInputs {
+    std::string bybit_frames;
+    std::string binance_frames;
+    std::string tmp_dir;
+};
+
+static void add_orderbook_cases(std::vector<BenchCase>& cases) {
+    for (int depth : {5, 20, 50, 200}) {
+        auto st = std::make_shared<std::pair<Levels, Levels>>();
+        std::mt19937_64 rng(depth);
+        make_levels(depth, rng, st->first, st->second);
+        auto ob = std::make_shared<OrderBook>();
+
+        cases.push_back({"orderbook.apply_snapshot/" + std::to_string(depth),
+                         [st, ob](std::uint64_t n) {
+                             for (std::uint64_t i = 0; i < n; ++i) {
+                                 ob->apply_snapshot(st->first, st->second);
+                                 do_not_optimize(ob->bids);
+                             }
+                         },
+                         0.0, 2.0 * depth});
+    }
+
+    for (int depth : {20, 50, 200}) {
+        std::mt19937_64 rng(depth + 1);
+        Levels bids, asks;
+        make_levels(depth, rng, bids, asks);
+        auto ob = std::make_shared<OrderBook>();
+        ob->apply_snapshot(bids, asks);
+        auto deltas = std::make_shared<std::vector<std::pair<Levels, Levels>>>(make_deltas(depth, 4096, rng));
+        auto idx = std::make_shared<std::size_t>(0);
+
+        cases.push_back({"orderbook.apply_delta/" + std::to_string(depth),
+                         [ob, deltas, idx](std::uint64_t n) {
+                             for (std::uint64_t i = 0; i < n; ++i) {
+                                 const auto& d = (*deltas)[(*idx)++ & 4095];
+                                 ob->apply_delta(d.first, d.second);
+                                 do_not_optimize(ob->asks);
+                             }
+                         },
+                         0.0, 0.0});
+    }
+}
+
+template <class Feed>
+static void add_feed_case(std::vector<BenchCase>& cases, const std::string& name,
+                          std::vector<std::string> frames, const std::string& instrument)
+{
+    auto fr = std::make_shared<std::vector<std::string>>(std::move(frames));
+    auto feed = std::make_shared<Feed>(instrument, 20);
+    auto quotes = std::make_shared<std::uint64_t>(0);
+    feed->on_quote = [quotes](const Quote& q, const OrderBook&) {
+        *quotes += 1;
+        do_not_optimize(q.bid);
+    };
+    auto idx = std::make_shared<std::size_t>(0);
+
+    cases.push_back({name,
+                     [fr, feed, idx](std::uint64_t n) {
+                         for (std::uint64_t i = 0; i < n; ++i) {
+                             if (*idx == fr->size()) {
+                                 // Wrap like a reconnect: wait for the next snapshot
+                                 *idx = 0;
+                                 feed->on_disconnect();
+                                 feed->take_resync();
+                             }
+                             feed->handle_frame((*fr)[(*idx)++], 0);
+                         }
+                     },
+                     avg_size(*fr), 0.0});
+}
+
+static bool add_feed_cases(std::vector<BenchCase>& cases, const BenchInputs& in) {
+    std::vector<std::string> frames;
+    std::string instrument = kSymbol;
+
+    if (!in.bybit_frames.empty()) {
+        if (!load_frames(in.bybit_frames, frames, instrument)) return false;
+        add_feed_case<BybitL2Feed>(cases, "feed.bybit.handle_frame/recorded", std::move(frames), instrument);
+    } else {
+        add_feed_case<BybitL2Feed>(cases, "feed.bybit.handle_frame", synthetic_bybit_frames(5000), instrument);
+    }
+
+    frames.clear();
+    instrument = kSymbol;
+    if (!in.binance_frames.empty()) {
+        if (!load_frames(in.binance_frames, frames, instrument)) return false;
+        add_feed_case<BinanceL2Feed>(cases, "feed.binance.handle_frame/recorded", std::move(frames), instrument);
+    } else {
+        add_feed_case<BinanceL2Feed>(cases, "feed.binance.handle_frame", synthetic_binance_frames(5000), instrument);
+    }
+    return true;
+}
+
+static void add_publish_cases(std::vector<BenchCase>& cases) {
+    auto q = std::make_shared<Quote>();
+    q->exchange = "bybit";
+    q->instrument = kSymbol;
+    q->bid = 3000.00;
+    q->ask = 3000.01;
+    q->spot = 3000.01;
+    q->ts_ms = 1700000000000LL;
+    q->exch_ts_ms = 1700000000000LL;
+    q->trace.id = 42;
+    q->trace.recv_ns = 1000;
+    q->trace.quote_ns = 2000;
+    q->trace.snap_ns = 3000;
+    q->trace.pub_ns = 4000;
+
+    std::mt19937_64 rng(3);
+    Levels bids, asks;
+    make_levels(20, rng, bids, asks);
+    auto ob = std::make_shared<OrderBook>();
+    ob->apply_snapshot(bids, asks);
+    auto snap = std::make_shared<StateSnapshot>(make_state(1700000000000ULL));
+
+    const std::string payload = serialize_snapshot("bybit", *q, *ob, *snap);
+
+    cases.push_back({"publish.serialize_snapshot",
+                     [q, ob, snap](std::uint64_t n) {
+                         for (std::uint64_t i = 0; i < n; ++i) {
+                             std::string s = serialize_snapshot("bybit", *q, *ob, *snap);
+                             do_not_optimize(s);
+                         }
+                     },
+                     static_cast<double>(payload.size()), 0.0});
+
+    auto p = std::make_shared<std::string>(payload);
+    cases.push_back({"strategy.parse_market_state_json",
+                     [p](std::uint64_t n) {
+                         for (std::uint64_t i = 0; i < n; ++i) {
+                             auto s = ZmqMarketSubscriber::parse_market_state_json(*p);
+                             do_not_optimize(s);
+                         }
+                     },
+                     static_cast<double>(payload.size()), 0.0});
+}
+
+static void add_state_db_case(std::vector<BenchCase>& cases, const BenchInputs& in) {
+    StateDBOptions o;
+    o.path = in.tmp_dir + "/bench_state.db";
+    o.compact_after_days = 0;
+    o.raw_retention_days = 0;
+    for (auto& d : o.bar_retention_days) d = 0;
+
+    constexpr std::size_t ROWS = 256;
+    auto db = std::make_shared<StateDB>(o);
+    auto batch = std::make_shared<std::vector<StateSnapshot>>();
+    for (std::size_t i = 0; i < ROWS; ++i) batch->push_back(make_state(0));
+
+    // ts_ms keeps advancing so every row is a fresh insert
+    auto ts = std::make_shared<std::uint64_t>(
+        static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count()));
+
+    cases.push_back({"statedb.write_batch/256",
+                     [db, batch, ts](std::uint64_t n) {
+                         for (std::uint64_t i = 0; i < n; ++i) {
+                             for (auto& s : *batch) s.ts_ms = ++*ts;
+                             if (!db->write_batch(*batch)) {
+                                 std::cerr << "[hft_bench] StateDB::write_batch failed\n";
+                                 std::exit(1);
+                             }
+                         }
+                     },
+                     0.0, static_cast<double>(ROWS)});
+}
+
+static void add_strategy_cases(std::vector<BenchCase>& cases) {
+    // Imbalance oscillating through the entry threshold so every branch runs
+    auto states = std::make_shared<std::vector<MarketState>>(1024);
+    std::mt19937_64 rng(5);
+    std::uniform_real_distribution<double> imb(-1.0, 1.0);
+    for (std::size_t i = 0; i < states->size(); ++i) {
+        auto& s = (*states)[i];
+        s.exchange = "bybit";
+        s.instrument = kSymbol;
+        s.ts_ms = static_cast<std::int64_t>(i);
+        s.bid = 3000.00;
+        s.ask = 3000.01;
+        s.mid = 3000.005;
+        s.spread = 0.01;
+        s.imbalance = imb(rng);
+    }
+    auto taker = std::make_shared<ImbalanceTaker>(0.6, 150);
+    auto idx = std::make_shared<std::size_t>(0);
+
+    cases.push_back({"strategy.imbalance_taker.on_state",
+                     [states, taker, idx](std::uint64_t n) {
+                         for (std::uint64_t i = 0; i < n; ++i) {
+                             int sig = taker->on_state((*states)[(*idx)++ & 1023]);
+                             do_not_optimize(sig);
+                         }
+                     },
+                     0.0, 0.0});
+
+    // Receiver -> worker handoff, both ends on one thread (no cross-core transfer)
+    auto ring = std::make_shared<SpscRing<PackedMarketState, 1024>>();
+    auto out = std::make_shared<MarketState>();
+    auto ridx = std::make_shared<std::size_t>(0);
+    cases.push_back({"strategy.market_ring.push_pop",
+                     [states, ring, out, ridx](std::uint64_t n) {
+                         PackedMarketState p;
+                         for (std::uint64_t i = 0; i < n; ++i) {
+                             pack_market_state((*states)[*ridx & 1023], static_cast<std::uint32_t>(*ridx & 1023), p);
+                             ++*ridx;
+                             ring->push(p);
+                             ring->try_pop(p);
+                             unpack_market_state(p, *out);
+                             do_not_optimize(*out);
+                         }
+                     },
+                     0.0, 0.0});
+
+    auto wallet = std::make_shared<VirtualWallet>(10000.0);
+    auto k = std::make_shared<std::uint64_t>(0);
+    cases.push_back({"strategy.wallet.fill_and_mark",
+                     [wallet, k](std::uint64_t n) {
+                         for (std::uint64_t i = 0; i < n; ++i) {
+                             const double px = 3000.0 + static_cast<double>(*k & 15) * 0.01;
+                             if ((*k)++ & 1) wallet->on_fill_sell(0.1, px);
+                             else            wallet->on_fill_buy(0.1, px);
+                             wallet->mark(px);
+                             do_not_optimize(wallet->snap());
+                         }
+                     },
+                     0.0, 0.0});
+}
+
+// ------------------------------------------------------------
+// JSON output / comparison
+// ------------------------------------------------------------
+static json results_to_json(const std::vector<BenchResult>& rs) {
+    json arr = json::array();
+    for (const auto& r : rs) {
+        arr.push_back({{"name", r.name},
+                       {"ns_per_op", r.ns_per_op},
+                       {"allocs_per_op", r.allocs_per_op},
+                       {"ops_per_sec", r.ops_per_sec},
+                       {"bytes_per_op", r.bytes_per_op},
+                       {"items_per_op", r.items_per_op},
+                       {"iterations", r.iterations}});
+    }
+    return {{"schema", "hft_bench_v1"}, {"results", arr}};
+}
+
+static bool print_comparison(const std::string& path, const std::vector<BenchResult>& rs) {
+    std::ifstream in(path);
+    json base = json::parse(in, nullptr, false);
+    if (!in.is_open() || base.is_discarded() || !base.contains("results")) {
+        std::cerr << "[hft_bench] cannot read baseline " << path << "\n";
+        return false;
+    }
+
+    std::map<std::string, json> by_name;
+    for (const auto& r : base["results"]) by_name[r.value("name", "")] = r;
+
+    std::printf("\nvs %s\n%-36s %12s %12s %9s %12s\n", path.c_str(),
+                "case", "base ns/op", "ns/op", "delta", "allocs/op");
+    for (const auto& r : rs) {
+        auto it = by_name.find(r.name);
+        if (it == by_name.end()) {
+            std::printf("%-36s %12s %12.1f %9s %12.2f\n", r.name.c_str(), "-", r.ns_per_op, "new", r.allocs_per_op);
+            continue;
+        }
+        const double b = it->second.value("ns_per_op", 0.0);
+        const double ba = it->second.value("allocs_per_op", 0.0);
+        char allocs[32];
+        std::snprintf(allocs, sizeof(allocs), "%.2f%s", r.allocs_per_op,
+                      r.allocs_per_op > ba + 0.005 ? " (+)" : (r.allocs_per_op < ba - 0.005 ? " (-)" : ""));
+        std::printf("%-36s %12.1f %12.1f %+8.1f%% %12s\n", r.name.c_str(), b, r.ns_per_op,
+                    b > 0 ? (r.ns_per_op - b) / b * 100.0 : 0.0, allocs);
+    }
+    return true;
+}
+
+static void usage() {
+    std::cerr << "Usage: hft_bench [--filter substr] [--min-time-ms N] [--list]\n"
+              << "                 [--bybit-frames f.frames] [--binance-frames f.frames]\n"
+              << "                 [--json out.json] [--compare baseline.json]\n";
+}
+
+int main(int argc, char** argv) {
+    BenchInputs in;
+    std::string filter, json_path, compare_path;
+    double min_time_ms = 300.0;
+    bool list = false;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string a = argv[i];
+        if (a == "--filter" && i + 1 < argc) filter = argv[++i];
+        else if (a == "--min-time-ms" && i + 1 < argc) min_time_ms = std::stod(argv[++i]);
+        else if (a == "--bybit-frames" && i + 1 < argc) in.bybit_frames = argv[++i];
+        else if (a == "--binance-frames" && i + 1 < argc) in.binance_frames = argv[++i];
+        else if (a == "--json" && i + 1 < argc) json_path = argv[++i];
+        else if (a == "--compare" && i + 1 < argc) compare_path = argv[++i];
+        else if (a == "--list") list = true;
+        else {
+            usage();
+            return 1;
+        }
+    }
+
+    // Scratch dir for the StateDB case (removed on exit)
+    char tmpl[] = "/tmp/hft_bench.XXXXXX";
+    if (!mkdtemp(tmpl)) {
+        std::perror("[hft_bench] mkdtemp");
+        return 1;
+    }
+    in.tmp_dir = tmpl;
+
+    int rc = 0;
+    {
+        std::vector<BenchCase> cases;
+        add_orderbook_cases(cases);
+        if (!add_feed_cases(cases, in)) rc = 1;
+        add_publish_cases(cases);
+        add_state_db_case(cases, in);
+        add_strategy_cases(cases);
+
+        std::vector<BenchResult> results;
+        if (rc == 0) {
+            if (!list) print_header();
+            for (const auto& c : cases) {
+                if (!filter.empty() && c.name.find(filter) == std::string::npos) continue;
+                if (list) {
+                    std::printf("%s\n", c.name.c_str());
+                    continue;
+                }
+                results.push_back(run_case(c, min_time_ms));
+                print_result(results.back());
+            }
+        }
+
+        if (rc == 0 && !json_path.empty()) {
+            std::ofstream out(json_path);
+            out << results_to_json(results).dump(2) << "\n";
+            if (!out) {
+                std::cerr << "[hft_bench] cannot write " << json_path << "\n";
+                rc = 1;
+            }
+        }
+        if (rc == 0 && !compare_path.empty() && !print_comparison(compare_path, results))
+            rc = 1;
+    }   // StateDB closed before its files go
+
+    std::error_code ec;
+    std::filesystem::remove_all(in.tmp_dir, ec);
+    return rc;
+}
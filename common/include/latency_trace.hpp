@@ -0,0 +1,222 @@
+#pragma once
+// Tick-to-trade latency tracing shared by hft_feeds, strategy_runner and place_order.
+//
+// A TraceContext rides with one market tick: hft_feeds stamps it from
+// ws.read() to ZMQ publish and sends it in the market_state "trace" object;
+// consumers add their own stamps and copy it into OrderIntent / Trade.
+// All stamps are CLOCK_MONOTONIC ns, which is shared by every process on one
+// host (cross-host spans are meaningless). 0 = stage not reached / untraced.
+//
+// Spans go into per-thread histograms: each thread writes only its own
+// (relaxed atomics, no locks after the first record on a thread), a reader
+// merges all of them for latency_report(). SIGUSR1 requests a dump.
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+inline std::uint64_t trace_now_ns() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<std::uint64_t>(ts.tv_sec) * 1000000000ull + static_cast<std::uint64_t>(ts.tv_nsec);
+}
+
+struct TraceContext {
+    std::uint64_t id = 0;           // hft_feeds quote sequence (unique per run)
+
+    // hft_feeds (published)
+    std::uint64_t recv_ns = 0;      // ws.read() returned
+    std::uint64_t quote_ns = 0;     // quote folded into MarketDataManager state
+    std::uint64_t snap_ns = 0;      // sampling tick that picked it up
+    std::uint64_t pub_ns = 0;       // payload built for ZMQ publish
+
+    // consumer (local)
+    std::uint64_t rx_ns = 0;        // ZMQ recv returned
+    std::uint64_t parsed_ns = 0;    // payload parsed
+    std::uint64_t dequeue_ns = 0;   // strategy worker / exec thread picked it up
+    std::uint64_t signal_ns = 0;    // strategy decision made
+    std::uint64_t intent_ns = 0;    // order intent queued
+    std::uint64_t submit_ns = 0;    // execution call returned (paper fill / REST reply)
+};
+
+// Consumer side: read the market_state "trace" object (nlohmann::json or
+// compatible). Leaves t untouched when the payload is untraced.
+template <class Json>
+inline void trace_from_json(const Json& j, TraceContext& t) {
+    auto it = j.find("trace");
+    if (it == j.end() || !it->is_object()) return;
+    t.id       = it->value("id", std::uint64_t{0});
+    t.recv_ns  = it->value("recv_ns", std::uint64_t{0});
+    t.quote_ns = it->value("quote_ns", std::uint64_t{0});
+    t.snap_ns  = it->value("snap_ns", std::uint64_t{0});
+    t.pub_ns   = it->value("pub_ns", std::uint64_t{0});
+}
+
+enum LatencySpan : int {
+    LS_FEED_PARSE = 0,  // recv -> quote          (JSON parse + book update + state lock)
+    LS_FEED_SAMPLE,     // quote -> snapshot tick (poll interval wait)
+    LS_FEED_PUBLISH,    // snapshot tick -> publish returned
+    LS_ZMQ,             // pub -> rx              (cross process)
+    LS_RX_PARSE,        // rx -> parsed
+    LS_STRAT_QUEUE,     // parsed -> worker dequeue (market ring)
+    LS_STRAT_SIGNAL,    // dequeue -> ImbalanceTaker::on_state returned
+    LS_EXEC_QUEUE,      // intent queued -> exec thread dequeue (g_exec_q)
+    LS_EXEC_SUBMIT,     // PaperExecutionEngine::submit
+    LS_REST_POST,       // BybitDemoClient::post round trip
+    LS_WS_ORDER,        // BybitTradeWsClient order queued -> ack
+    LS_TICK_TO_SIGNAL,  // recv -> signal
+    LS_TICK_TO_TRADE,   // recv of the tick traded on -> submit returned
+    LS_SPAN_COUNT
+};
+
+inline const char* latency_span_name(int s) {
+    static const char* names[LS_SPAN_COUNT] = {
+        "feed.parse", "feed.sample", "feed.publish", "zmq", "rx.parse",
+        "strat.queue", "strat.signal", "exec.queue", "exec.submit",
+        "rest.post", "ws.order", "tick_to_signal", "tick_to_trade"
+    };
+    return (s >= 0 && s < LS_SPAN_COUNT) ? names[s] : "?";
+}
+
+// Log-linear buckets: exact below 8ns, then 8 sub-buckets per power of two (~12% wide)
+class LatencyHistogram {
+public:
+    static constexpr int SUB_BITS = 3;
+    static constexpr int SUB = 1 << SUB_BITS;
+    static constexpr int BUCKETS = (64 - SUB_BITS + 1) * SUB;
+
+    static int bucket(std::uint64_t v) {
+        if (v < static_cast<std::uint64_t>(SUB)) return static_cast<int>(v);
+        const int msb = 63 - __builtin_clzll(v);
+        const int sub = static_cast<int>((v >> (msb - SUB_BITS)) & (SUB - 1));
+        return (msb - SUB_BITS + 1) * SUB + sub;
+    }
+
+    // Largest value that lands in bucket b
+    static std::uint64_t bucket_upper(int b) {
+        if (b < SUB) return static_cast<std::uint64_t>(b);
+        const int msb = b / SUB + SUB_BITS - 1;
+        const std::uint64_t base = 1ull << msb;
+        const std::uint64_t width = base >> SUB_BITS;
+        return base + (static_cast<std::uint64_t>(b % SUB) + 1) * width - 1;
+    }
+
+    // Owning thread only
+    void record(std::uint64_t v) {
+        auto& c = counts_[bucket(v)];
+        c.store(c.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        count_.store(count_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        if (v > max_.load(std::memory_order_relaxed)) max_.store(v, std::memory_order_relaxed);
+    }
+
+    // Any thread
+    void merge_into(std::vector<std::uint64_t>& counts, std::uint64_t& total, std::uint64_t& max) const {
+        for (int b = 0; b < BUCKETS; ++b) counts[b] += counts_[b].load(std::memory_order_relaxed);
+        total += count_.load(std::memory_order_relaxed);
+        max = std::max(max, max_.load(std::memory_order_relaxed));
+    }
+
+private:
+    std::atomic<std::uint64_t> counts_[BUCKETS] = {};
+    std::atomic<std::uint64_t> count_{0};
+    std::atomic<std::uint64_t> max_{0};
+};
+
+struct LatencyThreadHistograms {
+    LatencyHistogram spans[LS_SPAN_COUNT];
+};
+
+// Every thread's histograms; entries live until exit so a finished thread still reports
+struct LatencyRegistry {
+    std::mutex mtx;
+    std::vector<std::unique_ptr<LatencyThreadHistograms>> threads;
+
+    static LatencyRegistry& instance() {
+        static LatencyRegistry r;
+        return r;
+    }
+};
+
+inline LatencyThreadHistograms& latency_thread_histograms() {
+    thread_local LatencyThreadHistograms* h = nullptr;
+    if (!h) {
+        auto& r = LatencyRegistry::instance();
+        std::lock_guard<std::mutex> lk(r.mtx);
+        r.threads.push_back(std::make_unique<LatencyThreadHistograms>());
+        h = r.threads.back().get();
+    }
+    return *h;
+}
+
+// Record to - from; skipped when either end was never stamped
+inline void trace_span(LatencySpan s, std::uint64_t from_ns, std::uint64_t to_ns) {
+    if (from_ns == 0 || to_ns == 0 || to_ns < from_ns) return;
+    latency_thread_histograms().spans[s].record(to_ns - from_ns);
+}
+
+// One line per span with samples: count, p50/p90/p99/p99.9/max in microseconds
+inline std::string latency_report(const char* who) {
+    std::vector<std::vector<std::uint64_t>> counts(LS_SPAN_COUNT,
+        std::vector<std::uint64_t>(LatencyHistogram::BUCKETS, 0));
+    std::uint64_t totals[LS_SPAN_COUNT] = {};
+    std::uint64_t maxes[LS_SPAN_COUNT] = {};
+
+    {
+        auto& r = LatencyRegistry::instance();
+        std::lock_guard<std::mutex> lk(r.mtx);
+        for (const auto& t : r.threads) {
+            for (int s = 0; s < LS_SPAN_COUNT; ++s)
+                t->spans[s].merge_into(counts[s], totals[s], maxes[s]);
+        }
+    }
+
+    std::string out;
+    char line[192];
+    std::snprintf(line, sizeof(line), "[latency] %s (us)  %-15s %10s %9s %9s %9s %9s %9s\n",
+                  who, "span", "count", "p50", "p90", "p99", "p99.9", "max");
+    out += line;
+
+    for (int s = 0; s < LS_SPAN_COUNT; ++s) {
+        if (totals[s] == 0) continue;
+
+        const double qs[4] = {0.50, 0.90, 0.99, 0.999};
+        double pv[4] = {};
+        std::uint64_t seen = 0;
+        int qi = 0;
+        for (int b = 0; b < LatencyHistogram::BUCKETS && qi < 4; ++b) {
+            seen += counts[s][b];
+            while (qi < 4 && seen >= std::max<std::uint64_t>(1, static_cast<std::uint64_t>(std::ceil(qs[qi] * totals[s])))) {
+                pv[qi++] = std::min(LatencyHistogram::bucket_upper(b), maxes[s]) / 1000.0;
+            }
+        }
+
+        std::snprintf(line, sizeof(line), "[latency] %s       %-15s %10llu %9.1f %9.1f %9.1f %9.1f %9.1f\n",
+                      who, latency_span_name(s), static_cast<unsigned long long>(totals[s]),
+                      pv[0], pv[1], pv[2], pv[3], maxes[s] / 1000.0);
+        out += line;
+    }
+    return out;
+}
+
+// ---- on-demand dump: kill -USR1 <pid>, polled by a loop that owns stdout ----
+inline std::atomic<bool>& latency_dump_flag() {
+    static std::atomic<bool> f{false};
+    return f;
+}
+
+inline void latency_install_sigusr1() {
+    std::signal(SIGUSR1, [](int) { latency_dump_flag().store(true, std::memory_order_relaxed); });
+}
+
+inline bool latency_dump_requested() {
+    return latency_dump_flag().load(std::memory_order_relaxed) &&
+           latency_dump_flag().exchange(false, std::memory_order_relaxed);
+}
@@ -0,0 +1,299 @@
+#pragma once
+// In-process pre-trade risk gate shared by strategy_runner and place_order.
+//
+// Every counter the checks need lives here, fed by the caller from its own
+// fills / acks / order updates, so a check is a handful of relaxed loads and
+// compares with no I/O and no lock. Per instrument (any string key, e.g.
+// "linear|BTCUSDT"):
+//   pos                     signed position, from position pushes while
+//                           they come, else from fills
+//   open_buy / open_sell    qty resting or in flight, reserved on send
+//   open_notional           price * qty of the above
+// plus one order-rate window for the process.
+//
+// Threads: check_and_reserve() is for the single order-entry thread (it
+// owns the rate window). Fills, releases and position updates may come from
+// any thread; the counters are atomics and adds are CAS loops. A check that
+// races an update sees either side of it, which is as good as the
+// exchange's own view at that instant.
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class PreTradeRisk {
+public:
+    static constexpr std::uint32_t NONE = 0xffffffffu;
+
+    // One send time is kept per allowed order
+    static constexpr int MAX_ORDERS_PER_S = 1000000;
+
+    // 0 / unset disables a limit (stored as +inf, so it costs no branch)
+    struct Limits {
+        double max_order_qty = 0.0;          // per order, base qty
+        double max_order_notional = 0.0;     // per order, qty * price
+        double max_position = 0.0;           // |pos + same-side open + qty|
+        double max_open_notional = 0.0;      // per instrument, open + this order
+        int max_orders_per_s = 0;            // process-wide, at most MAX_ORDERS_PER_S
+
+        // RISK_MAX_ORDER_QTY, RISK_MAX_ORDER_NOTIONAL, RISK_MAX_POSITION,
+        // RISK_MAX_OPEN_NOTIONAL, RISK_MAX_ORDERS_PER_S
+        static Limits from_env() {
+            auto num = [](const char* k) {
+                const char* v = std::getenv(k);
+                return v ? std::atof(v) : 0.0;
+            };
+            Limits l;
+            l.max_order_qty      = num("RISK_MAX_ORDER_QTY");
+            l.max_order_notional = num("RISK_MAX_ORDER_NOTIONAL");
+            l.max_position       = num("RISK_MAX_POSITION");
+            l.max_open_notional  = num("RISK_MAX_OPEN_NOTIONAL");
+            l.max_orders_per_s   = static_cast<int>(std::min(num("RISK_MAX_ORDERS_PER_S"),
+                                                         double(std::numeric_limits<int>::max())));
+            return l;
+        }
+    };
+
+    // check_and_reserve() result: 0 = pass, else one bit per failed check
+    enum Reject : unsigned {
+        R_QTY           = 1u << 0,
+        R_NOTIONAL      = 1u << 1,
+        R_POSITION      = 1u << 2,
+        R_OPEN_NOTIONAL = 1u << 3,
+        R_RATE          = 1u << 4,
+        R_BAD_ORDER     = 1u << 5,   // qty / price not positive, unknown instrument
+    };
+    static constexpr int R_COUNT = 6;
+
+    static const char* reject_name(int bit) {
+        static const char* names[R_COUNT] = {
+            "order_qty", "order_notional", "position", "open_notional", "rate", "bad_order"
+        };
+        return (bit >= 0 && bit < R_COUNT) ? names[bit] : "?";
+    }
+
+    // What a passed check reserved; hand it back through release() for the
+    // part that will never rest (rejected, cancelled, filled)
+    struct Hold {
+        std::uint32_t id = NONE;
+        int side = 0;          // +1 buy, -1 sell
+        double qty = 0.0;
+        double px = 0.0;
+    };
+
+    PreTradeRisk(std::uint32_t capacity, const Limits& lim)
+        : capacity_(capacity),
+          keys_(new std::string[capacity]),
+          slots_(new Slot[capacity]),
+          max_qty_(limit_or_inf(lim.max_order_qty)),
+          max_notional_(limit_or_inf(lim.max_order_notional)),
+          max_position_(limit_or_inf(lim.max_position)),
+          max_open_notional_(limit_or_inf(lim.max_open_notional)),
+          sent_ns_(rate_slots(lim.max_orders_per_s), 0) {}
+
+    // Any thread. Slot of key, assigned on first sight; NONE when full.
+    std::uint32_t intern(const std::string& key) {
+        const std::uint32_t found = find(key);
+        if (found != NONE) return found;
+
+        std::lock_guard<std::mutex> lk(intern_mtx_);
+        const std::uint32_t n = count_.load(std::memory_order_relaxed);
+        for (std::uint32_t id = 0; id < n; ++id)
+            if (keys_[id] == key) return id;
+        if (n >= capacity_) return NONE;
+        keys_[n] = key;
+        count_.store(n + 1, std::memory_order_release);   // publishes keys_[n]
+        return n;
+    }
+
+    // Any thread; linear scan
+    std::uint32_t find(const std::string& key) const {
+        const std::uint32_t n = size();
+        for (std::uint32_t id = 0; id < n; ++id)
+            if (keys_[id] == key) return id;
+        return NONE;
+    }
+
+    std::uint32_t size() const { return count_.load(std::memory_order_acquire); }
+    const std::string& key(std::uint32_t id) const { return keys_[id]; }
+
+    // Order-entry thread. All checks are evaluated and OR-ed into one mask;
+    // on 0 the order is counted against the rate window and its qty /
+    // notional reserved as open, and `hold` describes the reservation.
+    unsigned check_and_reserve(std::uint32_t id, bool buy, double qty, double px,
+                               std::uint64_t now_ns, Hold& hold) {
+        hold = Hold{};
+        if (id >= capacity_ || !(qty > 0.0) || !(px > 0.0)) return count_reject(R_BAD_ORDER);
+
+        Slot& s = slots_[id];
+        const double side = buy ? 1.0 : -1.0;
+        const double notional = qty * px;
+        const double pos = s.pos.load(std::memory_order_relaxed);
+        const double open_same = (buy ? s.open_buy : s.open_sell).load(std::memory_order_relaxed);
+        const double open_notional = s.open_notional.load(std::memory_order_relaxed);
+        const bool rate_limited = !sent_ns_.empty();
+        const std::uint64_t oldest = rate_limited ? sent_ns_[rate_head_] : 0;
+
+        const unsigned r =
+              static_cast<unsigned>(qty > max_qty_)
+            | static_cast<unsigned>(notional > max_notional_) << 1
+            | static_cast<unsigned>(std::fabs(pos + side * (open_same + qty)) > max_position_) << 2
+            | static_cast<unsigned>(open_notional + notional > max_open_notional_) << 3
+            | static_cast<unsigned>(rate_limited && now_ns - oldest < RATE_WINDOW_NS) << 4;
+        if (r) return count_reject(r);
+
+        if (rate_limited) {
+            sent_ns_[rate_head_] = now_ns;
+            rate_head_ = rate_head_ + 1 == sent_ns_.size() ? 0 : rate_head_ + 1;
+        }
+
+        add(buy ? s.open_buy : s.open_sell, qty);
+        add(s.open_notional, notional);
+        bump(passed_);
+        hold = Hold{id, buy ? 1 : -1, qty, px};
+        return 0;
+    }
+
+    // Any thread: qty of a hold that is no longer open
+    void release(const Hold& h, double qty) {
+        if (h.id >= capacity_ || h.side == 0) return;
+        qty = std::min(qty, h.qty);
+        if (!(qty > 0.0)) return;
+        Slot& s = slots_[h.id];
+        add(h.side > 0 ? s.open_buy : s.open_sell, -qty);
+        add(s.open_notional, -qty * h.px);
+    }
+
+    // Any thread: a fill changes the position by +qty (buy) / -qty (sell).
+    // Ignored while set_position() owns the position: a push can land before
+    // or after the fill it includes, so adding both would count it twice.
+    void on_fill(std::uint32_t id, bool buy, double qty) {
+        if (id >= capacity_ || slots_[id].pos_known.load(std::memory_order_acquire)) return;
+        add(slots_[id].pos, buy ? qty : -qty);
+    }
+
+    // Any thread: authoritative position from the exchange; fills stop
+    // moving it until forget_positions()
+    void set_position(std::uint32_t id, double signed_qty) {
+        if (id >= capacity_) return;
+        slots_[id].pos.store(signed_qty, std::memory_order_relaxed);
+        slots_[id].pos_known.store(true, std::memory_order_release);
+    }
+
+    // Any thread: the position feed stopped (e.g. its stream dropped). The
+    // last pushed positions stay and fills move them again until the next push.
+    void forget_positions() {
+        const std::uint32_t n = size();
+        for (std::uint32_t i = 0; i < n; ++i)
+            slots_[i].pos_known.store(false, std::memory_order_release);
+    }
+
+    // Any thread. false until set_position() was called for id, and again
+    // after forget_positions().
+    bool position(std::uint32_t id, double& out) const {
+        if (id >= capacity_ || !slots_[id].pos_known.load(std::memory_order_acquire)) return false;
+        out = slots_[id].pos.load(std::memory_order_relaxed);
+        return true;
+    }
+
+    struct View {
+        double pos = 0.0;
+        bool pos_known = false;
+        double open_buy = 0.0;
+        double open_sell = 0.0;
+        double open_notional = 0.0;
+    };
+
+    View view(std::uint32_t id) const {
+        View v;
+        if (id >= capacity_) return v;
+        const Slot& s = slots_[id];
+        v.pos = s.pos.load(std::memory_order_relaxed);
+        v.pos_known = s.pos_known.load(std::memory_order_relaxed);
+        v.open_buy = s.open_buy.load(std::memory_order_relaxed);
+        v.open_sell = s.open_sell.load(std::memory_order_relaxed);
+        v.open_notional = s.open_notional.load(std::memory_order_relaxed);
+        return v;
+    }
+
+    std::uint64_t passed() const { return passed_.load(std::memory_order_relaxed); }
+    std::uint64_t rejected(int bit) const {
+        return (bit >= 0 && bit < R_COUNT) ? rejects_[bit].load(std::memory_order_relaxed) : 0;
+    }
+
+    // "order_qty,rate" for a reject mask
+    static std::string describe(unsigned mask) {
+        std::string out;
+        for (int b = 0; b < R_COUNT; ++b) {
+            if (!(mask & (1u << b))) continue;
+            if (!out.empty()) out += ",";
+            out += reject_name(b);
+        }
+        return out;
+    }
+
+private:
+    struct alignas(64) Slot {
+        std::atomic<double> pos{0.0};
+        std::atomic<double> open_buy{0.0};
+        std::atomic<double> open_sell{0.0};
+        std::atomic<double> open_notional{0.0};
+        std::atomic<bool> pos_known{false};
+    };
+
+    // Ring size for a max_orders_per_s; out of range is said, not clamped
+    static std::size_t rate_slots(int per_s) {
+        if (per_s <= MAX_ORDERS_PER_S) return static_cast<std::size_t>(std::max(per_s, 0));
+        std::cerr << "[RISK] max orders/s " << per_s << " is above " << MAX_ORDERS_PER_S
+                  << "; order rate limit off\n";
+        return 0;
+    }
+
+    static double limit_or_inf(double v) {
+        return v > 0.0 ? v : std::numeric_limits<double>::infinity();
+    }
+
+    static void add(std::atomic<double>& a, double d) {
+        double cur = a.load(std::memory_order_relaxed);
+        while (!a.compare_exchange_weak(cur, cur + d, std::memory_order_relaxed)) {}
+    }
+
+    // Order-entry thread is the only writer of the counters
+    static void bump(std::atomic<std::uint64_t>& c) {
+        c.store(c.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    unsigned count_reject(unsigned mask) {
+        for (int b = 0; b < R_COUNT; ++b)
+            if (mask & (1u << b)) bump(rejects_[b]);
+        return mask;
+    }
+
+    const std::uint32_t capacity_;
+    std::unique_ptr<std::string[]> keys_;
+    std::unique_ptr<Slot[]> slots_;
+    std::atomic<std::uint32_t> count_{0};
+    std::mutex intern_mtx_;
+
+    const double max_qty_;
+    const double max_notional_;
+    const double max_position_;
+    const double max_open_notional_;
+
+    // Order-entry thread only: send times of the last max_orders_per_s
+    // orders (none when unlimited); the slot at rate_head_ is the oldest
+    static constexpr std::uint64_t RATE_WINDOW_NS = 1000000000ull;
+    std::vector<std::uint64_t> sent_ns_;
+    std::size_t rate_head_ = 0;
+
+    std::atomic<std::uint64_t> passed_{0};
+    std::atomic<std::uint64_t> rejects_[R_COUNT] = {};
+};
@@ -8,8 +8,19 @@ public:
     explicit BinanceL2Feed(std::string instrument, int depth);
 
     void run() override;
+    void handle_frame(std::string_view frame, long long recv_ms) override;
+    void on_disconnect() override;
+
+    const char* exchange() const override { return "binance"; }
+    const std::string& instrument() const override { return instrument_; }
 
 private:
     std::string instrument_;    // e.g. "ETHUSDT"
 	int depth_ = 20;
+
+    // Parse state carried across frames
+    OrderBook ob_;
+    double spot_     = 0.0;     // last traded price from 24hrTicker
+    double best_bid_ = 0.0;     // from bookTicker
+    double best_ask_ = 0.0;     // from bookTicker
 };
@@ -8,8 +8,20 @@ public:
     explicit BybitL2Feed(std::string instrument, int depth);
 
     void run() override;
+    void handle_frame(std::string_view frame, long long recv_ms) override;
+    void on_disconnect() override;
+
+    const char* exchange() const override { return "bybit"; }
+    const std::string& instrument() const override { return instrument_; }
 
 private:
     std::string instrument_;   // e.g. "ETHUSDT"
 	int depth_ = 20;
+    int sub_depth_ = 50;       // Bybit orderbook depth actually subscribed (1/50/200/1000)
+    std::string book_topic_;   // "orderbook.<sub_depth_>.<instrument_>"
+
+    // Parse state carried across frames
+    OrderBook ob_;
+    double spot_ = 0.0;        // lastPrice from ticker
+    long long last_u_ = 0;     // orderbook update id; 0 = waiting for a snapshot
 };
@@ -1,7 +1,11 @@
 #pragma once
 #include "Quote.hpp"
+#include "FrameLog.hpp"
+#include <cstdint>
 #include <functional>
+#include <memory>
 #include <string>
+#include <string_view>
 
 class OrderBook;
 
@@ -12,6 +16,37 @@ public:
     // Blocking loop: connect WS, maintain orderbook, emit L1 quotes
     virtual void run() = 0;
 
+    // Parse one received frame (orderbook / quote updates, on_quote).
+    // recv_ms stamps emitted quotes: wall clock live, recorded time in replay.
+    virtual void handle_frame(std::string_view frame, long long recv_ms) = 0;
+
+    // Connection dropped: discard book state, the resubscribe brings a snapshot
+    virtual void on_disconnect() {}
+
+    // "bybit" / "binance" and the symbol this feed subscribes to
+    virtual const char* exchange() const = 0;
+    virtual const std::string& instrument() const = 0;
+
+    // True once after handle_frame() saw a sequence gap; the transport
+    // drops the connection and resubscribes
+    bool take_resync() {
+        const bool r = resync_;
+        resync_ = false;
+        return r;
+    }
+
     // Called whenever we have a new L1 quote
     std::function<void(const Quote&, const OrderBook&)> on_quote;
+
+    // Optional: every received frame is appended here (set before run())
+    std::unique_ptr<FrameRecorder> recorder;
+
+    // Optional ws:// / wss:// URL replacing the exchange default (set before run())
+    std::string endpoint;
+
+    // CLOCK_MONOTONIC at ws.read() of the frame being handled (0 in replay)
+    std::uint64_t trace_recv_ns = 0;
+
+protected:
+    bool resync_ = false;
 };
@@ -3,6 +3,7 @@
 #include "IFeed.hpp"
 #include "BinanceL2Feed.hpp"
 #include "BybitL2Feed.hpp"
+#include "ReplayFeed.hpp"
 #include "../src/core/ZmqPublisher.hpp"
 #include <memory>
 #include <thread>
@@ -15,6 +16,7 @@
 #include "StateDB.hpp"
 #include <mutex>
 #include <atomic>
+#include <fstream>
 
 /* ================= Exchange Choice ================= */
 
@@ -74,18 +76,47 @@ public:
         ExchangeChoice choice,
         const std::vector<std::string>& instruments,
         int orderBookDepth,
-        int orderBookPollFrequencyInMs
+        int orderBookPollFrequencyInMs,
+        const StateDBOptions& stateDbOptions = StateDBOptions{}
     );
 
+    // Replay mode: one ReplayFeed per frame log, no websockets.
+    // An empty stateDbOptions.path disables market_state.db writes.
+    MarketDataManager(
+        const std::vector<std::string>& replay_files,
+        int orderBookDepth,
+        int orderBookPollFrequencyInMs,
+        const StateDBOptions& stateDbOptions,
+        bool publish
+    );
+
+    // Record every feed's raw frames to <dir>/<exchange>_<instrument>_<utc time>.frames.
+    // Call before start_all().
+    bool enable_recording(const std::string& dir);
+
+    // Point every feed of `exchange` ("bybit"/"binance") at another ws:// or
+    // wss:// URL, e.g. the local mock_exchange. Call before start_all().
+    void set_endpoint(const std::string& exchange, const std::string& url);
+
     void start_all();
     void join_all();
 
+    // Single-threaded deterministic replay of every ReplayFeed, merged by
+    // receive time, with snapshot ticks on a simulated clock. speed <= 0 runs
+    // as fast as possible. Each snapshot payload is also written to
+    // features_path (JSONL) if given. Returns frames replayed.
+    std::uint64_t run_replay(double speed, const std::string& features_path);
+
+    // One sampling tick at ts_ms: publish + persist every key's state
+    void snapshot_once(std::uint64_t ts_ms);
+
     // ZMQ
     std::unique_ptr<ZmqPublisher> zmq_pub_;
     std::mutex zmq_pub_mtx_;
 
 private:
     void snapshot_loop();
+    void on_feed_quote(const char* ex, const Quote& q, const OrderBook& ob);
 
 private:
     std::vector<std::unique_ptr<IFeed>> feeds_;
@@ -105,7 +136,16 @@ private:
     std::unordered_map<MarketKey, Quote, MarketKeyHash> last_quote_;
     std::unordered_map<MarketKey, OrderBook, MarketKeyHash> last_ob_;
 
-    StateDB state_db_{"market_state.db"};
+    // Latency trace: id per traced quote (under state_mtx_), and the last id
+    // each key published (snapshot thread only) so a quote is traced once
+    std::uint64_t trace_seq_ = 0;
+    std::unordered_map<MarketKey, std::uint64_t, MarketKeyHash> last_traced_id_;
+
+    StateDB state_db_;
+    bool state_db_enabled_ = true;
+
+    std::vector<ReplayFeed*> replay_feeds_;   // owned by feeds_
+    std::ofstream features_out_;
 
     int order_book_depth_ = 20;
     int snapshot_freq_ms_ = 50;
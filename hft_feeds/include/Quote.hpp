@@ -1,4 +1,5 @@
 #pragma once
+#include "latency_trace.hpp"
 #include <string>
 
 struct Quote {
@@ -8,4 +9,6 @@ struct Quote {
     double ask = 0.0;        // best ask
     double spot = 0.0;       // last traded price / spot
     long long ts_ms = 0;     // local timestamp in ms
+    long long exch_ts_ms = 0; // exchange send time in ms (Bybit "ts", Binance "E"), 0 if the frame has none
+    TraceContext trace;      // latency stamps (recv_ns from the feed, rest by MarketDataManager)
 };
@@ -0,0 +1,49 @@
+#pragma once
+#include "IFeed.hpp"
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// Plays a frame log (FrameRecorder output) through the live feed's parser:
+// same handle_frame(), same OrderBook, same on_quote. Quotes carry the
+// recorded receive time, so nothing downstream reads the wall clock.
+class ReplayFeed : public IFeed {
+public:
+    explicit ReplayFeed(std::string path, int depth);
+
+    // Reads the header and builds the matching Bybit/Binance parser
+    bool open();
+
+    // Standalone playback on its own thread; speed <= 0 = as fast as possible,
+    // 1.0 = recorded pace. MarketDataManager::run_replay() steps feeds itself.
+    void run() override;
+    void set_speed(double speed) { speed_ = speed; }
+
+    void handle_frame(std::string_view frame, long long recv_ms) override;
+
+    const char* exchange() const override;
+    const std::string& instrument() const override { return instrument_; }
+
+    // Frame-at-a-time driving for a merged, single-threaded replay
+    bool has_next() const { return has_next_; }
+    std::uint64_t next_ns() const { return next_.recv_ns; }
+    void step();
+
+    std::uint64_t frames() const { return frames_; }
+
+private:
+    void advance();
+
+    std::string path_;
+    int depth_ = 20;
+    double speed_ = 0.0;
+
+    FrameReader reader_;
+    std::unique_ptr<IFeed> parser_;   // BybitL2Feed / BinanceL2Feed
+    std::string exchange_;
+    std::string instrument_;
+
+    FrameView next_;
+    bool has_next_ = false;
+    std::uint64_t frames_ = 0;
+};
@@ -0,0 +1,12 @@
+#pragma once
+
+#include "OrderBook.hpp"
+#include "Quote.hpp"
+#include "StateDB.hpp"
+#include <string>
+
+// market_state_v1 JSON payload published on ZMQ (Quote + OrderBook + StateSnapshot)
+std::string serialize_snapshot(const std::string& ex,
+                               const Quote& q,
+                               const OrderBook& ob,
+                               const StateSnapshot& s);
@@ -0,0 +1,20 @@
+#pragma once
+#include <string>
+
+class IFeed;
+
+// Where a feed connects: parsed from "wss://host[:port]/target" or
+// "ws://host[:port]/target" (plain TCP, for the local mock exchange)
+struct WsEndpoint {
+    bool tls = true;
+    std::string host;
+    std::string port;
+    std::string target = "/";
+};
+
+bool parse_ws_url(const std::string& url, WsEndpoint& out);
+
+// Blocking: connect, send `subscribe`, read frames into feed.handle_frame()
+// (timestamped + recorded). Reconnects with backoff when the connection drops
+// or the feed asks for a resync; feed.on_disconnect() runs before each retry.
+void ws_run_feed(const WsEndpoint& ep, const std::string& subscribe, IFeed& feed);
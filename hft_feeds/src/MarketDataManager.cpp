@@ -1,71 +1,23 @@
 #include "MarketDataManager.hpp"
+#include "SnapshotSerializer.hpp"
 #include <iostream>
 #include <cmath>
 #include <iomanip>
 #include <sstream>
 #include <chrono>
-
-// NOTE: unchanged serializer (we still use Quote + OrderBook + StateSnapshot)
-static std::string serialize_snapshot(
-    const std::string& ex,
-    const Quote& q,
-    const OrderBook& ob,
-    const StateSnapshot& s)
-{
-    std::ostringstream oss;
-    oss.setf(std::ios::fixed);
-    oss << std::setprecision(8);
-
-    oss << "{";
-    oss << "\"schema\":\"market_state_v1\",";
-    oss << "\"exchange\":\"" << ex << "\",";
-    oss << "\"instrument\":\"" << q.instrument << "\",";
-    oss << "\"ts_ms\":" << q.ts_ms << ",";
-
-    oss << "\"book_meta\":{";
-    oss << "\"bid_levels\":" << ob.bids.size() << ",";
-    oss << "\"ask_levels\":" << ob.asks.size();
-    oss << "},";
-
-    oss << "\"top_of_book\":{";
-    oss << "\"bid\":" << q.bid << ",";
-    oss << "\"ask\":" << q.ask << ",";
-    oss << "\"mid\":" << s.mid << ",";
-    oss << "\"spread\":" << s.spread;
-    oss << "},";
-
-    oss << "\"returns\":{";
-    oss << "\"r1\":" << s.r1 << ",";
-    oss << "\"r5\":" << s.r5 << ",";
-    oss << "\"r10\":" << s.r10;
-    oss << "},";
-
-    oss << "\"depth\":{";
-    oss << "\"bid_vol\":["
-        << s.bid_vol[0] << "," << s.bid_vol[1] << ","
-        << s.bid_vol[2] << "," << s.bid_vol[3] << ","
-        << s.bid_vol[4] << "],";
-    oss << "\"ask_vol\":["
-        << s.ask_vol[0] << "," << s.ask_vol[1] << ","
-        << s.ask_vol[2] << "," << s.ask_vol[3] << ","
-        << s.ask_vol[4] << "]";
-    oss << "},";
-
-    oss << "\"features\":{";
-    //SuPr moving it to strategy oss << "\"imbalance\":" << s.imbalance;
-    oss << "}";
-
-    oss << "}";
-
-    return oss.str();
-}
+#include <ctime>
+#include <algorithm>
+#include <filesystem>
 
 MarketDataManager::MarketDataManager(
     ExchangeChoice choice,
     const std::vector<std::string>& instruments,
     int orderBookDepth,
-    int orderBookPollFrequencyInMs)
-    : order_book_depth_(orderBookDepth),
+    int orderBookPollFrequencyInMs,
+    const StateDBOptions& stateDbOptions)
+    : state_db_(stateDbOptions),
+      state_db_enabled_(!stateDbOptions.path.empty()),
+      order_book_depth_(orderBookDepth),
       snapshot_freq_ms_(orderBookPollFrequencyInMs)
 {
     zmq_pub_ = std::make_unique<ZmqPublisher>("tcp://*:5555");
@@ -78,66 +30,7 @@ MarketDataManager::MarketDataManager(
 
             // ✅ state-only update (NO publish, NO DB push, NO cout)
             f->on_quote = [this](const Quote& q, const OrderBook& ob) {
-                const std::string ex = "binance";
-                MarketKey key{ex, q.instrument};
-
-                std::lock_guard<std::mutex> lock(state_mtx_);
-
-                // keep latest quote + book for snapshot thread
-                last_quote_[key] = q;
-                last_ob_[key]    = ob;
-
-                // ---- MID & SPREAD ----
-                double mid    = 0.5 * (q.bid + q.ask);
-                double spread = q.ask - q.bid;
-
-                auto& state = state_[key];
-                auto& hist  = price_history_[key];
-
-                state.mid    = mid;
-                state.spread = spread;
-
-                // ---- PRICE HISTORY ----
-                hist.emplace_back(q.ts_ms, mid);
-                while (!hist.empty() && q.ts_ms - hist.front().first > 15000) {
-                    hist.pop_front();
-                }
-
-                // ---- RETURNS ----
-                state.r1 = state.r5 = state.r10 = 0.0;
-
-                for (auto it = hist.rbegin(); it != hist.rend(); ++it) {
-                    double dt = (q.ts_ms - it->first) / 1000.0;
-                    if (dt >= 1.0  && state.r1  == 0.0) state.r1  = std::log(mid / it->second);
-                    if (dt >= 5.0  && state.r5  == 0.0) state.r5  = std::log(mid / it->second);
-                    if (dt >= 10.0 && state.r10 == 0.0) state.r10 = std::log(mid / it->second);
-                }
-
-                // ---- TOP-5 BID/ASK VOLUMES ----
-                int i = 0;
-                for (const auto& [px, qty] : ob.bids) {
-                    if (i >= 5) break;
-                    state.bid_vol[i++] = qty;
-                }
-                for (; i < 5; ++i) state.bid_vol[i] = 0.0;
-
-                i = 0;
-                for (const auto& [px, qty] : ob.asks) {
-                    if (i >= 5) break;
-                    state.ask_vol[i++] = qty;
-                }
-                for (; i < 5; ++i) state.ask_vol[i] = 0.0;
-
-                // ---- IMBALANCE ----
-                double bid_sum = 0.0, ask_sum = 0.0;
-                for (int k = 0; k < 5; ++k) {
-                    bid_sum += state.bid_vol[k];
-                    ask_sum += state.ask_vol[k];
-                }
-                const double eps = 1e-9;
-                //SuPr moving it to strategy state.imbalance = (bid_sum - ask_sum) / (bid_sum + ask_sum + eps);
-
-                state.cross_ex_signal = 0.0;
+                on_feed_quote("binance", q, ob);
             };
 
             feeds_.push_back(std::move(f));
@@ -149,60 +42,7 @@ MarketDataManager::MarketDataManager(
 
             // ✅ state-only update (NO publish, NO DB push, NO cout)
             f->on_quote = [this](const Quote& q, const OrderBook& ob) {
-                const std::string ex = "bybit";
-                MarketKey key{ex, q.instrument};
-
-                std::lock_guard<std::mutex> lock(state_mtx_);
-
-                last_quote_[key] = q;
-                last_ob_[key]    = ob;
-
-                double mid    = 0.5 * (q.bid + q.ask);
-                double spread = q.ask - q.bid;
-
-                auto& state = state_[key];
-                auto& hist  = price_history_[key];
-
-                state.mid    = mid;
-                state.spread = spread;
-
-                hist.emplace_back(q.ts_ms, mid);
-                while (!hist.empty() && q.ts_ms - hist.front().first > 15000) {
-                    hist.pop_front();
-                }
-
-                state.r1 = state.r5 = state.r10 = 0.0;
-
-                for (auto it = hist.rbegin(); it != hist.rend(); ++it) {
-                    double dt = (q.ts_ms - it->first) / 1000.0;
-                    if (dt >= 1.0  && state.r1  == 0.0) state.r1  = std::log(mid / it->second);
-                    if (dt >= 5.0  && state.r5  == 0.0) state.r5  = std::log(mid / it->second);
-                    if (dt >= 10.0 && state.r10 == 0.0) state.r10 = std::log(mid / it->second);
-                }
-
-                int i = 0;
-                for (const auto& [px, qty] : ob.bids) {
-                    if (i >= 5) break;
-                    state.bid_vol[i++] = qty;
-                }
-                for (; i < 5; ++i) state.bid_vol[i] = 0.0;
-
-                i = 0;
-                for (const auto& [px, qty] : ob.asks) {
-                    if (i >= 5) break;
-                    state.ask_vol[i++] = qty;
-                }
-                for (; i < 5; ++i) state.ask_vol[i] = 0.0;
-
-                double bid_sum = 0.0, ask_sum = 0.0;
-                for (int k = 0; k < 5; ++k) {
-                    bid_sum += state.bid_vol[k];
-                    ask_sum += state.ask_vol[k];
-                }
-                const double eps = 1e-9;
-                //SuPr moving it to strategy state.imbalance = (bid_sum - ask_sum) / (bid_sum + ask_sum + eps);
-
-                state.cross_ex_signal = 0.0;
+                on_feed_quote("bybit", q, ob);
             };
 
             feeds_.push_back(std::move(f));
@@ -210,8 +50,145 @@ MarketDataManager::MarketDataManager(
     }
 }
 
+MarketDataManager::MarketDataManager(
+    const std::vector<std::string>& replay_files,
+    int orderBookDepth,
+    int orderBookPollFrequencyInMs,
+    const StateDBOptions& stateDbOptions,
+    bool publish)
+    : state_db_(stateDbOptions),
+      state_db_enabled_(!stateDbOptions.path.empty()),
+      order_book_depth_(orderBookDepth),
+      snapshot_freq_ms_(orderBookPollFrequencyInMs)
+{
+    if (publish)
+        zmq_pub_ = std::make_unique<ZmqPublisher>("tcp://*:5555");
+
+    for (const auto& path : replay_files) {
+        auto f = std::make_unique<ReplayFeed>(path, order_book_depth_);
+        if (!f->open()) continue;
+
+        std::cout << "[MarketDataManager] replaying " << f->exchange() << " "
+                  << f->instrument() << " from " << path << "\n";
+
+        f->on_quote = [this, ex = std::string(f->exchange())](const Quote& q, const OrderBook& ob) {
+            on_feed_quote(ex.c_str(), q, ob);
+        };
+
+        replay_feeds_.push_back(f.get());
+        feeds_.push_back(std::move(f));
+    }
+}
+
+// Feed thread: fold one quote + book into the per-key state vector
+void MarketDataManager::on_feed_quote(const char* ex, const Quote& q, const OrderBook& ob) {
+    MarketKey key{ex, q.instrument};
+
+    std::lock_guard<std::mutex> lock(state_mtx_);
+
+    // keep latest quote + book for snapshot thread
+    Quote& lq = last_quote_[key];
+    lq = q;
+    last_ob_[key] = ob;
+
+    if (q.trace.recv_ns) {
+        lq.trace.id       = ++trace_seq_;
+        lq.trace.quote_ns = trace_now_ns();
+        trace_span(LS_FEED_PARSE, q.trace.recv_ns, lq.trace.quote_ns);
+    }
+
+    // ---- MID & SPREAD ----
+    double mid    = 0.5 * (q.bid + q.ask);
+    double spread = q.ask - q.bid;
+
+    auto& state = state_[key];
+    auto& hist  = price_history_[key];
+
+    state.mid    = mid;
+    state.spread = spread;
+
+    // ---- PRICE HISTORY ----
+    hist.emplace_back(q.ts_ms, mid);
+    while (!hist.empty() && q.ts_ms - hist.front().first > 15000) {
+        hist.pop_front();
+    }
+
+    // ---- RETURNS ----
+    state.r1 = state.r5 = state.r10 = 0.0;
+
+    for (auto it = hist.rbegin(); it != hist.rend(); ++it) {
+        double dt = (q.ts_ms - it->first) / 1000.0;
+        if (dt >= 1.0  && state.r1  == 0.0) state.r1  = std::log(mid / it->second);
+        if (dt >= 5.0  && state.r5  == 0.0) state.r5  = std::log(mid / it->second);
+        if (dt >= 10.0 && state.r10 == 0.0) state.r10 = std::log(mid / it->second);
+    }
+
+    // ---- TOP-5 BID/ASK VOLUMES ----
+    int i = 0;
+    for (const auto& [px, qty] : ob.bids) {
+        if (i >= 5) break;
+        state.bid_vol[i++] = qty;
+    }
+    for (; i < 5; ++i) state.bid_vol[i] = 0.0;
+
+    i = 0;
+    for (const auto& [px, qty] : ob.asks) {
+        if (i >= 5) break;
+        state.ask_vol[i++] = qty;
+    }
+    for (; i < 5; ++i) state.ask_vol[i] = 0.0;
+
+    // ---- IMBALANCE ----
+    double bid_sum = 0.0, ask_sum = 0.0;
+    for (int k = 0; k < 5; ++k) {
+        bid_sum += state.bid_vol[k];
+        ask_sum += state.ask_vol[k];
+    }
+    const double eps = 1e-9;
+    //SuPr moving it to strategy state.imbalance = (bid_sum - ask_sum) / (bid_sum + ask_sum + eps);
+
+    state.cross_ex_signal = 0.0;
+}
+
+void MarketDataManager::set_endpoint(const std::string& exchange, const std::string& url) {
+    for (auto& f : feeds_) {
+        if (exchange == f->exchange()) f->endpoint = url;
+    }
+    std::cout << "[MarketDataManager] " << exchange << " endpoint " << url << "\n";
+}
+
+bool MarketDataManager::enable_recording(const std::string& dir) {
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+    if (ec) {
+        std::cerr << "[MarketDataManager] cannot create record dir " << dir << ": " << ec.message() << "\n";
+        return false;
+    }
+
+    const std::time_t now = std::time(nullptr);
+    std::tm tm{};
+    gmtime_r(&now, &tm);
+    char stamp[32];
+    std::strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", &tm);
+
+    bool ok = true;
+    for (auto& f : feeds_) {
+        const std::string path = dir + "/" + f->exchange() + "_" + f->instrument() + "_" + stamp + ".frames";
+
+        auto rec = std::make_unique<FrameRecorder>(path, f->exchange(), f->instrument());
+        if (!rec->start()) {
+            ok = false;
+            continue;
+        }
+        std::cout << "[MarketDataManager] recording frames to " << path << "\n";
+        f->recorder = std::move(rec);
+    }
+    return ok;
+}
+
 void MarketDataManager::start_all() {
-    state_db_.start();
+    if (state_db_enabled_)
+        state_db_.start();
 
     // start feed threads
     threads_.reserve(feeds_.size());
@@ -238,7 +215,79 @@ void MarketDataManager::join_all() {
     if (snapshot_thread_.joinable())
         snapshot_thread_.join();
 
-    state_db_.stop();
+    if (state_db_enabled_)
+        state_db_.stop();
+
+    for (auto& f : feeds_) {
+        if (f->recorder) f->recorder->stop();
+    }
+}
+
+std::uint64_t MarketDataManager::run_replay(double speed, const std::string& features_path) {
+    using namespace std::chrono;
+
+    if (!features_path.empty()) {
+        features_out_.open(features_path, std::ios::out | std::ios::trunc);
+        if (!features_out_.is_open())
+            std::cerr << "[MarketDataManager] cannot open " << features_path << "\n";
+    }
+    if (state_db_enabled_)
+        state_db_.start();
+
+    // Simulated clock: starts at the earliest recorded frame, advances only
+    // with the frames, and fires a sampling tick every snapshot_freq_ms_.
+    std::uint64_t first_ns = UINT64_MAX;
+    for (auto* f : replay_feeds_) {
+        if (f->has_next() && f->next_ns() < first_ns) first_ns = f->next_ns();
+    }
+
+    std::uint64_t frames = 0, ticks = 0;
+    const auto wall0 = steady_clock::now();
+
+    if (first_ns != UINT64_MAX) {
+        const std::uint64_t freq = static_cast<std::uint64_t>(std::max(1, snapshot_freq_ms_));
+        std::uint64_t next_tick = (first_ns / 1000000 / freq + 1) * freq;
+
+        while (true) {
+            // k-way merge by receive time; ties go to the earlier file on the command line
+            ReplayFeed* nf = nullptr;
+            for (auto* f : replay_feeds_) {
+                if (f->has_next() && (!nf || f->next_ns() < nf->next_ns())) nf = f;
+            }
+            if (!nf) break;
+
+            // A tick at T sees every frame received before T, as a live tick would
+            const std::uint64_t t_ms = nf->next_ns() / 1000000;
+            while (next_tick <= t_ms) {
+                snapshot_once(next_tick);
+                next_tick += freq;
+                ++ticks;
+            }
+
+            if (speed > 0.0) {
+                std::this_thread::sleep_until(wall0 + nanoseconds(
+                    static_cast<std::int64_t>((nf->next_ns() - first_ns) / speed)));
+            }
+
+            nf->step();
+            ++frames;
+        }
+
+        // Final tick so the state after the last frame is emitted too
+        snapshot_once(next_tick);
+        ++ticks;
+    }
+
+    const double secs = duration<double>(steady_clock::now() - wall0).count();
+    std::cout << "[MarketDataManager] replay frames=" << frames
+              << " ticks=" << ticks
+              << " in " << secs << "s ("
+              << (secs > 0 ? frames / secs : 0.0) << " msgs/s)\n";
+
+    if (state_db_enabled_)
+        state_db_.stop();
+    features_out_.close();
+    return frames;
 }
 
 void MarketDataManager::snapshot_loop() {
@@ -249,76 +298,103 @@ void MarketDataManager::snapshot_loop() {
     while (running_) {
         auto t0 = steady_clock::now();
 
-        // Copy under lock (keep lock short)
-        std::vector<std::pair<MarketKey, StateVector>> states_copy;
-        std::vector<std::pair<MarketKey, Quote>> quotes_copy;
-        std::vector<std::pair<MarketKey, OrderBook>> obs_copy;
+        if (latency_dump_requested())
+            std::cout << latency_report("hft_feeds") << std::flush;
+
+        snapshot_once(static_cast<std::uint64_t>(duration_cast<milliseconds>(
+            system_clock::now().time_since_epoch()
+        ).count()));
+
+        std::this_thread::sleep_until(t0 + interval);
+    }
+}
+
+// One sampling tick at ts_ms (wall clock live, simulated clock in replay)
+void MarketDataManager::snapshot_once(std::uint64_t ts_ms) {
+    const std::uint64_t snap_ns = trace_now_ns();
+
+    // Copy under lock (keep lock short)
+    std::vector<std::pair<MarketKey, StateVector>> states_copy;
+    std::vector<std::pair<MarketKey, Quote>> quotes_copy;
+    std::vector<std::pair<MarketKey, OrderBook>> obs_copy;
 
-        {
-            std::lock_guard<std::mutex> lock(state_mtx_);
+    {
+        std::lock_guard<std::mutex> lock(state_mtx_);
 
-            states_copy.reserve(state_.size());
-            for (const auto& kv : state_) states_copy.push_back(kv);
+        states_copy.reserve(state_.size());
+        for (const auto& kv : state_) states_copy.push_back(kv);
 
-            quotes_copy.reserve(last_quote_.size());
-            for (const auto& kv : last_quote_) quotes_copy.push_back(kv);
+        quotes_copy.reserve(last_quote_.size());
+        for (const auto& kv : last_quote_) quotes_copy.push_back(kv);
 
-            obs_copy.reserve(last_ob_.size());
-            for (const auto& kv : last_ob_) obs_copy.push_back(kv);
+        obs_copy.reserve(last_ob_.size());
+        for (const auto& kv : last_ob_) obs_copy.push_back(kv);
+    }
+
+    // Build lookup maps (local)
+    std::unordered_map<MarketKey, Quote, MarketKeyHash> qmap;
+    std::unordered_map<MarketKey, OrderBook, MarketKeyHash> obmap;
+
+    for (auto& kv : quotes_copy) qmap.emplace(kv.first, std::move(kv.second));
+    for (auto& kv : obs_copy)    obmap.emplace(kv.first, std::move(kv.second));
+
+    // Emit snapshots on fixed clock
+    for (const auto& [key, st] : states_copy) {
+        auto qit  = qmap.find(key);
+        auto obit = obmap.find(key);
+        if (qit == qmap.end() || obit == obmap.end())
+            continue;
+
+        Quote q = qit->second;          // copy
+        const OrderBook& ob = obit->second;
+
+        // overwrite ts to sampling time (this is what you want)
+        q.ts_ms = static_cast<long long>(ts_ms);
+
+        // Trace a quote on the first tick that samples it; later ticks
+        // republishing the same quote go out untraced
+        auto& last_id = last_traced_id_[key];
+        if (q.trace.id && q.trace.id != last_id) {
+            last_id = q.trace.id;
+            q.trace.snap_ns = snap_ns;
+            q.trace.pub_ns  = trace_now_ns();
+            trace_span(LS_FEED_SAMPLE, q.trace.quote_ns, snap_ns);
+        } else {
+            q.trace = TraceContext{};
         }
 
-        // Build lookup maps (local)
-        std::unordered_map<MarketKey, Quote, MarketKeyHash> qmap;
-        std::unordered_map<MarketKey, OrderBook, MarketKeyHash> obmap;
-
-        for (auto& kv : quotes_copy) qmap.emplace(kv.first, std::move(kv.second));
-        for (auto& kv : obs_copy)    obmap.emplace(kv.first, std::move(kv.second));
-
-        // Emit snapshots on fixed clock
-        for (const auto& [key, st] : states_copy) {
-            auto qit  = qmap.find(key);
-            auto obit = obmap.find(key);
-            if (qit == qmap.end() || obit == obmap.end())
-                continue;
-
-            Quote q = qit->second;          // copy
-            const OrderBook& ob = obit->second;
-
-            // overwrite ts to sampling time (this is what you want)
-            q.ts_ms = duration_cast<milliseconds>(
-                system_clock::now().time_since_epoch()
-            ).count();
-
-            StateSnapshot snap;
-            snap.exchange   = key.exchange;
-            snap.instrument = key.instrument;
-            snap.ts_ms      = q.ts_ms;
-
-            snap.mid    = st.mid;
-            snap.spread = st.spread;
-            snap.r1     = st.r1;
-            snap.r5     = st.r5;
-            snap.r10    = st.r10;
-
-            //SuPr moving it to strategy snap.imbalance       = st.imbalance;
-            snap.cross_ex_signal = st.cross_ex_signal;
-
-            for (int i = 0; i < 5; ++i) {
-                snap.bid_vol[i] = st.bid_vol[i];
-                snap.ask_vol[i] = st.ask_vol[i];
-            }
+        StateSnapshot snap;
+        snap.exchange   = key.exchange;
+        snap.instrument = key.instrument;
+        snap.ts_ms      = q.ts_ms;
 
-            const std::string topic = "state." + key.exchange + "." + key.instrument;
-            const std::string payload = serialize_snapshot(key.exchange, q, ob, snap);
+        snap.mid    = st.mid;
+        snap.spread = st.spread;
+        snap.r1     = st.r1;
+        snap.r5     = st.r5;
+        snap.r10    = st.r10;
 
-            {
-                std::lock_guard<std::mutex> lock(zmq_pub_mtx_);
-                zmq_pub_->publish(topic, payload);
-            }
+        //SuPr moving it to strategy snap.imbalance       = st.imbalance;
+        snap.cross_ex_signal = st.cross_ex_signal;
 
-            state_db_.push(std::move(snap));
+        for (int i = 0; i < 5; ++i) {
+            snap.bid_vol[i] = st.bid_vol[i];
+            snap.ask_vol[i] = st.ask_vol[i];
         }
 
-        std::this_thread::sleep_until(t0 + interval);
+        const std::string topic = "state." + key.exchange + "." + key.instrument;
+        const std::string payload = serialize_snapshot(key.exchange, q, ob, snap);
+
+        if (zmq_pub_) {
+            std::lock_guard<std::mutex> lock(zmq_pub_mtx_);
+            zmq_pub_->publish(topic, payload);
+        }
+        if (q.trace.id)
+            trace_span(LS_FEED_PUBLISH, snap_ns, trace_now_ns());
+        if (features_out_.is_open())
+            features_out_ << payload << '\n';
+
+        if (state_db_enabled_)
+            state_db_.push(std::move(snap));
     }
 }
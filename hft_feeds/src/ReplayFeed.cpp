@@ -0,0 +1,69 @@
+#include "ReplayFeed.hpp"
+#include "BinanceL2Feed.hpp"
+#include "BybitL2Feed.hpp"
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+ReplayFeed::ReplayFeed(std::string path, int depth)
+    : path_(std::move(path)), depth_(depth), reader_(path_)
+{}
+
+bool ReplayFeed::open() {
+    if (!reader_.open()) return false;
+
+    exchange_   = reader_.exchange();
+    instrument_ = reader_.instrument();
+
+    if (exchange_ == "bybit")
+        parser_ = std::make_unique<BybitL2Feed>(instrument_, depth_);
+    else if (exchange_ == "binance")
+        parser_ = std::make_unique<BinanceL2Feed>(instrument_, depth_);
+    else {
+        std::cerr << "[ReplayFeed] " << path_ << ": unknown exchange '" << exchange_ << "'\n";
+        return false;
+    }
+
+    // Forward to whatever on_quote is installed on this feed at call time
+    parser_->on_quote = [this](const Quote& q, const OrderBook& ob) {
+        if (on_quote) on_quote(q, ob);
+    };
+
+    advance();
+    return true;
+}
+
+const char* ReplayFeed::exchange() const {
+    return parser_ ? parser_->exchange() : "replay";
+}
+
+void ReplayFeed::handle_frame(std::string_view frame, long long recv_ms) {
+    if (parser_) parser_->handle_frame(frame, recv_ms);
+}
+
+void ReplayFeed::advance() {
+    has_next_ = reader_.next(next_);
+}
+
+void ReplayFeed::step() {
+    if (!has_next_) return;
+    handle_frame(next_.data, static_cast<long long>(next_.recv_ns / 1000000));
+    ++frames_;
+    advance();
+}
+
+void ReplayFeed::run() {
+    if (!parser_ && !open()) return;
+
+    const auto wall0 = std::chrono::steady_clock::now();
+    const std::uint64_t rec0 = has_next_ ? next_.recv_ns : 0;
+
+    while (has_next_) {
+        if (speed_ > 0.0) {
+            const auto due = wall0 + std::chrono::nanoseconds(
+                static_cast<std::int64_t>((next_.recv_ns - rec0) / speed_));
+            std::this_thread::sleep_until(due);
+        }
+        step();
+    }
+}
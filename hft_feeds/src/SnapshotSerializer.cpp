@@ -0,0 +1,83 @@
+#include "SnapshotSerializer.hpp"
+#include <iomanip>
+#include <sstream>
+
+std::string serialize_snapshot(
+    const std::string& ex,
+    const Quote& q,
+    const OrderBook& ob,
+    const StateSnapshot& s)
+{
+    std::ostringstream oss;
+    oss.setf(std::ios::fixed);
+    oss << std::setprecision(8);
+
+    oss << "{";
+    oss << "\"schema\":\"market_state_v1\",";
+    oss << "\"exchange\":\"" << ex << "\",";
+    oss << "\"instrument\":\"" << q.instrument << "\",";
+    oss << "\"ts_ms\":" << q.ts_ms << ",";
+    oss << "\"exch_ts_ms\":" << q.exch_ts_ms << ",";
+
+    // Only on the first snapshot that carries this quote
+    if (q.trace.id) {
+        oss << "\"trace\":{";
+        oss << "\"id\":" << q.trace.id << ",";
+        oss << "\"recv_ns\":" << q.trace.recv_ns << ",";
+        oss << "\"quote_ns\":" << q.trace.quote_ns << ",";
+        oss << "\"snap_ns\":" << q.trace.snap_ns << ",";
+        oss << "\"pub_ns\":" << q.trace.pub_ns;
+        oss << "},";
+    }
+
+    oss << "\"book_meta\":{";
+    oss << "\"bid_levels\":" << ob.bids.size() << ",";
+    oss << "\"ask_levels\":" << ob.asks.size();
+    oss << "},";
+
+    oss << "\"top_of_book\":{";
+    oss << "\"bid\":" << q.bid << ",";
+    oss << "\"ask\":" << q.ask << ",";
+    oss << "\"mid\":" << s.mid << ",";
+    oss << "\"spread\":" << s.spread;
+    oss << "},";
+
+    oss << "\"returns\":{";
+    oss << "\"r1\":" << s.r1 << ",";
+    oss << "\"r5\":" << s.r5 << ",";
+    oss << "\"r10\":" << s.r10;
+    oss << "},";
+
+    oss << "\"depth\":{";
+    oss << "\"bid_vol\":["
+        << s.bid_vol[0] << "," << s.bid_vol[1] << ","
+        << s.bid_vol[2] << "," << s.bid_vol[3] << ","
+        << s.bid_vol[4] << "],";
+    oss << "\"ask_vol\":["
+        << s.ask_vol[0] << "," << s.ask_vol[1] << ","
+        << s.ask_vol[2] << "," << s.ask_vol[3] << ","
+        << s.ask_vol[4] << "],";
+
+    // Prices of those levels (0 past the end of the book)
+    auto write_px = [&oss](const char* name, const auto& side) {
+        oss << "\"" << name << "\":[";
+        auto it = side.begin();
+        for (int i = 0; i < 5; ++i) {
+            if (i) oss << ",";
+            oss << (it != side.end() ? (it++)->first : 0.0);
+        }
+        oss << "]";
+    };
+    write_px("bid_px", ob.bids);
+    oss << ",";
+    write_px("ask_px", ob.asks);
+    oss << "},";
+
+    oss << "\"features\":{";
+    //SuPr moving it to strategy oss << "\"imbalance\":" << s.imbalance;
+    oss << "}";
+
+    oss << "}";
+
+    return oss.str();
+}
@@ -0,0 +1,145 @@
+#include "WsTransport.hpp"
+#include "IFeed.hpp"
+#include <boost/beast/core.hpp>
+#include <boost/beast/ssl.hpp>
+#include <boost/beast/websocket.hpp>
+#include <boost/asio/connect.hpp>
+#include <boost/asio/ssl.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <thread>
+
+namespace beast     = boost::beast;
+namespace websocket = beast::websocket;
+namespace net       = boost::asio;
+namespace ssl       = net::ssl;
+using tcp           = net::ip::tcp;
+
+bool parse_ws_url(const std::string& url, WsEndpoint& out) {
+    WsEndpoint ep;
+    std::string rest;
+    if (url.rfind("wss://", 0) == 0) {
+        ep.tls = true;
+        rest = url.substr(6);
+    } else if (url.rfind("ws://", 0) == 0) {
+        ep.tls = false;
+        rest = url.substr(5);
+    } else {
+        return false;
+    }
+
+    const auto slash = rest.find('/');
+    const std::string authority = rest.substr(0, slash);
+    if (slash != std::string::npos) ep.target = rest.substr(slash);
+
+    const auto colon = authority.rfind(':');
+    if (colon != std::string::npos) {
+        ep.host = authority.substr(0, colon);
+        ep.port = authority.substr(colon + 1);
+    } else {
+        ep.host = authority;
+        ep.port = ep.tls ? "443" : "80";
+    }
+    if (ep.host.empty() || ep.port.empty()) return false;
+
+    out = std::move(ep);
+    return true;
+}
+
+// ------------------------------------------------------------
+// One connection: subscribe, then read until the socket fails
+// (throws) or the feed asks for a resync (returns)
+// ------------------------------------------------------------
+template <class WsStream>
+static void read_frames(WsStream& ws, const std::string& subscribe, IFeed& feed,
+                        std::uint64_t& frames)
+{
+    ws.write(net::buffer(subscribe));
+
+    beast::flat_buffer buffer;
+
+    while (true) {
+        buffer.consume(buffer.size());
+        ws.read(buffer);
+
+        const std::uint64_t recv_ns = frame_clock_ns();
+        feed.trace_recv_ns = trace_now_ns();
+        if (feed.recorder)
+            feed.recorder->record(buffer.data().data(), buffer.size(), recv_ns);
+
+        feed.handle_frame(std::string_view(static_cast<const char*>(buffer.data().data()),
+                                           buffer.size()),
+                          static_cast<long long>(recv_ns / 1000000));
+        ++frames;
+
+        if (feed.take_resync()) {
+            beast::error_code ec;
+            ws.close(websocket::close_code::normal, ec);
+            return;
+        }
+    }
+}
+
+static void connect_and_read(const WsEndpoint& ep, const std::string& subscribe,
+                             IFeed& feed, std::uint64_t& frames)
+{
+    net::io_context ioc;
+
+    tcp::resolver resolver(ioc);
+    auto const results = resolver.resolve(ep.host, ep.port);
+
+    if (ep.tls) {
+        ssl::context ctx(ssl::context::tlsv12_client);
+        ctx.set_default_verify_paths();
+        ctx.set_verify_mode(ssl::verify_peer);
+
+        beast::ssl_stream<beast::tcp_stream> tls_stream(ioc, ctx);
+        beast::get_lowest_layer(tls_stream).connect(results);
+        SSL_set_tlsext_host_name(tls_stream.native_handle(), ep.host.c_str());
+        tls_stream.handshake(ssl::stream_base::client);
+
+        websocket::stream<beast::ssl_stream<beast::tcp_stream>> ws(std::move(tls_stream));
+        ws.handshake(ep.host, ep.target);
+
+        std::cout << "[WsTransport] " << feed.exchange() << " " << feed.instrument()
+                  << " connected wss://" << ep.host << ":" << ep.port << ep.target << "\n";
+        read_frames(ws, subscribe, feed, frames);
+    } else {
+        websocket::stream<beast::tcp_stream> ws(ioc);
+        ws.next_layer().connect(results);
+        ws.next_layer().socket().set_option(tcp::no_delay(true));
+        ws.handshake(ep.host + ":" + ep.port, ep.target);
+
+        std::cout << "[WsTransport] " << feed.exchange() << " " << feed.instrument()
+                  << " connected ws://" << ep.host << ":" << ep.port << ep.target << "\n";
+        read_frames(ws, subscribe, feed, frames);
+    }
+}
+
+void ws_run_feed(const WsEndpoint& ep, const std::string& subscribe, IFeed& feed) {
+    using namespace std::chrono;
+
+    const milliseconds min_backoff(100), max_backoff(5000);
+    milliseconds backoff = min_backoff;
+
+    while (true) {
+        std::uint64_t frames = 0;
+        try {
+            connect_and_read(ep, subscribe, feed, frames);
+            std::cerr << "[WsTransport] " << feed.exchange() << " " << feed.instrument()
+                      << " resync after " << frames << " frames\n";
+        } catch (const std::exception& ex) {
+            std::cerr << "[WsTransport] " << feed.exchange() << " " << feed.instrument()
+                      << " disconnected after " << frames << " frames: " << ex.what() << "\n";
+        }
+
+        feed.on_disconnect();
+
+        // A session that delivered data resets the backoff; a dead endpoint backs off
+        if (frames > 0) backoff = min_backoff;
+        std::this_thread::sleep_for(backoff);
+        backoff = std::min(backoff * 2, max_backoff);
+    }
+}
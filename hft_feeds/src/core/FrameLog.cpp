@@ -0,0 +1,274 @@
+#include "FrameLog.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+
+// File grows in steps of this size (ftruncate + mremap), never per frame
+static constexpr std::size_t kFileStep = 64u << 20;
+
+std::uint64_t frame_clock_ns() {
+    timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return static_cast<std::uint64_t>(ts.tv_sec) * 1000000000ull +
+           static_cast<std::uint64_t>(ts.tv_nsec);
+}
+
+static std::size_t round_pow2(std::size_t n) {
+    std::size_t p = 4096;
+    while (p < n) p <<= 1;
+    return p;
+}
+
+// ------------------------------------------------------------
+// FrameRecorder
+// ------------------------------------------------------------
+
+FrameRecorder::FrameRecorder(std::string path,
+                             std::string exchange,
+                             std::string instrument,
+                             std::size_t ring_bytes)
+    : path_(std::move(path))
+    , exchange_(std::move(exchange))
+    , instrument_(std::move(instrument))
+    , ring_(round_pow2(ring_bytes))
+    , mask_(ring_.size() - 1)
+{}
+
+FrameRecorder::~FrameRecorder() {
+    stop();
+}
+
+bool FrameRecorder::start() {
+    if (running_.exchange(true)) return true;
+
+    fd_ = ::open(path_.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd_ < 0) {
+        std::cerr << "[FrameRecorder] open " << path_ << " failed: " << std::strerror(errno) << "\n";
+        running_ = false;
+        return false;
+    }
+    if (!ensure_mapped(kFileStep)) {
+        ::close(fd_);
+        fd_ = -1;
+        running_ = false;
+        return false;
+    }
+
+    FrameFileHeader h{};
+    std::memcpy(h.magic, FRAME_LOG_MAGIC, sizeof(h.magic));
+    h.version = FRAME_LOG_VERSION;
+    h.header_size = sizeof(FrameFileHeader);
+    h.start_ns = frame_clock_ns();
+    std::strncpy(h.exchange, exchange_.c_str(), sizeof(h.exchange) - 1);
+    std::strncpy(h.instrument, instrument_.c_str(), sizeof(h.instrument) - 1);
+    std::memcpy(map_, &h, sizeof(h));
+    written_ = sizeof(h);
+
+    writer_ = std::thread(&FrameRecorder::writer_loop, this);
+    return true;
+}
+
+void FrameRecorder::stop() {
+    if (!running_.exchange(false)) return;
+    if (writer_.joinable()) writer_.join();
+
+    drain();
+
+    const std::size_t end = static_cast<std::size_t>(written_.load());
+    if (map_) {
+        msync(map_, end, MS_SYNC);
+        munmap(map_, map_size_);
+        map_ = nullptr;
+        map_size_ = 0;
+    }
+    if (fd_ >= 0) {
+        if (ftruncate(fd_, static_cast<off_t>(end)) != 0)
+            std::cerr << "[FrameRecorder] ftruncate " << path_ << " failed\n";
+        ::close(fd_);
+        fd_ = -1;
+    }
+
+    std::cerr << "[FrameRecorder] " << path_ << " frames=" << frames()
+              << " dropped=" << dropped() << " bytes=" << end << "\n";
+}
+
+bool FrameRecorder::record(const void* data, std::size_t len, std::uint64_t recv_ns) {
+    if (len == 0) return true;   // len 0 marks end-of-data in the file
+
+    const std::uint64_t need = FRAME_RECORD_HEADER + len;
+    const std::uint64_t head = head_.load(std::memory_order_relaxed);
+
+    // Only re-read the consumer's tail_ (another core's line) when the cached one says full
+    if (head + need - tail_cache_ > ring_.size()) {
+        tail_cache_ = tail_.load(std::memory_order_acquire);
+        if (head + need - tail_cache_ > ring_.size()) {
+            dropped_.store(dropped_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return false;
+        }
+    }
+
+    char hdr[FRAME_RECORD_HEADER];
+    const std::uint32_t len32 = static_cast<std::uint32_t>(len);
+    std::memcpy(hdr, &len32, 4);
+    std::memcpy(hdr + 4, &recv_ns, 8);
+
+    // Copy into the ring, splitting at the wrap point
+    auto put = [&](std::uint64_t at, const char* src, std::size_t n) {
+        const std::size_t off = static_cast<std::size_t>(at & mask_);
+        const std::size_t first = std::min(n, ring_.size() - off);
+        std::memcpy(ring_.data() + off, src, first);
+        if (first < n) std::memcpy(ring_.data(), src + first, n - first);
+    };
+    put(head, hdr, FRAME_RECORD_HEADER);
+    put(head + FRAME_RECORD_HEADER, static_cast<const char*>(data), len);
+
+    head_.store(head + need, std::memory_order_release);
+    frames_.store(frames_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    return true;
+}
+
+bool FrameRecorder::ensure_mapped(std::size_t size) {
+    if (size <= map_size_) return true;
+
+    const std::size_t new_size = std::max(size, map_size_ + kFileStep);
+    if (ftruncate(fd_, static_cast<off_t>(new_size)) != 0) {
+        std::cerr << "[FrameRecorder] ftruncate " << path_ << " failed: " << std::strerror(errno) << "\n";
+        return false;
+    }
+
+    void* m = map_
+        ? mremap(map_, map_size_, new_size, MREMAP_MAYMOVE)
+        : mmap(nullptr, new_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (m == MAP_FAILED) {
+        std::cerr << "[FrameRecorder] mmap " << path_ << " failed: " << std::strerror(errno) << "\n";
+        return false;
+    }
+    map_ = static_cast<char*>(m);
+    map_size_ = new_size;
+    return true;
+}
+
+std::size_t FrameRecorder::drain() {
+    const std::uint64_t tail = tail_.load(std::memory_order_relaxed);
+    const std::uint64_t head = head_.load(std::memory_order_acquire);
+    if (head == tail || !map_) return 0;
+
+    // Ring bytes are already in file format: copy them through verbatim
+    const std::size_t n = static_cast<std::size_t>(head - tail);
+    const std::size_t at = static_cast<std::size_t>(written_.load(std::memory_order_relaxed));
+    if (!ensure_mapped(at + n)) return 0;
+
+    const std::size_t off = static_cast<std::size_t>(tail & mask_);
+    const std::size_t first = std::min(n, ring_.size() - off);
+    std::memcpy(map_ + at, ring_.data() + off, first);
+    if (first < n) std::memcpy(map_ + at + first, ring_.data(), n - first);
+
+    written_.store(at + n, std::memory_order_relaxed);
+    tail_.store(head, std::memory_order_release);
+    return n;
+}
+
+void FrameRecorder::writer_loop() {
+    while (running_) {
+        if (drain() == 0)
+            std::this_thread::sleep_for(std::chrono::microseconds(500));
+    }
+}
+
+// ------------------------------------------------------------
+// FrameReader
+// ------------------------------------------------------------
+
+FrameReader::FrameReader(std::string path)
+    : path_(std::move(path))
+{}
+
+FrameReader::~FrameReader() {
+    close();
+}
+
+bool FrameReader::open() {
+    if (map_) return true;
+
+    fd_ = ::open(path_.c_str(), O_RDONLY);
+    if (fd_ < 0) {
+        std::cerr << "[FrameReader] open " << path_ << " failed: " << std::strerror(errno) << "\n";
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd_, &st) != 0 || static_cast<std::size_t>(st.st_size) < sizeof(FrameFileHeader)) {
+        std::cerr << "[FrameReader] " << path_ << " is not a frame log\n";
+        close();
+        return false;
+    }
+    size_ = static_cast<std::size_t>(st.st_size);
+
+    void* m = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd_, 0);
+    if (m == MAP_FAILED) {
+        std::cerr << "[FrameReader] mmap " << path_ << " failed: " << std::strerror(errno) << "\n";
+        map_ = nullptr;
+        close();
+        return false;
+    }
+    map_ = static_cast<const char*>(m);
+    madvise(m, size_, MADV_SEQUENTIAL);
+
+    std::memcpy(&header_, map_, sizeof(header_));
+    if (std::memcmp(header_.magic, FRAME_LOG_MAGIC, sizeof(header_.magic)) != 0 ||
+        header_.version != FRAME_LOG_VERSION ||
+        header_.header_size < sizeof(FrameFileHeader) || header_.header_size > size_) {
+        std::cerr << "[FrameReader] " << path_ << ": bad header\n";
+        close();
+        return false;
+    }
+
+    pos_ = header_.header_size;
+    return true;
+}
+
+void FrameReader::close() {
+    if (map_) {
+        munmap(const_cast<char*>(map_), size_);
+        map_ = nullptr;
+    }
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+    size_ = 0;
+    pos_ = 0;
+}
+
+std::string FrameReader::exchange() const {
+    return std::string(header_.exchange, strnlen(header_.exchange, sizeof(header_.exchange)));
+}
+
+std::string FrameReader::instrument() const {
+    return std::string(header_.instrument, strnlen(header_.instrument, sizeof(header_.instrument)));
+}
+
+bool FrameReader::next(FrameView& out) {
+    if (!map_ || pos_ + FRAME_RECORD_HEADER > size_) return false;
+
+    std::uint32_t len;
+    std::memcpy(&len, map_ + pos_, 4);
+    if (len == 0 || pos_ + FRAME_RECORD_HEADER + len > size_) return false;   // end / torn tail
+
+    std::memcpy(&out.recv_ns, map_ + pos_ + 4, 8);
+    out.data = std::string_view(map_ + pos_ + FRAME_RECORD_HEADER, len);
+    pos_ += FRAME_RECORD_HEADER + len;
+    return true;
+}
+
+void FrameReader::rewind() {
+    if (map_) pos_ = header_.header_size;
+}
@@ -0,0 +1,128 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// ------------------------------------------------------------
+// Raw websocket frame log (one file per feed instance)
+//
+// File layout, little-endian, no padding:
+//   header   64 bytes   FrameFileHeader
+//   record   u32 len | u64 recv_ns | payload[len]    (repeated)
+//
+// recv_ns is CLOCK_REALTIME in ns, taken right after ws.read().
+// The file is preallocated and mmapped; after a crash the unwritten tail
+// is zeros, so readers stop at the first len == 0.
+// ------------------------------------------------------------
+
+constexpr char FRAME_LOG_MAGIC[8] = {'H','F','T','F','R','M','0','1'};
+constexpr std::uint32_t FRAME_LOG_VERSION = 1;
+constexpr std::size_t FRAME_RECORD_HEADER = 12;    // u32 len + u64 recv_ns
+
+struct FrameFileHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t header_size;      // sizeof(FrameFileHeader)
+    std::uint64_t start_ns;         // recorder start (CLOCK_REALTIME)
+    char exchange[16];              // NUL padded
+    char instrument[24];            // NUL padded
+};
+static_assert(sizeof(FrameFileHeader) == 64, "frame log header must stay 64 bytes");
+
+// CLOCK_REALTIME in ns (vDSO, ~20 ns)
+std::uint64_t frame_clock_ns();
+
+// ------------------------------------------------------------
+// Writer: the feed thread copies each frame into a lock-free SPSC byte
+// ring; a background thread moves ring bytes into the mmapped file.
+// One producer thread per recorder.
+// ------------------------------------------------------------
+class FrameRecorder {
+public:
+    FrameRecorder(std::string path,
+                  std::string exchange,
+                  std::string instrument,
+                  std::size_t ring_bytes = 8u << 20);
+    ~FrameRecorder();
+
+    FrameRecorder(const FrameRecorder&) = delete;
+    FrameRecorder& operator=(const FrameRecorder&) = delete;
+
+    bool start();
+    void stop();   // drains the ring, trims the file to its data
+
+    // Feed thread only. Returns false (and counts a drop) if the ring is full.
+    bool record(const void* data, std::size_t len, std::uint64_t recv_ns);
+
+    const std::string& path() const { return path_; }
+    std::uint64_t frames() const  { return frames_.load(std::memory_order_relaxed); }
+    std::uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+    std::uint64_t file_bytes() const { return written_.load(std::memory_order_relaxed); }
+
+private:
+    void writer_loop();
+    std::size_t drain();
+    bool ensure_mapped(std::size_t size);
+
+    std::string path_;
+    std::string exchange_;
+    std::string instrument_;
+
+    // SPSC ring: head_ written by the feed thread, tail_ by writer_loop.
+    // Monotonic byte counters; position = counter & mask_.
+    std::vector<char> ring_;
+    std::size_t mask_{0};
+    alignas(64) std::atomic<std::uint64_t> head_{0};
+    std::uint64_t tail_cache_{0};          // producer's last view of tail_
+    std::atomic<std::uint64_t> frames_{0};
+    std::atomic<std::uint64_t> dropped_{0};
+    alignas(64) std::atomic<std::uint64_t> tail_{0};
+    std::atomic<std::uint64_t> written_{0};  // file offset of the data end
+
+    int fd_{-1};
+    char* map_{nullptr};
+    std::size_t map_size_{0};
+
+    std::atomic<bool> running_{false};
+    std::thread writer_;
+};
+
+// ------------------------------------------------------------
+// Reader: mmaps a finished (or still growing / crashed) frame log
+// ------------------------------------------------------------
+struct FrameView {
+    std::uint64_t recv_ns{0};
+    std::string_view data;
+};
+
+class FrameReader {
+public:
+    explicit FrameReader(std::string path);
+    ~FrameReader();
+
+    FrameReader(const FrameReader&) = delete;
+    FrameReader& operator=(const FrameReader&) = delete;
+
+    bool open();
+    void close();
+
+    const FrameFileHeader& header() const { return header_; }
+    std::string exchange() const;
+    std::string instrument() const;
+
+    // Next record, or false at the end; views stay valid until close()
+    bool next(FrameView& out);
+    void rewind();
+
+private:
+    std::string path_;
+    int fd_{-1};
+    const char* map_{nullptr};
+    std::size_t size_{0};
+    std::size_t pos_{0};
+    FrameFileHeader header_{};
+};
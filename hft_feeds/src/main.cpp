@@ -63,7 +63,74 @@ static ExchangeChoice parse_exchanges_array_or_fallback(const json& j) {
     return ExchangeChoice::Both;
 }
 
-int main() {
+// "stateDb": { "path", "partitionByDay", "compactAfterDays", "compactBucketMs",
+//              "rawRetentionDays", "bars1sRetentionDays", "bars1mRetentionDays",
+//              "maintenanceIntervalSec", "checkpointIntervalMs",
+//              "statsLogIntervalSec" }  (all optional; partitioning,
+//              compaction and retention stay off unless set, see StateDBOptions)
+static StateDBOptions parse_state_db_options(const json& j) {
+    StateDBOptions o;
+    if (!j.contains("stateDb") || !j["stateDb"].is_object()) return o;
+
+    const json& s = j["stateDb"];
+    o.path                   = s.value("path", o.path);
+    o.partition_by_day       = s.value("partitionByDay", o.partition_by_day);
+    o.compact_after_days     = s.value("compactAfterDays", o.compact_after_days);
+    o.compact_bucket_ms      = s.value("compactBucketMs", o.compact_bucket_ms);
+    o.raw_retention_days     = s.value("rawRetentionDays", o.raw_retention_days);
+    o.bar_retention_days[0]  = s.value("bars1sRetentionDays", o.bar_retention_days[0]);
+    o.bar_retention_days[1]  = s.value("bars1mRetentionDays", o.bar_retention_days[1]);
+    o.maintenance_interval_s = s.value("maintenanceIntervalSec", o.maintenance_interval_s);
+    o.checkpoint_interval_ms = s.value("checkpointIntervalMs", o.checkpoint_interval_ms);
+    o.stats_log_interval_s   = s.value("statsLogIntervalSec", o.stats_log_interval_s);
+    return o;
+}
+
+// hft_feeds --replay a.frames [b.frames ...] [--speed X] [--features out.jsonl]
+//           [--state-db path] [--publish]
+// Replays recorded frames instead of connecting; depth / poll interval still
+// come from config.json. market_state.db and ZMQ are off unless asked for.
+static int run_replay_mode(int argc, char** argv, const json& j) {
+    std::vector<std::string> files;
+    double speed = 0.0;
+    std::string features_path;
+    StateDBOptions db_opts = parse_state_db_options(j);
+    db_opts.path.clear();
+    // Retention/compaction age against the wall clock and would eat the
+    // historical days being replayed
+    db_opts.compact_after_days = 0;
+    db_opts.raw_retention_days = 0;
+    for (auto& d : db_opts.bar_retention_days) d = 0;
+    bool publish = false;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        if (a == "--replay") continue;
+        else if (a == "--speed" && i + 1 < argc) speed = std::stod(argv[++i]);
+        else if (a == "--features" && i + 1 < argc) features_path = argv[++i];
+        else if (a == "--state-db" && i + 1 < argc) db_opts.path = argv[++i];
+        else if (a == "--publish") publish = true;
+        else files.push_back(a);
+    }
+    if (files.empty()) {
+        std::cerr << "Usage: hft_feeds --replay <file.frames>... [--speed X] [--features out.jsonl]"
+                     " [--state-db path] [--publish]\n";
+        return 1;
+    }
+
+    MarketDataManager mgr(files,
+                          j.value("orderBookDepth", 20),
+                          j.value("orderBookPollFrequencyInMs", 50),
+                          db_opts, publish);
+    return mgr.run_replay(speed, features_path) > 0 ? 0 : 1;
+}
+
+int main(int argc, char** argv) {
+    bool replay = false;
+    for (int i = 1; i < argc; ++i) {
+        if (std::string(argv[i]) == "--replay") replay = true;
+    }
+
     /*std::cout << "Select exchange:\n"
               << "1. Binance\n"
               << "2. Bybit\n"
@@ -85,14 +152,17 @@ int main() {
     auto instruments = parse_instruments(ins_line);*/
 	    // ---------- Open config file ----------
     std::ifstream cfg("../config.json");
-    if (!cfg.is_open()) {
+    if (!cfg.is_open() && !replay) {
         std::cerr << "Failed to open config.json\n";
         return 1;
     }
 
     // ---------- Parse JSON ----------
-    json j;
-    cfg >> j;
+    json j = json::object();
+    if (cfg.is_open()) cfg >> j;
+
+    if (replay) return run_replay_mode(argc, argv, j);
+
 	int orderbook_depth = j.value("orderBookDepth", 20);
 	int orderbook_poll_ms = j.value("orderBookPollFrequencyInMs", 50);
     // ---------- Read exchange ----------
@@ -105,7 +175,25 @@ int main() {
     }
 	
 	// ---------- Start market data ----------
-    MarketDataManager mgr(sel, instruments, orderbook_depth, orderbook_poll_ms);
+    MarketDataManager mgr(sel, instruments, orderbook_depth, orderbook_poll_ms,
+                          parse_state_db_options(j));
+
+    // ---------- Optional raw frame recording ----------
+    if (j.value("recordFrames", false))
+        mgr.enable_recording(j.value("recordDir", std::string("recordings")));
+
+    // ---------- Optional endpoint overrides ----------
+    // "endpoints": { "bybit": "ws://127.0.0.1:9001/v5/public/spot", "binance": "..." }
+    if (j.contains("endpoints") && j["endpoints"].is_object()) {
+        for (const auto& e : j["endpoints"].items()) {
+            if (e.value().is_string())
+                mgr.set_endpoint(to_lower(e.key()), e.value().get<std::string>());
+        }
+    }
+
+    // kill -USR1 <pid> dumps the latency histograms (next snapshot tick)
+    latency_install_sigusr1();
+
     mgr.start_all();
     mgr.join_all();
 
@@ -1,41 +1,107 @@
 #include "StateDB.hpp"
-#include <iostream>
+#include "StateSchema.hpp"
+#include <algorithm>
 #include <chrono>
+#include <cstdio>
+#include <iostream>
 
 static void log_sqlite_err(sqlite3* db, const char* where) {
     std::cerr << "[StateDB] " << where << " sqlite_err="
               << (db ? sqlite3_errmsg(db) : "null-db") << "\n";
 }
 
+static std::int64_t now_ms() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// Single file, no retention: the original behaviour of this constructor
+static StateDBOptions single_file_options(std::string db_path, int flush_ms, std::size_t max_queue) {
+    StateDBOptions o;
+    o.path = std::move(db_path);
+    o.flush_ms = flush_ms;
+    o.max_queue = max_queue;
+    o.partition_by_day = false;
+    o.compact_after_days = 0;
+    o.raw_retention_days = 0;
+    for (auto& d : o.bar_retention_days) d = 0;
+    return o;
+}
+
 StateDB::StateDB(std::string db_path, int flush_ms, std::size_t max_queue)
-    : db_path_(std::move(db_path))
-    , flush_ms_(flush_ms)
-    , max_queue_(max_queue)
+    : StateDB(single_file_options(std::move(db_path), flush_ms, max_queue))
+{}
+
+StateDB::StateDB(StateDBOptions opts)
+    : opts_(std::move(opts))
+    , db_path_(opts_.path)
+    , flush_ms_(opts_.flush_ms)
+    , max_queue_(opts_.max_queue)
 {}
 
 StateDB::~StateDB() {
     stop();
+    if (db_) close_writer();   // write_batch() without start()
 }
 
-bool StateDB::start() {
-    if (running_.exchange(true)) return true;
-
-    if (!open_connection()) {
-        running_ = false;
+// Writer connection: schema, pragmas, today's partition, prepared inserts
+bool StateDB::open_writer() {
+    if (!open_connection())
         return false;
-    }
     if (!init_schema_and_pragmas()) {
-        running_ = false;
+        close_connection();
+        return false;
+    }
+    // Inserts name part.market_state_v2, so a partition must exist to prepare them
+    if (opts_.partition_by_day && !attach_partition(now_ms() / STATE_DAY_MS)) {
         close_connection();
         return false;
     }
     if (!prepare_statements()) {
+        close_writer();
+        return false;
+    }
+    return true;
+}
+
+void StateDB::close_writer() {
+    finalize_statements();
+    detach_partition();
+    close_connection();   // last connection: final checkpoint, WAL removed
+}
+
+bool StateDB::write_batch(const std::vector<StateSnapshot>& batch) {
+    if (running_) return false;
+    if (!db_ && !open_writer()) return false;
+    return insert_batch(batch);
+}
+
+bool StateDB::start() {
+    if (running_.exchange(true)) return true;
+
+    if (!db_ && !open_writer()) {
         running_ = false;
-        close_connection();
         return false;
     }
 
+    // Commits stop checkpointing inline only once checkpoint_loop has a
+    // connection to do it off-thread; otherwise the WAL would grow unbounded
+    sqlite3* ckpt = nullptr;
+    if (opts_.checkpoint_interval_ms > 0) {
+        if (sqlite3_open_v2(db_path_.c_str(), &ckpt, SQLITE_OPEN_READWRITE, nullptr) != SQLITE_OK) {
+            log_sqlite_err(ckpt, "sqlite3_open_v2(checkpoint)");
+            if (ckpt) sqlite3_close(ckpt);
+            ckpt = nullptr;
+            std::cerr << "[StateDB] no checkpoint connection; writer keeps auto-checkpointing\n";
+        } else if (!state_exec_sql(db_, "PRAGMA wal_autocheckpoint=0;")) {
+            sqlite3_close(ckpt);
+            ckpt = nullptr;
+        }
+    }
+
     writer_ = std::thread(&StateDB::writer_loop, this);
+    maintenance_ = std::thread(&StateDB::maintenance_loop, this);
+    checkpointer_ = std::thread(&StateDB::checkpoint_loop, this, ckpt);
     return true;
 }
 
@@ -43,10 +109,19 @@ void StateDB::stop() {
     if (!running_.exchange(false)) return;
 
     cv_.notify_all();
+    {
+        // Under the lock so the wakeup cannot fall between the maintenance
+        // thread's running_ check and its wait
+        std::lock_guard<std::mutex> lk(maint_mtx_);
+        maint_cv_.notify_all();
+    }
     if (writer_.joinable()) writer_.join();
+    if (maintenance_.joinable()) maintenance_.join();
+    if (checkpointer_.joinable()) checkpointer_.join();
 
-    finalize_statements();
-    close_connection();
+    close_writer();
+
+    log_stats();
 }
 
 void StateDB::push(StateSnapshot s) {
@@ -58,8 +133,13 @@ void StateDB::push(StateSnapshot s) {
         // Drop oldest if queue is too large (protect memory / avoid stalls)
         if (q_.size() >= max_queue_) {
             q_.pop_front();
+            st_dropped_.fetch_add(1);
         }
         q_.push_back(std::move(s));
+        st_pushed_.fetch_add(1);
+
+        if (q_.size() > st_queue_hwm_.load(std::memory_order_relaxed))
+            st_queue_hwm_.store(q_.size(), std::memory_order_relaxed);
     }
     cv_.notify_one();
 }
@@ -83,110 +163,376 @@ void StateDB::close_connection() {
 }
 
 static bool exec_sql(sqlite3* db, const std::string& sql) {
-    char* err = nullptr;
-    int rc = sqlite3_exec(db, sql.c_str(), nullptr, nullptr, &err);
-    if (rc != SQLITE_OK) {
-        std::cerr << "[StateDB] sqlite_exec failed: " << (err ? err : "") << "\n";
-        sqlite3_free(err);
-        return false;
-    }
-    return true;
+    return state_exec_sql(db, sql.c_str());
 }
 
+// Multi-row statements amortise sqlite3_step/VM setup over many rows.
+// Sizes that exceed SQLITE_LIMIT_VARIABLE_NUMBER are skipped at prepare time.
+static constexpr std::size_t kBatchRows[] = {256, 64, 1};
+
 bool StateDB::init_schema_and_pragmas() {
-    // Pragmas (WAL + speed sane defaults)
-    if (!exec_sql(db_, "PRAGMA journal_mode=WAL;")) return false;
-    if (!exec_sql(db_, "PRAGMA synchronous=NORMAL;")) return false;
-    if (!exec_sql(db_, "PRAGMA temp_store=MEMORY;")) return false;
-    if (!exec_sql(db_, "PRAGMA foreign_keys=ON;")) return false;
-    if (!exec_sql(db_, "PRAGMA busy_timeout=2000;")) return false;
-
-    // Schema: single table (industry standard)
-    const char* create_sql =
-        "CREATE TABLE IF NOT EXISTS market_state ("
-        "  ts_ms INTEGER NOT NULL,"
-        "  exchange TEXT NOT NULL,"
-        "  instrument TEXT NOT NULL,"
-        "  mid REAL NOT NULL,"
-        "  spread REAL NOT NULL,"
-        "  r1 REAL NOT NULL,"
-        "  r5 REAL NOT NULL,"
-        "  r10 REAL NOT NULL,"
-        "  imbalance REAL NOT NULL,"
-        "  cross_ex_signal REAL NOT NULL,"
-        "  bid_v1 REAL NOT NULL, bid_v2 REAL NOT NULL, bid_v3 REAL NOT NULL, bid_v4 REAL NOT NULL, bid_v5 REAL NOT NULL,"
-        "  ask_v1 REAL NOT NULL, ask_v2 REAL NOT NULL, ask_v3 REAL NOT NULL, ask_v4 REAL NOT NULL, ask_v5 REAL NOT NULL"
-        ");";
-
-    if (!exec_sql(db_, create_sql)) return false;
-
-    // Indexes
-    if (!exec_sql(db_, "CREATE INDEX IF NOT EXISTS idx_market_state_ts ON market_state(ts_ms);")) return false;
-    if (!exec_sql(db_, "CREATE INDEX IF NOT EXISTS idx_market_state_key ON market_state(exchange, instrument, ts_ms);")) return false;
+    if (!state_apply_writer_pragmas(db_)) return false;
+
+    // Schema v2: instruments dictionary + clustered market_state_v2
+    if (!state_create_v2(db_)) return false;
+
+    if (state_table_exists(db_, "market_state")) {
+        std::cerr << "[StateDB] legacy v1 table market_state present in " << db_path_
+                  << " (new rows go to market_state_v2; run migrate_state_db to convert)\n";
+    }
 
     return true;
 }
 
 bool StateDB::prepare_statements() {
-    const char* ins =
-        "INSERT INTO market_state ("
-        " ts_ms, exchange, instrument, mid, spread, r1, r5, r10, imbalance, cross_ex_signal,"
-        " bid_v1,bid_v2,bid_v3,bid_v4,bid_v5,"
-        " ask_v1,ask_v2,ask_v3,ask_v4,ask_v5"
-        ") VALUES (?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?);";
-
-    int rc = sqlite3_prepare_v2(db_, ins, -1, &stmt_insert_, nullptr);
+    const int max_vars = sqlite3_limit(db_, SQLITE_LIMIT_VARIABLE_NUMBER, -1);
+
+    for (std::size_t rows : kBatchRows) {
+        if (static_cast<long long>(rows) * STATE_V2_INSERT_COLS > max_vars) continue;
+
+        // A row already stored (replay, restart inside the same ms) is
+        // ignored; RETURNING names the rows that went in, so only those
+        // reach the rollups
+        std::string ins = std::string("INSERT OR IGNORE INTO ") +
+                          (opts_.partition_by_day ? "part." : "main.") +
+                          "market_state_v2 (" + STATE_V2_INSERT_COLUMNS + ") VALUES ";
+        for (std::size_t r = 0; r < rows; ++r) {
+            ins += (r == 0) ? "(" : ",(";
+            for (int c = 0; c < STATE_V2_INSERT_COLS; ++c) ins += (c == 0) ? "?" : ",?";
+            ins += ")";
+        }
+        ins += " RETURNING instrument_id, ts_ms, seq;";
+
+        sqlite3_stmt* st = nullptr;
+        int rc = sqlite3_prepare_v3(db_, ins.c_str(), -1, SQLITE_PREPARE_PERSISTENT, &st, nullptr);
+        if (rc != SQLITE_OK) {
+            log_sqlite_err(db_, "sqlite3_prepare_v3(insert)");
+            return false;
+        }
+        stmt_batches_.push_back({rows, st});
+    }
+
+    // Rollups: merge a partial bar into whatever an earlier batch already wrote
+    for (int r = 0; r < STATE_ROLLUP_COUNT; ++r) {
+        const std::string t = STATE_ROLLUPS[r].table;
+        const std::string ups =
+            "INSERT INTO " + t + " (" + STATE_BAR_COLUMNS + ") "
+            "VALUES (?,?,?,?,?,?,?,?,?,?,?,?,?) "
+            "ON CONFLICT(instrument_id, bucket_ms) DO UPDATE SET"
+            " open  = CASE WHEN excluded.first_ts_ms < first_ts_ms THEN excluded.open ELSE open END,"
+            " close = CASE WHEN excluded.last_ts_ms >= last_ts_ms THEN excluded.close ELSE close END,"
+            " first_ts_ms = min(first_ts_ms, excluded.first_ts_ms),"
+            " last_ts_ms  = max(last_ts_ms, excluded.last_ts_ms),"
+            " high = max(high, excluded.high),"
+            " low  = min(low, excluded.low),"
+            " spread_sum = spread_sum + excluded.spread_sum,"
+            " spread_max = max(spread_max, excluded.spread_max),"
+            " bid_depth_sum = bid_depth_sum + excluded.bid_depth_sum,"
+            " ask_depth_sum = ask_depth_sum + excluded.ask_depth_sum,"
+            " n = n + excluded.n;";
+
+        int rc = sqlite3_prepare_v3(db_, ups.c_str(), -1, SQLITE_PREPARE_PERSISTENT,
+                                    &stmt_rollup_[r], nullptr);
+        if (rc != SQLITE_OK) {
+            log_sqlite_err(db_, "sqlite3_prepare_v3(rollup)");
+            return false;
+        }
+    }
+
+    int rc = sqlite3_prepare_v2(db_,
+        "INSERT OR IGNORE INTO instruments(exchange, instrument) VALUES (?,?);",
+        -1, &stmt_instr_insert_, nullptr);
     if (rc != SQLITE_OK) {
-        log_sqlite_err(db_, "sqlite3_prepare_v2(insert)");
-        stmt_insert_ = nullptr;
+        log_sqlite_err(db_, "sqlite3_prepare_v2(instruments insert)");
+        return false;
+    }
+
+    rc = sqlite3_prepare_v2(db_,
+        "SELECT instrument_id FROM instruments WHERE exchange=? AND instrument=?;",
+        -1, &stmt_instr_select_, nullptr);
+    if (rc != SQLITE_OK) {
+        log_sqlite_err(db_, "sqlite3_prepare_v2(instruments select)");
         return false;
     }
     return true;
 }
 
 void StateDB::finalize_statements() {
-    if (stmt_insert_) {
-        sqlite3_finalize(stmt_insert_);
-        stmt_insert_ = nullptr;
+    for (auto& b : stmt_batches_) sqlite3_finalize(b.stmt);
+    stmt_batches_.clear();
+
+    for (auto*& st : stmt_rollup_) {
+        if (st) {
+            sqlite3_finalize(st);
+            st = nullptr;
+        }
+    }
+
+    if (stmt_instr_insert_) {
+        sqlite3_finalize(stmt_instr_insert_);
+        stmt_instr_insert_ = nullptr;
+    }
+    if (stmt_instr_select_) {
+        sqlite3_finalize(stmt_instr_select_);
+        stmt_instr_select_ = nullptr;
     }
 }
 
+std::int64_t StateDB::instrument_id(const StateSnapshot& s) {
+    for (const auto& e : instrument_ids_) {
+        if (e.instrument == s.instrument && e.exchange == s.exchange) return e.id;
+    }
+
+    // First time we see this key: insert (if new) + read back the id.
+    // Runs inside the batch transaction.
+    sqlite3_reset(stmt_instr_insert_);
+    sqlite3_bind_text(stmt_instr_insert_, 1, s.exchange.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt_instr_insert_, 2, s.instrument.c_str(), -1, SQLITE_STATIC);
+    if (sqlite3_step(stmt_instr_insert_) != SQLITE_DONE) {
+        log_sqlite_err(db_, "sqlite3_step(instruments insert)");
+        return -1;
+    }
+
+    sqlite3_reset(stmt_instr_select_);
+    sqlite3_bind_text(stmt_instr_select_, 1, s.exchange.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt_instr_select_, 2, s.instrument.c_str(), -1, SQLITE_STATIC);
+    if (sqlite3_step(stmt_instr_select_) != SQLITE_ROW) {
+        log_sqlite_err(db_, "sqlite3_step(instruments select)");
+        return -1;
+    }
+    const std::int64_t id = sqlite3_column_int64(stmt_instr_select_, 0);
+    sqlite3_reset(stmt_instr_select_);
+
+    instrument_ids_.push_back({s.exchange, s.instrument, id});
+    return id;
+}
+
+std::int64_t StateDB::next_seq(std::int64_t id, std::uint64_t ts_ms) {
+    for (auto& e : seq_state_) {
+        if (e.id != id) continue;
+        if (ts_ms == e.ts_ms) return ++e.seq;
+        if (ts_ms > e.ts_ms) {
+            e.ts_ms = ts_ms;
+            e.seq = 0;
+        }
+        return 0;   // late sample: collides only with another late one, then ignored
+    }
+    seq_state_.push_back({id, ts_ms, 0});
+    return 0;
+}
+
+void StateDB::bind_row(sqlite3_stmt* st, int& idx, const StateSnapshot& s, std::int64_t id, std::int64_t seq) {
+    sqlite3_bind_int64(st, idx++, static_cast<sqlite3_int64>(id));
+    sqlite3_bind_int64(st, idx++, static_cast<sqlite3_int64>(s.ts_ms));
+
+    sqlite3_bind_double(st, idx++, s.mid);
+    sqlite3_bind_double(st, idx++, s.spread);
+    sqlite3_bind_double(st, idx++, s.r1);
+    sqlite3_bind_double(st, idx++, s.r5);
+    sqlite3_bind_double(st, idx++, s.r10);
+    sqlite3_bind_double(st, idx++, s.imbalance);
+    sqlite3_bind_double(st, idx++, s.cross_ex_signal);
+
+    for (int i = 0; i < 5; ++i) sqlite3_bind_double(st, idx++, s.bid_vol[i]);
+    for (int i = 0; i < 5; ++i) sqlite3_bind_double(st, idx++, s.ask_vol[i]);
+    sqlite3_bind_int64(st, idx++, static_cast<sqlite3_int64>(seq));
+}
+
+// After one multi-row INSERT ... RETURNING: flag which of its rows went in.
+// Returns how many were ignored.
+std::size_t StateDB::mark_inserted(const std::vector<StateSnapshot>& batch, std::size_t begin, std::size_t rows) {
+    const std::size_t end = begin + rows;
+    if (returned_.size() == rows) {
+        std::fill(batch_new_.begin() + begin, batch_new_.begin() + end, 1);
+        return 0;
+    }
+
+    // Some were duplicates. RETURNING comes back in VALUES order in
+    // practice, so walk forward; fall back to a scan of the chunk if not.
+    std::fill(batch_new_.begin() + begin, batch_new_.begin() + end, 0);
+    auto same = [&](std::size_t i, const InsertedKey& k) {
+        return batch_ids_[i] == k.id && static_cast<std::int64_t>(batch[i].ts_ms) == k.ts_ms &&
+               batch_seq_[i] == k.seq;
+    };
+    std::size_t i = begin;
+    for (const auto& k : returned_) {
+        while (i < end && !same(i, k)) ++i;
+        if (i == end) {
+            for (i = begin; i < end && !same(i, k); ++i) {}
+            if (i == end) continue;
+        }
+        batch_new_[i++] = 1;
+    }
+    return rows - returned_.size();
+}
+
 bool StateDB::insert_batch(const std::vector<StateSnapshot>& batch) {
-    if (batch.empty()) return true;
+    // One transaction per run of rows from the same UTC day; normally the
+    // whole batch, two runs around midnight
+    bool ok = true;
+    std::size_t begin = 0;
+    while (begin < batch.size()) {
+        const std::int64_t day = static_cast<std::int64_t>(batch[begin].ts_ms) / STATE_DAY_MS;
+        std::size_t end = batch.size();
+        if (opts_.partition_by_day) {
+            end = begin + 1;
+            while (end < batch.size() &&
+                   static_cast<std::int64_t>(batch[end].ts_ms) / STATE_DAY_MS == day)
+                ++end;
+        }
+
+        const auto t0 = std::chrono::steady_clock::now();
+        std::size_t duplicates = 0;
+        const bool run_ok = (!opts_.partition_by_day || attach_partition(day)) &&
+                            insert_rows(batch, begin, end, duplicates);
+        const auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - t0).count();
+
+        record_batch(end - begin, duplicates, run_ok, static_cast<std::uint64_t>(us));
+        ok = ok && run_ok;
+        begin = end;
+    }
+    return ok;
+}
 
+bool StateDB::insert_rows(const std::vector<StateSnapshot>& batch, std::size_t begin, std::size_t end,
+                          std::size_t& duplicates) {
     // One transaction per batch = fast
     if (!exec_sql(db_, "BEGIN IMMEDIATE TRANSACTION;")) return false;
 
-    for (const auto& s : batch) {
-        sqlite3_reset(stmt_insert_);
-        sqlite3_clear_bindings(stmt_insert_);
-
-        int idx = 1;
-        sqlite3_bind_int64(stmt_insert_, idx++, static_cast<sqlite3_int64>(s.ts_ms));
-        sqlite3_bind_text(stmt_insert_, idx++, s.exchange.c_str(), -1, SQLITE_TRANSIENT);
-        sqlite3_bind_text(stmt_insert_, idx++, s.instrument.c_str(), -1, SQLITE_TRANSIENT);
-
-        sqlite3_bind_double(stmt_insert_, idx++, s.mid);
-        sqlite3_bind_double(stmt_insert_, idx++, s.spread);
-        sqlite3_bind_double(stmt_insert_, idx++, s.r1);
-        sqlite3_bind_double(stmt_insert_, idx++, s.r5);
-        sqlite3_bind_double(stmt_insert_, idx++, s.r10);
-        sqlite3_bind_double(stmt_insert_, idx++, s.imbalance);
-        sqlite3_bind_double(stmt_insert_, idx++, s.cross_ex_signal);
-
-        for (int i = 0; i < 5; ++i) sqlite3_bind_double(stmt_insert_, idx++, s.bid_vol[i]);
-        for (int i = 0; i < 5; ++i) sqlite3_bind_double(stmt_insert_, idx++, s.ask_vol[i]);
-
-        int rc = sqlite3_step(stmt_insert_);
-        if (rc != SQLITE_DONE) {
-            log_sqlite_err(db_, "sqlite3_step(insert)");
-            exec_sql(db_, "ROLLBACK;");
-            return false;
+    // Ids resolved inside this transaction are only valid if it commits
+    auto rollback = [this]() {
+        exec_sql(db_, "ROLLBACK;");
+        instrument_ids_.clear();
+        return false;
+    };
+
+    batch_ids_.resize(batch.size());
+    batch_seq_.resize(batch.size());
+    batch_new_.resize(batch.size());
+    for (std::size_t i = begin; i < end; ++i) {
+        batch_ids_[i] = instrument_id(batch[i]);
+        if (batch_ids_[i] < 0) return rollback();
+        batch_seq_[i] = next_seq(batch_ids_[i], batch[i].ts_ms);
+    }
+
+    // Greedy: as many 256-row steps as fit, then 64-row, then single rows
+    std::size_t pos = begin;
+    for (const auto& b : stmt_batches_) {
+        while (end - pos >= b.rows) {
+            sqlite3_reset(b.stmt);
+
+            const std::size_t first = pos;
+            int idx = 1;
+            for (std::size_t r = 0; r < b.rows; ++r, ++pos)
+                bind_row(b.stmt, idx, batch[pos], batch_ids_[pos], batch_seq_[pos]);
+
+            returned_.clear();
+            int rc;
+            while ((rc = sqlite3_step(b.stmt)) == SQLITE_ROW) {
+                returned_.push_back({sqlite3_column_int64(b.stmt, 0), sqlite3_column_int64(b.stmt, 1),
+                                     sqlite3_column_int64(b.stmt, 2)});
+            }
+            if (rc != SQLITE_DONE) {
+                log_sqlite_err(db_, "sqlite3_step(insert)");
+                return rollback();
+            }
+            duplicates += mark_inserted(batch, first, b.rows);
         }
     }
 
-    if (!exec_sql(db_, "COMMIT;")) {
-        exec_sql(db_, "ROLLBACK;");
+    // Rollups ride in the same transaction. In single-file mode bars and raw
+    // rows commit together; with day partitions each WAL file commits on its
+    // own (WAL has no super-journal), so a crash inside COMMIT can leave the
+    // bars in main and the raw rows in "part" one batch apart
+    if (!update_rollups(batch, begin, end)) return rollback();
+
+    if (!exec_sql(db_, "COMMIT;")) return rollback();
+    return true;
+}
+
+bool StateDB::update_rollups(const std::vector<StateSnapshot>& batch, std::size_t begin, std::size_t end) {
+    // One open partial bar per (rollup, instrument); flushed when its bucket
+    // changes and at the end of the batch. A 200 ms batch touches ~1 bucket
+    // per key, so this is a couple of UPSERTs per instrument per commit.
+    rollup_open_.clear();
+
+    for (std::size_t i = begin; i < end; ++i) {
+        if (!batch_new_[i]) continue;   // already counted when first stored
+        const StateSnapshot& s = batch[i];
+        const std::int64_t id = batch_ids_[i];
+
+        double bid_depth = 0.0, ask_depth = 0.0;
+        for (int k = 0; k < 5; ++k) {
+            bid_depth += s.bid_vol[k];
+            ask_depth += s.ask_vol[k];
+        }
+
+        for (int r = 0; r < STATE_ROLLUP_COUNT; ++r) {
+            const std::int64_t w = STATE_ROLLUPS[r].bucket_ms;
+            const std::int64_t ts = static_cast<std::int64_t>(s.ts_ms);
+            const std::int64_t bucket = ts - ts % w;
+
+            RollupBar* bar = nullptr;
+            for (auto& b : rollup_open_) {
+                if (b.rollup == r && b.id == id) {
+                    bar = &b;
+                    break;
+                }
+            }
+
+            if (bar && bar->bucket_ms != bucket) {
+                if (!upsert_bar(*bar)) return false;
+            }
+            if (!bar || bar->bucket_ms != bucket) {
+                if (!bar) {
+                    rollup_open_.push_back({});
+                    bar = &rollup_open_.back();
+                }
+                *bar = RollupBar{r, id, bucket, s.ts_ms, s.ts_ms,
+                                 s.mid, s.mid, s.mid, s.mid,
+                                 0.0, s.spread, 0.0, 0.0, 0};
+            }
+
+            if (s.ts_ms < bar->first_ts) { bar->first_ts = s.ts_ms; bar->open = s.mid; }
+            if (s.ts_ms >= bar->last_ts) { bar->last_ts = s.ts_ms; bar->close = s.mid; }
+            if (s.mid > bar->high) bar->high = s.mid;
+            if (s.mid < bar->low)  bar->low  = s.mid;
+            if (s.spread > bar->spread_max) bar->spread_max = s.spread;
+            bar->spread_sum    += s.spread;
+            bar->bid_depth_sum += bid_depth;
+            bar->ask_depth_sum += ask_depth;
+            bar->n++;
+        }
+    }
+
+    for (const auto& b : rollup_open_) {
+        if (!upsert_bar(b)) return false;
+    }
+    return true;
+}
+
+bool StateDB::upsert_bar(const RollupBar& b) {
+    sqlite3_stmt* st = stmt_rollup_[b.rollup];
+    sqlite3_reset(st);
+
+    int idx = 1;
+    sqlite3_bind_int64(st, idx++, static_cast<sqlite3_int64>(b.id));
+    sqlite3_bind_int64(st, idx++, static_cast<sqlite3_int64>(b.bucket_ms));
+    sqlite3_bind_int64(st, idx++, static_cast<sqlite3_int64>(b.first_ts));
+    sqlite3_bind_int64(st, idx++, static_cast<sqlite3_int64>(b.last_ts));
+    sqlite3_bind_double(st, idx++, b.open);
+    sqlite3_bind_double(st, idx++, b.high);
+    sqlite3_bind_double(st, idx++, b.low);
+    sqlite3_bind_double(st, idx++, b.close);
+    sqlite3_bind_double(st, idx++, b.spread_sum);
+    sqlite3_bind_double(st, idx++, b.spread_max);
+    sqlite3_bind_double(st, idx++, b.bid_depth_sum);
+    sqlite3_bind_double(st, idx++, b.ask_depth_sum);
+    sqlite3_bind_int64(st, idx++, static_cast<sqlite3_int64>(b.n));
+
+    if (sqlite3_step(st) != SQLITE_DONE) {
+        log_sqlite_err(db_, "sqlite3_step(rollup upsert)");
         return false;
     }
     return true;
@@ -231,3 +577,338 @@ void StateDB::writer_loop() {
     }
     if (!tail.empty()) insert_batch(tail);
 }
+
+// ------------------------------------------------------------
+// Day partitions
+// ------------------------------------------------------------
+
+bool StateDB::attach_partition(std::int64_t day) {
+    if (day == part_day_) return true;
+
+    // Late rows for a day maintenance may already have compacted or removed
+    // would land in a file it no longer owns the layout of
+    const std::int64_t age = now_ms() / STATE_DAY_MS - day;
+    const int horizon = opts_.compact_after_days > 0 ? opts_.compact_after_days : opts_.raw_retention_days;
+    if (horizon > 0 && age >= horizon) {
+        std::cerr << "[StateDB] refusing rows for " << state_partition_path(db_path_, day)
+                  << ": older than the maintenance horizon (" << horizon << " days)\n";
+        return false;
+    }
+
+    // Maintenance checks writer_day_ and works on a file under part_mtx_
+    std::lock_guard<std::mutex> lk(part_mtx_);
+    detach_partition();
+
+    const std::string path = state_partition_path(db_path_, day);
+    if (!state_attach(db_, path, "part")) return false;
+
+    if (!exec_sql(db_, "PRAGMA part.journal_mode=WAL;") ||
+        !exec_sql(db_, "PRAGMA part.synchronous=NORMAL;") ||
+        !exec_sql(db_, "PRAGMA part.journal_size_limit=67108864;") ||
+        !state_create_partition(db_, "part", day)) {
+        exec_sql(db_, "DETACH DATABASE part;");
+        return false;
+    }
+
+    part_day_ = day;
+    writer_day_ = day;
+    return true;
+}
+
+void StateDB::detach_partition() {
+    if (part_day_ < 0) return;
+
+    // DETACH fails while a statement on "part" is still mid-step
+    for (auto& b : stmt_batches_) sqlite3_reset(b.stmt);
+
+    // Closing the last handle on the file checkpoints and drops its WAL
+    exec_sql(db_, "DETACH DATABASE part;");
+    part_day_ = -1;
+    writer_day_ = -1;
+}
+
+// ------------------------------------------------------------
+// Maintenance: compaction + retention (own connection, own thread)
+// ------------------------------------------------------------
+
+// Delete rows of one instrument older than `cutoff`, one day per
+// transaction so the writer never waits long on the lock.
+static bool delete_before(sqlite3* db, const std::string& table, const char* ts_col,
+                          std::int64_t id, std::int64_t cutoff, std::int64_t& deleted) {
+    const std::string min_sql =
+        "SELECT min(" + std::string(ts_col) + ") FROM " + table + " WHERE instrument_id=?;";
+    const std::string del_sql =
+        "DELETE FROM " + table + " WHERE instrument_id=? AND " + ts_col + "<?;";
+
+    sqlite3_stmt* st_min = nullptr;
+    sqlite3_stmt* st_del = nullptr;
+    bool ok = sqlite3_prepare_v2(db, min_sql.c_str(), -1, &st_min, nullptr) == SQLITE_OK &&
+              sqlite3_prepare_v2(db, del_sql.c_str(), -1, &st_del, nullptr) == SQLITE_OK;
+
+    if (ok) {
+        sqlite3_bind_int64(st_min, 1, id);
+        std::int64_t lo = cutoff;
+        if (sqlite3_step(st_min) == SQLITE_ROW && sqlite3_column_type(st_min, 0) != SQLITE_NULL)
+            lo = sqlite3_column_int64(st_min, 0);
+
+        for (std::int64_t upto = lo + STATE_DAY_MS; ok && lo < cutoff; upto += STATE_DAY_MS) {
+            const std::int64_t bound = std::min(upto, cutoff);
+            sqlite3_reset(st_del);
+            sqlite3_bind_int64(st_del, 1, id);
+            sqlite3_bind_int64(st_del, 2, bound);
+            ok = (sqlite3_step(st_del) == SQLITE_DONE);
+            deleted += sqlite3_changes(db);
+            lo = bound;
+        }
+    }
+
+    if (!ok) log_sqlite_err(db, "retention delete");
+    sqlite3_finalize(st_min);
+    sqlite3_finalize(st_del);
+    return ok;
+}
+
+void StateDB::maintenance_loop() {
+    bool enabled = opts_.compact_after_days > 0 || opts_.raw_retention_days > 0;
+    for (int days : opts_.bar_retention_days) enabled = enabled || days > 0;
+    if (!enabled) return;
+
+    sqlite3* db = nullptr;
+    if (sqlite3_open_v2(db_path_.c_str(), &db, SQLITE_OPEN_READWRITE, nullptr) != SQLITE_OK) {
+        log_sqlite_err(db, "sqlite3_open_v2(maintenance)");
+        if (db) sqlite3_close(db);
+        return;
+    }
+    exec_sql(db, "PRAGMA busy_timeout=5000;");
+
+    while (running_) {
+        run_maintenance(db);
+
+        std::unique_lock<std::mutex> lk(maint_mtx_);
+        maint_cv_.wait_for(lk, std::chrono::seconds(opts_.maintenance_interval_s),
+                           [&]{ return !running_; });
+    }
+
+    sqlite3_close(db);
+}
+
+void StateDB::run_maintenance(sqlite3* db) {
+    const std::int64_t today = now_ms() / STATE_DAY_MS;
+
+    // ---- partition files: drop past retention, downsample past compact_after_days
+    if (opts_.partition_by_day) {
+        for (const auto& p : state_list_partitions(db_path_)) {
+            if (!running_) return;
+
+            // Held across the check and the work: the writer cannot attach
+            // this day in between
+            std::lock_guard<std::mutex> lk(part_mtx_);
+            if (p.day == writer_day_.load()) continue;
+
+            const std::int64_t age = today - p.day;
+
+            if (opts_.raw_retention_days > 0 && age > opts_.raw_retention_days) {
+                std::remove(p.path.c_str());
+                std::remove((p.path + "-wal").c_str());
+                std::remove((p.path + "-shm").c_str());
+                std::cerr << "[StateDB] retention: removed " << p.path << "\n";
+                continue;
+            }
+
+            if (opts_.compact_after_days > 0 && age >= opts_.compact_after_days) {
+                const auto t0 = std::chrono::steady_clock::now();
+                const std::int64_t kept = state_compact_partition(p.path, opts_.compact_bucket_ms);
+                if (kept > 0) {
+                    const double secs = std::chrono::duration<double>(
+                        std::chrono::steady_clock::now() - t0).count();
+                    std::cerr << "[StateDB] compacted " << p.path << " to "
+                              << opts_.compact_bucket_ms << "ms buckets (" << kept
+                              << " rows kept) in " << secs << "s\n";
+                }
+            }
+        }
+    }
+
+    // ---- main file: raw rows (single-file mode / pre-partition data) + rollup bars
+    std::vector<std::int64_t> ids;
+    {
+        sqlite3_stmt* st = nullptr;
+        if (sqlite3_prepare_v2(db, "SELECT instrument_id FROM instruments;",
+                               -1, &st, nullptr) != SQLITE_OK) {
+            log_sqlite_err(db, "sqlite3_prepare_v2(maintenance instruments)");
+            return;
+        }
+        while (sqlite3_step(st) == SQLITE_ROW) ids.push_back(sqlite3_column_int64(st, 0));
+        sqlite3_finalize(st);
+    }
+
+    auto expire = [&](const std::string& table, const char* ts_col, int days) {
+        if (days <= 0) return;
+        const std::int64_t cutoff = (today - days) * STATE_DAY_MS;
+        std::int64_t deleted = 0;
+        for (std::int64_t id : ids) {
+            if (!running_ || !delete_before(db, table, ts_col, id, cutoff, deleted)) break;
+        }
+        if (deleted > 0)
+            std::cerr << "[StateDB] retention: deleted " << deleted << " rows from " << table << "\n";
+    };
+
+    expire("main.market_state_v2", "ts_ms", opts_.raw_retention_days);
+    for (int r = 0; r < STATE_ROLLUP_COUNT; ++r)
+        expire(std::string("main.") + STATE_ROLLUPS[r].table, "bucket_ms", opts_.bar_retention_days[r]);
+}
+
+// ------------------------------------------------------------
+// WAL checkpoints (own connection, own thread)
+// ------------------------------------------------------------
+
+void StateDB::checkpoint_loop(sqlite3* db) {
+    if (!db && opts_.stats_log_interval_s <= 0) return;
+
+    const int tick_ms = opts_.checkpoint_interval_ms > 0 ? opts_.checkpoint_interval_ms : 1000;
+    const auto log_every = std::chrono::seconds(opts_.stats_log_interval_s);
+    auto next_log = std::chrono::steady_clock::now() + log_every;
+
+    std::int64_t attached = -1;   // writer partition attached here as "part"
+
+    while (running_) {
+        {
+            std::unique_lock<std::mutex> lk(maint_mtx_);
+            maint_cv_.wait_for(lk, std::chrono::milliseconds(tick_ms), [&]{ return !running_; });
+        }
+        if (!running_) break;
+
+        if (db) {
+            // Follow the writer onto a new day file; the old one was already
+            // checkpointed by the writer's DETACH or by our last pass
+            const std::int64_t day = writer_day_.load();
+            if (day != attached) {
+                if (attached >= 0) exec_sql(db, "DETACH DATABASE part;");
+                attached = -1;
+                if (day >= 0 && state_attach(db, state_partition_path(db_path_, day), "part"))
+                    attached = day;
+            }
+
+            checkpoint_db(db, "main");
+            if (attached >= 0) checkpoint_db(db, "part");
+        }
+
+        if (opts_.stats_log_interval_s > 0 && std::chrono::steady_clock::now() >= next_log) {
+            log_stats();
+            next_log += log_every;
+        }
+    }
+
+    if (db) {
+        if (attached >= 0) exec_sql(db, "DETACH DATABASE part;");
+        sqlite3_close(db);
+    }
+}
+
+void StateDB::checkpoint_db(sqlite3* db, const char* db_name) {
+    // PASSIVE: copies what it can without waiting on (or blocking) the writer
+    int log_frames = 0, ckpt_frames = 0;
+    const auto t0 = std::chrono::steady_clock::now();
+    const int rc = sqlite3_wal_checkpoint_v2(db, db_name, SQLITE_CHECKPOINT_PASSIVE,
+                                             &log_frames, &ckpt_frames);
+    const auto us = static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - t0).count());
+
+    if (rc != SQLITE_OK && rc != SQLITE_BUSY) {
+        log_sqlite_err(db, "sqlite3_wal_checkpoint_v2");
+        return;
+    }
+
+    st_checkpoints_.fetch_add(1, std::memory_order_relaxed);
+    if (rc == SQLITE_BUSY || ckpt_frames < log_frames)
+        st_checkpoint_busy_.fetch_add(1, std::memory_order_relaxed);
+    if (us > st_checkpoint_max_us_.load(std::memory_order_relaxed))
+        st_checkpoint_max_us_.store(us, std::memory_order_relaxed);
+    if (std::string(db_name) == "main")
+        st_wal_frames_.store(log_frames, std::memory_order_relaxed);
+}
+
+// ------------------------------------------------------------
+// Stats
+// ------------------------------------------------------------
+
+void StateDB::record_batch(std::size_t rows, std::size_t duplicates, bool ok, std::uint64_t us) {
+    if (ok) {
+        st_written_.fetch_add(rows);
+        st_duplicates_.fetch_add(duplicates, std::memory_order_relaxed);
+        st_batches_.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        st_failed_.fetch_add(rows);
+    }
+
+    if (rows > st_max_batch_.load(std::memory_order_relaxed))
+        st_max_batch_.store(rows, std::memory_order_relaxed);
+
+    int b = 0;
+    while (b < kLatencyBuckets - 1 && (us >> b) > 1) ++b;   // bucket b holds us < 2^(b+1)
+    st_commit_hist_[b].fetch_add(1, std::memory_order_relaxed);
+    if (us > st_commit_max_us_.load(std::memory_order_relaxed))
+        st_commit_max_us_.store(us, std::memory_order_relaxed);
+}
+
+StateDBStats StateDB::stats() const {
+    StateDBStats s;
+
+    // Outcomes before pushed: each was pushed first, so queued cannot underflow
+    s.written = st_written_.load();
+    s.dropped = st_dropped_.load();
+    s.failed  = st_failed_.load();
+    s.pushed  = st_pushed_.load();
+    s.queued  = s.pushed - s.written - s.dropped - s.failed;
+
+    s.duplicates       = st_duplicates_.load(std::memory_order_relaxed);
+    s.queue_high_water = st_queue_hwm_.load(std::memory_order_relaxed);
+    s.batches          = st_batches_.load(std::memory_order_relaxed);
+    s.max_batch_rows   = st_max_batch_.load(std::memory_order_relaxed);
+
+    std::uint64_t hist[kLatencyBuckets];
+    std::uint64_t total = 0;
+    for (int b = 0; b < kLatencyBuckets; ++b) {
+        hist[b] = st_commit_hist_[b].load(std::memory_order_relaxed);
+        total += hist[b];
+    }
+    auto percentile = [&](double q) -> std::uint64_t {
+        if (total == 0) return 0;
+        const std::uint64_t rank = static_cast<std::uint64_t>(q * static_cast<double>(total - 1)) + 1;
+        std::uint64_t seen = 0;
+        for (int b = 0; b < kLatencyBuckets; ++b) {
+            seen += hist[b];
+            if (seen >= rank) return std::uint64_t{2} << b;
+        }
+        return std::uint64_t{2} << (kLatencyBuckets - 1);
+    };
+    s.commit_us_p50 = percentile(0.50);
+    s.commit_us_p99 = percentile(0.99);
+    s.commit_us_max = st_commit_max_us_.load(std::memory_order_relaxed);
+
+    s.checkpoints       = st_checkpoints_.load(std::memory_order_relaxed);
+    s.checkpoint_busy   = st_checkpoint_busy_.load(std::memory_order_relaxed);
+    s.checkpoint_us_max = st_checkpoint_max_us_.load(std::memory_order_relaxed);
+    s.wal_frames        = st_wal_frames_.load(std::memory_order_relaxed);
+    return s;
+}
+
+void StateDB::log_stats() const {
+    const StateDBStats s = stats();
+    std::cerr << "[StateDB] stats pushed=" << s.pushed
+              << " written=" << s.written
+              << " duplicates=" << s.duplicates
+              << " dropped=" << s.dropped
+              << " failed=" << s.failed
+              << " queued=" << s.queued
+              << " queue_hwm=" << s.queue_high_water
+              << " batches=" << s.batches
+              << " max_batch=" << s.max_batch_rows
+              << " commit_us(p50<=" << s.commit_us_p50
+              << " p99<=" << s.commit_us_p99
+              << " max=" << s.commit_us_max << ")"
+              << " checkpoints=" << s.checkpoints
+              << " ckpt_busy=" << s.checkpoint_busy
+              << " ckpt_us_max=" << s.checkpoint_us_max
+              << " wal_frames=" << s.wal_frames << "\n";
+}
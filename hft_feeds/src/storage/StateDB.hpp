@@ -1,5 +1,6 @@
 #pragma once
 #include <sqlite3.h>
+#include "StateSchema.hpp"
 
 #include <atomic>
 #include <condition_variable>
@@ -25,11 +26,72 @@ struct StateSnapshot {
     double ask_vol[5]{0,0,0,0,0};
 };
 
+// Storage layout + retention (config.json "stateDb" block). Partitioning,
+// compaction and retention are opt-in: by default everything goes to one
+// file and no row is ever compacted or deleted.
+struct StateDBOptions {
+    std::string path = "market_state.db";
+    int flush_ms = 200;
+    std::size_t max_queue = 50000;
+
+    // Raw rows go to market_state.YYYY-MM-DD.db (UTC), attached by the writer
+    bool partition_by_day = false;
+
+    // Partitions older than this many days are downsampled to one row per
+    // compact_bucket_ms per instrument (0 = never compact)
+    int compact_after_days = 0;
+    std::int64_t compact_bucket_ms = 1000;
+
+    // Delete raw rows / partition files older than this (0 = keep forever)
+    int raw_retention_days = 0;
+
+    // Per STATE_ROLLUPS entry (1s, 1m); 0 = keep forever
+    int bar_retention_days[STATE_ROLLUP_COUNT] = {0, 0};
+
+    // How often the maintenance thread looks for work
+    int maintenance_interval_s = 600;
+
+    // WAL checkpoints run PASSIVE from their own thread/connection at this
+    // period; the writer's inline auto-checkpoint is off (0 = leave it on;
+    // also left on when that connection cannot be opened)
+    int checkpoint_interval_ms = 1000;
+
+    // Periodic "[StateDB] stats ..." line (0 = only on stop)
+    int stats_log_interval_s = 60;
+};
+
+// Counters since start(). Every accepted snapshot ends up in exactly one of
+// written / dropped / failed, or is still queued:
+//   pushed == written + dropped + failed + queued
+struct StateDBStats {
+    std::uint64_t pushed{0};            // accepted by push()
+    std::uint64_t written{0};           // committed
+    std::uint64_t duplicates{0};        // of written: already stored, ignored (not in rollups)
+    std::uint64_t dropped{0};           // evicted from a full queue (max_queue)
+    std::uint64_t failed{0};            // in a transaction that rolled back
+    std::uint64_t queued{0};            // queued or in the batch being written
+
+    std::uint64_t queue_high_water{0};  // deepest q_ seen by push()
+    std::uint64_t batches{0};           // transactions committed
+    std::uint64_t max_batch_rows{0};
+
+    // Batch transaction latency (BEGIN..COMMIT); percentiles are log2-bucket upper bounds
+    std::uint64_t commit_us_p50{0};
+    std::uint64_t commit_us_p99{0};
+    std::uint64_t commit_us_max{0};
+
+    std::uint64_t checkpoints{0};
+    std::uint64_t checkpoint_busy{0};   // PASSIVE runs that could not finish (readers)
+    std::uint64_t checkpoint_us_max{0};
+    std::int64_t wal_frames{0};         // main WAL size at the last checkpoint
+};
+
 class StateDB {
 public:
     explicit StateDB(std::string db_path,
                      int flush_ms = 200,
                      std::size_t max_queue = 50000);
+    explicit StateDB(StateDBOptions opts);
     ~StateDB();
 
     StateDB(const StateDB&) = delete;
@@ -38,13 +100,62 @@ public:
     // B2 producer API (called from MarketDataManager threads)
     void push(StateSnapshot s);
 
-    // Start/stop writer thread
+    // Start/stop writer, maintenance and checkpoint threads
     bool start();
     void stop();
 
+    // Safe to call from any thread
+    StateDBStats stats() const;
+
+    // Write one batch on the calling thread, as the writer thread would
+    // (benchmarks, one-shot tools). Only while not start()ed; no maintenance
+    // or checkpoint thread runs.
+    bool write_batch(const std::vector<StateSnapshot>& batch);
+
 private:
+    // One prepared INSERT per supported row count (largest first, last = 1 row)
+    struct BatchStmt {
+        std::size_t rows;
+        sqlite3_stmt* stmt;
+    };
+
+    // Cached instruments.instrument_id (a handful of keys: linear scan, no hashing)
+    struct InstrumentId {
+        std::string exchange;
+        std::string instrument;
+        std::int64_t id;
+    };
+
+    // Last seq handed out per instrument (same-ms samples get 0, 1, 2...)
+    struct SeqState {
+        std::int64_t id;
+        std::uint64_t ts_ms;
+        std::int64_t seq;
+    };
+
+    // Row an INSERT ... RETURNING reported as actually inserted
+    struct InsertedKey {
+        std::int64_t id;
+        std::int64_t ts_ms;
+        std::int64_t seq;
+    };
+
+    // Partial time-bucket bar accumulated from the current batch
+    struct RollupBar {
+        int rollup;                 // index into STATE_ROLLUPS
+        std::int64_t id;
+        std::int64_t bucket_ms;
+        std::uint64_t first_ts, last_ts;
+        double open, high, low, close;
+        double spread_sum, spread_max;
+        double bid_depth_sum, ask_depth_sum;
+        std::int64_t n;
+    };
+
     bool open_connection();
     void close_connection();
+    bool open_writer();
+    void close_writer();
     bool init_schema_and_pragmas();
 
     bool prepare_statements();
@@ -52,14 +163,58 @@ private:
 
     void writer_loop();
     bool insert_batch(const std::vector<StateSnapshot>& batch);
+    // duplicates: rows ignored because they were already stored
+    bool insert_rows(const std::vector<StateSnapshot>& batch, std::size_t begin, std::size_t end,
+                     std::size_t& duplicates);
+
+    // Make `day`'s partition the one attached as "part" (between transactions).
+    // false for days at or past the compaction / retention horizon.
+    bool attach_partition(std::int64_t day);
+    void detach_partition();
+
+    // Compaction + retention on a separate connection; never touches the
+    // partition the writer has attached
+    void maintenance_loop();
+    void run_maintenance(sqlite3* db);
+
+    // PASSIVE checkpoints of main + the writer's partition, off the writer
+    // thread, on `db` (opened by start(); owned and closed here; nullptr =
+    // stats logging only)
+    void checkpoint_loop(sqlite3* db);
+    void checkpoint_db(sqlite3* db, const char* db_name);
+    void log_stats() const;
+    void record_batch(std::size_t rows, std::size_t duplicates, bool ok, std::uint64_t us);
+
+    std::int64_t instrument_id(const StateSnapshot& s);
+    std::int64_t next_seq(std::int64_t id, std::uint64_t ts_ms);
+    void bind_row(sqlite3_stmt* st, int& idx, const StateSnapshot& s, std::int64_t id, std::int64_t seq);
+    std::size_t mark_inserted(const std::vector<StateSnapshot>& batch, std::size_t begin, std::size_t rows);
+
+    bool update_rollups(const std::vector<StateSnapshot>& batch, std::size_t begin, std::size_t end);
+    bool upsert_bar(const RollupBar& b);
 
 private:
+    StateDBOptions opts_;
     std::string db_path_;
     int flush_ms_;
     std::size_t max_queue_;
 
     sqlite3* db_{nullptr};
-    sqlite3_stmt* stmt_insert_{nullptr};
+    std::int64_t part_day_{-1};                 // day attached as "part", -1 = none
+    std::atomic<std::int64_t> writer_day_{-1};  // same, readable by maintenance
+    std::vector<BatchStmt> stmt_batches_;
+    sqlite3_stmt* stmt_instr_insert_{nullptr};
+    sqlite3_stmt* stmt_instr_select_{nullptr};
+
+    std::vector<InstrumentId> instrument_ids_;
+    std::vector<std::int64_t> batch_ids_;
+    std::vector<std::int64_t> batch_seq_;
+    std::vector<char> batch_new_;               // row was inserted, not ignored as a duplicate
+    std::vector<InsertedKey> returned_;
+    std::vector<SeqState> seq_state_;
+
+    sqlite3_stmt* stmt_rollup_[STATE_ROLLUP_COUNT]{};   // one UPSERT per STATE_ROLLUPS entry
+    std::vector<RollupBar> rollup_open_;
 
     std::atomic<bool> running_{false};
     std::thread writer_;
@@ -67,4 +222,27 @@ private:
     std::mutex mtx_;
     std::condition_variable cv_;
     std::deque<StateSnapshot> q_;
+
+    std::thread maintenance_;
+    std::thread checkpointer_;
+    std::mutex maint_mtx_;               // also paces checkpointer_
+    std::mutex part_mtx_;                // attach_partition vs. maintenance of one partition file
+    std::condition_variable maint_cv_;
+
+    // Stats (see StateDBStats); counters only ever grow
+    static constexpr int kLatencyBuckets = 32;   // log2(us)
+    std::atomic<std::uint64_t> st_pushed_{0};
+    std::atomic<std::uint64_t> st_written_{0};
+    std::atomic<std::uint64_t> st_duplicates_{0};
+    std::atomic<std::uint64_t> st_dropped_{0};
+    std::atomic<std::uint64_t> st_failed_{0};
+    std::atomic<std::uint64_t> st_queue_hwm_{0};     // written under mtx_
+    std::atomic<std::uint64_t> st_batches_{0};
+    std::atomic<std::uint64_t> st_max_batch_{0};
+    std::atomic<std::uint64_t> st_commit_hist_[kLatencyBuckets]{};
+    std::atomic<std::uint64_t> st_commit_max_us_{0};
+    std::atomic<std::uint64_t> st_checkpoints_{0};
+    std::atomic<std::uint64_t> st_checkpoint_busy_{0};
+    std::atomic<std::uint64_t> st_checkpoint_max_us_{0};
+    std::atomic<std::int64_t> st_wal_frames_{0};
 };
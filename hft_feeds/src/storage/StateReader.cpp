@@ -0,0 +1,424 @@
+#include "StateReader.hpp"
+#include "StateSchema.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <thread>
+#include <utility>
+
+static void log_sqlite_err(sqlite3* db, const char* where) {
+    std::cerr << "[StateReader] " << where << " sqlite_err="
+              << (db ? sqlite3_errmsg(db) : "null-db") << "\n";
+}
+
+StateReader::StateReader(std::string db_path)
+    : db_path_(std::move(db_path))
+{}
+
+StateReader::~StateReader() {
+    close();
+}
+
+bool StateReader::open() {
+    if (db_) return true;
+
+    int rc = sqlite3_open_v2(db_path_.c_str(), &db_,
+                             SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX, nullptr);
+    if (rc != SQLITE_OK) {
+        log_sqlite_err(db_, "sqlite3_open_v2");
+        close();
+        return false;
+    }
+
+    // Big sequential scans: let sqlite read pages through mmap
+    state_exec_sql(db_, "PRAGMA mmap_size=268435456;");
+    state_exec_sql(db_, "PRAGMA busy_timeout=2000;");
+
+    if (!state_table_exists(db_, "market_state_v2")) {
+        std::cerr << "[StateReader] " << db_path_
+                  << " has no market_state_v2 table (run migrate_state_db for v1 files)\n";
+        close();
+        return false;
+    }
+
+    const std::string range_sql =
+        std::string("SELECT ") + STATE_V2_COLUMNS +
+        " FROM market_state_v2"
+        " WHERE instrument_id=? AND ts_ms>=? AND ts_ms<?"
+        " ORDER BY ts_ms;";
+
+    rc = sqlite3_prepare_v3(db_, range_sql.c_str(), -1,
+                            SQLITE_PREPARE_PERSISTENT, &stmt_range_, nullptr);
+    if (rc != SQLITE_OK) {
+        log_sqlite_err(db_, "sqlite3_prepare_v3(range)");
+        close();
+        return false;
+    }
+
+    rc = sqlite3_prepare_v2(db_,
+        "SELECT instrument_id FROM instruments WHERE exchange=? AND instrument=?;",
+        -1, &stmt_instr_, nullptr);
+    if (rc != SQLITE_OK) {
+        log_sqlite_err(db_, "sqlite3_prepare_v2(instruments)");
+        close();
+        return false;
+    }
+
+    // Rollups are optional (files written before they existed have none)
+    for (int r = 0; r < STATE_ROLLUP_COUNT; ++r) {
+        const StateRollup& ru = STATE_ROLLUPS[r];
+        if (!state_table_exists(db_, ru.table)) continue;
+
+        const std::string bars_sql =
+            std::string("SELECT bucket_ms, open, high, low, close, spread_avg, spread_max,"
+                        " bid_depth5_avg, ask_depth5_avg, n FROM ") + ru.table + "_v"
+            " WHERE instrument_id=? AND bucket_ms>=? AND bucket_ms<?"
+            " ORDER BY bucket_ms;";
+
+        rc = sqlite3_prepare_v3(db_, bars_sql.c_str(), -1,
+                                SQLITE_PREPARE_PERSISTENT, &stmt_bars_[r], nullptr);
+        if (rc != SQLITE_OK) {
+            log_sqlite_err(db_, "sqlite3_prepare_v3(bars)");
+            stmt_bars_[r] = nullptr;
+        }
+    }
+    return true;
+}
+
+void StateReader::close() {
+    detach_partition();
+    if (stmt_part_range_) {
+        sqlite3_finalize(stmt_part_range_);
+        stmt_part_range_ = nullptr;
+    }
+    if (stmt_range_) {
+        sqlite3_finalize(stmt_range_);
+        stmt_range_ = nullptr;
+    }
+    if (stmt_instr_) {
+        sqlite3_finalize(stmt_instr_);
+        stmt_instr_ = nullptr;
+    }
+    for (auto*& st : stmt_bars_) {
+        if (st) {
+            sqlite3_finalize(st);
+            st = nullptr;
+        }
+    }
+    if (db_) {
+        sqlite3_close(db_);
+        db_ = nullptr;
+    }
+}
+
+std::int64_t StateReader::instrument_id(const std::string& exchange, const std::string& instrument) {
+    if (!db_) return -1;
+
+    sqlite3_reset(stmt_instr_);
+    sqlite3_bind_text(stmt_instr_, 1, exchange.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt_instr_, 2, instrument.c_str(), -1, SQLITE_TRANSIENT);
+
+    std::int64_t id = -1;
+    if (sqlite3_step(stmt_instr_) == SQLITE_ROW)
+        id = sqlite3_column_int64(stmt_instr_, 0);
+    sqlite3_reset(stmt_instr_);
+    return id;
+}
+
+std::vector<StateKey> StateReader::instruments() {
+    std::vector<StateKey> out;
+    if (!db_) return out;
+
+    sqlite3_stmt* st = nullptr;
+    if (sqlite3_prepare_v2(db_,
+            "SELECT exchange, instrument FROM instruments ORDER BY instrument_id;",
+            -1, &st, nullptr) != SQLITE_OK) {
+        log_sqlite_err(db_, "sqlite3_prepare_v2(list instruments)");
+        return out;
+    }
+
+    while (sqlite3_step(st) == SQLITE_ROW) {
+        StateKey k;
+        k.exchange   = reinterpret_cast<const char*>(sqlite3_column_text(st, 0));
+        k.instrument = reinterpret_cast<const char*>(sqlite3_column_text(st, 1));
+        out.push_back(std::move(k));
+    }
+    sqlite3_finalize(st);
+    return out;
+}
+
+sqlite3_stmt* StateReader::open_partition(const std::string& path, std::int64_t id,
+                                          std::uint64_t from_ms, std::uint64_t to_ms) {
+    detach_partition();
+
+    if (!state_attach(db_, path, "p")) return nullptr;
+    part_attached_ = true;
+
+    // A file caught between its creation and the writer's CREATE TABLE
+    // has nothing to read yet
+    if (!state_table_exists(db_, "market_state_v2", "p")) return nullptr;
+
+    if (!stmt_part_range_) {
+        // Re-prepared by sqlite on its own whenever "p" points at another file
+        const std::string range_sql =
+            std::string("SELECT ") + STATE_V2_COLUMNS +
+            " FROM p.market_state_v2"
+            " WHERE instrument_id=? AND ts_ms>=? AND ts_ms<?"
+            " ORDER BY ts_ms;";
+
+        if (sqlite3_prepare_v3(db_, range_sql.c_str(), -1, SQLITE_PREPARE_PERSISTENT,
+                               &stmt_part_range_, nullptr) != SQLITE_OK) {
+            log_sqlite_err(db_, "sqlite3_prepare_v3(partition range)");
+            stmt_part_range_ = nullptr;
+            return nullptr;
+        }
+    }
+
+    sqlite3_reset(stmt_part_range_);
+    sqlite3_bind_int64(stmt_part_range_, 1, id);
+    sqlite3_bind_int64(stmt_part_range_, 2, static_cast<sqlite3_int64>(from_ms));
+    sqlite3_bind_int64(stmt_part_range_, 3, static_cast<sqlite3_int64>(to_ms));
+    return stmt_part_range_;
+}
+
+void StateReader::detach_partition() {
+    if (!part_attached_) return;
+    if (stmt_part_range_) sqlite3_reset(stmt_part_range_);
+    state_exec_sql(db_, "DETACH DATABASE p;");
+    part_attached_ = false;
+}
+
+// ------------------------------------------------------------
+// Cursor
+// ------------------------------------------------------------
+
+StateReader::Cursor::Cursor(Cursor&& o) noexcept {
+    *this = std::move(o);
+}
+
+StateReader::Cursor::~Cursor() {
+    stop();
+}
+
+StateReader::Cursor& StateReader::Cursor::operator=(Cursor&& o) noexcept {
+    if (this != &o) {
+        stop();
+        r_ = o.r_;
+        st_ = o.st_;
+        key_ = std::move(o.key_);
+        id_ = o.id_;
+        from_ms_ = o.from_ms_;
+        to_ms_ = o.to_ms_;
+        parts_ = std::move(o.parts_);
+        next_part_ = o.next_part_;
+        done_ = o.done_;
+        o.st_ = nullptr;
+        o.done_ = true;
+    }
+    return *this;
+}
+
+bool StateReader::Cursor::next_source() {
+    while (next_part_ < parts_.size()) {
+        st_ = r_->open_partition(parts_[next_part_++], id_, from_ms_, to_ms_);
+        if (st_) return true;
+    }
+    return false;
+}
+
+void StateReader::Cursor::stop() {
+    if (st_) sqlite3_reset(st_);
+    st_ = nullptr;
+    done_ = true;
+}
+
+std::size_t StateReader::Cursor::fetch(StateSnapshot* out, std::size_t max) {
+    std::size_t n = 0;
+    while (n < max && !done_) {
+        if (!st_ && !next_source()) {
+            done_ = true;
+            break;
+        }
+
+        int rc = sqlite3_step(st_);
+        if (rc != SQLITE_ROW) {
+            if (rc != SQLITE_DONE)
+                log_sqlite_err(sqlite3_db_handle(st_), "sqlite3_step(range)");
+            sqlite3_reset(st_);
+            st_ = nullptr;   // on to the next partition
+            continue;
+        }
+
+        StateSnapshot& s = out[n++];
+
+        // Short keys stay in SSO storage: no allocation when the buffer is reused
+        s.exchange   = key_.exchange;
+        s.instrument = key_.instrument;
+
+        // Column order = STATE_V2_COLUMNS (0 = instrument_id)
+        int c = 1;
+        s.ts_ms           = static_cast<std::uint64_t>(sqlite3_column_int64(st_, c++));
+        s.mid             = sqlite3_column_double(st_, c++);
+        s.spread          = sqlite3_column_double(st_, c++);
+        s.r1              = sqlite3_column_double(st_, c++);
+        s.r5              = sqlite3_column_double(st_, c++);
+        s.r10             = sqlite3_column_double(st_, c++);
+        s.imbalance       = sqlite3_column_double(st_, c++);
+        s.cross_ex_signal = sqlite3_column_double(st_, c++);
+        for (int i = 0; i < 5; ++i) s.bid_vol[i] = sqlite3_column_double(st_, c++);
+        for (int i = 0; i < 5; ++i) s.ask_vol[i] = sqlite3_column_double(st_, c++);
+    }
+    return n;
+}
+
+StateReader::Cursor StateReader::scan(const std::string& exchange, const std::string& instrument,
+                                      std::uint64_t from_ms, std::uint64_t to_ms) {
+    Cursor cur;
+    cur.key_ = {exchange, instrument};
+    if (!db_ || to_ms <= from_ms) return cur;
+
+    const std::int64_t id = instrument_id(exchange, instrument);
+    if (id < 0) return cur;
+
+    sqlite3_reset(stmt_range_);
+    sqlite3_bind_int64(stmt_range_, 1, id);
+    sqlite3_bind_int64(stmt_range_, 2, static_cast<sqlite3_int64>(from_ms));
+    sqlite3_bind_int64(stmt_range_, 3, static_cast<sqlite3_int64>(to_ms));
+
+    // Only the day files that can hold rows in [from_ms, to_ms)
+    const std::int64_t first_day = static_cast<std::int64_t>(from_ms / STATE_DAY_MS);
+    const std::int64_t last_day  = static_cast<std::int64_t>((to_ms - 1) / STATE_DAY_MS);
+    for (const auto& p : state_list_partitions(db_path_)) {
+        if (p.day >= first_day && p.day <= last_day) cur.parts_.push_back(p.path);
+    }
+
+    cur.r_ = this;
+    cur.st_ = stmt_range_;
+    cur.id_ = id;
+    cur.from_ms_ = from_ms;
+    cur.to_ms_ = to_ms;
+    cur.done_ = false;
+    return cur;
+}
+
+std::int64_t StateReader::for_each(const std::string& exchange, const std::string& instrument,
+                                   std::uint64_t from_ms, std::uint64_t to_ms,
+                                   const ChunkFn& fn, std::size_t chunk_rows) {
+    if (!db_) return -1;
+    if (chunk_rows == 0) chunk_rows = 1;
+
+    std::vector<StateSnapshot> buf(chunk_rows);
+    Cursor cur = scan(exchange, instrument, from_ms, to_ms);
+
+    std::int64_t total = 0;
+    while (true) {
+        const std::size_t n = cur.fetch(buf.data(), buf.size());
+        if (n == 0) break;
+        total += static_cast<std::int64_t>(n);
+        if (!fn(buf.data(), n)) {
+            cur.stop();
+            break;
+        }
+    }
+    return total;
+}
+
+std::int64_t StateReader::for_each_bar(const std::string& exchange, const std::string& instrument,
+                                       std::int64_t bucket_ms,
+                                       std::uint64_t from_ms, std::uint64_t to_ms,
+                                       const BarChunkFn& fn, std::size_t chunk_rows) {
+    if (!db_) return -1;
+    if (chunk_rows == 0) chunk_rows = 1;
+
+    sqlite3_stmt* st = nullptr;
+    for (int r = 0; r < STATE_ROLLUP_COUNT; ++r) {
+        if (STATE_ROLLUPS[r].bucket_ms == bucket_ms) st = stmt_bars_[r];
+    }
+    if (!st) {
+        std::cerr << "[StateReader] no rollup table for bucket_ms=" << bucket_ms << "\n";
+        return -1;
+    }
+
+    const std::int64_t id = instrument_id(exchange, instrument);
+    if (id < 0) return 0;
+
+    sqlite3_reset(st);
+    sqlite3_bind_int64(st, 1, id);
+    sqlite3_bind_int64(st, 2, static_cast<sqlite3_int64>(from_ms));
+    sqlite3_bind_int64(st, 3, static_cast<sqlite3_int64>(to_ms));
+
+    std::vector<StateBar> buf(chunk_rows);
+    std::int64_t total = 0;
+    bool more = true;
+
+    while (more) {
+        std::size_t n = 0;
+        while (n < buf.size()) {
+            int rc = sqlite3_step(st);
+            if (rc != SQLITE_ROW) {
+                if (rc != SQLITE_DONE) log_sqlite_err(db_, "sqlite3_step(bars)");
+                more = false;
+                break;
+            }
+            StateBar& b = buf[n++];
+            b.bucket_ms      = static_cast<std::uint64_t>(sqlite3_column_int64(st, 0));
+            b.open           = sqlite3_column_double(st, 1);
+            b.high           = sqlite3_column_double(st, 2);
+            b.low            = sqlite3_column_double(st, 3);
+            b.close          = sqlite3_column_double(st, 4);
+            b.spread_avg     = sqlite3_column_double(st, 5);
+            b.spread_max     = sqlite3_column_double(st, 6);
+            b.bid_depth5_avg = sqlite3_column_double(st, 7);
+            b.ask_depth5_avg = sqlite3_column_double(st, 8);
+            b.n              = sqlite3_column_int64(st, 9);
+        }
+
+        if (n == 0) break;
+        total += static_cast<std::int64_t>(n);
+        if (!fn(buf.data(), n)) break;
+    }
+
+    sqlite3_reset(st);
+    return total;
+}
+
+std::int64_t StateReader::scan_parallel(const std::string& db_path,
+                                        const std::vector<StateKey>& keys,
+                                        std::uint64_t from_ms, std::uint64_t to_ms,
+                                        const KeyChunkFn& fn,
+                                        unsigned threads,
+                                        std::size_t chunk_rows) {
+    if (keys.empty()) return 0;
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = std::min<unsigned>(threads, static_cast<unsigned>(keys.size()));
+
+    std::atomic<std::size_t> next{0};
+    std::atomic<std::int64_t> total{0};
+    std::atomic<bool> failed{false};
+
+    auto worker = [&]() {
+        StateReader r(db_path);
+        if (!r.open()) {
+            failed = true;
+            return;
+        }
+        while (true) {
+            const std::size_t i = next.fetch_add(1);
+            if (i >= keys.size()) break;
+
+            const StateKey& k = keys[i];
+            const std::int64_t n = r.for_each(k.exchange, k.instrument, from_ms, to_ms,
+                [&](const StateSnapshot* rows, std::size_t cnt) { return fn(k, rows, cnt); },
+                chunk_rows);
+            if (n > 0) total += n;
+        }
+    };
+
+    std::vector<std::thread> pool;
+    pool.reserve(threads);
+    for (unsigned t = 0; t < threads; ++t) pool.emplace_back(worker);
+    for (auto& t : pool) t.join();
+
+    return failed ? -1 : total.load();
+}
@@ -0,0 +1,127 @@
+#pragma once
+#include <sqlite3.h>
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "StateDB.hpp"   // StateSnapshot
+#include "StateSchema.hpp"
+
+// Read side of market_state.db (schema v2). Opens its own read-only
+// connection, so it can run next to a live StateDB writer (WAL).
+// Raw scans cover the main file and every day partition next to it
+// (market_state.YYYY-MM-DD.db) that overlaps the requested range.
+
+struct StateKey {
+    std::string exchange;
+    std::string instrument;
+};
+
+// One rollup bar (market_bars_1s / market_bars_1m), averages already divided out
+struct StateBar {
+    std::uint64_t bucket_ms{0};
+    double open{0.0}, high{0.0}, low{0.0}, close{0.0};
+    double spread_avg{0.0}, spread_max{0.0};
+    double bid_depth5_avg{0.0}, ask_depth5_avg{0.0};
+    std::int64_t n{0};
+};
+
+class StateReader {
+public:
+    // Called once per fetched chunk; return false to stop the scan early
+    using ChunkFn = std::function<bool(const StateSnapshot* rows, std::size_t n)>;
+    using BarChunkFn = std::function<bool(const StateBar* bars, std::size_t n)>;
+    using KeyChunkFn = std::function<bool(const StateKey& key,
+                                          const StateSnapshot* rows, std::size_t n)>;
+
+    explicit StateReader(std::string db_path);
+    ~StateReader();
+
+    StateReader(const StateReader&) = delete;
+    StateReader& operator=(const StateReader&) = delete;
+
+    bool open();
+    void close();
+
+    // instruments.instrument_id, or -1 if the key was never written
+    std::int64_t instrument_id(const std::string& exchange, const std::string& instrument);
+    std::vector<StateKey> instruments();
+
+    // Forward-only cursor over [from_ms, to_ms) for one key, ordered by ts_ms
+    // (main-file rows first, then partitions by day). Uses the reader's
+    // prepared range statements and partition slot: one live cursor per reader.
+    // Destroying a cursor resets its statement so an abandoned scan does not
+    // pin a WAL read snapshot; it must not outlive the reader's open().
+    class Cursor {
+    public:
+        Cursor() = default;
+        ~Cursor();
+        Cursor(Cursor&& o) noexcept;
+        Cursor& operator=(Cursor&& o) noexcept;
+        Cursor(const Cursor&) = delete;
+        Cursor& operator=(const Cursor&) = delete;
+
+        // Fill up to `max` rows into out[0..max); returns rows written, 0 at end
+        std::size_t fetch(StateSnapshot* out, std::size_t max);
+
+        bool done() const { return done_; }
+
+    private:
+        friend class StateReader;
+        bool next_source();
+        void stop();
+
+        StateReader* r_{nullptr};
+        sqlite3_stmt* st_{nullptr};
+        StateKey key_;
+        std::int64_t id_{-1};
+        std::uint64_t from_ms_{0}, to_ms_{0};
+        std::vector<std::string> parts_;    // partition files still to read
+        std::size_t next_part_{0};
+        bool done_{true};
+    };
+
+    Cursor scan(const std::string& exchange, const std::string& instrument,
+                std::uint64_t from_ms, std::uint64_t to_ms);
+
+    // Stream a range through `fn` in chunks of `chunk_rows` (one preallocated buffer).
+    // Returns rows delivered, or -1 if the reader is not open.
+    std::int64_t for_each(const std::string& exchange, const std::string& instrument,
+                          std::uint64_t from_ms, std::uint64_t to_ms,
+                          const ChunkFn& fn, std::size_t chunk_rows = 4096);
+
+    // Stream rollup bars; bucket_ms must be one of STATE_ROLLUPS (1000, 60000).
+    // Returns bars delivered, or -1 on error / unknown resolution.
+    std::int64_t for_each_bar(const std::string& exchange, const std::string& instrument,
+                              std::int64_t bucket_ms,
+                              std::uint64_t from_ms, std::uint64_t to_ms,
+                              const BarChunkFn& fn, std::size_t chunk_rows = 4096);
+
+    // Fan out one scan per key over up to `threads` workers, each with its own
+    // connection. `fn` is called concurrently from worker threads (never for
+    // the same key at once) and its `key` argument refers into `keys`.
+    static std::int64_t scan_parallel(const std::string& db_path,
+                                      const std::vector<StateKey>& keys,
+                                      std::uint64_t from_ms, std::uint64_t to_ms,
+                                      const KeyChunkFn& fn,
+                                      unsigned threads = 0,
+                                      std::size_t chunk_rows = 4096);
+
+private:
+    // Attach `path` as "p" and return the bound range statement over it,
+    // or nullptr if the file cannot be read
+    sqlite3_stmt* open_partition(const std::string& path, std::int64_t id,
+                                 std::uint64_t from_ms, std::uint64_t to_ms);
+    void detach_partition();
+
+private:
+    std::string db_path_;
+    sqlite3* db_{nullptr};
+    sqlite3_stmt* stmt_range_{nullptr};
+    sqlite3_stmt* stmt_part_range_{nullptr};
+    bool part_attached_{false};
+    sqlite3_stmt* stmt_instr_{nullptr};
+    sqlite3_stmt* stmt_bars_[STATE_ROLLUP_COUNT]{};
+};
@@ -0,0 +1,400 @@
+#include "StateSchema.hpp"
+#include <iostream>
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+
+#define STATE_V2_COLUMNS_SQL \
+    "instrument_id, ts_ms, mid, spread, r1, r5, r10, imbalance, cross_ex_signal," \
+    " bid_v1,bid_v2,bid_v3,bid_v4,bid_v5," \
+    " ask_v1,ask_v2,ask_v3,ask_v4,ask_v5"
+
+const char* const STATE_V2_COLUMNS = STATE_V2_COLUMNS_SQL;
+const char* const STATE_V2_INSERT_COLUMNS = STATE_V2_COLUMNS_SQL ", seq";
+
+const StateRollup STATE_ROLLUPS[STATE_ROLLUP_COUNT] = {
+    {"market_bars_1s", 1000},
+    {"market_bars_1m", 60000},
+};
+
+const char* const STATE_BAR_COLUMNS =
+    "instrument_id, bucket_ms, first_ts_ms, last_ts_ms,"
+    " open, high, low, close,"
+    " spread_sum, spread_max, bid_depth_sum, ask_depth_sum, n";
+
+bool state_exec_sql(sqlite3* db, const char* sql) {
+    char* err = nullptr;
+    int rc = sqlite3_exec(db, sql, nullptr, nullptr, &err);
+    if (rc != SQLITE_OK) {
+        std::cerr << "[StateDB] sqlite_exec failed: " << (err ? err : "") << "\n";
+        sqlite3_free(err);
+        return false;
+    }
+    return true;
+}
+
+bool state_apply_writer_pragmas(sqlite3* db) {
+    if (!state_exec_sql(db, "PRAGMA journal_mode=WAL;")) return false;
+    if (!state_exec_sql(db, "PRAGMA synchronous=NORMAL;")) return false;
+    if (!state_exec_sql(db, "PRAGMA temp_store=MEMORY;")) return false;
+    if (!state_exec_sql(db, "PRAGMA foreign_keys=ON;")) return false;
+    if (!state_exec_sql(db, "PRAGMA busy_timeout=2000;")) return false;
+    // WAL is reused after each checkpoint; this trims it back if a long reader let it grow
+    if (!state_exec_sql(db, "PRAGMA journal_size_limit=67108864;")) return false;
+    return true;
+}
+
+// Clustered on (instrument_id, ts_ms, seq): range scans per instrument are
+// sequential, and there is no separate rowid b-tree or secondary index.
+// seq tells apart samples of one instrument within the same millisecond.
+static std::string raw_table_sql(const std::string& p) {
+    return "CREATE TABLE IF NOT EXISTS " + p + "market_state_v2 ("
+           "  instrument_id INTEGER NOT NULL,"
+           "  ts_ms INTEGER NOT NULL,"
+           "  mid REAL NOT NULL,"
+           "  spread REAL NOT NULL,"
+           "  r1 REAL NOT NULL,"
+           "  r5 REAL NOT NULL,"
+           "  r10 REAL NOT NULL,"
+           "  imbalance REAL NOT NULL,"
+           "  cross_ex_signal REAL NOT NULL,"
+           "  bid_v1 REAL NOT NULL, bid_v2 REAL NOT NULL, bid_v3 REAL NOT NULL, bid_v4 REAL NOT NULL, bid_v5 REAL NOT NULL,"
+           "  ask_v1 REAL NOT NULL, ask_v2 REAL NOT NULL, ask_v3 REAL NOT NULL, ask_v4 REAL NOT NULL, ask_v5 REAL NOT NULL,"
+           "  seq INTEGER NOT NULL DEFAULT 0,"
+           "  PRIMARY KEY (instrument_id, ts_ms, seq)"
+           ") WITHOUT ROWID;";
+}
+
+bool state_create_v2(sqlite3* db, const char* db_name) {
+    const std::string p = std::string(db_name) + ".";
+
+    // Dictionary: one row per (exchange, instrument), rows reference the id
+    const std::string instruments_sql =
+        "CREATE TABLE IF NOT EXISTS " + p + "instruments ("
+        "  instrument_id INTEGER PRIMARY KEY,"
+        "  exchange TEXT NOT NULL,"
+        "  instrument TEXT NOT NULL,"
+        "  UNIQUE(exchange, instrument)"
+        ");";
+
+    if (!state_exec_sql(db, instruments_sql.c_str())) return false;
+    if (!state_exec_sql(db, raw_table_sql(p).c_str())) return false;
+
+    // OHLC of mid, spread avg/max, mean top-5 depth per side, sample count
+    for (const auto& r : STATE_ROLLUPS) {
+        const std::string bars_sql =
+            "CREATE TABLE IF NOT EXISTS " + p + r.table + " ("
+            "  instrument_id INTEGER NOT NULL,"
+            "  bucket_ms INTEGER NOT NULL,"
+            "  first_ts_ms INTEGER NOT NULL,"
+            "  last_ts_ms INTEGER NOT NULL,"
+            "  open REAL NOT NULL, high REAL NOT NULL, low REAL NOT NULL, close REAL NOT NULL,"
+            "  spread_sum REAL NOT NULL, spread_max REAL NOT NULL,"
+            "  bid_depth_sum REAL NOT NULL, ask_depth_sum REAL NOT NULL,"
+            "  n INTEGER NOT NULL,"
+            "  PRIMARY KEY (instrument_id, bucket_ms)"
+            ") WITHOUT ROWID;";
+
+        const std::string view_sql =
+            "CREATE VIEW IF NOT EXISTS " + p + r.table + "_v AS"
+            " SELECT instrument_id, bucket_ms, open, high, low, close,"
+            "  spread_sum / n AS spread_avg, spread_max,"
+            "  bid_depth_sum / n AS bid_depth5_avg, ask_depth_sum / n AS ask_depth5_avg, n"
+            " FROM " + r.table + ";";
+
+        if (!state_exec_sql(db, bars_sql.c_str())) return false;
+        if (!state_exec_sql(db, view_sql.c_str())) return false;
+    }
+
+    const std::string version_sql =
+        "PRAGMA " + p + "user_version=" + std::to_string(STATE_SCHEMA_VERSION) + ";";
+    return state_exec_sql(db, version_sql.c_str());
+}
+
+bool state_table_exists(sqlite3* db, const char* table, const char* db_name) {
+    const std::string sql =
+        std::string("SELECT 1 FROM ") + db_name +
+        ".sqlite_master WHERE type='table' AND name=?;";
+
+    sqlite3_stmt* st = nullptr;
+    if (sqlite3_prepare_v2(db, sql.c_str(), -1, &st, nullptr) != SQLITE_OK)
+        return false;
+
+    sqlite3_bind_text(st, 1, table, -1, SQLITE_STATIC);
+    const bool found = (sqlite3_step(st) == SQLITE_ROW);
+    sqlite3_finalize(st);
+    return found;
+}
+
+std::int64_t state_migrate_v1_to_v2(sqlite3* db) {
+    if (!state_table_exists(db, "market_state")) return 0;
+    if (!state_create_v2(db)) return -1;
+
+    if (!state_exec_sql(db,
+            "INSERT OR IGNORE INTO instruments(exchange, instrument) "
+            "SELECT DISTINCT exchange, instrument FROM market_state;"))
+        return -1;
+
+    // v1 rows of one instrument in the same millisecond get seq 0, 1, 2... in
+    // rowid order, as the writer would have given them; the numbering is
+    // stable, so a rerun only fills in what is missing
+    const std::string copy_sql =
+        std::string("INSERT OR IGNORE INTO market_state_v2 (") + STATE_V2_INSERT_COLUMNS + ") "
+        "SELECT i.instrument_id, m.ts_ms, m.mid, m.spread, m.r1, m.r5, m.r10,"
+        " m.imbalance, m.cross_ex_signal,"
+        " m.bid_v1, m.bid_v2, m.bid_v3, m.bid_v4, m.bid_v5,"
+        " m.ask_v1, m.ask_v2, m.ask_v3, m.ask_v4, m.ask_v5,"
+        " ROW_NUMBER() OVER (PARTITION BY i.instrument_id, m.ts_ms ORDER BY m.rowid) - 1 "
+        "FROM market_state m "
+        "JOIN instruments i ON i.exchange = m.exchange AND i.instrument = m.instrument;";
+
+    if (!state_exec_sql(db, copy_sql.c_str())) return -1;
+    return static_cast<std::int64_t>(sqlite3_changes(db));
+}
+
+bool state_rebuild_rollups(sqlite3* db) {
+    for (const auto& r : STATE_ROLLUPS) {
+        const std::string b = std::to_string(r.bucket_ms);
+        const std::string sql =
+            std::string("INSERT OR REPLACE INTO ") + r.table + " (" + STATE_BAR_COLUMNS + ") "
+            "WITH g AS ("
+            " SELECT instrument_id, (ts_ms / " + b + ") * " + b + " AS bucket_ms,"
+            "  min(ts_ms) AS f, max(ts_ms) AS l, max(mid) AS h, min(mid) AS lo,"
+            "  sum(spread) AS ss, max(spread) AS sm,"
+            "  sum(bid_v1 + bid_v2 + bid_v3 + bid_v4 + bid_v5) AS bd,"
+            "  sum(ask_v1 + ask_v2 + ask_v3 + ask_v4 + ask_v5) AS ad,"
+            "  count(*) AS n"
+            " FROM market_state_v2 GROUP BY instrument_id, bucket_ms) "
+            "SELECT g.instrument_id, g.bucket_ms, g.f, g.l, o.mid, g.h, g.lo, c.mid,"
+            " g.ss, g.sm, g.bd, g.ad, g.n "
+            "FROM g "
+            "JOIN market_state_v2 o ON o.instrument_id = g.instrument_id AND o.ts_ms = g.f AND o.seq ="
+            "  (SELECT min(seq) FROM market_state_v2 WHERE instrument_id = g.instrument_id AND ts_ms = g.f) "
+            "JOIN market_state_v2 c ON c.instrument_id = g.instrument_id AND c.ts_ms = g.l AND c.seq ="
+            "  (SELECT max(seq) FROM market_state_v2 WHERE instrument_id = g.instrument_id AND ts_ms = g.l);";
+
+        if (!state_exec_sql(db, sql.c_str())) return false;
+    }
+    return true;
+}
+
+// ------------------------------------------------------------
+// Day partitions
+// ------------------------------------------------------------
+
+// days since epoch <-> civil date (proleptic Gregorian, H. Hinnant's algorithms)
+static void civil_from_days(std::int64_t z, int& y, unsigned& m, unsigned& d) {
+    z += 719468;
+    const std::int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+    const unsigned doe = static_cast<unsigned>(z - era * 146097);
+    const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const unsigned mp = (5 * doy + 2) / 153;
+    d = doy - (153 * mp + 2) / 5 + 1;
+    m = mp < 10 ? mp + 3 : mp - 9;
+    y = static_cast<int>(yoe + era * 400 + (m <= 2));
+}
+
+static std::int64_t days_from_civil(int y, unsigned m, unsigned d) {
+    y -= m <= 2;
+    const std::int64_t era = (y >= 0 ? y : y - 399) / 400;
+    const unsigned yoe = static_cast<unsigned>(y - era * 400);
+    const unsigned doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+    const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + static_cast<std::int64_t>(doe) - 719468;
+}
+
+// "dir/market_state.db" -> {"dir/market_state", ".db"}
+static void split_db_path(const std::string& db_path, std::string& stem, std::string& ext) {
+    const auto slash = db_path.find_last_of('/');
+    const auto dot = db_path.find_last_of('.');
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+        stem = db_path;
+        ext = ".db";
+    } else {
+        stem = db_path.substr(0, dot);
+        ext = db_path.substr(dot);
+    }
+}
+
+std::string state_partition_path(const std::string& db_path, std::int64_t day) {
+    int y;
+    unsigned m, d;
+    civil_from_days(day, y, m, d);
+
+    char date[32];   // room for any int year, keeps -Wformat-truncation quiet
+    std::snprintf(date, sizeof(date), "%04d-%02u-%02u", y, m, d);
+
+    std::string stem, ext;
+    split_db_path(db_path, stem, ext);
+    return stem + "." + date + ext;
+}
+
+std::vector<StatePartition> state_list_partitions(const std::string& db_path) {
+    namespace fs = std::filesystem;
+
+    std::string stem, ext;
+    split_db_path(db_path, stem, ext);
+
+    const fs::path stem_path(stem);
+    const std::string prefix = stem_path.filename().string() + ".";
+    fs::path dir = stem_path.parent_path();
+    if (dir.empty()) dir = ".";
+
+    std::vector<StatePartition> out;
+    std::error_code ec;
+    for (fs::directory_iterator it(dir, ec), end; !ec && it != end; it.increment(ec)) {
+        const std::string name = it->path().filename().string();
+
+        // <prefix>YYYY-MM-DD<ext>, nothing else (skips -wal/-shm and .compact.tmp)
+        if (name.size() != prefix.size() + 10 + ext.size()) continue;
+        if (name.compare(0, prefix.size(), prefix) != 0) continue;
+        if (name.compare(name.size() - ext.size(), ext.size(), ext) != 0) continue;
+
+        int y;
+        unsigned m, d;
+        if (std::sscanf(name.c_str() + prefix.size(), "%4d-%2u-%2u", &y, &m, &d) != 3) continue;
+        if (m < 1 || m > 12 || d < 1 || d > 31) continue;
+
+        out.push_back({days_from_civil(y, m, d), (dir / name).string()});
+    }
+
+    std::sort(out.begin(), out.end(),
+              [](const StatePartition& a, const StatePartition& b) { return a.day < b.day; });
+    return out;
+}
+
+bool state_attach(sqlite3* db, const std::string& path, const char* name) {
+    const std::string sql = std::string("ATTACH DATABASE ? AS ") + name + ";";
+
+    sqlite3_stmt* st = nullptr;
+    if (sqlite3_prepare_v2(db, sql.c_str(), -1, &st, nullptr) != SQLITE_OK) {
+        std::cerr << "[StateDB] attach prepare failed: " << sqlite3_errmsg(db) << "\n";
+        return false;
+    }
+    sqlite3_bind_text(st, 1, path.c_str(), -1, SQLITE_TRANSIENT);
+
+    const bool ok = (sqlite3_step(st) == SQLITE_DONE);
+    if (!ok)
+        std::cerr << "[StateDB] attach " << path << " failed: " << sqlite3_errmsg(db) << "\n";
+    sqlite3_finalize(st);
+    return ok;
+}
+
+bool state_create_partition(sqlite3* db, const char* db_name, std::int64_t day) {
+    const std::string p = std::string(db_name) + ".";
+
+    const std::string meta_sql =
+        "CREATE TABLE IF NOT EXISTS " + p + "partition_meta ("
+        "  key TEXT PRIMARY KEY,"
+        "  value INTEGER NOT NULL"
+        ") WITHOUT ROWID;";
+
+    const std::string seed_sql =
+        "INSERT OR IGNORE INTO " + p + "partition_meta(key, value) VALUES"
+        " ('day', " + std::to_string(day) + "), ('bucket_ms', 0);";
+
+    const std::string version_sql =
+        "PRAGMA " + p + "user_version=" + std::to_string(STATE_SCHEMA_VERSION) + ";";
+
+    return state_exec_sql(db, raw_table_sql(p).c_str()) &&
+           state_exec_sql(db, meta_sql.c_str()) &&
+           state_exec_sql(db, seed_sql.c_str()) &&
+           state_exec_sql(db, version_sql.c_str());
+}
+
+std::int64_t state_partition_bucket_ms(sqlite3* db, const char* db_name) {
+    if (!state_table_exists(db, "partition_meta", db_name)) return 0;
+
+    const std::string sql =
+        std::string("SELECT value FROM ") + db_name + ".partition_meta WHERE key='bucket_ms';";
+
+    sqlite3_stmt* st = nullptr;
+    if (sqlite3_prepare_v2(db, sql.c_str(), -1, &st, nullptr) != SQLITE_OK) return 0;
+
+    std::int64_t v = 0;
+    if (sqlite3_step(st) == SQLITE_ROW) v = sqlite3_column_int64(st, 0);
+    sqlite3_finalize(st);
+    return v;
+}
+
+std::int64_t state_compact_partition(const std::string& path, std::int64_t bucket_ms) {
+    if (bucket_ms <= 0) return -1;
+
+    // CREATE is for the attached scratch file (attached dbs inherit these flags)
+    if (!std::filesystem::exists(path)) return -1;
+
+    sqlite3* db = nullptr;
+    if (sqlite3_open_v2(path.c_str(), &db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE,
+                        nullptr) != SQLITE_OK) {
+        std::cerr << "[StateDB] compact: cannot open " << path << ": "
+                  << (db ? sqlite3_errmsg(db) : "null-db") << "\n";
+        if (db) sqlite3_close(db);
+        return -1;
+    }
+    state_exec_sql(db, "PRAGMA busy_timeout=5000;");
+
+    auto fail = [&]() -> std::int64_t {
+        sqlite3_close(db);
+        std::remove((path + ".compact.tmp").c_str());
+        return -1;
+    };
+
+    if (state_partition_bucket_ms(db, "main") >= bucket_ms) {
+        sqlite3_close(db);
+        return 0;
+    }
+
+    std::int64_t day = 0;
+    {
+        sqlite3_stmt* st = nullptr;
+        if (sqlite3_prepare_v2(db, "SELECT value FROM partition_meta WHERE key='day';",
+                               -1, &st, nullptr) == SQLITE_OK &&
+            sqlite3_step(st) == SQLITE_ROW)
+            day = sqlite3_column_int64(st, 0);
+        sqlite3_finalize(st);
+    }
+
+    const std::string tmp = path + ".compact.tmp";
+    std::remove(tmp.c_str());
+
+    // Scratch file: no journal, one transaction, synced on COMMIT
+    if (!state_attach(db, tmp, "c")) return fail();
+    if (!state_exec_sql(db, "PRAGMA c.journal_mode=OFF;")) return fail();
+    if (!state_create_partition(db, "c", day)) return fail();
+
+    // Bare columns next to max(): SQLite takes them from the max(ts_ms) row,
+    // so every kept row is a real sample (the last one of its bucket).
+    const std::string b = std::to_string(bucket_ms);
+    const std::string copy_sql =
+        std::string("INSERT INTO c.market_state_v2 (") + STATE_V2_COLUMNS + ") "
+        "SELECT instrument_id, max(ts_ms), mid, spread, r1, r5, r10, imbalance, cross_ex_signal,"
+        " bid_v1, bid_v2, bid_v3, bid_v4, bid_v5,"
+        " ask_v1, ask_v2, ask_v3, ask_v4, ask_v5"
+        " FROM main.market_state_v2 GROUP BY instrument_id, ts_ms / " + b + ";";
+
+    if (!state_exec_sql(db, "BEGIN;")) return fail();
+    if (!state_exec_sql(db, copy_sql.c_str())) {
+        state_exec_sql(db, "ROLLBACK;");
+        return fail();
+    }
+    const std::int64_t kept = sqlite3_changes(db);
+
+    const std::string meta_sql =
+        "UPDATE c.partition_meta SET value=" + b + " WHERE key='bucket_ms';";
+    if (!state_exec_sql(db, meta_sql.c_str()) || !state_exec_sql(db, "COMMIT;")) {
+        state_exec_sql(db, "ROLLBACK;");
+        return fail();
+    }
+
+    if (!state_exec_sql(db, "DETACH DATABASE c;")) return fail();
+    sqlite3_close(db);   // last connection: checkpoints and removes the raw file's WAL
+
+    if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+        std::cerr << "[StateDB] compact: rename " << tmp << " failed\n";
+        std::remove(tmp.c_str());
+        return -1;
+    }
+    return kept;
+}
@@ -0,0 +1,96 @@
+#pragma once
+#include <sqlite3.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// ------------------------------------------------------------
+// market_state.db schema (shared by the writer, readers and tools)
+//
+// v1: market_state(ts_ms, exchange TEXT, instrument TEXT, ...) + 2 indexes
+// v2: instruments dictionary + market_state_v2 keyed by integer
+//     instrument_id, clustered on (instrument_id, ts_ms, seq), WITHOUT ROWID
+//     (seq tells apart samples of one instrument in the same millisecond)
+//     + market_bars_1s / market_bars_1m rollups kept by the writer
+//
+// Day partitions (optional): raw market_state_v2 rows go to one file per
+// UTC day next to the main file, e.g. market_state.2026-10-18.db. The main
+// file keeps the instruments dictionary, the rollups and any unpartitioned
+// rows. A partition file has market_state_v2 + partition_meta(key, value).
+// ------------------------------------------------------------
+
+constexpr int STATE_SCHEMA_VERSION = 2;
+
+// Columns per market_state_v2 row (instrument_id, ts_ms, 7 scalars, 10 depth)
+constexpr int STATE_V2_COLS = 19;
+
+// Column list in read order (seq is left out: it only orders same-ms rows)
+extern const char* const STATE_V2_COLUMNS;
+
+// STATE_V2_COLUMNS + seq, in bind order (matches StateDB::bind_row)
+constexpr int STATE_V2_INSERT_COLS = STATE_V2_COLS + 1;
+extern const char* const STATE_V2_INSERT_COLUMNS;
+
+// Time-bucket rollups. Bars store sums + n so partial bars from successive
+// batches merge with an UPSERT; the *_v views expose the averages.
+struct StateRollup {
+    const char* table;
+    std::int64_t bucket_ms;
+};
+
+constexpr int STATE_ROLLUP_COUNT = 2;
+extern const StateRollup STATE_ROLLUPS[STATE_ROLLUP_COUNT];   // 1s, 1m
+
+// Column list of a rollup table in bind order
+extern const char* const STATE_BAR_COLUMNS;
+
+bool state_exec_sql(sqlite3* db, const char* sql);
+
+// Pragmas used by every writer connection (WAL + speed sane defaults)
+bool state_apply_writer_pragmas(sqlite3* db);
+
+// CREATE IF NOT EXISTS for the v2 tables in schema `db_name` ("main", attached name...)
+bool state_create_v2(sqlite3* db, const char* db_name = "main");
+
+bool state_table_exists(sqlite3* db, const char* table, const char* db_name = "main");
+
+// Recompute every rollup bar from market_state_v2 (used after bulk loads)
+bool state_rebuild_rollups(sqlite3* db);
+
+// Copy every row of the v1 `market_state` table into v2 (idempotent).
+// Returns number of rows copied, or -1 on error.
+std::int64_t state_migrate_v1_to_v2(sqlite3* db);
+
+// ------------------------------------------------------------
+// Day partitions
+// ------------------------------------------------------------
+
+constexpr std::int64_t STATE_DAY_MS = 86400000;
+
+struct StatePartition {
+    std::int64_t day;       // days since 1970-01-01 (UTC)
+    std::string path;
+};
+
+// market_state.db + day -> market_state.YYYY-MM-DD.db (same directory)
+std::string state_partition_path(const std::string& db_path, std::int64_t day);
+
+// Partition files that exist next to `db_path`, sorted by day
+std::vector<StatePartition> state_list_partitions(const std::string& db_path);
+
+// ATTACH `path` AS `name` (path bound as a parameter, no quoting issues)
+bool state_attach(sqlite3* db, const std::string& path, const char* name);
+
+// market_state_v2 + partition_meta in schema `db_name`; records `day` once
+bool state_create_partition(sqlite3* db, const char* db_name, std::int64_t day);
+
+// partition_meta.bucket_ms: 0 = raw rows, >0 = downsampled to that bucket
+std::int64_t state_partition_bucket_ms(sqlite3* db, const char* db_name);
+
+// Rewrite a raw partition file keeping the last row of every
+// (instrument_id, bucket_ms) bucket. Builds <path>.compact.tmp with its own
+// connection and renames it over `path`; nothing else needs to be stopped
+// as long as the writer is not attached to this day.
+// Returns rows kept, 0 if already compacted at >= bucket_ms, -1 on error.
+std::int64_t state_compact_partition(const std::string& path, std::int64_t bucket_ms);
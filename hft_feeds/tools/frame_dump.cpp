@@ -0,0 +1,61 @@
+// frame_dump: inspect a raw frame log written by FrameRecorder.
+//
+// Usage: frame_dump <file.frames> [--print] [--limit N]
+//
+// Prints the header and a summary (frames, bytes, time span, largest frame).
+// --print also writes every frame as "<recv_ns> <payload>" to stdout.
+
+#include "FrameLog.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <string>
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "Usage: frame_dump <file.frames> [--print] [--limit N]\n";
+        return 1;
+    }
+
+    bool print = false;
+    std::uint64_t limit = 0;
+    for (int i = 2; i < argc; ++i) {
+        std::string a = argv[i];
+        if (a == "--print") print = true;
+        else if (a == "--limit" && i + 1 < argc) limit = std::stoull(argv[++i]);
+    }
+
+    FrameReader r(argv[1]);
+    if (!r.open()) return 1;
+
+    std::cout << "exchange=" << r.exchange()
+              << " instrument=" << r.instrument()
+              << " start_ns=" << r.header().start_ns << "\n";
+
+    std::uint64_t frames = 0, bytes = 0, first_ns = 0, last_ns = 0;
+    std::size_t max_len = 0;
+
+    FrameView f;
+    while (r.next(f)) {
+        if (frames == 0) first_ns = f.recv_ns;
+        last_ns = f.recv_ns;
+        ++frames;
+        bytes += f.data.size();
+        if (f.data.size() > max_len) max_len = f.data.size();
+
+        if (print) {
+            std::printf("%llu %.*s\n", static_cast<unsigned long long>(f.recv_ns),
+                        static_cast<int>(f.data.size()), f.data.data());
+        }
+        if (limit && frames >= limit) break;
+    }
+
+    const double secs = frames > 1 ? (last_ns - first_ns) / 1e9 : 0.0;
+    std::cout << "frames=" << frames
+              << " payload_bytes=" << bytes
+              << " max_frame=" << max_len
+              << " span_s=" << secs
+              << " avg_rate=" << (secs > 0 ? frames / secs : 0.0) << "/s\n";
+    return 0;
+}
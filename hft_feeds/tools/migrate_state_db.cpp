@@ -0,0 +1,124 @@
+// migrate_state_db: convert a v1 market_state.db (TEXT keys, rowid table,
+// two secondary indexes) into the v2 layout used by StateDB.
+//
+// Usage: migrate_state_db [db_path] [--drop-v1] [--vacuum]
+//
+// The copy is idempotent (INSERT OR IGNORE on the v2 primary key, with
+// same-millisecond rows numbered by seq in v1 rowid order), so it can be
+// re-run if it was interrupted.
+
+#include "StateSchema.hpp"
+#include <sqlite3.h>
+
+#include <chrono>
+#include <iostream>
+#include <string>
+
+static std::int64_t count_rows(sqlite3* db, const char* table) {
+    const std::string sql = std::string("SELECT COUNT(*) FROM ") + table + ";";
+    sqlite3_stmt* st = nullptr;
+    std::int64_t n = -1;
+    if (sqlite3_prepare_v2(db, sql.c_str(), -1, &st, nullptr) == SQLITE_OK &&
+        sqlite3_step(st) == SQLITE_ROW) {
+        n = sqlite3_column_int64(st, 0);
+    }
+    sqlite3_finalize(st);
+    return n;
+}
+
+int main(int argc, char** argv) {
+    std::string db_path = "market_state.db";
+    bool drop_v1 = false;
+    bool vacuum  = false;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        if (a == "--drop-v1")     drop_v1 = true;
+        else if (a == "--vacuum") vacuum = true;
+        else if (a == "-h" || a == "--help") {
+            std::cout << "Usage: migrate_state_db [db_path] [--drop-v1] [--vacuum]\n";
+            return 0;
+        }
+        else db_path = a;
+    }
+
+    sqlite3* db = nullptr;
+    if (sqlite3_open(db_path.c_str(), &db) != SQLITE_OK) {
+        std::cerr << "[migrate] cannot open " << db_path << ": "
+                  << (db ? sqlite3_errmsg(db) : "null-db") << "\n";
+        sqlite3_close(db);
+        return 1;
+    }
+
+    if (!state_apply_writer_pragmas(db)) {
+        sqlite3_close(db);
+        return 1;
+    }
+
+    if (!state_table_exists(db, "market_state")) {
+        std::cout << "[migrate] no v1 market_state table in " << db_path << ", nothing to do\n";
+        state_create_v2(db);
+        sqlite3_close(db);
+        return 0;
+    }
+
+    const auto t0 = std::chrono::steady_clock::now();
+    const std::int64_t v1_rows = count_rows(db, "market_state");
+    std::cout << "[migrate] " << db_path << ": v1 rows=" << v1_rows << "\n";
+
+    if (!state_exec_sql(db, "BEGIN IMMEDIATE TRANSACTION;")) {
+        sqlite3_close(db);
+        return 1;
+    }
+
+    const std::int64_t copied = state_migrate_v1_to_v2(db);
+    if (copied < 0) {
+        state_exec_sql(db, "ROLLBACK;");
+        sqlite3_close(db);
+        return 1;
+    }
+
+    // Backfill 1s/1m bars for the migrated history
+    if (!state_rebuild_rollups(db)) {
+        state_exec_sql(db, "ROLLBACK;");
+        sqlite3_close(db);
+        return 1;
+    }
+
+    if (drop_v1) {
+        if (!state_exec_sql(db, "DROP INDEX IF EXISTS idx_market_state_ts;") ||
+            !state_exec_sql(db, "DROP INDEX IF EXISTS idx_market_state_key;") ||
+            !state_exec_sql(db, "DROP TABLE market_state;")) {
+            state_exec_sql(db, "ROLLBACK;");
+            sqlite3_close(db);
+            return 1;
+        }
+    }
+
+    if (!state_exec_sql(db, "COMMIT;")) {
+        state_exec_sql(db, "ROLLBACK;");
+        sqlite3_close(db);
+        return 1;
+    }
+
+    // VACUUM cannot run inside a transaction; it is what actually shrinks the file
+    if (vacuum) {
+        state_exec_sql(db, "PRAGMA wal_checkpoint(TRUNCATE);");
+        if (!state_exec_sql(db, "VACUUM;")) {
+            sqlite3_close(db);
+            return 1;
+        }
+    }
+
+    const auto secs = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - t0).count();
+
+    std::cout << "[migrate] copied=" << copied
+              << " instruments=" << count_rows(db, "instruments")
+              << " v2 rows=" << count_rows(db, "market_state_v2")
+              << (drop_v1 ? " (v1 dropped)" : "")
+              << " in " << secs << "s\n";
+
+    sqlite3_close(db);
+    return 0;
+}
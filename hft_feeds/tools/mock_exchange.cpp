@@ -0,0 +1,522 @@
+// mock_exchange: local Bybit v5 / Binance spot websocket load generator.
+//
+// Usage: mock_exchange [--port 9001] [--rate N] [--mid 3000] [--tick 0.01]
+//                      [--ticker-every 10] [--depth-every 5] [--gap-every N]
+//                      [--disconnect-after N] [--burst-every-ms T --burst N]
+//                      [--seed S] [--stats-sec 1]
+//
+// Plain ws:// on any path. The first message picks the protocol:
+//   {"op":"subscribe","args":[...]}        -> Bybit orderbook snapshot/delta + tickers
+//   {"method":"SUBSCRIBE","params":[...]}  -> Binance depth snapshots, bookTicker, 24hrTicker
+// Every connection streams its own random-walk book for the subscribed symbol.
+// Exchange timestamps (Bybit "ts", Binance "E") are the send time, so the
+// exch_ts_ms field hft_feeds publishes gives end-to-end latency.
+//
+//   --rate              messages/s per connection, 0 = as fast as the socket takes
+//   --gap-every         Bybit: skip one update id every N deltas (feed must resync)
+//   --disconnect-after  close after N messages (feed must reconnect)
+//   --burst-every-ms/--burst  every T ms, send N extra messages back to back
+//
+// Point hft_feeds at it with config.json:
+//   "endpoints": { "bybit":   "ws://127.0.0.1:9001/v5/public/spot",
+//                  "binance": "ws://127.0.0.1:9001/ws" }
+
+#include <boost/beast/core.hpp>
+#include <boost/beast/websocket.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/write.hpp>
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace beast     = boost::beast;
+namespace websocket = beast::websocket;
+namespace net       = boost::asio;
+using tcp           = net::ip::tcp;
+using json          = nlohmann::json;
+
+struct MockOptions {
+    unsigned short port = 9001;
+    double rate = 1000.0;
+    double mid = 3000.0;
+    double tick = 0.01;
+    int ticker_every = 10;
+    int depth_every = 5;                 // Binance: every Nth message is a depth snapshot
+    std::uint64_t gap_every = 0;
+    std::uint64_t disconnect_after = 0;
+    int burst_every_ms = 0;
+    int burst = 0;
+    std::uint64_t seed = 1;
+    int stats_sec = 1;
+};
+
+static std::atomic<std::uint64_t> g_sent{0};
+static std::atomic<std::uint64_t> g_bytes{0};
+static std::atomic<int> g_open{0};
+
+static long long wall_ms() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+static void appendf(std::string& out, const char* fmt, ...) {
+    char tmp[256];
+    va_list ap;
+    va_start(ap, fmt);
+    const int n = std::vsnprintf(tmp, sizeof(tmp), fmt, ap);
+    va_end(ap);
+    if (n > 0) out.append(tmp, std::min<std::size_t>(static_cast<std::size_t>(n), sizeof(tmp) - 1));
+}
+
+// Server -> client frames are unmasked, so a batch of text frames can be
+// framed here and sent with one write() instead of one syscall per message
+static void append_ws_frame(std::string& out, const std::string& payload) {
+    const std::uint64_t n = payload.size();
+    out.push_back(static_cast<char>(0x81));   // FIN + text
+    if (n < 126) {
+        out.push_back(static_cast<char>(n));
+    } else if (n < 65536) {
+        out.push_back(static_cast<char>(126));
+        out.push_back(static_cast<char>((n >> 8) & 0xff));
+        out.push_back(static_cast<char>(n & 0xff));
+    } else {
+        out.push_back(static_cast<char>(127));
+        for (int s = 56; s >= 0; s -= 8) out.push_back(static_cast<char>((n >> s) & 0xff));
+    }
+    out += payload;
+}
+
+// ------------------------------------------------------------
+// Random-walk book on a tick grid: `levels` bids below best_bid_,
+// `levels` asks above it, quantities index 0 = top of book
+// ------------------------------------------------------------
+class SyntheticBook {
+public:
+    using Levels = std::vector<std::pair<long long, double>>;   // (price ticks, qty), qty 0 = remove
+
+    SyntheticBook(double mid, double tick, int levels, std::uint64_t seed)
+        : rng_(seed), tick_(tick), levels_(std::max(1, levels))
+    {
+        best_bid_ = static_cast<long long>(std::floor(mid / tick_));
+        for (int i = 0; i < levels_; ++i) {
+            bq_.push_back(qty());
+            aq_.push_back(qty());
+        }
+        decimals_ = std::max(0, static_cast<int>(std::ceil(-std::log10(tick_) - 1e-9)));
+    }
+
+    // One market event: a one-tick move (5%) or 1-3 size changes near the top
+    void step(Levels& bids, Levels& asks) {
+        bids.clear();
+        asks.clear();
+
+        const double r = uni_(rng_);
+        if (r < 0.025) {
+            // up: best ask becomes best bid
+            const long long old_bid = best_bid_;
+            ++best_bid_;
+            aq_.pop_front();
+            asks.emplace_back(best_bid_, 0.0);
+            aq_.push_back(qty());
+            asks.emplace_back(best_bid_ + levels_, aq_.back());
+
+            bq_.push_front(qty());
+            bids.emplace_back(best_bid_, bq_.front());
+            bq_.pop_back();
+            bids.emplace_back(old_bid - levels_ + 1, 0.0);
+        } else if (r < 0.05) {
+            // down: best bid becomes best ask
+            const long long old_bid = best_bid_;
+            --best_bid_;
+            bq_.pop_front();
+            bids.emplace_back(old_bid, 0.0);
+            bq_.push_back(qty());
+            bids.emplace_back(best_bid_ - levels_ + 1, bq_.back());
+
+            aq_.push_front(qty());
+            asks.emplace_back(old_bid, aq_.front());
+            aq_.pop_back();
+            asks.emplace_back(old_bid + levels_, 0.0);
+        } else {
+            const int changes = 1 + static_cast<int>(rng_() % 3);
+            for (int c = 0; c < changes; ++c) {
+                // Geometric level choice: most activity at the top
+                int lvl = 0;
+                while (lvl + 1 < levels_ && uni_(rng_) < 0.5) ++lvl;
+                const double q = qty();
+                if (rng_() & 1) {
+                    bq_[lvl] = q;
+                    bids.emplace_back(best_bid_ - lvl, q);
+                } else {
+                    aq_[lvl] = q;
+                    asks.emplace_back(best_bid_ + 1 + lvl, q);
+                }
+            }
+        }
+    }
+
+    void snapshot(Levels& bids, Levels& asks, int depth) const {
+        bids.clear();
+        asks.clear();
+        const int n = std::min(depth, levels_);
+        for (int i = 0; i < n; ++i) {
+            bids.emplace_back(best_bid_ - i, bq_[i]);
+            asks.emplace_back(best_bid_ + 1 + i, aq_[i]);
+        }
+    }
+
+    long long best_bid() const { return best_bid_; }
+    long long best_ask() const { return best_bid_ + 1; }
+    double bid_qty() const { return bq_.front(); }
+    double ask_qty() const { return aq_.front(); }
+
+    void append_px(std::string& out, long long ticks) const {
+        appendf(out, "%.*f", decimals_, ticks * tick_);
+    }
+
+    std::mt19937_64& rng() { return rng_; }
+
+private:
+    double qty() { return std::round((0.001 + 5.0 * uni_(rng_) * uni_(rng_)) * 1000.0) / 1000.0; }
+
+    std::mt19937_64 rng_;
+    std::uniform_real_distribution<double> uni_{0.0, 1.0};
+    double tick_;
+    int levels_;
+    int decimals_ = 2;
+    long long best_bid_ = 0;
+    std::deque<double> bq_, aq_;
+};
+
+static void append_levels(std::string& out, const SyntheticBook& book, const SyntheticBook::Levels& lv) {
+    out += '[';
+    for (std::size_t i = 0; i < lv.size(); ++i) {
+        if (i) out += ',';
+        out += "[\"";
+        book.append_px(out, lv[i].first);
+        appendf(out, "\",\"%.3f\"]", lv[i].second);
+    }
+    out += ']';
+}
+
+// ------------------------------------------------------------
+// Per-protocol message generators
+// ------------------------------------------------------------
+struct StreamState {
+    bool bybit = true;
+    std::string symbol;          // "ETHUSDT"
+    int depth = 50;
+    std::uint64_t msgs = 0;
+    std::uint64_t update_id = 0;
+    std::uint64_t deltas = 0;
+    std::uint64_t gaps = 0;
+    SyntheticBook::Levels bids, asks;
+};
+
+static void bybit_book_msg(std::string& msg, SyntheticBook& book, StreamState& st,
+                           const MockOptions& o, bool snapshot)
+{
+    if (snapshot) {
+        book.snapshot(st.bids, st.asks, st.depth);
+        st.update_id = 1;
+    } else {
+        book.step(st.bids, st.asks);
+        ++st.update_id;
+        if (o.gap_every && ++st.deltas % o.gap_every == 0) {
+            ++st.update_id;      // the feed sees u jump by 2
+            ++st.gaps;
+        }
+    }
+
+    const long long ts = wall_ms();
+    appendf(msg, "{\"topic\":\"orderbook.%d.%s\",\"type\":\"%s\",\"ts\":%lld,\"data\":{\"s\":\"%s\",\"b\":",
+            st.depth, st.symbol.c_str(), snapshot ? "snapshot" : "delta", ts, st.symbol.c_str());
+    append_levels(msg, book, st.bids);
+    msg += ",\"a\":";
+    append_levels(msg, book, st.asks);
+    appendf(msg, ",\"u\":%llu,\"seq\":%llu},\"cts\":%lld}",
+            static_cast<unsigned long long>(st.update_id),
+            static_cast<unsigned long long>(st.msgs + 1), ts);
+}
+
+static void bybit_ticker_msg(std::string& msg, SyntheticBook& book, StreamState& st) {
+    const long long last = (book.rng()() & 1) ? book.best_bid() : book.best_ask();
+    appendf(msg, "{\"topic\":\"tickers.%s\",\"ts\":%lld,\"type\":\"snapshot\",\"cs\":%llu,\"data\":{\"symbol\":\"%s\",\"lastPrice\":\"",
+            st.symbol.c_str(), wall_ms(), static_cast<unsigned long long>(st.msgs + 1), st.symbol.c_str());
+    book.append_px(msg, last);
+    msg += "\",\"bid1Price\":\"";
+    book.append_px(msg, book.best_bid());
+    appendf(msg, "\",\"bid1Size\":\"%.3f\",\"ask1Price\":\"", book.bid_qty());
+    book.append_px(msg, book.best_ask());
+    appendf(msg, "\",\"ask1Size\":\"%.3f\"}}", book.ask_qty());
+}
+
+static void binance_msg(std::string& msg, SyntheticBook& book, StreamState& st, const MockOptions& o) {
+    const std::uint64_t k = st.msgs + 1;
+
+    if (o.ticker_every > 0 && k % o.ticker_every == 0) {
+        const long long last = (book.rng()() & 1) ? book.best_bid() : book.best_ask();
+        appendf(msg, "{\"e\":\"24hrTicker\",\"E\":%lld,\"s\":\"%s\",\"c\":\"", wall_ms(), st.symbol.c_str());
+        book.append_px(msg, last);
+        msg += "\",\"b\":\"";
+        book.append_px(msg, book.best_bid());
+        appendf(msg, "\",\"B\":\"%.3f\",\"a\":\"", book.bid_qty());
+        book.append_px(msg, book.best_ask());
+        appendf(msg, "\",\"A\":\"%.3f\"}", book.ask_qty());
+        return;
+    }
+
+    book.step(st.bids, st.asks);
+    ++st.update_id;
+    if (o.gap_every && ++st.deltas % o.gap_every == 0) {
+        ++st.update_id;
+        ++st.gaps;
+    }
+
+    if (o.depth_every > 0 && k % o.depth_every == 0) {
+        book.snapshot(st.bids, st.asks, st.depth);
+        appendf(msg, "{\"lastUpdateId\":%llu,\"bids\":", static_cast<unsigned long long>(st.update_id));
+        append_levels(msg, book, st.bids);
+        msg += ",\"asks\":";
+        append_levels(msg, book, st.asks);
+        msg += '}';
+        return;
+    }
+
+    appendf(msg, "{\"u\":%llu,\"s\":\"%s\",\"b\":\"", static_cast<unsigned long long>(st.update_id), st.symbol.c_str());
+    book.append_px(msg, book.best_bid());
+    appendf(msg, "\",\"B\":\"%.3f\",\"a\":\"", book.bid_qty());
+    book.append_px(msg, book.best_ask());
+    appendf(msg, "\",\"A\":\"%.3f\"}", book.ask_qty());
+}
+
+static void next_msg(std::string& msg, SyntheticBook& book, StreamState& st, const MockOptions& o) {
+    msg.clear();
+    if (!st.bybit)
+        binance_msg(msg, book, st, o);
+    else if (o.ticker_every > 0 && (st.msgs + 1) % o.ticker_every == 0)
+        bybit_ticker_msg(msg, book, st);
+    else
+        bybit_book_msg(msg, book, st, o, false);
+    ++st.msgs;
+}
+
+// ------------------------------------------------------------
+// Subscription: protocol, symbol and book depth from the first message
+// ------------------------------------------------------------
+static bool parse_subscription(const std::string& text, StreamState& st, std::string& ack) {
+    json sub = json::parse(text, nullptr, false);
+    if (sub.is_discarded() || !sub.is_object()) return false;
+
+    if (sub.value("op", std::string()) == "subscribe" && sub.contains("args") && sub["args"].is_array()) {
+        st.bybit = true;
+        for (const auto& a : sub["args"]) {
+            if (!a.is_string()) continue;
+            const std::string t = a.get<std::string>();
+            if (t.rfind("orderbook.", 0) == 0) {
+                const auto dot = t.find('.', 10);
+                if (dot == std::string::npos) continue;
+                st.depth  = std::stoi(t.substr(10, dot - 10));
+                st.symbol = t.substr(dot + 1);
+            } else if (t.rfind("tickers.", 0) == 0 && st.symbol.empty()) {
+                st.symbol = t.substr(8);
+            }
+        }
+        ack = "{\"success\":true,\"ret_msg\":\"\",\"conn_id\":\"mock\",\"op\":\"subscribe\"}";
+        return !st.symbol.empty();
+    }
+
+    if (sub.value("method", std::string()) == "SUBSCRIBE" && sub.contains("params") && sub["params"].is_array()) {
+        st.bybit = false;
+        st.depth = 20;
+        for (const auto& p : sub["params"]) {
+            if (!p.is_string()) continue;
+            const std::string t = p.get<std::string>();
+            const auto at = t.find('@');
+            if (at == std::string::npos) continue;
+            st.symbol = t.substr(0, at);
+            if (t.compare(at, 6, "@depth") == 0) {
+                const int d = std::atoi(t.c_str() + at + 6);
+                if (d > 0) st.depth = d;
+            }
+        }
+        for (auto& c : st.symbol) c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+        ack = "{\"result\":null,\"id\":" + std::to_string(sub.value("id", 1)) + "}";
+        return !st.symbol.empty();
+    }
+
+    return false;
+}
+
+// ------------------------------------------------------------
+// One client connection
+// ------------------------------------------------------------
+static void run_session(tcp::socket sock, const MockOptions& o, int conn_id) {
+    using namespace std::chrono;
+
+    StreamState st;
+    ++g_open;
+
+    try {
+        sock.set_option(tcp::no_delay(true));
+        websocket::stream<tcp::socket> ws(std::move(sock));
+        ws.accept();
+
+        beast::flat_buffer in;
+        ws.read(in);
+
+        std::string ack;
+        if (!parse_subscription(beast::buffers_to_string(in.data()), st, ack)) {
+            std::cerr << "[mock_exchange] conn " << conn_id << ": unrecognised subscription\n";
+            ws.close(websocket::close_code::policy_error);
+            --g_open;
+            return;
+        }
+        ws.text(true);
+        ws.write(net::buffer(ack));
+
+        std::cout << "[mock_exchange] conn " << conn_id << " " << (st.bybit ? "bybit" : "binance")
+                  << " " << st.symbol << " depth=" << st.depth << std::endl;
+
+        SyntheticBook book(o.mid, o.tick, st.depth, o.seed + static_cast<std::uint64_t>(conn_id));
+
+        std::string msg, out;
+        msg.reserve(64 * 1024);
+        out.reserve(1 << 20);
+
+        // Bybit opens with a full snapshot, u=1
+        if (st.bybit) {
+            bybit_book_msg(msg, book, st, o, true);
+            ++st.msgs;
+            append_ws_frame(out, msg);
+            net::write(ws.next_layer(), net::buffer(out));
+        }
+
+        const auto t0 = steady_clock::now();
+        auto next_burst = t0 + milliseconds(o.burst_every_ms);
+        std::uint64_t paced = 0;
+        const std::uint64_t max_batch = 256;
+
+        while (true) {
+            std::uint64_t n = max_batch;
+            const auto now = steady_clock::now();
+
+            if (o.rate > 0.0) {
+                const double elapsed = duration<double>(now - t0).count();
+                const auto due = static_cast<std::uint64_t>(elapsed * o.rate);
+                if (due <= paced) {
+                    const double wait_s = (paced + 1) / o.rate - elapsed;
+                    if (wait_s > 100e-6) std::this_thread::sleep_for(duration<double>(wait_s - 50e-6));
+                    else std::this_thread::yield();
+                    continue;
+                }
+                n = std::min(due - paced, max_batch);
+            }
+            paced += n;
+
+            if (o.burst_every_ms > 0 && o.burst > 0 && now >= next_burst) {
+                n += static_cast<std::uint64_t>(o.burst);
+                next_burst += milliseconds(o.burst_every_ms);
+            }
+
+            out.clear();
+            std::uint64_t batch = 0;
+            while (batch < n) {
+                next_msg(msg, book, st, o);
+                append_ws_frame(out, msg);
+                ++batch;
+                if (o.disconnect_after && st.msgs >= o.disconnect_after) break;
+            }
+            net::write(ws.next_layer(), net::buffer(out));
+            g_sent += batch;
+            g_bytes += out.size();
+
+            if (o.disconnect_after && st.msgs >= o.disconnect_after) {
+                ws.close(websocket::close_code::going_away);
+                std::cout << "[mock_exchange] conn " << conn_id << " disconnect after " << st.msgs << " msgs" << std::endl;
+                break;
+            }
+        }
+    } catch (const std::exception& ex) {
+        std::cout << "[mock_exchange] conn " << conn_id << " closed after " << st.msgs
+                  << " msgs (gaps=" << st.gaps << "): " << ex.what() << std::endl;
+    }
+    --g_open;
+}
+
+int main(int argc, char** argv) {
+    MockOptions o;
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        auto next = [&]() -> const char* { return i + 1 < argc ? argv[++i] : "0"; };
+        if      (a == "--port")             o.port = static_cast<unsigned short>(std::stoi(next()));
+        else if (a == "--rate")             o.rate = std::stod(next());
+        else if (a == "--mid")              o.mid = std::stod(next());
+        else if (a == "--tick")             o.tick = std::stod(next());
+        else if (a == "--ticker-every")     o.ticker_every = std::stoi(next());
+        else if (a == "--depth-every")      o.depth_every = std::stoi(next());
+        else if (a == "--gap-every")        o.gap_every = std::stoull(next());
+        else if (a == "--disconnect-after") o.disconnect_after = std::stoull(next());
+        else if (a == "--burst-every-ms")   o.burst_every_ms = std::stoi(next());
+        else if (a == "--burst")            o.burst = std::stoi(next());
+        else if (a == "--seed")             o.seed = std::stoull(next());
+        else if (a == "--stats-sec")        o.stats_sec = std::stoi(next());
+        else {
+            std::cerr << "Usage: mock_exchange [--port 9001] [--rate N] [--mid 3000] [--tick 0.01]\n"
+                         "                     [--ticker-every 10] [--depth-every 5] [--gap-every N]\n"
+                         "                     [--disconnect-after N] [--burst-every-ms T --burst N]\n"
+                         "                     [--seed S] [--stats-sec 1]\n";
+            return 1;
+        }
+    }
+    if (o.tick <= 0.0) o.tick = 0.01;
+
+    try {
+        net::io_context ioc;
+        tcp::acceptor acceptor(ioc, tcp::endpoint(net::ip::make_address("0.0.0.0"), o.port));
+        std::cout << "[mock_exchange] listening on ws://0.0.0.0:" << o.port
+                  << " rate=" << o.rate << "/s per connection\n";
+
+        if (o.stats_sec > 0) {
+            std::thread([&o]() {
+                std::uint64_t last_sent = 0, last_bytes = 0;
+                while (true) {
+                    std::this_thread::sleep_for(std::chrono::seconds(o.stats_sec));
+                    const std::uint64_t s = g_sent.load(), b = g_bytes.load();
+                    if (s != last_sent) {
+                        std::cout << "[mock_exchange] conns=" << g_open.load()
+                                  << " msgs/s=" << (s - last_sent) / o.stats_sec
+                                  << " MB/s=" << (b - last_bytes) / 1e6 / o.stats_sec
+                                  << " total=" << s << std::endl;
+                    }
+                    last_sent = s;
+                    last_bytes = b;
+                }
+            }).detach();
+        }
+
+        int conn_id = 0;
+        while (true) {
+            tcp::socket sock(ioc);
+            acceptor.accept(sock);
+            std::thread(run_session, std::move(sock), std::cref(o), ++conn_id).detach();
+        }
+    } catch (const std::exception& ex) {
+        std::cerr << "[mock_exchange] " << ex.what() << std::endl;
+        return 1;
+    }
+}
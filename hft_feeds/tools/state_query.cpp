@@ -0,0 +1,198 @@
+// state_query: stream rows out of market_state.db without loading them into memory.
+//
+//   state_query <db> --list
+//   state_query <db> <exchange> <instrument> <from_ms> <to_ms> [--count] [--chunk N] [--bars 1s|1m]
+//   state_query <db> --all <from_ms> <to_ms> [--threads N] [--chunk N]
+//
+// Single-key mode prints CSV to stdout (or only a row count with --count);
+// --bars reads the rollup tables instead of raw rows.
+// --all fans out across every instrument in parallel and prints a per-key summary.
+
+#include "StateReader.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+static std::uint64_t parse_ts(const std::string& s) {
+    if (s == "max") return static_cast<std::uint64_t>(std::numeric_limits<std::int64_t>::max());
+    return std::stoull(s);
+}
+
+static void usage() {
+    std::cerr << "Usage:\n"
+              << "  state_query <db> --list\n"
+              << "  state_query <db> <exchange> <instrument> <from_ms> <to_ms> [--count] [--chunk N] [--bars 1s|1m]\n"
+              << "  state_query <db> --all <from_ms> <to_ms> [--threads N] [--chunk N]\n";
+}
+
+static void print_csv_header() {
+    std::printf("ts_ms,exchange,instrument,mid,spread,r1,r5,r10,imbalance,cross_ex_signal,"
+                "bid_v1,bid_v2,bid_v3,bid_v4,bid_v5,ask_v1,ask_v2,ask_v3,ask_v4,ask_v5\n");
+}
+
+static void print_csv_row(const StateSnapshot& s) {
+    std::printf("%llu,%s,%s,%.8f,%.8f,%.10f,%.10f,%.10f,%.8f,%.8f",
+                static_cast<unsigned long long>(s.ts_ms),
+                s.exchange.c_str(), s.instrument.c_str(),
+                s.mid, s.spread, s.r1, s.r5, s.r10, s.imbalance, s.cross_ex_signal);
+    for (double v : s.bid_vol) std::printf(",%.8f", v);
+    for (double v : s.ask_vol) std::printf(",%.8f", v);
+    std::printf("\n");
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        usage();
+        return 1;
+    }
+
+    const std::string db_path = argv[1];
+    std::vector<std::string> pos;
+    bool count_only = false;
+    bool all = false;
+    bool list = false;
+    unsigned threads = 0;
+    std::size_t chunk = 4096;
+    std::int64_t bars_ms = 0;
+
+    for (int i = 2; i < argc; ++i) {
+        std::string a = argv[i];
+        if (a == "--count") count_only = true;
+        else if (a == "--all") all = true;
+        else if (a == "--list") list = true;
+        else if (a == "--threads" && i + 1 < argc) threads = static_cast<unsigned>(std::stoul(argv[++i]));
+        else if (a == "--chunk" && i + 1 < argc) chunk = std::stoul(argv[++i]);
+        else if (a == "--bars" && i + 1 < argc) {
+            std::string r = argv[++i];
+            bars_ms = (r == "1m") ? 60000 : 1000;
+        }
+        else pos.push_back(a);
+    }
+
+    StateReader reader(db_path);
+    if (!reader.open()) return 1;
+
+    if (list) {
+        for (const auto& k : reader.instruments())
+            std::cout << k.exchange << " " << k.instrument << "\n";
+        return 0;
+    }
+
+    const auto t0 = std::chrono::steady_clock::now();
+    auto elapsed = [&]() {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    };
+
+    // ---------------- parallel fan-out across instruments ----------------
+    if (all) {
+        if (pos.size() < 2) {
+            usage();
+            return 1;
+        }
+        const std::uint64_t from = parse_ts(pos[0]);
+        const std::uint64_t to   = parse_ts(pos[1]);
+
+        struct Summary {
+            std::int64_t rows = 0;
+            std::uint64_t first_ts = 0, last_ts = 0;
+            double mid_sum = 0.0;
+        };
+
+        const auto keys = reader.instruments();
+        std::vector<Summary> sums(keys.size());
+
+        auto index_of = [&](const StateKey& k) -> std::size_t {
+            // scan_parallel hands back references into `keys`
+            return static_cast<std::size_t>(&k - keys.data());
+        };
+
+        const std::int64_t total = StateReader::scan_parallel(db_path, keys, from, to,
+            [&](const StateKey& k, const StateSnapshot* rows, std::size_t n) {
+                Summary& s = sums[index_of(k)];   // one worker per key: no lock needed
+                if (s.rows == 0) s.first_ts = rows[0].ts_ms;
+                s.last_ts = rows[n - 1].ts_ms;
+                for (std::size_t i = 0; i < n; ++i) s.mid_sum += rows[i].mid;
+                s.rows += static_cast<std::int64_t>(n);
+                return true;
+            }, threads, chunk);
+
+        if (total < 0) return 1;
+
+        for (std::size_t i = 0; i < keys.size(); ++i) {
+            const auto& s = sums[i];
+            std::cout << keys[i].exchange << " " << keys[i].instrument
+                      << " rows=" << s.rows
+                      << " first_ts=" << s.first_ts
+                      << " last_ts=" << s.last_ts
+                      << " mean_mid=" << (s.rows ? s.mid_sum / s.rows : 0.0) << "\n";
+        }
+
+        const double secs = elapsed();
+        std::cerr << "[state_query] rows=" << total << " in " << secs << "s ("
+                  << (secs > 0 ? total / secs : 0.0) << " rows/s)\n";
+        return 0;
+    }
+
+    // ---------------- single key ----------------
+    if (pos.size() < 4) {
+        usage();
+        return 1;
+    }
+
+    const std::string exchange   = pos[0];
+    const std::string instrument = pos[1];
+    const std::uint64_t from     = parse_ts(pos[2]);
+    const std::uint64_t to       = parse_ts(pos[3]);
+
+    if (reader.instrument_id(exchange, instrument) < 0) {
+        std::cerr << "[state_query] unknown key " << exchange << " " << instrument << "\n";
+        return 1;
+    }
+
+    if (bars_ms > 0) {
+        if (!count_only)
+            std::printf("bucket_ms,open,high,low,close,spread_avg,spread_max,bid_depth5_avg,ask_depth5_avg,n\n");
+
+        const std::int64_t total = reader.for_each_bar(exchange, instrument, bars_ms, from, to,
+            [&](const StateBar* bars, std::size_t n) {
+                if (!count_only) {
+                    for (std::size_t i = 0; i < n; ++i) {
+                        const StateBar& b = bars[i];
+                        std::printf("%llu,%.8f,%.8f,%.8f,%.8f,%.8f,%.8f,%.8f,%.8f,%lld\n",
+                                    static_cast<unsigned long long>(b.bucket_ms),
+                                    b.open, b.high, b.low, b.close,
+                                    b.spread_avg, b.spread_max,
+                                    b.bid_depth5_avg, b.ask_depth5_avg,
+                                    static_cast<long long>(b.n));
+                    }
+                }
+                return true;
+            }, chunk);
+
+        if (count_only) std::cout << total << "\n";
+        std::cerr << "[state_query] bars=" << total << " in " << elapsed() << "s\n";
+        return total < 0 ? 1 : 0;
+    }
+
+    if (!count_only) print_csv_header();
+
+    const std::int64_t total = reader.for_each(exchange, instrument, from, to,
+        [&](const StateSnapshot* rows, std::size_t n) {
+            if (!count_only) {
+                for (std::size_t i = 0; i < n; ++i) print_csv_row(rows[i]);
+            }
+            return true;
+        }, chunk);
+
+    if (count_only) std::cout << total << "\n";
+
+    const double secs = elapsed();
+    std::cerr << "[state_query] rows=" << total << " in " << secs << "s ("
+              << (secs > 0 ? total / secs : 0.0) << " rows/s)\n";
+    return total < 0 ? 1 : 0;
+}
@@ -1,12 +1,66 @@
 #pragma once
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
 #include <string>
+#include <string_view>
+#include <vector>
+
+#include "bybit_signer.hpp"
+
+struct curl_slist;
 
 class BybitDemoClient {
 public:
-    BybitDemoClient(std::string api_key, std::string api_secret);
+    // Requests run on pooled curl handles that share one DNS and TLS session
+    // cache and each keep their own connection, so after warm_up() an order
+    // costs a network round trip instead of DNS + TCP + TLS handshakes.
+    struct HttpOptions {
+        std::string base_url = "https://api-demo.bybit.com";
+        std::string ca_file;       // extra CA bundle, e.g. the local stub's cert
+        bool http2 = false;        // negotiate HTTP/2 (ALPN); falls back to 1.1
+        int warm_handles = 2;      // handles created by warm_up()
+        int keepalive_s = 30;      // ping when idle this long, 0 = off
+        int max_connections = 8;   // async: parallel connections (HTTP/1.1); more requests queue
+
+        // BYBIT_BASE_URL, BYBIT_CA_FILE, BYBIT_HTTP2=1,
+        // BYBIT_WARM_HANDLES, BYBIT_KEEPALIVE_S, BYBIT_MAX_CONNECTIONS
+        static HttpOptions from_env();
+    };
+
+    struct HttpStats {
+        std::uint64_t requests = 0;
+        std::uint64_t new_connections = 0;   // requests that had to connect
+        std::uint64_t pings = 0;
+        std::uint64_t handles = 0;
+        std::uint64_t async_in_flight = 0;   // submitted, callback not yet returned
+    };
+
+    // X-Bapi-Limit / X-Bapi-Limit-Status / X-Bapi-Limit-Reset-Timestamp of
+    // the last response; -1 / 0 when the exchange did not send them
+    struct RateLimit {
+        int limit = -1;           // requests per window for this endpoint
+        int remaining = -1;
+        long long reset_ms = 0;   // wall clock, when the window refills
+    };
+
+    BybitDemoClient(std::string api_key, std::string api_secret);   // HttpOptions::from_env()
+    BybitDemoClient(std::string api_key, std::string api_secret, HttpOptions opt);
+    ~BybitDemoClient();
+
+    BybitDemoClient(const BybitDemoClient&) = delete;
+    BybitDemoClient& operator=(const BybitDemoClient&) = delete;
 
     bool ready() const;
 
+    // Opens a connection on each of warm_handles handles now (unsigned GET
+    // /v5/market/time) so the first orders do not pay for it; true if the
+    // exchange answered
+    bool warm_up();
+
+    HttpStats http_stats() const;
+
     // Returns response JSON string
     std::string place_market_order(
         const std::string& category,  // "spot" or "linear"
@@ -30,11 +84,63 @@ public:
     );
 	std::string get_positions(const std::string& category, const std::string& symbol);
 
+    // ---- async gateway (curl multi) ----
+    // Requests from any thread go to one gateway thread that keeps them all
+    // in flight over the multi's connections (multiplexed with HTTP/2, up to
+    // max_connections in parallel with HTTP/1.1). Callbacks run on that
+    // thread, so they should be short; futures are fulfilled the same way.
+    using Callback = std::function<void(std::string resp)>;
+
+    void post_async(const std::string& path, const std::string& body_json, Callback cb);
+
+    void place_limit_order_async(
+        const std::string& category,
+        const std::string& symbol,
+        const std::string& side,
+        double qty,
+        double price,
+        const std::string& tif,
+        Callback cb
+    );
+    void cancel_order_async(
+        const std::string& category,
+        const std::string& symbol,
+        const std::string& orderId,
+        Callback cb
+    );
+
+    std::future<std::string> place_limit_order_async(
+        const std::string& category,
+        const std::string& symbol,
+        const std::string& side,
+        double qty,
+        double price,
+        const std::string& tif = "GTC"
+    );
+    std::future<std::string> cancel_order_async(
+        const std::string& category,
+        const std::string& symbol,
+        const std::string& orderId
+    );
+
+    struct CancelRequest {
+        std::string category;
+        std::string symbol;
+        std::string orderId;
+    };
+    // All cancels in flight at once; responses in request order
+    std::vector<std::string> cancel_orders(const std::vector<CancelRequest>& reqs);
+
+    // Every open order of one symbol, including ones this process never saw acked
+    std::string cancel_all_orders(const std::string& category, const std::string& symbol);
+
 	// Returns +size for long, -size for short, 0 if flat (linear futures)
 	double get_position_size_linear(const std::string& symbol);
 
 	// Closes current position using reduce-only MARKET order
 	std::string close_position_market_reduce_only(const std::string& category, const std::string& symbol);
+	// Same with the signed position already known (no get_positions round trip)
+	std::string close_position_market_reduce_only(const std::string& category, const std::string& symbol, double pos);
 	std::string get_executions(const std::string& category,
                            const std::string& symbol,
                            long long startTimeMs);
@@ -42,7 +148,7 @@ public:
                            const std::string& symbol,
                            long long startTimeMs,
                            const std::string& cursor);
-	std::string get(const std::string& path, const std::string& query_string);
+	std::string get(const std::string& path, const std::string& query_string, RateLimit* rl = nullptr);
 	std::string get_transaction_log(const std::string& category,
                                 const std::string& symbol,
                                 long long startTimeMs,
@@ -55,11 +161,37 @@ public:
                                 long long startTimeMs,
                                 long long endTimeMs,
                                 const std::string& type = "SETTLEMENT");
+
+    // One page of a bounded window [startTimeMs, endTimeMs] (at most 7 days)
+    // at the endpoint's maximum page size, reporting the rate-limit headers
+    std::string get_executions(const std::string& category,
+                               const std::string& symbol,
+                               long long startTimeMs,
+                               long long endTimeMs,
+                               const std::string& cursor,
+                               RateLimit* rl);
+    std::string get_transaction_log(const std::string& category,
+                                     const std::string& symbol,
+                                     long long startTimeMs,
+                                     long long endTimeMs,
+                                     const std::string& cursor,
+                                     const std::string& type,
+                                     RateLimit* rl);
 private:
+    struct HttpPool;        // curl handles, share handle, keepalive thread
+    struct SignedHeaders;   // X-BAPI-* headers in fixed buffers
+
     std::string api_key_;
     std::string api_secret_;
+    BybitSigner signer_;
+    std::string key_header_;    // "X-BAPI-API-KEY: <key>"
+    std::string recv_window_;   // BYBIT_RECV_WINDOW; empty = per-method default
+    std::unique_ptr<HttpPool> http_;
 
     std::string post(const std::string& path, const std::string& body_json);
+    void sign_request(std::string_view sign_part, const char* default_recv_window, SignedHeaders& out) const;
+    int perform(const std::string& url, const std::string* body, curl_slist* headers,
+                std::string& resp, long& http_code, RateLimit* rl = nullptr);
 	//std::string get(const std::string& path, const std::string& query_string);
 
 };
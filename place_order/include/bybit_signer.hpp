@@ -0,0 +1,31 @@
+#pragma once
+#include <cstddef>
+#include <initializer_list>
+#include <memory>
+#include <string>
+#include <string_view>
+
+// HMAC-SHA256 with the key absorbed once: the constructor hashes
+// key ^ ipad and key ^ opad, every signature starts from copies of those
+// two states. Hex output goes into the caller's buffer, so signing
+// allocates nothing.
+class BybitSigner {
+public:
+    static constexpr std::size_t HEX_LEN = 64;
+
+    explicit BybitSigner(std::string_view secret);
+    ~BybitSigner();
+
+    BybitSigner(BybitSigner&&) noexcept;
+    BybitSigner& operator=(BybitSigner&&) noexcept;
+
+    // Lowercase hex HMAC of the parts as if concatenated; writes exactly
+    // HEX_LEN chars (no NUL)
+    void sign(std::initializer_list<std::string_view> parts, char* out) const;
+
+    std::string sign_hex(std::initializer_list<std::string_view> parts) const;
+
+private:
+    struct Keyed;   // SHA256_CTX pair
+    std::unique_ptr<Keyed> k_;
+};
@@ -0,0 +1,103 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include <nlohmann/json.hpp>
+
+#include "bybit_signer.hpp"
+
+// Bybit v5 websocket order entry (/v5/trade) plus the private order /
+// execution / position streams (/v5/private), both authenticated with the
+// same key as BybitDemoClient.
+//
+// One io thread owns both connections. Orders are written as soon as they
+// are queued and acknowledged by the trade socket (one round trip, no TLS
+// or HTTP per request); fills arrive on the private socket as they happen.
+// Connects never block the io thread and give up after connect_timeout_ms.
+// Dropped connections reconnect with backoff; orders in flight on a dropped
+// trade socket, or unanswered after ack_timeout_ms, complete with an error,
+// and fills missed while the private socket was down are left to the REST
+// sync (sync_exec).
+class BybitTradeWsClient {
+public:
+    struct Options {
+        std::string private_url = "wss://stream-demo.bybit.com/v5/private";
+        std::string trade_url = "wss://stream-demo.bybit.com/v5/trade";
+        std::string ca_file;        // extra trust anchor (local stub)
+        int ping_s = 20;            // Bybit drops sockets silent for ~30s
+        int recv_window_ms = 5000;
+        int start_timeout_ms = 5000;   // start() waits this long for both sockets
+        int connect_timeout_ms = 5000; // resolve + connect + TLS + ws handshake, per attempt
+        int ack_timeout_ms = 10000;    // request without a reply completes with an error
+
+        // BYBIT_WS_PRIVATE_URL, BYBIT_WS_TRADE_URL, BYBIT_CA_FILE,
+        // BYBIT_RECV_WINDOW
+        static Options from_env();
+    };
+
+    struct Stats {
+        std::uint64_t acks = 0;
+        std::uint64_t orders = 0;        // order stream records
+        std::uint64_t executions = 0;
+        std::uint64_t positions = 0;
+        std::uint64_t reconnects = 0;
+        std::uint64_t in_flight = 0;     // requests queued or sent, callback not yet returned
+    };
+
+    // Response in the REST shape ({"retCode","retMsg","result":{...}}) so
+    // callers can share their /v5/order/* handling
+    using Callback = std::function<void(std::string resp)>;
+    // One record of a private stream's "data" array
+    using Handler = std::function<void(const nlohmann::json& rec)>;
+
+    BybitTradeWsClient(std::string api_key, std::string api_secret);   // Options::from_env()
+    BybitTradeWsClient(std::string api_key, std::string api_secret, Options opt);
+    ~BybitTradeWsClient();
+
+    BybitTradeWsClient(const BybitTradeWsClient&) = delete;
+    BybitTradeWsClient& operator=(const BybitTradeWsClient&) = delete;
+
+    // Set before start(); they run on the io thread, so keep them short
+    void on_order(Handler h);
+    void on_execution(Handler h);
+    void on_position(Handler h);
+    // Private socket lost or stopped: its pushes stop until it resubscribes
+    void on_private_down(std::function<void()> h);
+
+    // Connects and authenticates both sockets; true once both are usable
+    // (the io thread keeps retrying either way). Call once.
+    bool start();
+    void stop();
+
+    // Trade socket authenticated
+    bool ready() const;
+
+    void place_limit_order(
+        const std::string& category,
+        const std::string& symbol,
+        const std::string& side,
+        double qty,
+        double price,
+        const std::string& tif,
+        Callback cb
+    );
+    void cancel_order(
+        const std::string& category,
+        const std::string& symbol,
+        const std::string& orderId,
+        Callback cb
+    );
+
+    Stats stats() const;
+
+private:
+    struct Io;   // io_context, both sessions, pending acks
+
+    std::string api_key_;
+    std::string api_secret_;
+    BybitSigner signer_;
+    Options opt_;
+    std::unique_ptr<Io> io_;
+};
@@ -0,0 +1,110 @@
+#pragma once
+#include <sqlite3.h>
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+#include <nlohmann/json_fwd.hpp>
+
+// One fill as stored; numeric fields already parsed out of Bybit's strings
+struct ExecRecord {
+    std::string category;
+    std::string symbol;
+    std::string execId;
+    std::int64_t ts_ms = 0;        // execTime
+
+    std::string orderId;
+    std::string side;              // "Buy" / "Sell"
+    double price = 0.0;
+    double qty = 0.0;
+    double fee = 0.0;
+    std::string feeCurrency;
+    std::string execType;          // "Trade", "Funding", ...
+    std::string orderType;
+    std::int64_t seq = 0;
+
+    std::int64_t rowid = 0;        // insertion order; set by cursors only
+};
+
+// Bybit execution JSON (REST list / private stream, execTime) or a legacy
+// ledger line (ts_ms). Numbers may be strings. false without execId / time.
+bool exec_record_from_json(const nlohmann::json& e, ExecRecord& out);
+
+// Execution ledger in SQLite (WAL), replacing the append-only
+// executions_ledger.jsonl:
+//   UNIQUE (exec_id)                        dedupe on insert, no id set in memory
+//   (category, symbol, ts_ms, exec_id)      per-key time ranges, already ordered
+//   (symbol, ts_ms)                         symbol-wide windows (fees)
+// so every operation costs O(log n + result) however long the history.
+// Safe to share between threads: writes and point queries go through one
+// connection (calls serialised); cursors read through a second, read-only
+// one, so a long scan never holds up an insert.
+class ExecLedger {
+public:
+    explicit ExecLedger(std::string db_path);
+    ~ExecLedger();
+
+    ExecLedger(const ExecLedger&) = delete;
+    ExecLedger& operator=(const ExecLedger&) = delete;
+
+    // Creates the schema; an empty ledger imports legacy_jsonl (if present) once
+    bool open(const std::string& legacy_jsonl = "");
+    void close();
+    bool is_open() const { return db_ != nullptr; }
+    const std::string& path() const { return db_path_; }
+
+    // false if execId is empty, already recorded, or the write failed
+    bool insert(const ExecRecord& r);
+
+    // Rows are never deleted, so the highest rowid is also the row count
+    std::int64_t size() { return last_rowid(); }
+    std::int64_t last_rowid();
+
+    // Forward-only cursor over one (category, symbol) and [from_ms, to_ms],
+    // ordered by (ts_ms, execId). Reads one WAL snapshot, taken at the first
+    // next(): rows inserted meanwhile (any thread) are not seen. Must not
+    // outlive the ledger.
+    class Cursor {
+    public:
+        Cursor() = default;
+        Cursor(Cursor&& o) noexcept;
+        Cursor& operator=(Cursor&& o) noexcept;
+        Cursor(const Cursor&) = delete;
+        Cursor& operator=(const Cursor&) = delete;
+        ~Cursor();
+
+        bool next(ExecRecord& out);
+
+    private:
+        friend class ExecLedger;
+        void stop();
+
+        sqlite3_stmt* st_ = nullptr;
+    };
+
+    // trades_only: execType == "Trade" (funding / settlement rows skipped)
+    Cursor range(const std::string& category, const std::string& symbol,
+                 std::int64_t from_ms, std::int64_t to_ms, bool trades_only = false);
+
+    // Rows of one key inserted after after_rowid (up to upto_rowid), in the
+    // same (ts_ms, execId) order as range(). Walks the rowid b-tree, so the
+    // cost follows the number of rows appended, not the key's history.
+    Cursor appended(const std::string& category, const std::string& symbol,
+                    std::int64_t after_rowid, std::int64_t upto_rowid, bool trades_only = false);
+
+    // Every row inserted after after_rowid, in insertion (rowid) order
+    Cursor after(std::int64_t after_rowid);
+
+private:
+    Cursor query(const std::string& sql, const std::string& category, const std::string& symbol,
+                 std::int64_t lo, std::int64_t hi);
+    Cursor prepare_cursor(const std::string& sql);
+    bool import_jsonl(const std::string& path);
+
+    std::string db_path_;
+    sqlite3* db_ = nullptr;
+    sqlite3* read_db_ = nullptr;   // cursors only; the library serialises calls on it
+    sqlite3_stmt* stmt_insert_ = nullptr;
+    std::recursive_mutex mtx_;
+};
@@ -0,0 +1,119 @@
+#pragma once
+#include <chrono>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "bybit_demo_client.hpp"
+
+// Token bucket in front of the REST history endpoints. Starts from the
+// configured rate; every response's X-Bapi-Limit* headers pull it down to
+// what the exchange says is left, and an exhausted window (or retCode
+// 10006) blocks everyone until the reset timestamp.
+class RateBucket {
+public:
+    RateBucket(double rate_per_s, double burst);
+
+    void acquire();   // blocks until a token is available
+    void observe(const BybitDemoClient::RateLimit& rl);
+    void block_until(long long wall_ms);
+
+private:
+    using Clock = std::chrono::steady_clock;
+    void refill(Clock::time_point now);
+
+    std::mutex mtx_;
+    const double max_rate_;
+    double rate_;
+    double burst_;
+    double tokens_;
+    Clock::time_point last_;
+    Clock::time_point blocked_until_;
+};
+
+// Paginated history (executions, funding settlements) over long windows.
+// The window is cut into time slices that worker threads page through
+// concurrently on the client's pooled connections, all drawing from one
+// RateBucket. Slices are merged back in order: a slice is handed over once
+// it and every earlier slice are complete, sorted by time and deduplicated
+// by key, so callers see one ordered stream.
+//
+// sync() additionally remembers, per (kind, category, symbol), the time
+// range already delivered in full and only fetches what lies past it (with
+// a small overlap for late records). The range is persisted after every
+// delivered slice, so an interrupted backfill resumes where it stopped.
+class HistorySync {
+public:
+    enum class Kind { EXECUTIONS, FUNDING };
+
+    struct Options {
+        int workers = 4;
+        long long slice_ms = 6LL * 3600 * 1000;     // clamped to the API's 7 day window
+        double rps = 10.0;                          // before the headers say otherwise
+        long long overlap_ms = 60 * 1000;           // re-read past the synced range
+        std::string cursor_path = "sync_cursors.json";
+
+        // BYBIT_SYNC_WORKERS, BYBIT_SYNC_SLICE_MIN, BYBIT_SYNC_RPS,
+        // BYBIT_SYNC_OVERLAP_S, BYBIT_SYNC_CURSORS
+        static Options from_env();
+    };
+
+    struct Query {
+        Kind kind = Kind::EXECUTIONS;
+        std::string category;
+        std::string symbol;
+        long long start_ms = 0;
+        long long end_ms = 0;
+    };
+
+    struct Result {
+        long long from_ms = 0;       // where fetching started (after resume)
+        long long covered_to = 0;    // end of the contiguous delivered range
+        int slices = 0;
+        int pages = 0;
+        int retries = 0;             // rate-limited / transport retries
+        long long fetched = 0;       // records received, duplicates included
+        long long delivered = 0;
+        bool complete = true;
+        std::string error;           // first failing response, if any
+    };
+
+    // Dedupe key; empty drops the record. Default: execId / transaction id.
+    using KeyFn = std::function<std::string(const nlohmann::json&)>;
+    using Sink = std::function<void(const nlohmann::json&)>;
+
+    HistorySync(BybitDemoClient& client, Options opt);
+
+    // Whole window, nothing remembered. sink runs on the calling thread.
+    Result fetch(const Query& q, const Sink& sink, const KeyFn& key = nullptr);
+
+    // Resumes past the persisted range for this key and extends it
+    Result sync(const Query& q, const Sink& sink, const KeyFn& key = nullptr);
+
+    const Options& options() const { return opt_; }
+
+private:
+    struct Range {
+        long long lo = 0;
+        long long hi = -1;   // empty while hi < lo
+    };
+
+    Result run(const Query& q, long long from_ms, const Sink& sink, const KeyFn& key,
+               const std::function<void(long long covered_to)>& progress);
+
+    static std::string cursor_key(const Query& q);
+    void load_cursors();
+    void save_cursors();
+
+    BybitDemoClient& client_;
+    Options opt_;
+    RateBucket bucket_;
+
+    std::mutex cursors_mtx_;
+    bool cursors_loaded_ = false;
+    std::map<std::string, Range> cursors_;
+};
@@ -0,0 +1,86 @@
+#pragma once
+#include <sqlite3.h>
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+
+#include "exec_ledger.hpp"
+
+enum class LotSide { LONG, SHORT };
+
+struct Lot {
+    LotSide side;
+    double qty;          // remaining qty
+    double px;           // entry price
+    std::string execId;  // opening execId
+    long long ts_ms;     // opening time
+    double fee_rem;      // remaining OPEN fee to allocate when this lot is closed
+};
+
+// One (partial) close of an open lot by a fill
+struct LotClose {
+    LotSide side_closed;
+    const Lot* open;         // lot as it was before this close
+    double qty;
+    double gross;
+    double fee_close_alloc;  // share of the closing fill's fee
+    double fee_open_alloc;   // share of the lot's remaining open fee
+    double net;
+};
+
+// FIFO lot book for one (category, symbol). Longs and shorts live in
+// separate deques, oldest at the front, so a close pops from the front
+// instead of erasing from the middle of a mixed vector.
+//
+// The checkpoint is the last fill applied, in ledger order (ts_ms, execId),
+// plus the highest ledger rowid already looked at: a sync only reads rows
+// appended after that rowid.
+struct LotBook {
+    std::deque<Lot> longs;
+    std::deque<Lot> shorts;
+
+    std::int64_t last_rowid = 0;
+    std::int64_t last_ts_ms = 0;
+    std::string  last_exec_id;
+    std::int64_t fills = 0;      // fills applied since the last rebuild
+
+    using OnClose = std::function<void(const ExecRecord& fill, const LotClose& c)>;
+
+    // Buy closes shorts first, Sell closes longs first; the rest opens a lot.
+    // Both open and close fees are allocated pro rata to each close.
+    void apply(const ExecRecord& fill, const OnClose& on_close);
+
+    // true if fill sorts after the checkpoint, i.e. can be applied in order
+    bool after_checkpoint(const ExecRecord& fill) const;
+
+    void clear();
+};
+
+// Lot books persisted next to the executions (same SQLite file, own
+// connection): open lots per key plus the checkpoint.
+class LotBookStore {
+public:
+    explicit LotBookStore(std::string db_path);
+    ~LotBookStore();
+
+    LotBookStore(const LotBookStore&) = delete;
+    LotBookStore& operator=(const LotBookStore&) = delete;
+
+    bool open();
+    void close();
+    bool is_open() const { return db_ != nullptr; }
+
+    // false if nothing stored for the key (book left empty)
+    bool load(const std::string& category, const std::string& symbol, LotBook& book);
+
+    // Replaces the key's lots and checkpoint in one transaction
+    bool save(const std::string& category, const std::string& symbol, const LotBook& book);
+
+private:
+    std::string db_path_;
+    sqlite3* db_ = nullptr;
+    std::mutex mtx_;
+};
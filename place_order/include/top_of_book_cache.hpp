@@ -0,0 +1,130 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "latency_trace.hpp"
+
+// Latest bid/ask per "exchange|instrument", seqlocked.
+//
+// The ZMQ rx thread is the only writer: it interns keys and stores quotes.
+// Order entry on any other thread copies a slot and retries if a store
+// overlapped, so a reader never takes a lock and never stalls the writer.
+// Slots and keys never move; ids are never reused.
+class TopOfBookCache {
+public:
+    static constexpr std::uint32_t NONE = 0xffffffffu;
+
+    struct Quote {
+        double bid = 0.0;
+        double ask = 0.0;
+        std::int64_t ts_ms = 0;
+        TraceContext trace;     // last traced tick of this instrument
+    };
+
+    explicit TopOfBookCache(std::uint32_t capacity)
+        : capacity_(capacity), keys_(new std::string[capacity]), slots_(new Slot[capacity]) {}
+
+    // Writer only: slot of exchange|instrument, assigned on first sight;
+    // NONE once capacity slots are taken
+    std::uint32_t intern(std::string_view exchange, std::string_view instrument) {
+        scratch_.assign(exchange).append("|").append(instrument);
+        auto it = ids_.find(scratch_);
+        if (it != ids_.end()) return it->second;
+
+        const std::uint32_t id = count_.load(std::memory_order_relaxed);
+        if (id >= capacity_) return NONE;
+
+        keys_[id] = scratch_;
+        ids_.emplace(scratch_, id);
+        count_.store(id + 1, std::memory_order_release);   // publishes keys_[id]
+        return id;
+    }
+
+    // Writer only. trace == nullptr keeps the slot's previous trace.
+    void store(std::uint32_t id, double bid, double ask, std::int64_t ts_ms, const TraceContext* trace) {
+        if (id >= capacity_) return;
+        Slot& s = slots_[id];
+        Quote q = s.q;          // the writer may read its own slot freely
+        q.bid = bid;
+        q.ask = ask;
+        q.ts_ms = ts_ms;
+        if (trace) q.trace = *trace;
+
+        const std::uint32_t seq = s.seq.load(std::memory_order_relaxed);
+        s.seq.store(seq + 1, std::memory_order_relaxed);   // odd: write in progress
+        std::atomic_thread_fence(std::memory_order_release);
+        std::memcpy(&s.q, &q, sizeof(q));
+        s.seq.store(seq + 2, std::memory_order_release);
+    }
+
+    // Any thread; false until the first store for id
+    bool load(std::uint32_t id, Quote& out) const {
+        if (id >= capacity_) return false;
+        const Slot& s = slots_[id];
+        while (true) {
+            const std::uint32_t seq1 = s.seq.load(std::memory_order_acquire);
+            if (seq1 == 0) return false;
+            if (seq1 & 1) continue;
+
+            std::memcpy(&out, &s.q, sizeof(out));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (s.seq.load(std::memory_order_relaxed) == seq1) return true;
+        }
+    }
+
+    // Any thread
+    std::uint32_t size() const { return count_.load(std::memory_order_acquire); }
+
+    // Any thread, id < size()
+    const std::string& key(std::uint32_t id) const { return keys_[id]; }
+
+    // Any thread; linear scan, for manual orders. Prefers exchange|instrument,
+    // else the first venue publishing that instrument.
+    std::uint32_t find(std::string_view exchange, std::string_view instrument) const {
+        const std::uint32_t n = size();
+        std::uint32_t any = NONE;
+        for (std::uint32_t id = 0; id < n; ++id) {
+            const std::string& k = keys_[id];
+            const auto bar = k.find('|');
+            if (std::string_view(k).substr(bar + 1) != instrument) continue;
+            if (std::string_view(k).substr(0, bar) == exchange) return id;
+            if (any == NONE) any = id;
+        }
+        return any;
+    }
+
+private:
+    struct alignas(64) Slot {
+        std::atomic<std::uint32_t> seq{0};
+        Quote q;
+    };
+
+    const std::uint32_t capacity_;
+    std::unique_ptr<std::string[]> keys_;
+    std::unique_ptr<Slot[]> slots_;
+    std::atomic<std::uint32_t> count_{0};
+
+    // Writer only
+    std::unordered_map<std::string, std::uint32_t> ids_;
+    std::string scratch_;
+};
+
+// What the rx thread needs from one market_state_v1 payload
+struct MarketStateTob {
+    std::string_view exchange;     // views into the payload
+    std::string_view instrument;
+    std::int64_t ts_ms = 0;
+    double bid = 0.0;
+    double ask = 0.0;
+    TraceContext trace;            // id == 0 when untraced
+};
+
+// Picks the fields above straight out of the compact JSON hft_feeds
+// publishes, without building a document. false if the payload does not
+// look like that (caller falls back to a full parse).
+bool scan_market_state(std::string_view payload, MarketStateTob& out);
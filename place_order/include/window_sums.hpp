@@ -0,0 +1,70 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Time-ordered prefix sums per symbol over a ledger, so a window
+// [from_ms, to_ms] is two binary searches and a subtraction instead of a
+// full ledger scan.
+//
+// Points are persisted to an append-only sidecar (one text line per point,
+// "<mark> <ts_ms> <v0> <v1> <symbol>"), where mark is the source position
+// just after the record (byte offset for a JSONL ledger, rowid for SQLite).
+// The owner catches up from mark() before querying; nothing is re-parsed.
+//
+// Not thread-safe: owned by the command loop.
+class WindowSums {
+public:
+    static constexpr int N_VALUES = 2;
+    using Values = std::array<double, N_VALUES>;
+
+    struct Window {
+        Values sum{};
+        std::int64_t count = 0;
+    };
+
+    explicit WindowSums(std::string idx_path);
+
+    // Reads the sidecar (dropping a torn last line). false if it is missing.
+    bool load();
+
+    // Forgets every point and truncates the sidecar (source was replaced)
+    void reset();
+
+    // Source position covered so far
+    std::uint64_t mark() const { return mark_; }
+
+    // Adds a point and appends it to the sidecar. Out-of-order ts_ms is
+    // fine; it only costs a shift of the later points of that symbol.
+    void add(const std::string& symbol, std::int64_t ts_ms, const Values& v, std::uint64_t mark);
+
+    // Skips source records that carry no point (not persisted: re-read
+    // after a restart, which is harmless)
+    void advance(std::uint64_t mark) { if (mark > mark_) mark_ = mark; }
+
+    void flush();
+
+    // Inclusive on both ends
+    Window query(const std::string& symbol, std::int64_t from_ms, std::int64_t to_ms) const;
+    Window total(const std::string& symbol) const;
+
+    std::int64_t points() const { return n_points_; }
+    const std::string& path() const { return idx_path_; }
+
+private:
+    struct Point {
+        std::int64_t ts_ms;
+        Values cum;          // inclusive prefix sum up to this point
+    };
+
+    void insert_point(const std::string& symbol, std::int64_t ts_ms, const Values& v);
+
+    std::string idx_path_;
+    std::ofstream out_;
+    std::unordered_map<std::string, std::vector<Point>> by_symbol_;
+    std::uint64_t mark_ = 0;
+    std::int64_t n_points_ = 0;
+};
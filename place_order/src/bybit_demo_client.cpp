@@ -1,16 +1,24 @@
 #include "bybit_demo_client.hpp"
+#include "latency_trace.hpp"
 
 #include <nlohmann/json.hpp>
-#include <openssl/hmac.h>
 #include <curl/curl.h>
 
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <charconv>
 #include <chrono>
-#include <sstream>
-#include <iomanip>
+#include <condition_variable>
+#include <cstring>
 #include <cstdlib>
 #include <cmath>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
 
-std::string BybitDemoClient::place_limit_order(
+static std::string limit_order_body(
     const std::string& category,
     const std::string& symbol,
     const std::string& side,
@@ -27,29 +35,36 @@ std::string BybitDemoClient::place_limit_order(
     j["price"] = std::to_string(price);
     j["timeInForce"] = tif;          // "GTC" good default
 
-    return post("/v5/order/create", j.dump());
+    return j.dump();
 }
 
-static long long now_ms() {
-    using namespace std::chrono;
-    return duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
+static std::string cancel_order_body(
+    const std::string& category,
+    const std::string& symbol,
+    const std::string& orderId
+) {
+    nlohmann::json j;
+    j["category"] = category;
+    j["symbol"]   = symbol;
+    j["orderId"]  = orderId;
+
+    return j.dump();
 }
 
-static std::string hex_encode(const unsigned char* data, size_t len) {
-    std::ostringstream oss;
-    for (size_t i = 0; i < len; i++)
-        oss << std::hex << std::setw(2) << std::setfill('0') << (int)data[i];
-    return oss.str();
+std::string BybitDemoClient::place_limit_order(
+    const std::string& category,
+    const std::string& symbol,
+    const std::string& side,
+    double qty,
+    double price,
+    const std::string& tif
+) {
+    return post("/v5/order/create", limit_order_body(category, symbol, side, qty, price, tif));
 }
 
-static std::string hmac_sha256_hex(const std::string& key, const std::string& msg) {
-    unsigned int outlen = 0;
-    unsigned char out[EVP_MAX_MD_SIZE];
-    HMAC(EVP_sha256(),
-         key.data(), (int)key.size(),
-         (const unsigned char*)msg.data(), (int)msg.size(),
-         out, &outlen);
-    return hex_encode(out, outlen);
+static long long now_ms() {
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
 }
 
 static size_t write_cb(char* ptr, size_t size, size_t nmemb, void* userdata) {
@@ -58,8 +73,451 @@ static size_t write_cb(char* ptr, size_t size, size_t nmemb, void* userdata) {
     return size * nmemb;
 }
 
+// Picks the X-Bapi-Limit* response headers into a RateLimit
+static size_t rate_limit_header_cb(char* ptr, size_t size, size_t nmemb, void* userdata) {
+    auto* rl = static_cast<BybitDemoClient::RateLimit*>(userdata);
+    const std::size_t n = size * nmemb;
+    const std::string_view line(ptr, n);
+
+    const auto colon = line.find(':');
+    if (colon == std::string_view::npos) return n;
+    const std::string_view name = line.substr(0, colon);
+
+    auto iequals = [](std::string_view a, std::string_view b) {
+        if (a.size() != b.size()) return false;
+        for (std::size_t i = 0; i < a.size(); ++i)
+            if (std::tolower(static_cast<unsigned char>(a[i])) != std::tolower(static_cast<unsigned char>(b[i])))
+                return false;
+        return true;
+    };
+    auto value = [&](long long& out) {
+        std::size_t i = colon + 1;
+        while (i < n && line[i] == ' ') ++i;
+        std::from_chars(line.data() + i, line.data() + n, out);
+    };
+
+    long long v = 0;
+    if (iequals(name, "X-Bapi-Limit"))                        { value(v); rl->limit = static_cast<int>(v); }
+    else if (iequals(name, "X-Bapi-Limit-Status"))            { value(v); rl->remaining = static_cast<int>(v); }
+    else if (iequals(name, "X-Bapi-Limit-Reset-Timestamp"))   { value(v); rl->reset_ms = v; }
+    return n;
+}
+
+// ------------------------------------------------------------
+// Request signing
+// ------------------------------------------------------------
+
+// X-BAPI-* headers of one request, linked into a curl_slist by hand: curl
+// only reads the list, so nothing is allocated per request. The nodes point
+// into the object, hence no copies.
+struct BybitDemoClient::SignedHeaders {
+    static constexpr std::size_t VALUE_MAX = 24;   // ms timestamp / recv window digits
+
+    char sign[sizeof("X-BAPI-SIGN: ") + BybitSigner::HEX_LEN];
+    char ts[sizeof("X-BAPI-TIMESTAMP: ") + VALUE_MAX];
+    char recv[sizeof("X-BAPI-RECV-WINDOW: ") + VALUE_MAX];
+    curl_slist nodes[5];
+
+    SignedHeaders() = default;
+    SignedHeaders(const SignedHeaders&) = delete;
+    SignedHeaders& operator=(const SignedHeaders&) = delete;
+
+    curl_slist* list() { return nodes; }
+};
+
+// prefix + value + NUL into a buffer sized for both
+template <std::size_t N, std::size_t M>
+static void put_header(char (&out)[N], const char (&prefix)[M], std::string_view value) {
+    static_assert(N >= M);
+    std::memcpy(out, prefix, M - 1);
+    const std::size_t n = std::min(value.size(), N - M);
+    std::memcpy(out + M - 1, value.data(), n);
+    out[M - 1 + n] = '\0';
+}
+
+// ------------------------------------------------------------
+// HTTP connection pool
+// ------------------------------------------------------------
+BybitDemoClient::HttpOptions BybitDemoClient::HttpOptions::from_env() {
+    HttpOptions o;
+    if (const char* v = std::getenv("BYBIT_BASE_URL"); v && *v) o.base_url = v;
+    if (const char* v = std::getenv("BYBIT_CA_FILE"); v && *v) o.ca_file = v;
+    if (const char* v = std::getenv("BYBIT_HTTP2")) o.http2 = std::string(v) == "1";
+    if (const char* v = std::getenv("BYBIT_WARM_HANDLES")) o.warm_handles = std::atoi(v);
+    if (const char* v = std::getenv("BYBIT_KEEPALIVE_S")) o.keepalive_s = std::atoi(v);
+    if (const char* v = std::getenv("BYBIT_MAX_CONNECTIONS")) o.max_connections = std::max(1, std::atoi(v));
+    return o;
+}
+
+static std::string curl_error_json(int rc) {
+    return std::string("{\"error\":\"curl perform failed\",\"msg\":\"") +
+           curl_easy_strerror(static_cast<CURLcode>(rc)) + "\"}";
+}
+
+// Idle easy handles plus a share handle for DNS / TLS sessions. Connections
+// are not shared: libcurl does not support one connection cache used from
+// several threads at once, so each sync handle keeps its own (a reused
+// handle reuses its connection) and the async gateway's handles use the
+// multi's. A ping thread keeps the most recently released handle's
+// connection from idling out (servers and curl's own CURLOPT_MAXAGE_CONN
+// drop idle ones). Concurrent requests each get their own handle, hence
+// their own connection, on the sync path. The async gateway drives its
+// handles from one curl multi: with HTTP/2 requests are multiplexed over
+// the multi's connections (PIPEWAIT), up to max_connections per host, and
+// complete through callbacks.
+struct BybitDemoClient::HttpPool {
+    explicit HttpPool(HttpOptions o) : opt(std::move(o)) {
+        static std::once_flag global_init;
+        std::call_once(global_init, [] { curl_global_init(CURL_GLOBAL_DEFAULT); });
+
+        share = curl_share_init();
+        curl_share_setopt(share, CURLSHOPT_LOCKFUNC, &HttpPool::lock_cb);
+        curl_share_setopt(share, CURLSHOPT_UNLOCKFUNC, &HttpPool::unlock_cb);
+        curl_share_setopt(share, CURLSHOPT_USERDATA, this);
+        curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+        curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+
+        last_use_ns = trace_now_ns();
+        if (opt.keepalive_s > 0) pinger = std::thread([this] { ping_loop(); });
+    }
+
+    ~HttpPool() {
+        {
+            std::lock_guard<std::mutex> lk(mtx);
+            stop = true;
+        }
+        cv.notify_all();
+        if (pinger.joinable()) pinger.join();
+
+        if (multi) {
+            {
+                std::lock_guard<std::mutex> lk(async_mtx);
+                async_stop = true;
+            }
+            curl_multi_wakeup(multi);
+            if (gateway.joinable()) gateway.join();
+        }
+
+        for (CURL* h : idle) curl_easy_cleanup(h);   // before the multi / share they used
+        if (multi) curl_multi_cleanup(multi);
+        curl_share_cleanup(share);
+    }
+
+    static void lock_cb(CURL*, curl_lock_data data, curl_lock_access, void* userp) {
+        static_cast<HttpPool*>(userp)->share_mtx[data].lock();
+    }
+    static void unlock_cb(CURL*, curl_lock_data data, void* userp) {
+        static_cast<HttpPool*>(userp)->share_mtx[data].unlock();
+    }
+
+    CURL* acquire() {
+        {
+            std::lock_guard<std::mutex> lk(mtx);
+            if (!idle.empty()) {
+                CURL* h = idle.back();
+                idle.pop_back();
+                return h;
+            }
+        }
+        CURL* h = curl_easy_init();
+        if (h) handles.fetch_add(1, std::memory_order_relaxed);
+        return h;
+    }
+
+    void release(CURL* h) {
+        std::lock_guard<std::mutex> lk(mtx);
+        idle.push_back(h);
+    }
+
+    // Options every request starts from; curl_easy_reset keeps the handle's
+    // connections and caches
+    void configure(CURL* h, const std::string& url) const {
+        curl_easy_reset(h);
+        curl_easy_setopt(h, CURLOPT_URL, url.c_str());
+        curl_easy_setopt(h, CURLOPT_SHARE, share);
+        curl_easy_setopt(h, CURLOPT_NOSIGNAL, 1L);
+        curl_easy_setopt(h, CURLOPT_TCP_NODELAY, 1L);
+        curl_easy_setopt(h, CURLOPT_TCP_KEEPALIVE, 1L);
+        curl_easy_setopt(h, CURLOPT_CONNECTTIMEOUT_MS, 5000L);
+        curl_easy_setopt(h, CURLOPT_TIMEOUT_MS, 15000L);
+        curl_easy_setopt(h, CURLOPT_HTTP_VERSION,
+                         opt.http2 ? CURL_HTTP_VERSION_2TLS : CURL_HTTP_VERSION_1_1);
+
+        // TLS verify ON
+        curl_easy_setopt(h, CURLOPT_SSL_VERIFYPEER, 1L);
+        curl_easy_setopt(h, CURLOPT_SSL_VERIFYHOST, 2L);
+        if (!opt.ca_file.empty()) curl_easy_setopt(h, CURLOPT_CAINFO, opt.ca_file.c_str());
+    }
+
+    // Counts the request and whether it had to open a connection
+    void account(CURL* h) {
+        long connects = 0;
+        curl_easy_getinfo(h, CURLINFO_NUM_CONNECTS, &connects);
+        requests.fetch_add(1, std::memory_order_relaxed);
+        if (connects > 0) new_connections.fetch_add(1, std::memory_order_relaxed);
+        last_use_ns.store(trace_now_ns(), std::memory_order_relaxed);
+    }
+
+    // Unsigned public endpoint; keeps / opens a connection
+    bool ping() {
+        CURL* h = acquire();
+        if (!h) return false;
+        const bool ok = ping(h);
+        release(h);
+        return ok;
+    }
+
+    // Same on a handle the caller holds: keeps / opens that handle's connection
+    bool ping(CURL* h) {
+        std::string resp;
+        configure(h, opt.base_url + "/v5/market/time");
+        curl_easy_setopt(h, CURLOPT_HTTPGET, 1L);
+        curl_easy_setopt(h, CURLOPT_WRITEFUNCTION, write_cb);
+        curl_easy_setopt(h, CURLOPT_WRITEDATA, &resp);
+
+        const CURLcode rc = curl_easy_perform(h);
+        long http_code = 0;
+        curl_easy_getinfo(h, CURLINFO_RESPONSE_CODE, &http_code);
+        account(h);
+        pings.fetch_add(1, std::memory_order_relaxed);
+        return rc == CURLE_OK && http_code >= 200 && http_code < 300;
+    }
+
+    void ping_loop() {
+        const std::uint64_t period_ns = static_cast<std::uint64_t>(opt.keepalive_s) * 1000000000ull;
+        std::unique_lock<std::mutex> lk(mtx);
+        while (!stop) {
+            cv.wait_for(lk, std::chrono::seconds(opt.keepalive_s));
+            if (stop) break;
+            if (trace_now_ns() - last_use_ns.load(std::memory_order_relaxed) < period_ns) continue;
+
+            lk.unlock();
+            ping();
+            lk.lock();
+        }
+    }
+
+    // ---- async gateway ----
+    struct AsyncRequest {
+        std::string url;
+        std::string body;
+        SignedHeaders headers;
+        Callback cb;
+
+        std::string resp;
+        std::uint64_t t0_ns = 0;
+    };
+
+    void submit(std::unique_ptr<AsyncRequest> req) {
+        std::call_once(gateway_once, [this] {
+            multi = curl_multi_init();
+            curl_multi_setopt(multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+            curl_multi_setopt(multi, CURLMOPT_MAX_HOST_CONNECTIONS, static_cast<long>(opt.max_connections));
+            gateway = std::thread([this] { gateway_loop(); });
+        });
+
+        req->t0_ns = trace_now_ns();
+        in_flight.fetch_add(1, std::memory_order_relaxed);   // until its callback returns
+        {
+            std::lock_guard<std::mutex> lk(async_mtx);
+            submitted.push_back(std::move(req));
+        }
+        curl_multi_wakeup(multi);
+    }
+
+    void finish(AsyncRequest* req, CURLcode rc) {
+        trace_span(LS_REST_POST, req->t0_ns, trace_now_ns());
+        if (req->cb) req->cb(rc == CURLE_OK ? std::move(req->resp) : curl_error_json(rc));
+        delete req;
+        in_flight.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    void gateway_loop() {
+        std::deque<std::unique_ptr<AsyncRequest>> batch;
+        while (true) {
+            {
+                std::lock_guard<std::mutex> lk(async_mtx);
+                if (async_stop) break;
+                batch.swap(submitted);
+            }
+
+            for (auto& up : batch) {
+                AsyncRequest* req = up.release();
+
+                CURL* h = acquire();
+                if (!h) {
+                    finish(req, CURLE_FAILED_INIT);
+                    continue;
+                }
+                configure(h, req->url);
+                curl_easy_setopt(h, CURLOPT_HTTPHEADER, req->headers.list());
+                curl_easy_setopt(h, CURLOPT_POSTFIELDS, req->body.c_str());
+                curl_easy_setopt(h, CURLOPT_POSTFIELDSIZE, static_cast<long>(req->body.size()));
+                curl_easy_setopt(h, CURLOPT_WRITEFUNCTION, write_cb);
+                curl_easy_setopt(h, CURLOPT_WRITEDATA, &req->resp);
+                curl_easy_setopt(h, CURLOPT_PRIVATE, req);
+                curl_easy_setopt(h, CURLOPT_PIPEWAIT, 1L);   // HTTP/2: wait to multiplex rather than connect
+                curl_multi_add_handle(multi, h);
+                active.push_back(h);
+            }
+            batch.clear();
+
+            int running = 0;
+            curl_multi_perform(multi, &running);
+
+            int left = 0;
+            while (CURLMsg* m = curl_multi_info_read(multi, &left)) {
+                if (m->msg != CURLMSG_DONE) continue;
+                CURL* h = m->easy_handle;
+                const CURLcode rc = m->data.result;
+
+                AsyncRequest* req = nullptr;
+                curl_easy_getinfo(h, CURLINFO_PRIVATE, &req);
+                account(h);
+                curl_multi_remove_handle(multi, h);
+                active.erase(std::find(active.begin(), active.end(), h));
+                release(h);
+                finish(req, rc);
+            }
+
+            curl_multi_poll(multi, nullptr, 0, 1000, nullptr);
+        }
+
+        // Shutdown: whatever is still in flight completes with an error
+        {
+            std::lock_guard<std::mutex> lk(async_mtx);
+            batch.swap(submitted);
+        }
+        for (auto& up : batch) finish(up.release(), CURLE_ABORTED_BY_CALLBACK);
+        for (CURL* h : active) {
+            AsyncRequest* req = nullptr;
+            curl_easy_getinfo(h, CURLINFO_PRIVATE, &req);
+            curl_multi_remove_handle(multi, h);
+            release(h);
+            finish(req, CURLE_ABORTED_BY_CALLBACK);
+        }
+        active.clear();
+    }
+
+    HttpOptions opt;
+    CURLSH* share = nullptr;
+    std::mutex share_mtx[CURL_LOCK_DATA_LAST];
+
+    std::mutex mtx;              // idle, stop
+    std::vector<CURL*> idle;
+    std::condition_variable cv;
+    bool stop = false;
+    std::thread pinger;
+
+    std::atomic<std::uint64_t> requests{0};
+    std::atomic<std::uint64_t> new_connections{0};
+    std::atomic<std::uint64_t> pings{0};
+    std::atomic<std::uint64_t> handles{0};
+    std::atomic<std::uint64_t> last_use_ns{0};
+
+    std::once_flag gateway_once;
+    CURLM* multi = nullptr;
+    std::thread gateway;
+    std::mutex async_mtx;        // submitted, async_stop
+    std::deque<std::unique_ptr<AsyncRequest>> submitted;
+    bool async_stop = false;
+    std::vector<CURL*> active;   // gateway thread only
+    std::atomic<std::uint64_t> in_flight{0};
+};
+
 BybitDemoClient::BybitDemoClient(std::string api_key, std::string api_secret)
-: api_key_(std::move(api_key)), api_secret_(std::move(api_secret)) {}
+: BybitDemoClient(std::move(api_key), std::move(api_secret), HttpOptions::from_env()) {}
+
+BybitDemoClient::BybitDemoClient(std::string api_key, std::string api_secret, HttpOptions opt)
+: api_key_(std::move(api_key)), api_secret_(std::move(api_secret)),
+  signer_(api_secret_),
+  key_header_("X-BAPI-API-KEY: " + api_key_),
+  http_(std::make_unique<HttpPool>(std::move(opt))) {
+    const char* rw = std::getenv("BYBIT_RECV_WINDOW");
+    if (rw && *rw && std::strlen(rw) <= SignedHeaders::VALUE_MAX) recv_window_ = rw;
+}
+
+BybitDemoClient::~BybitDemoClient() = default;
+
+bool BybitDemoClient::warm_up() {
+    // Handles up front, so a burst of requests does not pay curl_easy_init;
+    // connections are per handle, so each one connects now
+    std::vector<CURL*> hs;
+    for (int i = 0; i < http_->opt.warm_handles; ++i)
+        if (CURL* h = http_->acquire()) hs.push_back(h);
+    if (hs.empty()) return http_->ping();
+
+    bool ok = false;
+    for (CURL* h : hs) ok = http_->ping(h) || ok;
+    for (CURL* h : hs) http_->release(h);
+    return ok;
+}
+
+BybitDemoClient::HttpStats BybitDemoClient::http_stats() const {
+    HttpStats st;
+    st.requests        = http_->requests.load(std::memory_order_relaxed);
+    st.new_connections = http_->new_connections.load(std::memory_order_relaxed);
+    st.pings           = http_->pings.load(std::memory_order_relaxed);
+    st.handles         = http_->handles.load(std::memory_order_relaxed);
+    st.async_in_flight = http_->in_flight.load(std::memory_order_relaxed);
+    return st;
+}
+
+// V5 signature: hex HMAC(secret, ts + apiKey + recvWindow + (body | queryString))
+void BybitDemoClient::sign_request(std::string_view sign_part, const char* default_recv_window,
+                                   SignedHeaders& h) const {
+    const std::string_view recv = recv_window_.empty() ? std::string_view(default_recv_window)
+                                                       : std::string_view(recv_window_);
+    char ts_buf[SignedHeaders::VALUE_MAX];
+    const std::string_view ts(ts_buf, std::to_chars(ts_buf, ts_buf + sizeof(ts_buf), now_ms()).ptr - ts_buf);
+
+    static constexpr char SIGN[] = "X-BAPI-SIGN: ";
+    std::memcpy(h.sign, SIGN, sizeof(SIGN) - 1);
+    signer_.sign({ts, api_key_, recv, sign_part}, h.sign + sizeof(SIGN) - 1);
+    h.sign[sizeof(SIGN) - 1 + BybitSigner::HEX_LEN] = '\0';
+
+    put_header(h.ts, "X-BAPI-TIMESTAMP: ", ts);
+    put_header(h.recv, "X-BAPI-RECV-WINDOW: ", recv);
+
+    h.nodes[0] = {const_cast<char*>(key_header_.c_str()), &h.nodes[1]};
+    h.nodes[1] = {h.sign, &h.nodes[2]};
+    h.nodes[2] = {h.ts, &h.nodes[3]};
+    h.nodes[3] = {h.recv, &h.nodes[4]};
+    h.nodes[4] = {const_cast<char*>("Content-Type: application/json"), nullptr};
+}
+
+// Request on a pooled handle; body == nullptr is a GET.
+// Returns the CURLcode; resp / http_code are set when it is CURLE_OK.
+int BybitDemoClient::perform(const std::string& url, const std::string* body, curl_slist* headers,
+                             std::string& resp, long& http_code, RateLimit* rl) {
+    CURL* curl = http_->acquire();
+    if (!curl) return CURLE_FAILED_INIT;
+
+    http_->configure(curl, url);
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+    if (body) {
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, body->c_str());
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, static_cast<long>(body->size()));
+    } else {
+        curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
+    }
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_cb);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &resp);
+    if (rl) {
+        *rl = RateLimit{};
+        curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, rate_limit_header_cb);
+        curl_easy_setopt(curl, CURLOPT_HEADERDATA, rl);
+    }
+
+    CURLcode rc = curl_easy_perform(curl);
+
+    http_code = 0;
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
+    http_->account(curl);
+
+    http_->release(curl);
+    return rc;
+}
 
 bool BybitDemoClient::ready() const {
     return !api_key_.empty() && !api_secret_.empty();
@@ -82,45 +540,19 @@ std::string BybitDemoClient::place_market_order(
 }
 
 std::string BybitDemoClient::post(const std::string& path, const std::string& body_json) {
-    const std::string base = "https://api-demo.bybit.com";
-    const std::string url = base + path;
-
-    const char* rw = std::getenv("BYBIT_RECV_WINDOW");
-    const std::string recv_window = rw ? std::string(rw) : "5000";
-    const std::string ts = std::to_string(now_ms());
-
-    // V5 signature: ts + apiKey + recvWindow + body
-    const std::string payload = ts + api_key_ + recv_window + body_json;
-    const std::string sig = hmac_sha256_hex(api_secret_, payload);
-
-    CURL* curl = curl_easy_init();
-    if (!curl) return "{\"error\":\"curl init failed\"}";
-
-    struct curl_slist* headers = nullptr;
-    headers = curl_slist_append(headers, ("X-BAPI-API-KEY: " + api_key_).c_str());
-    headers = curl_slist_append(headers, ("X-BAPI-SIGN: " + sig).c_str());
-    headers = curl_slist_append(headers, ("X-BAPI-TIMESTAMP: " + ts).c_str());
-    headers = curl_slist_append(headers, ("X-BAPI-RECV-WINDOW: " + recv_window).c_str());
-    headers = curl_slist_append(headers, "Content-Type: application/json");
+    const std::string url = http_->opt.base_url + path;
 
     std::string resp;
-    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, body_json.c_str());
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_cb);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &resp);
-
-    // TLS verify ON
-    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 1L);
-    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 2L);
-
-    CURLcode rc = curl_easy_perform(curl);
-
-    curl_slist_free_all(headers);
-    curl_easy_cleanup(curl);
+    long http_code = 0;
+    const std::uint64_t t0 = trace_now_ns();
+    SignedHeaders headers;
+    sign_request(body_json, "5000", headers);
+    const int rc = perform(url, &body_json, headers.list(), resp, http_code);
+    trace_span(LS_REST_POST, t0, trace_now_ns());
 
     if (rc != CURLE_OK) {
-        return std::string("{\"error\":\"curl perform failed\",\"msg\":\"") + curl_easy_strerror(rc) + "\"}";
+        if (rc == CURLE_FAILED_INIT) return "{\"error\":\"curl init failed\"}";
+        return curl_error_json(rc);
     }
     return resp;
 }
@@ -130,12 +562,87 @@ std::string BybitDemoClient::cancel_order(
     const std::string& symbol,
     const std::string& orderId
 ) {
+    return post("/v5/order/cancel", cancel_order_body(category, symbol, orderId));
+}
+
+std::string BybitDemoClient::cancel_all_orders(const std::string& category, const std::string& symbol) {
     nlohmann::json j;
     j["category"] = category;
     j["symbol"]   = symbol;
-    j["orderId"]  = orderId;
+    return post("/v5/order/cancel-all", j.dump());
+}
 
-    return post("/v5/order/cancel", j.dump());
+// ------------------------------------------------------------
+// Async gateway
+// ------------------------------------------------------------
+void BybitDemoClient::post_async(const std::string& path, const std::string& body_json, Callback cb) {
+    auto req = std::make_unique<HttpPool::AsyncRequest>();
+    req->url = http_->opt.base_url + path;
+    req->body = body_json;
+    sign_request(body_json, "5000", req->headers);
+    req->cb = std::move(cb);
+    http_->submit(std::move(req));
+}
+
+void BybitDemoClient::place_limit_order_async(
+    const std::string& category,
+    const std::string& symbol,
+    const std::string& side,
+    double qty,
+    double price,
+    const std::string& tif,
+    Callback cb
+) {
+    post_async("/v5/order/create", limit_order_body(category, symbol, side, qty, price, tif), std::move(cb));
+}
+
+void BybitDemoClient::cancel_order_async(
+    const std::string& category,
+    const std::string& symbol,
+    const std::string& orderId,
+    Callback cb
+) {
+    post_async("/v5/order/cancel", cancel_order_body(category, symbol, orderId), std::move(cb));
+}
+
+static BybitDemoClient::Callback fulfil(std::shared_ptr<std::promise<std::string>> p) {
+    return [p](std::string resp) { p->set_value(std::move(resp)); };
+}
+
+std::future<std::string> BybitDemoClient::place_limit_order_async(
+    const std::string& category,
+    const std::string& symbol,
+    const std::string& side,
+    double qty,
+    double price,
+    const std::string& tif
+) {
+    auto p = std::make_shared<std::promise<std::string>>();
+    auto f = p->get_future();
+    place_limit_order_async(category, symbol, side, qty, price, tif, fulfil(p));
+    return f;
+}
+
+std::future<std::string> BybitDemoClient::cancel_order_async(
+    const std::string& category,
+    const std::string& symbol,
+    const std::string& orderId
+) {
+    auto p = std::make_shared<std::promise<std::string>>();
+    auto f = p->get_future();
+    cancel_order_async(category, symbol, orderId, fulfil(p));
+    return f;
+}
+
+std::vector<std::string> BybitDemoClient::cancel_orders(const std::vector<CancelRequest>& reqs) {
+    std::vector<std::future<std::string>> fs;
+    fs.reserve(reqs.size());
+    for (const auto& r : reqs) fs.push_back(cancel_order_async(r.category, r.symbol, r.orderId));
+
+    std::vector<std::string> out;
+    out.reserve(fs.size());
+    for (auto& f : fs) out.push_back(f.get());
+    return out;
 }
 
 /*std::string BybitDemoClient::get(const std::string& path, const std::string& query_string) {
@@ -224,7 +731,16 @@ std::string BybitDemoClient::close_position_market_reduce_only(const std::string
         return R"({"error":"close supports only category=linear (USDT Perpetual) for now"})";
     }
 
-    double pos = get_position_size_linear(symbol);
+    return close_position_market_reduce_only(category, symbol, get_position_size_linear(symbol));
+}
+
+std::string BybitDemoClient::close_position_market_reduce_only(const std::string& category,
+                                                               const std::string& symbol,
+                                                               double pos) {
+    if (category != "linear") {
+        return R"({"error":"close supports only category=linear (USDT Perpetual) for now"})";
+    }
+
     if (std::abs(pos) < 1e-12) {
         return R"({"ok":true,"msg":"Already flat"})";
     }
@@ -249,50 +765,18 @@ std::string BybitDemoClient::close_position_market_reduce_only(const std::string
     return post("/v5/order/create", j.dump());
 }
 
-std::string BybitDemoClient::get(const std::string& path, const std::string& query_string) {
-    const std::string base = "https://api-demo.bybit.com";
-    const std::string url  = base + path + (query_string.empty() ? "" : ("?" + query_string));
-
-    const char* rw = std::getenv("BYBIT_RECV_WINDOW");
-    const std::string recv_window = rw ? std::string(rw) : "10000";
-    const std::string ts = std::to_string(now_ms());
-
-    // V5 signature for GET: ts + apiKey + recvWindow + queryString
-    const std::string payload = ts + api_key_ + recv_window + query_string;
-    const std::string sig = hmac_sha256_hex(api_secret_, payload);
-
-    CURL* curl = curl_easy_init();
-    if (!curl) return "{\"error\":\"curl init failed\"}";
-
-    struct curl_slist* headers = nullptr;
-    headers = curl_slist_append(headers, ("X-BAPI-API-KEY: " + api_key_).c_str());
-    headers = curl_slist_append(headers, ("X-BAPI-SIGN: " + sig).c_str());
-    headers = curl_slist_append(headers, ("X-BAPI-TIMESTAMP: " + ts).c_str());
-    headers = curl_slist_append(headers, ("X-BAPI-RECV-WINDOW: " + recv_window).c_str());
-    headers = curl_slist_append(headers, "Content-Type: application/json");
+std::string BybitDemoClient::get(const std::string& path, const std::string& query_string, RateLimit* rl) {
+    const std::string url  = http_->opt.base_url + path + (query_string.empty() ? "" : ("?" + query_string));
 
     std::string resp;
-    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-
-    // IMPORTANT: GET + capture response
-    curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_cb);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &resp);
-
-    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 1L);
-    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 2L);
-
-    CURLcode rc = curl_easy_perform(curl);
-
     long http_code = 0;
-    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
-
-    curl_slist_free_all(headers);
-    curl_easy_cleanup(curl);
+    SignedHeaders headers;
+    sign_request(query_string, "10000", headers);
+    const int rc = perform(url, nullptr, headers.list(), resp, http_code, rl);
 
     if (rc != CURLE_OK) {
-        return std::string("{\"error\":\"curl perform failed\",\"msg\":\"") + curl_easy_strerror(rc) + "\"}";
+        if (rc == CURLE_FAILED_INIT) return "{\"error\":\"curl init failed\"}";
+        return curl_error_json(rc);
     }
     if (http_code < 200 || http_code >= 300) {
         return std::string("{\"error\":\"http\",\"code\":") + std::to_string(http_code) +
@@ -352,3 +836,41 @@ std::string BybitDemoClient::get_transaction_log(const std::string& category,
 
 
 
+
+std::string BybitDemoClient::get_executions(const std::string& category,
+                                            const std::string& symbol,
+                                            long long startTimeMs,
+                                            long long endTimeMs,
+                                            const std::string& cursor,
+                                            RateLimit* rl) {
+    std::string qs = "category=" + category +
+                     "&symbol=" + symbol +
+                     "&startTime=" + std::to_string(startTimeMs) +
+                     "&endTime=" + std::to_string(endTimeMs) +
+                     "&limit=100";
+
+    if (!cursor.empty()) qs += "&cursor=" + cursor;
+
+    return get("/v5/execution/list", qs, rl);
+}
+
+std::string BybitDemoClient::get_transaction_log(const std::string& category,
+                                                 const std::string& symbol,
+                                                 long long startTimeMs,
+                                                 long long endTimeMs,
+                                                 const std::string& cursor,
+                                                 const std::string& type,
+                                                 RateLimit* rl) {
+    std::string qs = "accountType=UNIFIED"
+                     "&category=" + category +
+                     "&type=" + type +
+                     "&startTime=" + std::to_string(startTimeMs) +
+                     "&endTime=" + std::to_string(endTimeMs) +
+                     "&limit=50";
+
+    if (!symbol.empty()) qs += "&symbol=" + symbol;
+
+    if (!cursor.empty()) qs += "&cursor=" + cursor;
+
+    return get("/v5/account/transaction-log", qs, rl);
+}
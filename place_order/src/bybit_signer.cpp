@@ -0,0 +1,69 @@
+// The low-level SHA256_* API is deprecated in OpenSSL 3, but its context is
+// a plain struct: copying it is a memcpy. EVP_MD_CTX_copy_ex / HMAC_CTX
+// copies go through the provider and allocate on every request.
+#define OPENSSL_SUPPRESS_DEPRECATED
+
+#include "bybit_signer.hpp"
+
+#include <openssl/crypto.h>
+#include <openssl/sha.h>
+
+#include <cstring>
+
+struct BybitSigner::Keyed {
+    SHA256_CTX inner;   // after key ^ ipad
+    SHA256_CTX outer;   // after key ^ opad
+};
+
+BybitSigner::BybitSigner(std::string_view secret) : k_(std::make_unique<Keyed>()) {
+    unsigned char key[SHA256_CBLOCK] = {};
+    if (secret.size() > SHA256_CBLOCK) {
+        SHA256(reinterpret_cast<const unsigned char*>(secret.data()), secret.size(), key);
+    } else {
+        std::memcpy(key, secret.data(), secret.size());
+    }
+
+    unsigned char pad[SHA256_CBLOCK];
+    for (int i = 0; i < SHA256_CBLOCK; ++i) pad[i] = key[i] ^ 0x36;
+    SHA256_Init(&k_->inner);
+    SHA256_Update(&k_->inner, pad, sizeof(pad));
+
+    for (int i = 0; i < SHA256_CBLOCK; ++i) pad[i] = key[i] ^ 0x5c;
+    SHA256_Init(&k_->outer);
+    SHA256_Update(&k_->outer, pad, sizeof(pad));
+
+    OPENSSL_cleanse(key, sizeof(key));
+    OPENSSL_cleanse(pad, sizeof(pad));
+}
+
+BybitSigner::~BybitSigner() {
+    if (k_) OPENSSL_cleanse(k_.get(), sizeof(Keyed));
+}
+
+BybitSigner::BybitSigner(BybitSigner&&) noexcept = default;
+BybitSigner& BybitSigner::operator=(BybitSigner&&) noexcept = default;
+
+void BybitSigner::sign(std::initializer_list<std::string_view> parts, char* out) const {
+    static constexpr char HEX[] = "0123456789abcdef";
+
+    unsigned char md[SHA256_DIGEST_LENGTH];
+
+    SHA256_CTX c = k_->inner;
+    for (std::string_view p : parts) SHA256_Update(&c, p.data(), p.size());
+    SHA256_Final(md, &c);
+
+    c = k_->outer;
+    SHA256_Update(&c, md, sizeof(md));
+    SHA256_Final(md, &c);
+
+    for (int i = 0; i < SHA256_DIGEST_LENGTH; ++i) {
+        out[2 * i]     = HEX[md[i] >> 4];
+        out[2 * i + 1] = HEX[md[i] & 0x0f];
+    }
+}
+
+std::string BybitSigner::sign_hex(std::initializer_list<std::string_view> parts) const {
+    char hex[HEX_LEN];
+    sign(parts, hex);
+    return std::string(hex, HEX_LEN);
+}
@@ -0,0 +1,649 @@
+#include "bybit_trade_ws_client.hpp"
+#include "latency_trace.hpp"
+
+#include <boost/beast/core.hpp>
+#include <boost/beast/ssl.hpp>
+#include <boost/beast/websocket.hpp>
+#include <boost/asio/connect.hpp>
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/ssl.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+namespace beast     = boost::beast;
+namespace websocket = beast::websocket;
+namespace net       = boost::asio;
+namespace ssl       = net::ssl;
+using tcp           = net::ip::tcp;
+using json          = nlohmann::json;
+
+static long long now_ms() {
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
+}
+
+// ------------------------------------------------------------
+// Endpoints: "wss://host[:port]/target" or "ws://..." (local stub)
+// ------------------------------------------------------------
+struct WsUrl {
+    bool tls = true;
+    std::string host;
+    std::string port;
+    std::string target = "/";
+};
+
+static bool parse_ws_url(const std::string& url, WsUrl& out) {
+    WsUrl ep;
+    std::string rest;
+    if (url.rfind("wss://", 0) == 0) {
+        rest = url.substr(6);
+    } else if (url.rfind("ws://", 0) == 0) {
+        ep.tls = false;
+        rest = url.substr(5);
+    } else {
+        return false;
+    }
+
+    const auto slash = rest.find('/');
+    const std::string authority = rest.substr(0, slash);
+    if (slash != std::string::npos) ep.target = rest.substr(slash);
+
+    const auto colon = authority.rfind(':');
+    ep.host = authority.substr(0, colon);
+    ep.port = colon != std::string::npos ? authority.substr(colon + 1) : (ep.tls ? "443" : "80");
+    if (ep.host.empty() || ep.port.empty()) return false;
+
+    out = std::move(ep);
+    return true;
+}
+
+// ------------------------------------------------------------
+// Plain and TLS websocket streams behind one interface
+// ------------------------------------------------------------
+class WsConn {
+public:
+    using Handler = std::function<void(beast::error_code, std::size_t)>;
+    virtual ~WsConn() = default;
+    virtual void async_read(beast::flat_buffer& buf, Handler h) = 0;
+    virtual void async_write(const std::string& msg, Handler h) = 0;
+    virtual void close() = 0;   // pending operations complete with an error
+};
+
+template <class Ws>
+class WsConnT : public WsConn {
+public:
+    explicit WsConnT(std::unique_ptr<Ws> ws) : ws_(std::move(ws)) {}
+
+    void async_read(beast::flat_buffer& buf, Handler h) override { ws_->async_read(buf, std::move(h)); }
+    void async_write(const std::string& msg, Handler h) override {
+        ws_->async_write(net::buffer(msg), std::move(h));
+    }
+    void close() override {
+        beast::error_code ec;
+        beast::get_lowest_layer(*ws_).socket().close(ec);
+    }
+
+private:
+    std::unique_ptr<Ws> ws_;
+};
+
+// Resolve, TCP connect, TLS and websocket handshakes, all asynchronous on
+// the io thread (the other socket keeps being served meanwhile) and bounded
+// by one deadline; on expiry or cancel() the step in progress is aborted.
+class WsConnectOp {
+public:
+    using Handler = std::function<void(std::shared_ptr<WsConn> conn, std::string err)>;
+    virtual ~WsConnectOp() = default;
+    virtual void cancel() = 0;   // handler still runs, with an error
+};
+
+template <class Ws>
+class WsConnectOpT : public WsConnectOp, public std::enable_shared_from_this<WsConnectOpT<Ws>> {
+public:
+    static constexpr bool TLS = !std::is_same_v<Ws, websocket::stream<beast::tcp_stream>>;
+
+    WsConnectOpT(net::io_context& ioc, std::unique_ptr<Ws> ws, const WsUrl& ep, Handler h)
+        : resolver_(ioc), deadline_(ioc), ws_(std::move(ws)), ep_(ep), handler_(std::move(h)) {}
+
+    void start(std::chrono::milliseconds timeout) {
+        auto self = this->shared_from_this();
+        deadline_.expires_after(timeout);
+        deadline_.async_wait([self](beast::error_code ec) {
+            if (!ec) self->abort("timed out");
+        });
+        resolver_.async_resolve(ep_.host, ep_.port,
+            [self](beast::error_code ec, tcp::resolver::results_type results) {
+                if (ec || self->aborted()) return self->finish(ec);
+                beast::get_lowest_layer(*self->ws_).async_connect(results,
+                    [self](beast::error_code ec, const tcp::endpoint&) { self->on_connect(ec); });
+            });
+    }
+
+    void cancel() override { abort("cancelled"); }
+
+private:
+    void on_connect(beast::error_code ec) {
+        if (ec || aborted()) return finish(ec);
+        beast::get_lowest_layer(*ws_).socket().set_option(tcp::no_delay(true), ec);
+
+        auto self = this->shared_from_this();
+        if constexpr (TLS) {
+            SSL_set_tlsext_host_name(ws_->next_layer().native_handle(), ep_.host.c_str());
+            ws_->next_layer().async_handshake(ssl::stream_base::client, [self](beast::error_code ec) {
+                if (ec || self->aborted()) return self->finish(ec);
+                self->ws_handshake();
+            });
+        } else {
+            ws_handshake();
+        }
+    }
+
+    void ws_handshake() {
+        ws_->set_option(websocket::stream_base::timeout::suggested(beast::role_type::client));
+        ws_->text(true);
+        auto self = this->shared_from_this();
+        ws_->async_handshake(ep_.host + ":" + ep_.port, ep_.target,
+                             [self](beast::error_code ec) { self->finish(ec); });
+    }
+
+    // A step that completed just before abort() must not start the next one
+    bool aborted() const { return !why_.empty(); }
+
+    // The aborted step completes with operation_aborted; finish() reports why
+    void abort(const char* why) {
+        if (done_) return;
+        why_ = why;
+        resolver_.cancel();
+        beast::error_code ec;
+        beast::get_lowest_layer(*ws_).socket().close(ec);
+    }
+
+    void finish(beast::error_code ec) {
+        if (done_) return;
+        done_ = true;
+        deadline_.cancel();
+        if (!ec && !aborted()) {
+            handler_(std::make_shared<WsConnT<Ws>>(std::move(ws_)), {});
+            return;
+        }
+        handler_(nullptr, aborted() ? why_ : ec.message());
+    }
+
+    tcp::resolver resolver_;
+    net::steady_timer deadline_;
+    std::unique_ptr<Ws> ws_;
+    WsUrl ep_;
+    Handler handler_;
+    std::string why_;   // set by abort()
+    bool done_ = false;
+};
+
+static std::shared_ptr<WsConnectOp> ws_connect_async(net::io_context& ioc, ssl::context& ctx, const WsUrl& ep,
+                                                     std::chrono::milliseconds timeout, WsConnectOp::Handler h) {
+    if (ep.tls) {
+        using Ws = websocket::stream<beast::ssl_stream<beast::tcp_stream>>;
+        auto op = std::make_shared<WsConnectOpT<Ws>>(ioc, std::make_unique<Ws>(ioc, ctx), ep, std::move(h));
+        op->start(timeout);
+        return op;
+    }
+    using Ws = websocket::stream<beast::tcp_stream>;
+    auto op = std::make_shared<WsConnectOpT<Ws>>(ioc, std::make_unique<Ws>(ioc), ep, std::move(h));
+    op->start(timeout);
+    return op;
+}
+
+// ------------------------------------------------------------
+// Options
+// ------------------------------------------------------------
+BybitTradeWsClient::Options BybitTradeWsClient::Options::from_env() {
+    Options o;
+    if (const char* v = std::getenv("BYBIT_WS_PRIVATE_URL"); v && *v) o.private_url = v;
+    if (const char* v = std::getenv("BYBIT_WS_TRADE_URL"); v && *v) o.trade_url = v;
+    if (const char* v = std::getenv("BYBIT_CA_FILE"); v && *v) o.ca_file = v;
+    if (const char* v = std::getenv("BYBIT_RECV_WINDOW"); v && *v) o.recv_window_ms = std::atoi(v);
+    return o;
+}
+
+// ------------------------------------------------------------
+// Io: everything below runs on the io thread unless noted
+// ------------------------------------------------------------
+struct BybitTradeWsClient::Io {
+    struct Session {
+        Session(net::io_context& ioc, const char* n) : name(n), ping(ioc), retry(ioc) {}
+
+        const char* name;
+        WsUrl ep;
+        std::shared_ptr<WsConn> conn;     // handlers hold it; stale ones see conn changed
+        beast::flat_buffer rx;
+        std::deque<std::string> outq;     // front is being written
+        bool writing = false;
+        bool authed = false;
+        bool opened_once = false;
+        net::steady_timer ping;
+        net::steady_timer retry;
+        std::chrono::milliseconds backoff{100};
+        std::shared_ptr<WsConnectOp> connecting;   // attempt in progress
+    };
+
+    struct Pending {
+        Callback cb;
+        std::uint64_t t0_ns = 0;
+        std::chrono::steady_clock::time_point expires;
+    };
+
+    explicit Io(BybitTradeWsClient& c)
+        : owner(c),
+          work(net::make_work_guard(ioc)),
+          ctx(ssl::context::tlsv12_client),
+          priv(ioc, "private"),
+          trade(ioc, "trade"),
+          ack_sweep(ioc) {
+        ctx.set_default_verify_paths();
+        if (!owner.opt_.ca_file.empty()) ctx.load_verify_file(owner.opt_.ca_file);
+        ctx.set_verify_mode(ssl::verify_peer);
+    }
+
+    std::string auth_msg() const {
+        const long long expires = now_ms() + 10000;
+        const std::string sig = owner.signer_.sign_hex({"GET/realtime", std::to_string(expires)});
+        json j;
+        j["op"] = "auth";
+        j["args"] = {owner.api_key_, expires, sig};
+        return j.dump();
+    }
+
+    void open(Session& s) {
+        if (stopping) return;
+        if (s.opened_once) reconnects.fetch_add(1, std::memory_order_relaxed);
+        s.opened_once = true;
+
+        s.connecting = ws_connect_async(ioc, ctx, s.ep, std::chrono::milliseconds(owner.opt_.connect_timeout_ms),
+            [this, &s](std::shared_ptr<WsConn> c, std::string err) {
+                s.connecting.reset();
+                if (stopping) {
+                    if (c) c->close();
+                    return;
+                }
+                if (!c) {
+                    std::cerr << "[WS] " << s.name << " connect failed: " << err << "\n";
+                    schedule_retry(s);
+                    return;
+                }
+                on_connected(s, std::move(c));
+            });
+    }
+
+    void on_connected(Session& s, std::shared_ptr<WsConn> c) {
+        s.conn = std::move(c);
+        std::cout << "[WS] " << s.name << " connected " << (s.ep.tls ? "wss://" : "ws://")
+                  << s.ep.host << ":" << s.ep.port << s.ep.target << "\n";
+
+        s.rx.consume(s.rx.size());
+        s.outq.clear();
+        s.writing = false;
+        s.authed = false;
+        send(s, auth_msg());
+        read(s);
+    }
+
+    void schedule_retry(Session& s) {
+        if (stopping) return;
+        s.retry.expires_after(s.backoff);
+        s.retry.async_wait([this, &s](beast::error_code ec) {
+            if (!ec) open(s);
+        });
+        s.backoff = std::min(s.backoff * 2, std::chrono::milliseconds(5000));
+    }
+
+    void fail(Session& s, const std::string& why) {
+        if (!s.conn) return;
+        std::cerr << "[WS] " << s.name << " disconnected: " << why << "\n";
+        s.conn->close();
+        s.conn.reset();
+        s.authed = false;
+        if (&s == &trade) {
+            trade_ready.store(false);
+            fail_pending("ws trade disconnected");
+        } else {
+            priv_ready.store(false);
+            if (priv_down_h) priv_down_h();
+        }
+        schedule_retry(s);
+    }
+
+    void fail_pending(const std::string& why) {
+        json err;
+        err["error"] = why;
+        const std::string resp = err.dump();
+        for (auto& kv : pending) complete(kv.second.cb, resp);
+        pending.clear();
+    }
+
+    // Acks that never came (socket up but the request lost or stuck)
+    // complete with an error; the order's real state is left to the
+    // private stream / REST
+    void arm_ack_sweep() {
+        ack_sweep.expires_after(std::chrono::milliseconds(250));
+        ack_sweep.async_wait([this](beast::error_code ec) {
+            if (ec) return;
+            const auto now = std::chrono::steady_clock::now();
+            std::vector<Callback> expired;
+            for (auto it = pending.begin(); it != pending.end();) {
+                if (it->second.expires > now) {
+                    ++it;
+                    continue;
+                }
+                expired.push_back(std::move(it->second.cb));
+                it = pending.erase(it);
+            }
+            for (auto& cb : expired) complete(cb, R"({"error":"ws ack timeout"})");
+            arm_ack_sweep();
+        });
+    }
+
+    // Every callback submit() accepted runs through here exactly once
+    void complete(Callback& cb, const std::string& resp) {
+        cb(resp);
+        in_flight.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    void read(Session& s) {
+        auto c = s.conn;
+        c->async_read(s.rx, [this, &s, c](beast::error_code ec, std::size_t) {
+            if (c != s.conn) return;
+            if (ec) {
+                fail(s, ec.message());
+                return;
+            }
+            const std::string msg = beast::buffers_to_string(s.rx.data());
+            s.rx.consume(s.rx.size());
+            on_message(s, msg);
+            if (c == s.conn) read(s);
+        });
+    }
+
+    void send(Session& s, std::string msg) {
+        if (!s.conn) return;
+        s.outq.push_back(std::move(msg));
+        if (!s.writing) write_next(s);
+    }
+
+    void write_next(Session& s) {
+        s.writing = true;
+        auto c = s.conn;
+        c->async_write(s.outq.front(), [this, &s, c](beast::error_code ec, std::size_t) {
+            if (c != s.conn) return;
+            if (ec) {
+                fail(s, ec.message());
+                return;
+            }
+            s.outq.pop_front();
+            if (s.outq.empty()) s.writing = false;
+            else write_next(s);
+        });
+    }
+
+    // App-level ping on both sockets, whether or not they are up
+    void arm_ping(Session& s) {
+        s.ping.expires_after(std::chrono::seconds(std::max(1, owner.opt_.ping_s)));
+        s.ping.async_wait([this, &s](beast::error_code ec) {
+            if (ec) return;
+            if (s.authed) send(s, R"({"op":"ping"})");
+            arm_ping(s);
+        });
+    }
+
+    void on_authed(Session& s) {
+        s.authed = true;
+        s.backoff = std::chrono::milliseconds(100);
+        std::cout << "[WS] " << s.name << " authenticated\n";
+
+        if (&s == &priv) {
+            send(s, R"({"op":"subscribe","args":["order","execution","position"]})");
+            return;
+        }
+        trade_ready.store(true);
+        notify();
+    }
+
+    void on_message(Session& s, const std::string& msg) {
+        const json j = json::parse(msg, nullptr, false);
+        if (j.is_discarded() || !j.is_object()) return;
+
+        // Private stream: {"topic":"execution","data":[...]}
+        if (auto t = j.find("topic"); t != j.end() && t->is_string()) {
+            const std::string& topic = t->get_ref<const std::string&>();
+            const Handler* h = nullptr;
+            std::atomic<std::uint64_t>* n = nullptr;
+            if (topic == "execution")     { h = &exec_h;  n = &executions; }
+            else if (topic == "order")    { h = &order_h; n = &orders; }
+            else if (topic == "position") { h = &pos_h;   n = &positions; }
+            if (!h) return;
+
+            auto d = j.find("data");
+            if (d == j.end() || !d->is_array()) return;
+            for (const auto& rec : *d) {
+                n->fetch_add(1, std::memory_order_relaxed);
+                if (*h) (*h)(rec);
+            }
+            return;
+        }
+
+        const std::string op = j.value("op", "");
+
+        // Private replies {"success":true,...}, trade replies {"retCode":0,...}
+        const bool ok = j.value("success", false) || j.value("retCode", -1) == 0;
+
+        if (op == "auth") {
+            if (ok) on_authed(s);
+            else fail(s, "auth rejected: " + msg);
+            return;
+        }
+        if (op == "subscribe") {
+            if (!ok) {
+                fail(s, "subscribe rejected: " + msg);
+                return;
+            }
+            priv_ready.store(true);
+            notify();
+            return;
+        }
+
+        // Trade acks carry our reqId
+        auto r = j.find("reqId");
+        if (r == j.end() || !r->is_string()) return;
+        auto it = pending.find(r->get<std::string>());
+        if (it == pending.end()) return;
+
+        Pending p = std::move(it->second);
+        pending.erase(it);
+        trace_span(LS_WS_ORDER, p.t0_ns, trace_now_ns());
+        acks.fetch_add(1, std::memory_order_relaxed);
+
+        json out;
+        out["retCode"] = j.value("retCode", -1);
+        out["retMsg"] = j.value("retMsg", "");
+        out["result"] = j.contains("data") ? j["data"] : json::object();
+        out["retExtInfo"] = j.contains("retExtInfo") ? j["retExtInfo"] : json::object();
+        complete(p.cb, out.dump());
+    }
+
+    // Any thread
+    void submit(const std::string& op, json args, Callback cb) {
+        const std::uint64_t t0 = trace_now_ns();
+        const std::string req_id = std::to_string(next_req.fetch_add(1, std::memory_order_relaxed));
+
+        json j;
+        j["reqId"] = req_id;
+        j["header"] = {{"X-BAPI-TIMESTAMP", std::to_string(now_ms())},
+                       {"X-BAPI-RECV-WINDOW", std::to_string(owner.opt_.recv_window_ms)}};
+        j["op"] = op;
+        j["args"] = json::array({std::move(args)});
+
+        in_flight.fetch_add(1, std::memory_order_relaxed);
+        net::post(ioc, [this, req_id, t0, msg = j.dump(), cb = std::move(cb)]() mutable {
+            if (!trade.authed) {
+                complete(cb, R"({"error":"ws trade not connected"})");
+                return;
+            }
+            pending.emplace(req_id, Pending{std::move(cb), t0,
+                                            std::chrono::steady_clock::now() +
+                                                std::chrono::milliseconds(owner.opt_.ack_timeout_ms)});
+            send(trade, std::move(msg));
+        });
+    }
+
+    void notify() {
+        { std::lock_guard<std::mutex> lk(mtx); }
+        cv.notify_all();
+    }
+
+    BybitTradeWsClient& owner;
+    Handler order_h, exec_h, pos_h;   // set before start()
+    std::function<void()> priv_down_h;
+
+    net::io_context ioc;
+    net::executor_work_guard<net::io_context::executor_type> work;
+    ssl::context ctx;
+    Session priv;
+    Session trade;
+    net::steady_timer ack_sweep;
+    std::thread th;
+    bool stopping = false;
+
+    std::unordered_map<std::string, Pending> pending;   // reqId -> caller
+    std::atomic<std::uint64_t> next_req{1};
+
+    std::mutex mtx;                  // start() waits on cv for both sockets
+    std::condition_variable cv;
+    std::atomic<bool> trade_ready{false};
+    std::atomic<bool> priv_ready{false};
+
+    std::atomic<std::uint64_t> acks{0}, orders{0}, executions{0}, positions{0}, reconnects{0};
+    std::atomic<std::uint64_t> in_flight{0};   // any thread
+};
+
+// ------------------------------------------------------------
+// BybitTradeWsClient
+// ------------------------------------------------------------
+BybitTradeWsClient::BybitTradeWsClient(std::string api_key, std::string api_secret)
+    : BybitTradeWsClient(std::move(api_key), std::move(api_secret), Options::from_env()) {}
+
+BybitTradeWsClient::BybitTradeWsClient(std::string api_key, std::string api_secret, Options opt)
+    : api_key_(std::move(api_key)), api_secret_(std::move(api_secret)), signer_(api_secret_), opt_(std::move(opt)),
+      io_(std::make_unique<Io>(*this)) {}
+
+BybitTradeWsClient::~BybitTradeWsClient() {
+    stop();
+}
+
+void BybitTradeWsClient::on_order(Handler h)     { io_->order_h = std::move(h); }
+void BybitTradeWsClient::on_execution(Handler h) { io_->exec_h = std::move(h); }
+void BybitTradeWsClient::on_position(Handler h)  { io_->pos_h = std::move(h); }
+void BybitTradeWsClient::on_private_down(std::function<void()> h) { io_->priv_down_h = std::move(h); }
+
+bool BybitTradeWsClient::start() {
+    if (io_->th.joinable()) return ready();
+    if (!parse_ws_url(opt_.private_url, io_->priv.ep) || !parse_ws_url(opt_.trade_url, io_->trade.ep)) {
+        std::cerr << "[WS] bad url: " << opt_.private_url << " / " << opt_.trade_url << "\n";
+        return false;
+    }
+
+    Io& io = *io_;
+    net::post(io.ioc, [&io] {
+        io.open(io.priv);
+        io.open(io.trade);
+        io.arm_ping(io.priv);
+        io.arm_ping(io.trade);
+        io.arm_ack_sweep();
+    });
+    io.th = std::thread([&io] { io.ioc.run(); });
+
+    std::unique_lock<std::mutex> lk(io.mtx);
+    return io.cv.wait_for(lk, std::chrono::milliseconds(opt_.start_timeout_ms),
+                          [&io] { return io.trade_ready.load() && io.priv_ready.load(); });
+}
+
+void BybitTradeWsClient::stop() {
+    Io& io = *io_;
+    if (!io.th.joinable()) return;
+
+    net::post(io.ioc, [&io] {
+        io.stopping = true;
+        for (auto* s : {&io.priv, &io.trade}) {
+            if (s->connecting) s->connecting->cancel();
+            if (s->conn) s->conn->close();
+            s->conn.reset();
+            s->authed = false;
+            s->ping.cancel();
+            s->retry.cancel();
+        }
+        io.ack_sweep.cancel();
+        io.trade_ready.store(false);
+        if (io.priv_ready.exchange(false) && io.priv_down_h) io.priv_down_h();
+        io.fail_pending("ws client stopped");
+        io.work.reset();
+    });
+    io.th.join();
+}
+
+bool BybitTradeWsClient::ready() const {
+    return io_->trade_ready.load();
+}
+
+void BybitTradeWsClient::place_limit_order(
+    const std::string& category,
+    const std::string& symbol,
+    const std::string& side,
+    double qty,
+    double price,
+    const std::string& tif,
+    Callback cb
+) {
+    json a;
+    a["category"] = category;
+    a["symbol"] = symbol;
+    a["side"] = side;
+    a["orderType"] = "Limit";
+    a["qty"] = std::to_string(qty);
+    a["price"] = std::to_string(price);
+    a["timeInForce"] = tif;
+    io_->submit("order.create", std::move(a), std::move(cb));
+}
+
+void BybitTradeWsClient::cancel_order(
+    const std::string& category,
+    const std::string& symbol,
+    const std::string& orderId,
+    Callback cb
+) {
+    json a;
+    a["category"] = category;
+    a["symbol"] = symbol;
+    a["orderId"] = orderId;
+    io_->submit("order.cancel", std::move(a), std::move(cb));
+}
+
+BybitTradeWsClient::Stats BybitTradeWsClient::stats() const {
+    Stats st;
+    st.acks       = io_->acks.load(std::memory_order_relaxed);
+    st.orders     = io_->orders.load(std::memory_order_relaxed);
+    st.executions = io_->executions.load(std::memory_order_relaxed);
+    st.positions  = io_->positions.load(std::memory_order_relaxed);
+    st.reconnects = io_->reconnects.load(std::memory_order_relaxed);
+    st.in_flight  = io_->in_flight.load(std::memory_order_relaxed);
+    return st;
+}
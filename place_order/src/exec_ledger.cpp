@@ -0,0 +1,333 @@
+#include "exec_ledger.hpp"
+
+#include <nlohmann/json.hpp>
+
+#include <fstream>
+#include <iostream>
+
+static void log_sqlite_err(sqlite3* db, const char* what) {
+    std::cerr << "[ExecLedger] " << what << ": " << (db ? sqlite3_errmsg(db) : "no db") << "\n";
+}
+
+static bool exec_sql(sqlite3* db, const char* sql) {
+    char* err = nullptr;
+    if (sqlite3_exec(db, sql, nullptr, nullptr, &err) != SQLITE_OK) {
+        std::cerr << "[ExecLedger] " << (err ? err : "sqlite3_exec failed") << " in: " << sql << "\n";
+        sqlite3_free(err);
+        return false;
+    }
+    return true;
+}
+
+static const char* EXEC_COLUMNS =
+    "category, symbol, exec_id, ts_ms, order_id, side, price, qty, fee, "
+    "fee_currency, exec_type, order_type, seq";
+
+static const char* SCHEMA_SQL =
+    "CREATE TABLE IF NOT EXISTS executions ("
+    "  category     TEXT    NOT NULL,"
+    "  symbol       TEXT    NOT NULL,"
+    "  exec_id      TEXT    NOT NULL,"
+    "  ts_ms        INTEGER NOT NULL,"
+    "  order_id     TEXT,"
+    "  side         TEXT,"
+    "  price        REAL,"
+    "  qty          REAL,"
+    "  fee          REAL,"
+    "  fee_currency TEXT,"
+    "  exec_type    TEXT,"
+    "  order_type   TEXT,"
+    "  seq          INTEGER"
+    ");"
+    "CREATE UNIQUE INDEX IF NOT EXISTS executions_exec_id ON executions(exec_id);"
+    "CREATE INDEX IF NOT EXISTS executions_key_ts ON executions(category, symbol, ts_ms, exec_id);";
+
+// ------------------------------------------------------------
+// JSON -> ExecRecord
+// ------------------------------------------------------------
+static double num_or_zero(const nlohmann::json& j, const char* key) {
+    auto it = j.find(key);
+    if (it == j.end()) return 0.0;
+    try {
+        if (it->is_number()) return it->get<double>();
+        if (it->is_string() && !it->get_ref<const std::string&>().empty())
+            return std::stod(it->get<std::string>());
+    } catch (...) {}
+    return 0.0;
+}
+
+static bool int_field(const nlohmann::json& j, const char* key, std::int64_t& out) {
+    auto it = j.find(key);
+    if (it == j.end()) return false;
+    try {
+        if (it->is_number_integer()) { out = it->get<std::int64_t>(); return true; }
+        if (it->is_number())         { out = static_cast<std::int64_t>(it->get<double>()); return true; }
+        if (it->is_string())         { out = std::stoll(it->get<std::string>()); return true; }
+    } catch (...) {}
+    return false;
+}
+
+bool exec_record_from_json(const nlohmann::json& e, ExecRecord& r) {
+    r = ExecRecord{};
+    r.execId = e.value("execId", "");
+    if (r.execId.empty()) return false;
+    if (!int_field(e, "execTime", r.ts_ms) && !int_field(e, "ts_ms", r.ts_ms)) return false;
+
+    r.category    = e.value("category", "");
+    r.symbol      = e.value("symbol", "");
+    r.orderId     = e.value("orderId", "");
+    r.side        = e.value("side", "");
+    r.price       = num_or_zero(e, "execPrice");
+    r.qty         = num_or_zero(e, "execQty");
+    r.fee         = num_or_zero(e, "execFee");
+    r.feeCurrency = e.value("feeCurrency", "");
+    r.execType    = e.value("execType", "");
+    r.orderType   = e.value("orderType", "");
+    int_field(e, "seq", r.seq);
+    return true;
+}
+
+// ------------------------------------------------------------
+// ExecLedger
+// ------------------------------------------------------------
+ExecLedger::ExecLedger(std::string db_path) : db_path_(std::move(db_path)) {}
+
+ExecLedger::~ExecLedger() {
+    close();
+}
+
+bool ExecLedger::open(const std::string& legacy_jsonl) {
+    std::lock_guard<std::recursive_mutex> lk(mtx_);
+    if (db_) return true;
+
+    if (sqlite3_open(db_path_.c_str(), &db_) != SQLITE_OK) {
+        log_sqlite_err(db_, "sqlite3_open");
+        close();
+        return false;
+    }
+
+    const bool ok =
+        exec_sql(db_, "PRAGMA journal_mode=WAL;") &&
+        exec_sql(db_, "PRAGMA synchronous=NORMAL;") &&
+        exec_sql(db_, "PRAGMA busy_timeout=2000;") &&
+        exec_sql(db_, SCHEMA_SQL);
+    if (!ok) {
+        close();
+        return false;
+    }
+
+    const std::string ins = std::string("INSERT OR IGNORE INTO executions (") + EXEC_COLUMNS +
+                            ") VALUES (?,?,?,?,?,?,?,?,?,?,?,?,?)";
+    if (sqlite3_prepare_v2(db_, ins.c_str(), -1, &stmt_insert_, nullptr) != SQLITE_OK) {
+        log_sqlite_err(db_, "prepare");
+        close();
+        return false;
+    }
+
+    // Opened after the schema exists; in WAL mode its snapshots never block
+    // the writer
+    if (sqlite3_open_v2(db_path_.c_str(), &read_db_, SQLITE_OPEN_READONLY | SQLITE_OPEN_FULLMUTEX,
+                        nullptr) != SQLITE_OK ||
+        !exec_sql(read_db_, "PRAGMA busy_timeout=2000;")) {
+        log_sqlite_err(read_db_, "sqlite3_open_v2(read)");
+        close();
+        return false;
+    }
+
+    if (!legacy_jsonl.empty() && size() == 0) import_jsonl(legacy_jsonl);
+    return true;
+}
+
+void ExecLedger::close() {
+    std::lock_guard<std::recursive_mutex> lk(mtx_);
+    if (stmt_insert_) sqlite3_finalize(stmt_insert_);
+    stmt_insert_ = nullptr;
+    if (read_db_) sqlite3_close_v2(read_db_);   // deferred until live cursors finish
+    read_db_ = nullptr;
+    if (db_) sqlite3_close(db_);
+    db_ = nullptr;
+}
+
+// One transaction for the whole file; duplicates are dropped by the index
+bool ExecLedger::import_jsonl(const std::string& path) {
+    std::ifstream in(path);
+    if (!in.good()) return false;
+
+    if (!exec_sql(db_, "BEGIN")) return false;
+    std::int64_t lines = 0, imported = 0;
+    std::string line;
+    ExecRecord r;
+    while (std::getline(in, line)) {
+        if (line.empty()) continue;
+        ++lines;
+        try {
+            if (exec_record_from_json(nlohmann::json::parse(line), r) && insert(r)) ++imported;
+        } catch (...) {}
+    }
+    if (!exec_sql(db_, "COMMIT")) {
+        exec_sql(db_, "ROLLBACK");
+        return false;
+    }
+    std::cout << "[ExecLedger] imported " << imported << " of " << lines << " lines from " << path
+              << " into " << db_path_ << "\n";
+    return true;
+}
+
+static void bind_text(sqlite3_stmt* st, int i, const std::string& s) {
+    sqlite3_bind_text(st, i, s.data(), static_cast<int>(s.size()), SQLITE_STATIC);
+}
+
+bool ExecLedger::insert(const ExecRecord& r) {
+    if (r.execId.empty()) return false;
+
+    std::lock_guard<std::recursive_mutex> lk(mtx_);
+    if (!db_) return false;
+
+    sqlite3_stmt* st = stmt_insert_;
+    bind_text(st, 1, r.category);
+    bind_text(st, 2, r.symbol);
+    bind_text(st, 3, r.execId);
+    sqlite3_bind_int64(st, 4, r.ts_ms);
+    bind_text(st, 5, r.orderId);
+    bind_text(st, 6, r.side);
+    sqlite3_bind_double(st, 7, r.price);
+    sqlite3_bind_double(st, 8, r.qty);
+    sqlite3_bind_double(st, 9, r.fee);
+    bind_text(st, 10, r.feeCurrency);
+    bind_text(st, 11, r.execType);
+    bind_text(st, 12, r.orderType);
+    sqlite3_bind_int64(st, 13, r.seq);
+
+    const int rc = sqlite3_step(st);
+    sqlite3_reset(st);
+    sqlite3_clear_bindings(st);
+    if (rc != SQLITE_DONE) {
+        log_sqlite_err(db_, "insert");
+        return false;
+    }
+    return sqlite3_changes(db_) == 1;
+}
+
+std::int64_t ExecLedger::last_rowid() {
+    std::lock_guard<std::recursive_mutex> lk(mtx_);
+    if (!db_) return 0;
+
+    // MAX(rowid) is one b-tree descent
+    sqlite3_stmt* st = nullptr;
+    std::int64_t n = 0;
+    if (sqlite3_prepare_v2(db_, "SELECT COALESCE(MAX(rowid), 0) FROM executions", -1, &st, nullptr) == SQLITE_OK &&
+        sqlite3_step(st) == SQLITE_ROW)
+        n = sqlite3_column_int64(st, 0);
+    sqlite3_finalize(st);
+    return n;
+}
+
+ExecLedger::Cursor ExecLedger::range(const std::string& category, const std::string& symbol,
+                                     std::int64_t from_ms, std::int64_t to_ms, bool trades_only) {
+    const std::string sql = std::string("SELECT ") + EXEC_COLUMNS +
+                            ", rowid FROM executions WHERE category = ?1 AND symbol = ?2"
+                            " AND ts_ms BETWEEN ?3 AND ?4" +
+                            (trades_only ? " AND exec_type = 'Trade'" : "") +
+                            " ORDER BY ts_ms, exec_id";
+    return query(sql, category, symbol, from_ms, to_ms);
+}
+
+ExecLedger::Cursor ExecLedger::appended(const std::string& category, const std::string& symbol,
+                                        std::int64_t after_rowid, std::int64_t upto_rowid,
+                                        bool trades_only) {
+    // Unary + keeps the planner off the (category, symbol, ...) index, which
+    // would scan the key's whole history; the rowid range is the cheap side.
+    const std::string sql = std::string("SELECT ") + EXEC_COLUMNS +
+                            ", rowid FROM executions WHERE rowid > ?3 AND rowid <= ?4"
+                            " AND +category = ?1 AND +symbol = ?2" +
+                            (trades_only ? " AND exec_type = 'Trade'" : "") +
+                            " ORDER BY ts_ms, exec_id";
+    return query(sql, category, symbol, after_rowid, upto_rowid);
+}
+
+ExecLedger::Cursor ExecLedger::after(std::int64_t after_rowid) {
+    Cursor c = prepare_cursor(std::string("SELECT ") + EXEC_COLUMNS +
+                              ", rowid FROM executions WHERE rowid > ?1 ORDER BY rowid");
+    if (c.st_) sqlite3_bind_int64(c.st_, 1, after_rowid);
+    return c;
+}
+
+// The ledger lock covers only the handle lookup; the statement runs on
+// read_db_ without it
+ExecLedger::Cursor ExecLedger::prepare_cursor(const std::string& sql) {
+    Cursor c;
+    std::lock_guard<std::recursive_mutex> lk(mtx_);
+    if (!read_db_) return c;
+
+    if (sqlite3_prepare_v2(read_db_, sql.c_str(), -1, &c.st_, nullptr) != SQLITE_OK) {
+        log_sqlite_err(read_db_, "prepare cursor");
+        c.stop();
+    }
+    return c;
+}
+
+ExecLedger::Cursor ExecLedger::query(const std::string& sql, const std::string& category,
+                                     const std::string& symbol, std::int64_t lo, std::int64_t hi) {
+    Cursor c = prepare_cursor(sql);
+    if (!c.st_) return c;
+
+    // SQLITE_TRANSIENT: the cursor outlives the caller's strings
+    sqlite3_bind_text(c.st_, 1, category.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_text(c.st_, 2, symbol.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_int64(c.st_, 3, lo);
+    sqlite3_bind_int64(c.st_, 4, hi);
+    return c;
+}
+
+// ------------------------------------------------------------
+// Cursor
+// ------------------------------------------------------------
+ExecLedger::Cursor::Cursor(Cursor&& o) noexcept : st_(o.st_) {
+    o.st_ = nullptr;
+}
+
+ExecLedger::Cursor& ExecLedger::Cursor::operator=(Cursor&& o) noexcept {
+    if (this != &o) {
+        stop();
+        st_ = o.st_;
+        o.st_ = nullptr;
+    }
+    return *this;
+}
+
+ExecLedger::Cursor::~Cursor() {
+    stop();
+}
+
+void ExecLedger::Cursor::stop() {
+    if (st_) sqlite3_finalize(st_);
+    st_ = nullptr;
+}
+
+static std::string column_text(sqlite3_stmt* st, int i) {
+    const auto* p = sqlite3_column_text(st, i);
+    return p ? std::string(reinterpret_cast<const char*>(p), sqlite3_column_bytes(st, i)) : std::string();
+}
+
+bool ExecLedger::Cursor::next(ExecRecord& r) {
+    if (!st_) return false;
+    if (sqlite3_step(st_) != SQLITE_ROW) {
+        stop();
+        return false;
+    }
+    r.category    = column_text(st_, 0);
+    r.symbol      = column_text(st_, 1);
+    r.execId      = column_text(st_, 2);
+    r.ts_ms       = sqlite3_column_int64(st_, 3);
+    r.orderId     = column_text(st_, 4);
+    r.side        = column_text(st_, 5);
+    r.price       = sqlite3_column_double(st_, 6);
+    r.qty         = sqlite3_column_double(st_, 7);
+    r.fee         = sqlite3_column_double(st_, 8);
+    r.feeCurrency = column_text(st_, 9);
+    r.execType    = column_text(st_, 10);
+    r.orderType   = column_text(st_, 11);
+    r.seq         = sqlite3_column_int64(st_, 12);
+    r.rowid       = sqlite3_column_int64(st_, 13);
+    return true;
+}
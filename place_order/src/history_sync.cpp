@@ -0,0 +1,351 @@
+#include "history_sync.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <thread>
+#include <unordered_set>
+
+static long long wall_ms() {
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
+}
+
+static constexpr long long MAX_WINDOW_MS = 7LL * 24 * 3600 * 1000;   // per request, both endpoints
+
+// ------------------------------------------------------------
+// RateBucket
+// ------------------------------------------------------------
+RateBucket::RateBucket(double rate_per_s, double burst)
+: max_rate_(rate_per_s > 0 ? rate_per_s : 1.0),
+  rate_(max_rate_),
+  burst_(burst >= 1.0 ? burst : 1.0),
+  tokens_(burst_),
+  last_(Clock::now()),
+  blocked_until_(last_) {}
+
+void RateBucket::refill(Clock::time_point now) {
+    const double dt = std::chrono::duration<double>(now - last_).count();
+    tokens_ = std::min(burst_, tokens_ + dt * rate_);
+    last_ = now;
+}
+
+void RateBucket::acquire() {
+    while (true) {
+        Clock::duration wait;
+        {
+            std::lock_guard<std::mutex> lk(mtx_);
+            const auto now = Clock::now();
+            if (now < blocked_until_) {
+                wait = blocked_until_ - now;
+            } else {
+                refill(now);
+                if (tokens_ >= 1.0) {
+                    tokens_ -= 1.0;
+                    return;
+                }
+                wait = std::chrono::duration_cast<Clock::duration>(
+                    std::chrono::duration<double>((1.0 - tokens_) / rate_));
+            }
+        }
+        std::this_thread::sleep_for(wait);
+    }
+}
+
+void RateBucket::observe(const BybitDemoClient::RateLimit& rl) {
+    std::lock_guard<std::mutex> lk(mtx_);
+    refill(Clock::now());
+    if (rl.limit > 0) {
+        rate_ = std::min(max_rate_, static_cast<double>(rl.limit));
+        burst_ = std::min(burst_, static_cast<double>(rl.limit));
+    }
+    if (rl.remaining >= 0) tokens_ = std::min(tokens_, static_cast<double>(rl.remaining));
+    if (rl.remaining == 0 && rl.reset_ms > 0) {
+        const long long dt = std::clamp(rl.reset_ms - wall_ms(), 0LL, 5000LL);
+        blocked_until_ = std::max(blocked_until_, Clock::now() + std::chrono::milliseconds(dt));
+    }
+}
+
+void RateBucket::block_until(long long until_wall_ms) {
+    std::lock_guard<std::mutex> lk(mtx_);
+    const long long dt = std::clamp(until_wall_ms - wall_ms(), 0LL, 5000LL);
+    blocked_until_ = std::max(blocked_until_, Clock::now() + std::chrono::milliseconds(dt));
+    tokens_ = 0.0;
+}
+
+// ------------------------------------------------------------
+// Record helpers
+// ------------------------------------------------------------
+static long long record_ts(const nlohmann::json& e, HistorySync::Kind kind) {
+    const char* field = kind == HistorySync::Kind::EXECUTIONS ? "execTime" : "transactionTime";
+    auto it = e.find(field);
+    if (it == e.end()) return 0;
+    try {
+        if (it->is_string()) return std::stoll(it->get<std::string>());
+        if (it->is_number()) return static_cast<long long>(it->get<double>());
+    } catch (...) {}
+    return 0;
+}
+
+static std::string default_key(const nlohmann::json& e, HistorySync::Kind kind) {
+    if (kind == HistorySync::Kind::EXECUTIONS) return e.value("execId", "");
+    for (const char* k : {"id", "transId", "txnId"}) {
+        auto it = e.find(k);
+        if (it != e.end() && it->is_string()) return it->get<std::string>();
+    }
+    return e.dump();
+}
+
+// ------------------------------------------------------------
+// HistorySync
+// ------------------------------------------------------------
+HistorySync::Options HistorySync::Options::from_env() {
+    Options o;
+    if (const char* v = std::getenv("BYBIT_SYNC_WORKERS"))   o.workers = std::max(1, std::atoi(v));
+    if (const char* v = std::getenv("BYBIT_SYNC_SLICE_MIN")) o.slice_ms = std::atoll(v) * 60 * 1000;
+    if (const char* v = std::getenv("BYBIT_SYNC_RPS"))       o.rps = std::atof(v);
+    if (const char* v = std::getenv("BYBIT_SYNC_OVERLAP_S")) o.overlap_ms = std::atoll(v) * 1000;
+    if (const char* v = std::getenv("BYBIT_SYNC_CURSORS"))   o.cursor_path = v;
+    return o;
+}
+
+HistorySync::HistorySync(BybitDemoClient& client, Options opt)
+: client_(client), opt_(std::move(opt)), bucket_(opt_.rps, opt_.rps) {
+    opt_.slice_ms = std::clamp(opt_.slice_ms, 60LL * 1000, MAX_WINDOW_MS);
+    opt_.workers = std::max(1, opt_.workers);
+    opt_.overlap_ms = std::max(0LL, opt_.overlap_ms);
+}
+
+struct SyncSlice {
+    long long a = 0, b = 0;   // inclusive
+    bool done = false;
+    bool ok = true;
+    std::vector<std::pair<long long, std::string>> order;   // (ts, key) per record
+    std::vector<nlohmann::json> recs;
+    int pages = 0;
+    int retries = 0;
+    std::string error;
+};
+
+HistorySync::Result HistorySync::run(const Query& q, long long from_ms, const Sink& sink, const KeyFn& key,
+                                     const std::function<void(long long)>& progress) {
+    Result res;
+    res.from_ms = from_ms;
+    res.covered_to = from_ms - 1;
+
+    std::vector<SyncSlice> slices;
+    for (long long a = from_ms; a <= q.end_ms; a += opt_.slice_ms) {
+        SyncSlice s;
+        s.a = a;
+        s.b = std::min(q.end_ms, a + opt_.slice_ms - 1);
+        slices.push_back(std::move(s));
+    }
+    res.slices = static_cast<int>(slices.size());
+    if (slices.empty()) return res;
+
+    auto key_of = [&](const nlohmann::json& e) { return key ? key(e) : default_key(e, q.kind); };
+
+    // One slice, page by page; the cursor makes pages of a slice sequential
+    auto fetch_slice = [&](SyncSlice& s) {
+        std::string cursor;
+        int transport_failures = 0;
+        int limited = 0;
+        while (true) {
+            bucket_.acquire();
+            BybitDemoClient::RateLimit rl;
+            const std::string resp = q.kind == Kind::EXECUTIONS
+                ? client_.get_executions(q.category, q.symbol, s.a, s.b, cursor, &rl)
+                : client_.get_transaction_log(q.category, q.symbol, s.a, s.b, cursor, "SETTLEMENT", &rl);
+            bucket_.observe(rl);
+
+            nlohmann::json j;
+            try {
+                j = nlohmann::json::parse(resp);
+            } catch (...) {}
+
+            // curl / HTTP failure (including a 403 / 429 from the gateway): back off, retry
+            if (!j.is_object() || j.contains("error") || !j.contains("retCode")) {
+                if (++transport_failures > 3) {
+                    s.ok = false;
+                    s.error = resp;
+                    return;
+                }
+                s.retries++;
+                std::this_thread::sleep_for(std::chrono::milliseconds(200 * transport_failures));
+                continue;
+            }
+
+            const int code = j["retCode"].is_number() ? j["retCode"].get<int>() : -1;
+            if (code == 10006) {   // too many visits: wait for the window, same page again
+                if (++limited > 20) {
+                    s.ok = false;
+                    s.error = resp;
+                    return;
+                }
+                s.retries++;
+                bucket_.block_until(rl.reset_ms > 0 ? rl.reset_ms : wall_ms() + 1000);
+                continue;
+            }
+            if (code != 0) {
+                s.ok = false;
+                s.error = resp;
+                return;
+            }
+
+            s.pages++;
+            auto& result = j["result"];
+            if (result.is_object() && result.contains("list") && result["list"].is_array()) {
+                for (auto& e : result["list"]) {
+                    s.order.emplace_back(record_ts(e, q.kind), key_of(e));
+                    s.recs.push_back(std::move(e));
+                }
+            }
+
+            cursor.clear();
+            if (result.is_object() && result.contains("nextPageCursor") && result["nextPageCursor"].is_string())
+                cursor = result["nextPageCursor"].get<std::string>();
+            if (cursor.empty()) return;
+        }
+    };
+
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::atomic<std::size_t> next{0};
+    std::atomic<bool> abort{false};
+
+    const int n_workers = std::min<int>(opt_.workers, static_cast<int>(slices.size()));
+    std::vector<std::thread> workers;
+    workers.reserve(static_cast<std::size_t>(n_workers));
+    for (int w = 0; w < n_workers; ++w) {
+        workers.emplace_back([&] {
+            while (!abort.load(std::memory_order_relaxed)) {
+                const std::size_t i = next.fetch_add(1);
+                if (i >= slices.size()) break;
+                fetch_slice(slices[i]);
+                std::lock_guard<std::mutex> lk(mtx);
+                slices[i].done = true;
+                cv.notify_all();
+            }
+        });
+    }
+
+    // Deliver in slice order as soon as a prefix is complete. Duplicates only
+    // straddle a boundary, so the previous slice's keys are enough.
+    std::unordered_set<std::string> prev_keys, cur_keys;
+    std::vector<std::size_t> idx;
+    for (auto& s : slices) {
+        {
+            std::unique_lock<std::mutex> lk(mtx);
+            cv.wait(lk, [&] { return s.done; });
+        }
+        res.pages += s.pages;
+        res.retries += s.retries;
+        res.fetched += static_cast<long long>(s.recs.size());
+        if (!s.ok) {
+            res.complete = false;
+            res.error = s.error;
+            abort = true;
+            break;
+        }
+
+        idx.resize(s.recs.size());
+        for (std::size_t i = 0; i < idx.size(); ++i) idx[i] = i;
+        std::sort(idx.begin(), idx.end(), [&](std::size_t x, std::size_t y) { return s.order[x] < s.order[y]; });
+
+        cur_keys.clear();
+        for (std::size_t i : idx) {
+            const std::string& k = s.order[i].second;
+            if (k.empty() || prev_keys.count(k) || !cur_keys.insert(k).second) continue;
+            sink(s.recs[i]);
+            res.delivered++;
+        }
+        prev_keys.swap(cur_keys);
+
+        res.covered_to = s.b;
+        if (progress) progress(s.b);
+
+        s.recs.clear();
+        s.recs.shrink_to_fit();
+        s.order.clear();
+        s.order.shrink_to_fit();
+    }
+
+    for (auto& t : workers) t.join();
+    return res;
+}
+
+HistorySync::Result HistorySync::fetch(const Query& q, const Sink& sink, const KeyFn& key) {
+    return run(q, q.start_ms, sink, key, nullptr);
+}
+
+std::string HistorySync::cursor_key(const Query& q) {
+    return std::string(q.kind == Kind::EXECUTIONS ? "exec" : "fund") + "|" + q.category + "|" + q.symbol;
+}
+
+HistorySync::Result HistorySync::sync(const Query& q, const Sink& sink, const KeyFn& key) {
+    const std::string ck = cursor_key(q);
+    Range r;
+    {
+        std::lock_guard<std::mutex> lk(cursors_mtx_);
+        load_cursors();
+        auto it = cursors_.find(ck);
+        if (it != cursors_.end()) r = it->second;
+    }
+
+    // Start past what is already synced if the request begins inside it
+    long long from = q.start_ms;
+    if (r.hi >= r.lo && q.start_ms >= r.lo && q.start_ms <= r.hi)
+        from = std::max(q.start_ms, std::min(r.hi, q.end_ms) - opt_.overlap_ms);
+
+    auto progress = [&](long long covered_to) {
+        std::lock_guard<std::mutex> lk(cursors_mtx_);
+        Range& cur = cursors_[ck];
+        if (cur.hi >= cur.lo && from <= cur.hi + 1 && covered_to >= cur.lo - 1) {
+            cur.lo = std::min(cur.lo, from);
+            cur.hi = std::max(cur.hi, covered_to);
+        } else {
+            cur = Range{from, covered_to};
+        }
+        save_cursors();
+    };
+
+    return run(q, from, sink, key, progress);
+}
+
+// {"exec|linear|BTCUSDT": {"lo": ms, "hi": ms}, ...}
+void HistorySync::load_cursors() {
+    if (cursors_loaded_) return;
+    cursors_loaded_ = true;
+
+    std::ifstream in(opt_.cursor_path);
+    if (!in.good()) return;
+    try {
+        const auto j = nlohmann::json::parse(in);
+        for (auto it = j.begin(); it != j.end(); ++it) {
+            Range r;
+            r.lo = it.value().value("lo", 0LL);
+            r.hi = it.value().value("hi", -1LL);
+            cursors_[it.key()] = r;
+        }
+    } catch (...) {
+        std::cerr << "[HistorySync] ignoring unreadable " << opt_.cursor_path << "\n";
+    }
+}
+
+// Write-then-rename, so a crash leaves the old file or the new one
+void HistorySync::save_cursors() {
+    nlohmann::json j = nlohmann::json::object();
+    for (const auto& [k, r] : cursors_) j[k] = {{"lo", r.lo}, {"hi", r.hi}};
+
+    const std::string tmp = opt_.cursor_path + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::trunc);
+        if (!out.good()) return;
+        out << j.dump() << "\n";
+    }
+    std::rename(tmp.c_str(), opt_.cursor_path.c_str());
+}
@@ -0,0 +1,270 @@
+#include "lot_book.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+// ------------------------------------------------------------
+// LotBook
+// ------------------------------------------------------------
+void LotBook::apply(const ExecRecord& fill, const OnClose& on_close) {
+    const double px = fill.price;
+    double qty = fill.qty;
+    const double fee_total = fill.fee; // fee for THIS fill
+
+    if (qty <= 0.0 || px <= 0.0) return;
+
+    const std::string& side = fill.side;
+    const bool isBuy  = (side == "Buy"  || side == "BUY"  || side == "buy");
+    const bool isSell = (side == "Sell" || side == "SELL" || side == "sell");
+    if (!isBuy && !isSell) return;
+
+    const double fill_qty_total = qty; // keep original for fee splitting
+
+    auto close_against = [&](std::deque<Lot>& lots, LotSide against_side) {
+        while (!lots.empty() && qty > 0.0) {
+            Lot& lot = lots.front();
+            const double close_qty = std::min(qty, lot.qty);
+
+            const double gross = (against_side == LotSide::LONG)
+                ? (px - lot.px) * close_qty    // sell closes long
+                : (lot.px - px) * close_qty;   // buy closes short
+
+            const double fee_close_alloc = (fee_total != 0.0 && fill_qty_total > 0.0)
+                ? fee_total * (close_qty / fill_qty_total) : 0.0;
+            const double fee_open_alloc = (lot.fee_rem != 0.0 && lot.qty > 0.0)
+                ? lot.fee_rem * (close_qty / lot.qty) : 0.0;
+
+            if (on_close) {
+                on_close(fill, LotClose{against_side, &lot, close_qty, gross, fee_close_alloc,
+                                        fee_open_alloc, gross - fee_close_alloc - fee_open_alloc});
+            }
+
+            lot.fee_rem -= fee_open_alloc;
+            lot.qty     -= close_qty;
+            qty         -= close_qty;
+
+            if (lot.qty <= 1e-12) lots.pop_front();
+        }
+    };
+
+    auto open_rest = [&](std::deque<Lot>& lots, LotSide lot_side) {
+        if (qty <= 1e-12) return;
+        Lot l;
+        l.side = lot_side;
+        l.qty = qty;
+        l.px = px;
+        l.execId = fill.execId;
+        l.ts_ms = fill.ts_ms;
+        l.fee_rem = (fee_total != 0.0 && fill_qty_total > 0.0) ? (fee_total * (qty / fill_qty_total)) : 0.0;
+        lots.push_back(std::move(l));
+    };
+
+    if (isBuy) {
+        close_against(shorts, LotSide::SHORT);   // Buy closes shorts first
+        open_rest(longs, LotSide::LONG);
+    } else {
+        close_against(longs, LotSide::LONG);     // Sell closes longs first
+        open_rest(shorts, LotSide::SHORT);
+    }
+}
+
+bool LotBook::after_checkpoint(const ExecRecord& fill) const {
+    if (fills == 0) return true;
+    if (fill.ts_ms != last_ts_ms) return fill.ts_ms > last_ts_ms;
+    return fill.execId > last_exec_id;
+}
+
+void LotBook::clear() {
+    longs.clear();
+    shorts.clear();
+    last_rowid = 0;
+    last_ts_ms = 0;
+    last_exec_id.clear();
+    fills = 0;
+}
+
+// ------------------------------------------------------------
+// LotBookStore
+// ------------------------------------------------------------
+static bool exec_sql(sqlite3* db, const char* sql) {
+    char* err = nullptr;
+    if (sqlite3_exec(db, sql, nullptr, nullptr, &err) != SQLITE_OK) {
+        std::cerr << "[LotBookStore] " << (err ? err : "sqlite3_exec failed") << " in: " << sql << "\n";
+        sqlite3_free(err);
+        return false;
+    }
+    return true;
+}
+
+static const char* LOT_SCHEMA_SQL =
+    "CREATE TABLE IF NOT EXISTS lot_checkpoints ("
+    "  category     TEXT    NOT NULL,"
+    "  symbol       TEXT    NOT NULL,"
+    "  last_rowid   INTEGER NOT NULL,"
+    "  last_ts_ms   INTEGER NOT NULL,"
+    "  last_exec_id TEXT    NOT NULL,"
+    "  fills        INTEGER NOT NULL,"
+    "  PRIMARY KEY (category, symbol)"
+    ");"
+    "CREATE TABLE IF NOT EXISTS lot_open ("
+    "  category TEXT    NOT NULL,"
+    "  symbol   TEXT    NOT NULL,"
+    "  side     INTEGER NOT NULL,"   // 0 long, 1 short
+    "  pos      INTEGER NOT NULL,"   // FIFO position within the side
+    "  qty      REAL    NOT NULL,"
+    "  px       REAL    NOT NULL,"
+    "  exec_id  TEXT    NOT NULL,"
+    "  ts_ms    INTEGER NOT NULL,"
+    "  fee_rem  REAL    NOT NULL,"
+    "  PRIMARY KEY (category, symbol, side, pos)"
+    ");";
+
+static void bind_key(sqlite3_stmt* st, const std::string& category, const std::string& symbol) {
+    sqlite3_bind_text(st, 1, category.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_text(st, 2, symbol.c_str(), -1, SQLITE_STATIC);
+}
+
+LotBookStore::LotBookStore(std::string db_path) : db_path_(std::move(db_path)) {}
+
+LotBookStore::~LotBookStore() {
+    close();
+}
+
+bool LotBookStore::open() {
+    std::lock_guard<std::mutex> lk(mtx_);
+    if (db_) return true;
+
+    if (sqlite3_open(db_path_.c_str(), &db_) != SQLITE_OK) {
+        std::cerr << "[LotBookStore] sqlite3_open: " << sqlite3_errmsg(db_) << "\n";
+        sqlite3_close(db_);
+        db_ = nullptr;
+        return false;
+    }
+
+    const bool ok =
+        exec_sql(db_, "PRAGMA journal_mode=WAL;") &&
+        exec_sql(db_, "PRAGMA synchronous=NORMAL;") &&
+        exec_sql(db_, "PRAGMA busy_timeout=2000;") &&
+        exec_sql(db_, LOT_SCHEMA_SQL);
+    if (!ok) {
+        sqlite3_close(db_);
+        db_ = nullptr;
+    }
+    return ok;
+}
+
+void LotBookStore::close() {
+    std::lock_guard<std::mutex> lk(mtx_);
+    if (db_) sqlite3_close(db_);
+    db_ = nullptr;
+}
+
+bool LotBookStore::load(const std::string& category, const std::string& symbol, LotBook& book) {
+    std::lock_guard<std::mutex> lk(mtx_);
+    book.clear();
+    if (!db_) return false;
+
+    sqlite3_stmt* st = nullptr;
+    bool found = false;
+    if (sqlite3_prepare_v2(db_,
+                           "SELECT last_rowid, last_ts_ms, last_exec_id, fills FROM lot_checkpoints "
+                           "WHERE category = ?1 AND symbol = ?2",
+                           -1, &st, nullptr) == SQLITE_OK) {
+        bind_key(st, category, symbol);
+        if (sqlite3_step(st) == SQLITE_ROW) {
+            book.last_rowid = sqlite3_column_int64(st, 0);
+            book.last_ts_ms = sqlite3_column_int64(st, 1);
+            const auto* id = sqlite3_column_text(st, 2);
+            book.last_exec_id = id ? reinterpret_cast<const char*>(id) : "";
+            book.fills = sqlite3_column_int64(st, 3);
+            found = true;
+        }
+    }
+    sqlite3_finalize(st);
+    if (!found) return false;
+
+    st = nullptr;
+    if (sqlite3_prepare_v2(db_,
+                           "SELECT side, qty, px, exec_id, ts_ms, fee_rem FROM lot_open "
+                           "WHERE category = ?1 AND symbol = ?2 ORDER BY side, pos",
+                           -1, &st, nullptr) == SQLITE_OK) {
+        bind_key(st, category, symbol);
+        while (sqlite3_step(st) == SQLITE_ROW) {
+            Lot l;
+            l.side = sqlite3_column_int(st, 0) == 0 ? LotSide::LONG : LotSide::SHORT;
+            l.qty = sqlite3_column_double(st, 1);
+            l.px = sqlite3_column_double(st, 2);
+            const auto* id = sqlite3_column_text(st, 3);
+            l.execId = id ? reinterpret_cast<const char*>(id) : "";
+            l.ts_ms = sqlite3_column_int64(st, 4);
+            l.fee_rem = sqlite3_column_double(st, 5);
+            (l.side == LotSide::LONG ? book.longs : book.shorts).push_back(std::move(l));
+        }
+    }
+    sqlite3_finalize(st);
+    return true;
+}
+
+bool LotBookStore::save(const std::string& category, const std::string& symbol, const LotBook& book) {
+    std::lock_guard<std::mutex> lk(mtx_);
+    if (!db_) return false;
+    if (!exec_sql(db_, "BEGIN")) return false;
+
+    sqlite3_stmt* del = nullptr;
+    sqlite3_stmt* ins = nullptr;
+    sqlite3_stmt* cp = nullptr;
+    bool ok =
+        sqlite3_prepare_v2(db_, "DELETE FROM lot_open WHERE category = ?1 AND symbol = ?2",
+                           -1, &del, nullptr) == SQLITE_OK &&
+        sqlite3_prepare_v2(db_,
+                           "INSERT INTO lot_open (category, symbol, side, pos, qty, px, exec_id, ts_ms, fee_rem) "
+                           "VALUES (?1, ?2, ?3, ?4, ?5, ?6, ?7, ?8, ?9)",
+                           -1, &ins, nullptr) == SQLITE_OK &&
+        sqlite3_prepare_v2(db_,
+                           "INSERT OR REPLACE INTO lot_checkpoints "
+                           "(category, symbol, last_rowid, last_ts_ms, last_exec_id, fills) "
+                           "VALUES (?1, ?2, ?3, ?4, ?5, ?6)",
+                           -1, &cp, nullptr) == SQLITE_OK;
+
+    if (ok) {
+        bind_key(del, category, symbol);
+        ok = sqlite3_step(del) == SQLITE_DONE;
+    }
+
+    auto put_side = [&](const std::deque<Lot>& lots, int side) {
+        std::int64_t pos = 0;
+        for (const Lot& l : lots) {
+            if (!ok) return;
+            sqlite3_reset(ins);
+            bind_key(ins, category, symbol);
+            sqlite3_bind_int(ins, 3, side);
+            sqlite3_bind_int64(ins, 4, pos++);
+            sqlite3_bind_double(ins, 5, l.qty);
+            sqlite3_bind_double(ins, 6, l.px);
+            sqlite3_bind_text(ins, 7, l.execId.c_str(), -1, SQLITE_STATIC);
+            sqlite3_bind_int64(ins, 8, l.ts_ms);
+            sqlite3_bind_double(ins, 9, l.fee_rem);
+            ok = sqlite3_step(ins) == SQLITE_DONE;
+        }
+    };
+    put_side(book.longs, 0);
+    put_side(book.shorts, 1);
+
+    if (ok) {
+        bind_key(cp, category, symbol);
+        sqlite3_bind_int64(cp, 3, book.last_rowid);
+        sqlite3_bind_int64(cp, 4, book.last_ts_ms);
+        sqlite3_bind_text(cp, 5, book.last_exec_id.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_int64(cp, 6, book.fills);
+        ok = sqlite3_step(cp) == SQLITE_DONE;
+    }
+
+    if (!ok) std::cerr << "[LotBookStore] save " << category << " " << symbol << ": " << sqlite3_errmsg(db_) << "\n";
+
+    sqlite3_finalize(del);
+    sqlite3_finalize(ins);
+    sqlite3_finalize(cp);
+
+    exec_sql(db_, ok ? "COMMIT" : "ROLLBACK");
+    return ok;
+}
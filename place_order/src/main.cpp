@@ -6,6 +6,7 @@
 
 #include <iostream>
 #include <string>
+#include <string_view>
 #include <thread>
 #include <atomic>
 #include <cstdlib>
@@ -18,13 +19,43 @@
 #include <unordered_set>
 #include <algorithm>
 #include <cmath>
+#include <filesystem>
+#include <sstream>
 
 #include <zmq.hpp>
 #include <nlohmann/json.hpp>
 
 #include "bybit_demo_client.hpp"
+#include "bybit_trade_ws_client.hpp"
+#include "exec_ledger.hpp"
+#include "history_sync.hpp"
+#include "lot_book.hpp"
+#include "pre_trade_risk.hpp"
+#include "top_of_book_cache.hpp"
+#include "window_sums.hpp"
+#include "latency_trace.hpp"
+
+// ---- Console output ----
+// The command loop, the websocket io thread and the REST gateway (order /
+// cancel acks) all print; each line is built first and written whole under
+// one lock so they never interleave mid-line.
+static std::mutex g_out_mtx;
+
+struct OutLine {
+    std::ostringstream s;
+
+    template <class T>
+    OutLine& operator<<(const T& v) {
+        s << v;
+        return *this;
+    }
+    ~OutLine() {
+        std::lock_guard<std::mutex> lk(g_out_mtx);
+        std::cout << s.str() << std::flush;
+    }
+};
 
-static const char* LEDGER_PATH       = "executions_ledger.jsonl";
+static const char* LEDGER_PATH       = "executions_ledger.jsonl";   // legacy, imported once
 static const char* FUND_LEDGER_PATH  = "funding_ledger.jsonl";
 static const char* TRADE_LEDGER_PATH = "trades_ledger.jsonl";
 
@@ -79,22 +110,6 @@ static bool extract_ts_ms_any(const nlohmann::json& j, long long& ts_out) {
     return false;
 }
 
-static double get_num_field(const nlohmann::json& j, const char* key) {
-    if (!j.contains(key)) return 0.0;
-    return get_num_safe(j.at(key));
-}
-
-enum class LotSide { LONG, SHORT };
-
-struct Lot {
-    LotSide side;
-    double qty;          // remaining qty
-    double px;           // entry price
-    std::string execId;  // opening execId
-    long long ts_ms;     // opening time
-    double fee_rem;      // remaining OPEN fee to allocate when this lot is closed
-};
-
 static std::string lot_side_str(LotSide s) {
     return (s == LotSide::LONG) ? "LONG" : "SHORT";
 }
@@ -117,255 +132,221 @@ static bool append_trade_event(const nlohmann::json& ev) {
     return true;
 }
 
-// Read executions ledger lines for a symbol+category, sorted by ts_ms then execId
-static std::vector<nlohmann::json> load_execs_from_ledger(const std::string& category,
-                                                         const std::string& symbol) {
-    std::vector<nlohmann::json> out;
-    std::ifstream in(LEDGER_PATH);
-    if (!in.good()) return out;
+// ------------------------ Execution ledger (shared) ------------------------
+// SQLite, indexed by execId and (category, symbol, ts_ms); see exec_ledger.hpp
+static ExecLedger g_exec_ledger("executions_ledger.db");
+
+// ------------------------ FIFO lot books (incremental) ------------------------
+// One LotBook per (category, symbol), loaded from g_lot_store on first use
+// and checkpointed after every sync. Command-loop thread only.
+static LotBookStore g_lot_store("executions_ledger.db");
+static std::unordered_map<std::string, LotBook> g_lot_books;
+
+struct LotSyncStats {
+    long long applied = 0;
+    bool rebuilt = false;
+    long long closed_events = 0;
+    double gross_realized_sum = 0.0;
+    double net_realized_sum = 0.0;
+};
 
-    std::string line;
-    while (std::getline(in, line)) {
-        if (line.empty()) continue;
-        try {
-            auto j = nlohmann::json::parse(line);
-            if (!j.contains("symbol") || !j["symbol"].is_string()) continue;
-            if (j["symbol"].get<std::string>() != symbol) continue;
-
-            if (j.contains("category") && j["category"].is_string()) {
-                if (j["category"].get<std::string>() != category) continue;
-            } else continue;
-
-            if (!j.contains("execId") || !j["execId"].is_string()) continue;
-            if (!j.contains("side")) continue;
-            if (!j.contains("execQty")) continue;
-            if (!j.contains("execPrice")) continue;
-			// IMPORTANT: only real trade fills
-			if (j.contains("execType") && j["execType"].is_string()) {
-				if (j["execType"].get<std::string>() != "Trade") continue;
-			} else {
-				continue;
-			}
-            long long ts=0;
-            if (!extract_ts_ms_any(j, ts)) continue;
-
-            out.push_back(j);
-        } catch (...) {}
+// Trade event for one FIFO close (both open and close fee allocated)
+static void emit_trade_close(const std::string& category,
+                             const std::string& symbol,
+                             const ExecRecord& fill,
+                             const LotClose& c,
+                             LotSyncStats& st) {
+    nlohmann::json ev;
+    ev["ts_ms"] = fill.ts_ms;
+    ev["category"] = category;
+    ev["symbol"] = symbol;
+
+    ev["close_execId"] = fill.execId;
+    ev["open_execId"]  = c.open->execId;
+    ev["side_closed"]  = lot_side_str(c.side_closed);
+
+    ev["qty"] = c.qty;
+    ev["open_price"] = c.open->px;
+    ev["close_price"] = fill.price;
+
+    ev["gross_realized"] = c.gross;
+    ev["fee_close_alloc"] = c.fee_close_alloc;
+    ev["fee_open_alloc"]  = c.fee_open_alloc;
+    ev["net_realized"] = c.net;
+
+    ev["tradeId"] = make_trade_id(fill.execId, c.open->execId, symbol, c.qty, c.open->px, fill.price, fill.ts_ms);
+
+    if (append_trade_event(ev)) {
+        st.closed_events++;
+        st.gross_realized_sum += c.gross;
+        st.net_realized_sum   += c.net;
     }
-
-    std::sort(out.begin(), out.end(), [](const nlohmann::json& a, const nlohmann::json& b){
-        long long ta=0, tb=0;
-        extract_ts_ms_any(a, ta);
-        extract_ts_ms_any(b, tb);
-        if (ta != tb) return ta < tb;
-        return a.value("execId", "") < b.value("execId", "");
-    });
-
-    return out;
 }
 
-// FIFO matching. Generates trade events on closes.
-// Allocates BOTH close fee (from close fill) and open fee (stored in lot.fee_rem)
-static void process_fill_and_emit_trades(const std::string& category,
-                                        const std::string& symbol,
-                                        const nlohmann::json& fill,
-                                        std::vector<Lot>& lots,
-                                        long long& closed_events,
-                                        double& gross_realized_sum,
-                                        double& net_realized_sum) {
-    const std::string execId = fill.value("execId", "");
-    long long ts=0; extract_ts_ms_any(fill, ts);
-
-    const std::string side = fill.value("side", "");
-    const double px  = get_num_field(fill, "execPrice");
-    double qty       = get_num_field(fill, "execQty");
-    const double fee_total = get_num_field(fill, "execFee"); // fee for THIS fill
-
-    if (qty <= 0.0 || px <= 0.0) return;
-
-    const bool isBuy  = (side == "Buy"  || side == "BUY"  || side == "buy");
-    const bool isSell = (side == "Sell" || side == "SELL" || side == "sell");
-    if (!isBuy && !isSell) return;
-
-    const double fill_qty_total = qty; // keep original for fee splitting
-
-    auto close_against = [&](LotSide against_side) {
-        for (size_t i = 0; i < lots.size() && qty > 0.0; ) {
-            if (lots[i].side != against_side) { i++; continue; }
-
-            const double close_qty = std::min(qty, lots[i].qty);
-            if (close_qty <= 0.0) { i++; continue; }
-
-            const double open_px  = lots[i].px;
-            const double close_px = px;
-
-            double gross = 0.0;
-            if (against_side == LotSide::LONG) {
-                gross = (close_px - open_px) * close_qty;   // sell closes long
-            } else {
-                gross = (open_px - close_px) * close_qty;   // buy closes short
-            }
-
-            // CLOSE fee allocation from this fill
-            double fee_close_alloc = 0.0;
-            if (fee_total != 0.0 && fill_qty_total > 0.0) {
-                fee_close_alloc = fee_total * (close_qty / fill_qty_total);
-            }
-
-            // OPEN fee allocation from the lot
-            double fee_open_alloc = 0.0;
-            if (lots[i].fee_rem != 0.0 && lots[i].qty > 0.0) {
-                fee_open_alloc = lots[i].fee_rem * (close_qty / lots[i].qty);
-            }
-
-            const double net = gross - fee_close_alloc - fee_open_alloc;
-
-            nlohmann::json ev;
-            ev["ts_ms"] = ts;
-            ev["category"] = category;
-            ev["symbol"] = symbol;
-
-            ev["close_execId"] = execId;
-            ev["open_execId"]  = lots[i].execId;
-            ev["side_closed"]  = lot_side_str(against_side);
-
-            ev["qty"] = close_qty;
-            ev["open_price"] = open_px;
-            ev["close_price"] = close_px;
-
-            ev["gross_realized"] = gross;
-            ev["fee_close_alloc"] = fee_close_alloc;
-            ev["fee_open_alloc"]  = fee_open_alloc;
-            ev["net_realized"] = net;
-
-            ev["tradeId"] = make_trade_id(execId, lots[i].execId, symbol, close_qty, open_px, close_px, ts);
-
-            if (append_trade_event(ev)) {
-                closed_events++;
-                gross_realized_sum += gross;
-                net_realized_sum   += net;
-            }
+// Applies the trade fills appended to the execution ledger since the book's
+// checkpoint. A backfilled fill that sorts before the checkpoint (sync_exec
+// filling an older gap) invalidates the FIFO order, so the book is rebuilt
+// from the whole history; tradeId dedupe keeps the trade ledger clean.
+static LotBook& sync_lot_book(const std::string& category,
+                              const std::string& symbol,
+                              LotSyncStats& st) {
+    auto it = g_lot_books.find(category + "|" + symbol);
+    if (it == g_lot_books.end()) {
+        it = g_lot_books.emplace(category + "|" + symbol, LotBook{}).first;
+        g_lot_store.load(category, symbol, it->second);
+    }
+    LotBook& book = it->second;
 
-            lots[i].fee_rem -= fee_open_alloc;
-            lots[i].qty     -= close_qty;
-            qty             -= close_qty;
+    const std::int64_t upto = g_exec_ledger.last_rowid();
+    const auto on_close = [&](const ExecRecord& fill, const LotClose& c) {
+        emit_trade_close(category, symbol, fill, c, st);
+    };
 
-            if (lots[i].qty <= 1e-12) {
-                lots.erase(lots.begin() + (long long)i);
-            } else {
-                i++;
-            }
+    // false if the first appended fill is not after the checkpoint; rows come
+    // in (ts_ms, execId) order, so that is the only one that can be
+    auto apply_appended = [&](std::int64_t after_rowid) {
+        auto cur = g_exec_ledger.appended(category, symbol, after_rowid, upto, /*trades_only=*/true);
+        ExecRecord r;
+        while (cur.next(r)) {
+            if (!book.after_checkpoint(r)) return false;
+            book.apply(r, on_close);
+            book.last_ts_ms = r.ts_ms;
+            book.last_exec_id = r.execId;
+            book.fills++;
+            st.applied++;
         }
+        return true;
     };
 
-    if (isBuy) {
-        close_against(LotSide::SHORT);   // Buy closes shorts first
-        if (qty > 1e-12) {
-            Lot l;
-            l.side = LotSide::LONG;
-            l.qty = qty;
-            l.px = px;
-            l.execId = execId;
-            l.ts_ms = ts;
-            l.fee_rem = (fee_total != 0.0 && fill_qty_total > 0.0) ? (fee_total * (qty / fill_qty_total)) : 0.0;
-            lots.push_back(l);
-        }
-    } else {
-        close_against(LotSide::LONG);    // Sell closes longs first
-        if (qty > 1e-12) {
-            Lot l;
-            l.side = LotSide::SHORT;
-            l.qty = qty;
-            l.px = px;
-            l.execId = execId;
-            l.ts_ms = ts;
-            l.fee_rem = (fee_total != 0.0 && fill_qty_total > 0.0) ? (fee_total * (qty / fill_qty_total)) : 0.0;
-            lots.push_back(l);
-        }
+    if (book.last_rowid > upto || !apply_appended(book.last_rowid)) {
+        book.clear();
+        st.rebuilt = true;
+        apply_appended(0);
+    }
+
+    if (book.last_rowid != upto) {
+        book.last_rowid = upto;
+        g_lot_store.save(category, symbol, book);
     }
+    return book;
 }
 
-// Sum realized pnl from trades ledger in a time window
-static nlohmann::json sum_realized_from_trade_ledger(const std::string& symbol, long long start_ms, long long end_ms) {
-    std::ifstream in(TRADE_LEDGER_PATH);
-    double gross = 0.0;
-    double net = 0.0;
-    long long count = 0;
-    long long scanned = 0;
-
-    if (!in.good()) {
-        nlohmann::json err;
-        err["error"] = "cannot_open_ledger";
-        err["ledger_path"] = TRADE_LEDGER_PATH;
-        return err;
+// ------------------------ Windowed sums (prefix-sum indexes) ------------------------
+// One WindowSums per ledger, persisted as <ledger>.idx. Each query first
+// catches up with whatever was appended since the index mark (byte offset
+// of a JSONL ledger, rowid of the execution ledger), then answers with two
+// binary searches.
+static WindowSums g_trade_sums(std::string(TRADE_LEDGER_PATH) + ".idx");   // gross, net
+static WindowSums g_fund_sums(std::string(FUND_LEDGER_PATH) + ".idx");     // funding
+static WindowSums g_fee_sums("executions_ledger.db.fees.idx");             // execFee
+
+// extract: ledger line -> (symbol, ts_ms, values); false skips the line
+template <typename Extract>
+static bool catch_up_jsonl_sums(WindowSums& ws, const char* path, Extract extract) {
+    std::error_code ec;
+    const std::uint64_t size = std::filesystem::file_size(path, ec);
+    if (ec) return false;
+    if (size < ws.mark()) {
+        OutLine() << "[ledger] " << path << " shrank below its index; rebuilding " << ws.path() << "\n";
+        ws.reset();
     }
+    if (size == ws.mark()) return true;
+
+    std::ifstream in(path, std::ios::binary);
+    if (!in.good()) return false;
+    in.seekg((std::streamoff)ws.mark());
 
     std::string line;
+    std::string symbol;
+    long long ts = 0;
+    WindowSums::Values v{};
     while (std::getline(in, line)) {
-        if (line.empty()) continue;
-        scanned++;
-        try {
-            auto j = nlohmann::json::parse(line);
+        if (in.eof()) break;   // partial line still being written
+        const std::uint64_t pos = (std::uint64_t)in.tellg();
+        bool ok = false;
+        if (!line.empty()) {
+            try {
+                v = {};
+                ok = extract(nlohmann::json::parse(line), symbol, ts, v);
+            } catch (...) {}
+        }
+        if (ok) ws.add(symbol, ts, v, pos);
+        else    ws.advance(pos);
+    }
+    ws.flush();
+    return true;
+}
 
-            if (!j.contains("symbol") || !j["symbol"].is_string()) continue;
-            if (j["symbol"].get<std::string>() != symbol) continue;
+static bool catch_up_trade_sums() {
+    return catch_up_jsonl_sums(g_trade_sums, TRADE_LEDGER_PATH,
+        [](const nlohmann::json& j, std::string& symbol, long long& ts, WindowSums::Values& v) {
+            if (!j.contains("symbol") || !j["symbol"].is_string()) return false;
+            if (!extract_ts_ms_any(j, ts)) return false;
+            symbol = j["symbol"].get<std::string>();
+            v[0] = j.value("gross_realized", 0.0);
+            v[1] = j.value("net_realized", 0.0);
+            return true;
+        });
+}
 
-            long long ts=0;
-            if (!extract_ts_ms_any(j, ts)) continue;
-            if (ts < start_ms || ts > end_ms) continue;
+static bool catch_up_fund_sums() {
+    return catch_up_jsonl_sums(g_fund_sums, FUND_LEDGER_PATH,
+        [](const nlohmann::json& j, std::string& symbol, long long& ts, WindowSums::Values& v) {
+            if (!j.contains("symbol") || !j["symbol"].is_string()) return false;
+            if (!extract_ts_ms_any(j, ts)) return false;
+            symbol = j["symbol"].get<std::string>();
+            if (j.contains("funding")) v[0] = get_num_safe(j["funding"]);
+            return true;
+        });
+}
 
-            gross += j.value("gross_realized", 0.0);
-            net   += j.value("net_realized", 0.0);
-            count++;
-        } catch (...) {}
+static bool catch_up_fee_sums() {
+    if (!g_exec_ledger.is_open()) return false;
+    const std::int64_t last = g_exec_ledger.last_rowid();
+    if (last < (std::int64_t)g_fee_sums.mark()) {
+        OutLine() << "[ledger] " << g_exec_ledger.path() << " is behind its index; rebuilding "
+                  << g_fee_sums.path() << "\n";
+        g_fee_sums.reset();
     }
+    if (last == (std::int64_t)g_fee_sums.mark()) return true;
+
+    auto cur = g_exec_ledger.after((std::int64_t)g_fee_sums.mark());
+    ExecRecord r;
+    while (cur.next(r)) g_fee_sums.add(r.symbol, r.ts_ms, {r.fee, 0.0}, (std::uint64_t)r.rowid);
+    g_fee_sums.flush();
+    return true;
+}
+
+static nlohmann::json ledger_error(const std::string& path) {
+    nlohmann::json err;
+    err["error"] = "cannot_open_ledger";
+    err["ledger_path"] = path;
+    return err;
+}
+
+// Sum realized pnl from trades ledger in a time window
+static nlohmann::json sum_realized_from_trade_ledger(const std::string& symbol, long long start_ms, long long end_ms) {
+    if (!catch_up_trade_sums()) return ledger_error(TRADE_LEDGER_PATH);
+    const auto w = g_trade_sums.query(symbol, start_ms, end_ms);
 
     nlohmann::json out;
     out["symbol"] = symbol;
-    out["gross_realized"] = gross;
-    out["net_realized"] = net;
-    out["close_events"] = count;
-    out["scanned_lines"] = scanned;
+    out["gross_realized"] = w.sum[0];
+    out["net_realized"] = w.sum[1];
+    out["close_events"] = (long long)w.count;
     out["ledger_path"] = TRADE_LEDGER_PATH;
     return out;
 }
 
 static nlohmann::json sum_realized_from_trade_ledger_all(const std::string& symbol) {
-    std::ifstream in(TRADE_LEDGER_PATH);
-    double gross = 0.0;
-    double net = 0.0;
-    long long count = 0;
-    long long scanned = 0;
-
-    if (!in.good()) {
-        nlohmann::json err;
-        err["error"] = "cannot_open_ledger";
-        err["ledger_path"] = TRADE_LEDGER_PATH;
-        return err;
-    }
-
-    std::string line;
-    while (std::getline(in, line)) {
-        if (line.empty()) continue;
-        scanned++;
-        try {
-            auto j = nlohmann::json::parse(line);
-
-            if (!j.contains("symbol") || !j["symbol"].is_string()) continue;
-            if (j["symbol"].get<std::string>() != symbol) continue;
-
-            gross += j.value("gross_realized", 0.0);
-            net   += j.value("net_realized", 0.0);
-            count++;
-        } catch (...) {}
-    }
+    if (!catch_up_trade_sums()) return ledger_error(TRADE_LEDGER_PATH);
+    const auto w = g_trade_sums.total(symbol);
 
     nlohmann::json out;
     out["symbol"] = symbol;
-    out["gross_realized_all"] = gross;
-    out["net_realized_all"] = net;
-    out["close_events_all"] = count;
-    out["scanned_lines"] = scanned;
+    out["gross_realized_all"] = w.sum[0];
+    out["net_realized_all"] = w.sum[1];
+    out["close_events_all"] = (long long)w.count;
     out["ledger_path"] = TRADE_LEDGER_PATH;
     return out;
 }
@@ -375,102 +356,28 @@ static long long now_ms_local() {
                std::chrono::system_clock::now().time_since_epoch()).count();
 }
 
-static bool extract_ts_ms(const nlohmann::json& j, long long& ts_out) {
-    if (!j.contains("ts_ms")) return false;
-    try {
-        if (j["ts_ms"].is_number_integer()) { ts_out = j["ts_ms"].get<long long>(); return true; }
-        if (j["ts_ms"].is_number())         { ts_out = (long long)j["ts_ms"].get<double>(); return true; }
-        if (j["ts_ms"].is_string())         { ts_out = std::stoll(j["ts_ms"].get<std::string>()); return true; }
-    } catch (...) {}
-    return false;
-}
-
 // Sum exec fees from execution ledger within a time window
 static nlohmann::json sum_exec_fees_from_ledger(const std::string& symbol, long long start_ms, long long end_ms) {
-    std::ifstream in(LEDGER_PATH);
-    double fees = 0.0;
-    long long count = 0;
-    long long scanned = 0;
-
-    if (!in.good()) {
-        nlohmann::json err;
-        err["error"] = "cannot_open_ledger";
-        err["ledger_path"] = LEDGER_PATH;
-        return err;
-    }
-
-    std::string line;
-    while (std::getline(in, line)) {
-        if (line.empty()) continue;
-        scanned++;
-        try {
-            auto j = nlohmann::json::parse(line);
-
-            if (j.contains("symbol") && j["symbol"].is_string()) {
-                if (j["symbol"].get<std::string>() != symbol) continue;
-            } else continue;
-
-            long long ts=0;
-            if (!extract_ts_ms(j, ts)) continue;
-            if (ts < start_ms || ts > end_ms) continue;
-
-            if (j.contains("execFee")) {
-                fees += get_num_safe(j["execFee"]);
-            }
-            count++;
-        } catch (...) {}
-    }
+    if (!catch_up_fee_sums()) return ledger_error(g_exec_ledger.path());
+    const auto w = g_fee_sums.query(symbol, start_ms, end_ms);
 
     nlohmann::json out;
     out["symbol"] = symbol;
-    out["fees"] = fees;
-    out["exec_count"] = count;
-    out["scanned_lines"] = scanned;
-    out["ledger_path"] = LEDGER_PATH;
+    out["fees"] = w.sum[0];
+    out["exec_count"] = (long long)w.count;
+    out["ledger_path"] = g_exec_ledger.path();
     return out;
 }
 
 // Sum funding from funding ledger within a time window
 static nlohmann::json sum_funding_from_ledger(const std::string& symbol, long long start_ms, long long end_ms) {
-    std::ifstream in(FUND_LEDGER_PATH);
-    double funding = 0.0;
-    long long count = 0;
-    long long scanned = 0;
-
-    if (!in.good()) {
-        nlohmann::json err;
-        err["error"] = "cannot_open_ledger";
-        err["ledger_path"] = FUND_LEDGER_PATH;
-        return err;
-    }
-
-    std::string line;
-    while (std::getline(in, line)) {
-        if (line.empty()) continue;
-        scanned++;
-        try {
-            auto j = nlohmann::json::parse(line);
-
-            if (j.contains("symbol") && j["symbol"].is_string()) {
-                if (j["symbol"].get<std::string>() != symbol) continue;
-            } else continue;
-
-            long long ts=0;
-            if (!extract_ts_ms(j, ts)) continue;
-            if (ts < start_ms || ts > end_ms) continue;
-
-            if (j.contains("funding")) {
-                funding += get_num_safe(j["funding"]);
-            }
-            count++;
-        } catch (...) {}
-    }
+    if (!catch_up_fund_sums()) return ledger_error(FUND_LEDGER_PATH);
+    const auto w = g_fund_sums.query(symbol, start_ms, end_ms);
 
     nlohmann::json out;
     out["symbol"] = symbol;
-    out["funding"] = funding;
-    out["event_count"] = count;
-    out["scanned_lines"] = scanned;
+    out["funding"] = w.sum[0];
+    out["event_count"] = (long long)w.count;
     out["ledger_path"] = FUND_LEDGER_PATH;
     return out;
 }
@@ -557,59 +464,36 @@ static bool append_funding_to_ledger(const nlohmann::json& e,
     return true;
 }
 
-// ------------------------ Execution ledger (shared) ------------------------
-static std::unordered_set<std::string> g_seen_exec_ids;
-
-static void load_seen_exec_ids() {
-    std::ifstream in(LEDGER_PATH);
-    if (!in.good()) return;
+// Funding settlements of one symbol (the API may ignore the symbol filter)
+static bool is_funding_for(const nlohmann::json& e, const std::string& symbol) {
+    if (e.contains("symbol") && e["symbol"].is_string() && e["symbol"].get<std::string>() != symbol)
+        return false;
+    return e.contains("funding");
+}
 
-    std::string line;
-    while (std::getline(in, line)) {
-        if (line.empty()) continue;
-        try {
-            auto j = nlohmann::json::parse(line);
-            if (j.contains("execId") && j["execId"].is_string()) {
-                g_seen_exec_ids.insert(j["execId"].get<std::string>());
-            }
-        } catch (...) {}
-    }
+static HistorySync::Query history_query(HistorySync::Kind kind,
+                                        const std::string& category,
+                                        const std::string& symbol,
+                                        long long start_ms,
+                                        long long end_ms) {
+    HistorySync::Query q;
+    q.kind = kind;
+    q.category = category;
+    q.symbol = symbol;
+    q.start_ms = start_ms;
+    q.end_ms = end_ms;
+    return q;
 }
 
+// Dedupe is the UNIQUE execId index: false for an execId already recorded
 static bool append_execution_to_ledger(const nlohmann::json& e,
                                        const std::string& category,
-                                       const std::string& symbol) {
-    if (!e.contains("execId") || !e["execId"].is_string()) return false;
-    const std::string execId = e["execId"].get<std::string>();
-    if (execId.empty()) return false;
-
-    std::lock_guard<std::mutex> lk(g_ledger_mtx);
-
-    if (g_seen_exec_ids.find(execId) != g_seen_exec_ids.end())
-        return false;
-
-    nlohmann::json out;
-    out["category"] = category;
-    out["symbol"] = symbol;
-    out["execId"] = execId;
-
-    if (e.contains("execTime")) out["ts_ms"] = e["execTime"];
-    if (e.contains("orderId")) out["orderId"] = e["orderId"];
-    if (e.contains("side")) out["side"] = e["side"];
-    if (e.contains("execPrice")) out["execPrice"] = e["execPrice"];
-    if (e.contains("execQty")) out["execQty"] = e["execQty"];
-    if (e.contains("execFee")) out["execFee"] = e["execFee"];
-    if (e.contains("feeCurrency")) out["feeCurrency"] = e["feeCurrency"];
-    if (e.contains("execType")) out["execType"] = e["execType"];
-    if (e.contains("orderType")) out["orderType"] = e["orderType"];
-    if (e.contains("seq")) out["seq"] = e["seq"];
-
-    std::ofstream f(LEDGER_PATH, std::ios::app);
-    if (!f.good()) return false;
-
-    f << out.dump() << "\n";
-    g_seen_exec_ids.insert(execId);
-    return true;
+                                       const std::string& symbol,
+                                       ExecRecord& r) {
+    if (!exec_record_from_json(e, r)) return false;
+    r.category = category;
+    r.symbol = symbol;
+    return g_exec_ledger.insert(r);
 }
 
 // ------------------------ Utilities ------------------------
@@ -618,28 +502,163 @@ static std::string env_or(const char* k, const std::string& defv) {
     return v ? std::string(v) : defv;
 }
 
-// Latest cached top-of-book (from ZMQ)
-static std::mutex g_px_mtx;
-static double g_last_bid = 0.0;
-static double g_last_ask = 0.0;
+// Latest top-of-book per exchange|instrument (from ZMQ). Orders price from
+// the ORDER_PX_EXCHANGE venue of their symbol, else any venue quoting it.
+static const std::uint32_t MAX_INSTRUMENTS = 256;
+static TopOfBookCache g_tob(MAX_INSTRUMENTS);
+
+// Pre-trade limits (RISK_*), checked on the command thread before any
+// client call. Keys are "category|symbol". Positions come from the private
+// stream's position pushes while it is up, else from fills (ws or sync_exec)
+// on top of the position at start (REST-only: seeded, see risk_id); open
+// exposure is reserved on send and handed back as acks, order updates,
+// fills and cancels come in.
+static PreTradeRisk g_risk(MAX_INSTRUMENTS, PreTradeRisk::Limits::from_env());
+static const long long g_start_ms = now_ms_local();
+
+// REST-only there are no position pushes: a key's position is read once
+// with get_positions when the command thread first uses it (before its
+// first order or sync_exec, not on every send), and only fills after that
+// move it. Set in main; null with the private stream.
+static BybitDemoClient* g_pos_seed_client = nullptr;
+static long long g_pos_from_ms[MAX_INSTRUMENTS];   // per g_risk id: fills before are in pos; 0 = not seeded
+
+// Signed one-way position of symbol from a /v5/position/list response
+static bool parse_position(const std::string& resp, const std::string& symbol, double& out) {
+    try {
+        auto j = nlohmann::json::parse(resp);
+        if (!j.contains("retCode") || !j["retCode"].is_number() || j["retCode"].get<int>() != 0) return false;
+        out = 0.0;
+        for (const auto& p : j["result"]["list"]) {
+            if (p.value("symbol", "") != symbol) continue;
+            const double size = get_num_safe(p.value("size", nlohmann::json()));
+            const std::string side = p.value("side", "");
+            out += side == "Buy" ? size : side == "Sell" ? -size : 0.0;
+        }
+        return true;
+    } catch (...) {
+        return false;
+    }
+}
+
+// Command thread: g_risk id of category|symbol, seeding its position first
+// if REST-only
+static std::uint32_t risk_id(const std::string& category, const std::string& symbol) {
+    const std::uint32_t id = g_risk.intern(category + "|" + symbol);
+    if (id == PreTradeRisk::NONE || !g_pos_seed_client || g_pos_from_ms[id] != 0) return id;
+
+    g_pos_from_ms[id] = now_ms_local();
+    double pos = 0.0;
+    if (parse_position(g_pos_seed_client->get_positions(category, symbol), symbol, pos)) {
+        if (pos != 0.0) g_risk.on_fill(id, pos > 0.0, std::fabs(pos));
+        OutLine() << "[RISK] " << category << "|" << symbol << " position at start " << pos << "\n";
+    } else {
+        OutLine() << "[RISK] no position for " << category << "|" << symbol
+                  << "; RISK_MAX_POSITION counts fills from now only\n";
+    }
+    return id;
+}
 
-// ---- Open order tracking (for cancel / killswitch) ----
+// ---- Open order tracking (for cancel / killswitch / risk exposure) ----
 struct OpenOrderInfo {
     std::string category;
     std::string symbol;
+    PreTradeRisk::Hold hold;    // empty for orders not sent from here
+    double reserved = 0.0;      // part of hold.qty still open at g_risk
+    double leaves = -1.0;       // from the private stream, -1 = not seen yet
+    double filled = 0.0;        // executions seen for it (ws or sync_exec)
 };
 
 static std::mutex g_orders_mtx;
 static std::unordered_map<std::string, OpenOrderInfo> g_open_orders; // orderId -> info
+// Orders the private stream saw finish; an ack that arrives after the fill
+// (separate sockets) must not re-track them
+static std::unordered_set<std::string> g_done_orders;
+
+// Caller holds g_orders_mtx. Exposure only ever shrinks to what is left,
+// so leaves and fills of the same qty, in either order, release it once.
+static void shrink_reserved(OpenOrderInfo& o, double open) {
+    open = std::max(open, 0.0);
+    if (open < o.reserved) {
+        g_risk.release(o.hold, o.reserved - open);
+        o.reserved = open;
+    }
+}
+
+// Caller holds g_orders_mtx
+static void set_leaves(OpenOrderInfo& o, double leaves) {
+    o.leaves = leaves;
+    shrink_reserved(o, leaves);
+}
+
+// Caller holds g_orders_mtx
+static void remember_done(const std::string& orderId) {
+    if (g_done_orders.size() >= 100000) g_done_orders.clear();
+    g_done_orders.insert(orderId);
+}
+
+// Caller holds g_orders_mtx
+static void drop_order(std::unordered_map<std::string, OpenOrderInfo>::iterator it) {
+    g_risk.release(it->second.hold, it->second.reserved);
+    g_open_orders.erase(it);
+}
+
+// Ack side: the order rests with its reservation; if the private stream
+// finished it first, the reservation goes straight back
+static void track_order(const std::string& orderId, const std::string& category, const std::string& symbol,
+                        const PreTradeRisk::Hold& hold) {
+    std::lock_guard<std::mutex> lk(g_orders_mtx);
+    if (g_done_orders.count(orderId)) {
+        g_risk.release(hold, hold.qty);
+        return;
+    }
+    OpenOrderInfo& o = g_open_orders[orderId];
+    o.category = category;
+    o.symbol = symbol;
+    o.hold = hold;
+    o.reserved = hold.qty;
+    if (o.leaves >= 0.0) set_leaves(o, o.leaves);
+    shrink_reserved(o, hold.qty - o.filled);
+}
 
-static void track_order(const std::string& orderId, const std::string& category, const std::string& symbol) {
+// Private stream side: live order with leaves qty still open
+static void track_order_update(const std::string& orderId, const std::string& category, const std::string& symbol,
+                               double leaves) {
     std::lock_guard<std::mutex> lk(g_orders_mtx);
-    g_open_orders[orderId] = {category, symbol};
+    if (g_done_orders.count(orderId)) return;
+    OpenOrderInfo& o = g_open_orders[orderId];
+    o.category = category;
+    o.symbol = symbol;
+    set_leaves(o, leaves);
+}
+
+static void finish_order(const std::string& orderId) {
+    std::lock_guard<std::mutex> lk(g_orders_mtx);
+    auto it = g_open_orders.find(orderId);
+    if (it != g_open_orders.end()) drop_order(it);
+    remember_done(orderId);
+}
+
+// Execution side: the only thing that hands a fill's reservation back
+// REST-only (no order updates); an order filled in full is done
+static void fill_order(const std::string& orderId, double qty) {
+    if (!(qty > 0.0)) return;
+    std::lock_guard<std::mutex> lk(g_orders_mtx);
+    auto it = g_open_orders.find(orderId);
+    if (it == g_open_orders.end()) return;
+    OpenOrderInfo& o = it->second;
+    o.filled += qty;
+    shrink_reserved(o, o.hold.qty - o.filled);
+    if (o.hold.side != 0 && o.filled >= o.hold.qty * (1.0 - 1e-9)) {
+        drop_order(it);
+        remember_done(orderId);
+    }
 }
 
 static void untrack_order(const std::string& orderId) {
     std::lock_guard<std::mutex> lk(g_orders_mtx);
-    g_open_orders.erase(orderId);
+    auto it = g_open_orders.find(orderId);
+    if (it != g_open_orders.end()) drop_order(it);
 }
 
 static std::vector<std::pair<std::string, OpenOrderInfo>> snapshot_open_orders() {
@@ -650,6 +669,89 @@ static std::vector<std::pair<std::string, OpenOrderInfo>> snapshot_open_orders()
     return v;
 }
 
+// Order create response (gateway thread): latency span, echo, track on
+// success; anything else hands the risk reservation back
+static void on_order_ack(const std::string& resp, const std::string& category, const std::string& symbol,
+                         const TraceContext& tr, const PreTradeRisk::Hold& hold) {
+    trace_span(LS_TICK_TO_TRADE, tr.recv_ns, trace_now_ns());
+    OutLine() << resp << "\n";
+    try {
+        auto j = nlohmann::json::parse(resp);
+        if (j.contains("retCode") && j["retCode"].is_number() && j["retCode"].get<int>() == 0) {
+            auto oid = j["result"]["orderId"].get<std::string>();
+            track_order(oid, category, symbol, hold);
+            OutLine() << "[TRACK] orderId=" << oid << "\n";
+            return;
+        }
+    } catch (...) {}
+    g_risk.release(hold, hold.qty);
+}
+
+// Cancel response: echo, untrack on success
+static void on_cancel_ack(const std::string& resp, const std::string& orderId) {
+    OutLine() << resp << "\n";
+
+    try {
+        auto j = nlohmann::json::parse(resp);
+        if (j.contains("retCode") && j["retCode"].is_number() && j["retCode"].get<int>() == 0) {
+            untrack_order(orderId);
+        }
+    } catch (...) {}
+}
+
+// An execution from the private stream or sync_exec: into the ledger and,
+// the first time it is seen, into g_risk and its order's reservation. Fills
+// from before start (or before the REST seed) are already part of the position.
+static bool record_execution(const nlohmann::json& e, const std::string& category, const std::string& symbol) {
+    ExecRecord r;
+    if (!append_execution_to_ledger(e, category, symbol, r)) return false;
+    if (r.execType != "Funding") {
+        const std::uint32_t id = g_pos_seed_client ? risk_id(category, symbol)
+                                                   : g_risk.intern(category + "|" + symbol);
+        if (id != PreTradeRisk::NONE && r.ts_ms >= std::max(g_start_ms, g_pos_from_ms[id]))
+            g_risk.on_fill(id, r.side == "Buy", r.qty);
+        fill_order(r.orderId, r.qty);
+    }
+    return true;
+}
+
+// ---- Private websocket streams (io thread) ----
+// Fills go straight into the execution ledger (deduped by execId, so a
+// later sync_exec over the same window only fills gaps); order updates keep
+// g_open_orders in step with the exchange.
+static void on_ws_execution(const nlohmann::json& e) {
+    const std::string category = e.value("category", "");
+    const std::string symbol = e.value("symbol", "");
+    const bool appended = record_execution(e, category, symbol);
+    OutLine() << "[FILL] " << symbol << " " << e.value("side", "") << " " << e.value("execQty", "")
+              << " @ " << e.value("execPrice", "") << " orderId=" << e.value("orderId", "")
+              << (appended ? "" : " (dup)") << "\n";
+}
+
+static void on_ws_order(const nlohmann::json& o) {
+    const std::string oid = o.value("orderId", "");
+    const std::string status = o.value("orderStatus", "");
+    if (oid.empty()) return;
+
+    if (status == "New" || status == "PartiallyFilled" || status == "Untriggered")
+        track_order_update(oid, o.value("category", ""), o.value("symbol", ""),
+                           get_num_safe(o.value("leavesQty", nlohmann::json())));
+    else
+        finish_order(oid);   // Filled / Cancelled / Rejected / Deactivated / ...
+}
+
+// One-way mode only (positionIdx 0): hedge mode has two legs per symbol
+static void on_ws_position(const nlohmann::json& p) {
+    if (get_num_safe(p.value("positionIdx", nlohmann::json(0))) == 0.0) {
+        const std::string side = p.value("side", "");
+        const double size = get_num_safe(p.value("size", nlohmann::json()));
+        g_risk.set_position(g_risk.intern(p.value("category", "") + "|" + p.value("symbol", "")),
+                            side == "Buy" ? size : side == "Sell" ? -size : 0.0);
+    }
+    OutLine() << "[POS] " << p.value("symbol", "") << " " << p.value("side", "")
+              << " size=" << p.value("size", "") << " entry=" << p.value("entryPrice", "") << "\n";
+}
+
 // ---- Ctrl+C kill flag ----
 static std::atomic<bool> g_sigint{false};
 static void on_sigint(int) { g_sigint.store(true); }
@@ -681,7 +783,7 @@ int main() {
     sub.connect(addr);
     sub.set(zmq::sockopt::subscribe, topic);
 
-    std::cout << "[place_order] SUB connected to " << addr
+    OutLine() << "[place_order] SUB connected to " << addr
               << " topic='" << topic << "'\n";
 
     // Bybit client (keys from env)
@@ -690,24 +792,66 @@ int main() {
         env_or("BYBIT_API_SECRET", "")
     );
 
+    // History backfill: time slices in parallel under one rate-limit bucket
+    HistorySync history(bybit, HistorySync::Options::from_env());
+
     // Ledger warmup
-    load_seen_exec_ids();
+    if (!g_exec_ledger.open(LEDGER_PATH) || !g_lot_store.open()) {
+        OutLine() << "[ledger] WARNING: cannot open " << g_exec_ledger.path() << "\n";
+    }
     load_seen_funding_ids();
     load_seen_trade_ids();
 
-    std::cout << "[ledger] loaded tradeIds=" << g_seen_trade_ids.size()
+    OutLine() << "[ledger] loaded tradeIds=" << g_seen_trade_ids.size()
               << " from " << TRADE_LEDGER_PATH << "\n";
-    std::cout << "[ledger] loaded execIds=" << g_seen_exec_ids.size()
-              << " from " << LEDGER_PATH << "\n";
-    std::cout << "[ledger] loaded fundIds=" << g_seen_fund_ids.size()
+    OutLine() << "[ledger] execIds=" << g_exec_ledger.size()
+              << " in " << g_exec_ledger.path() << "\n";
+    OutLine() << "[ledger] loaded fundIds=" << g_seen_fund_ids.size()
               << " from " << FUND_LEDGER_PATH << "\n";
 
+    // Window indexes: load the sidecars, then index only what they miss
+    for (WindowSums* ws : {&g_trade_sums, &g_fund_sums, &g_fee_sums}) ws->load();
+    catch_up_trade_sums();
+    catch_up_fund_sums();
+    catch_up_fee_sums();
+    OutLine() << "[ledger] window index points trades=" << g_trade_sums.points()
+              << " funding=" << g_fund_sums.points()
+              << " fees=" << g_fee_sums.points() << "\n";
+
     if (!bybit.ready()) {
-        std::cout << "[place_order] NOTE: set BYBIT_API_KEY and BYBIT_API_SECRET to enable orders.\n";
+        OutLine() << "[place_order] NOTE: set BYBIT_API_KEY and BYBIT_API_SECRET to enable orders.\n";
+    } else if (!bybit.warm_up()) {
+        OutLine() << "[place_order] NOTE: REST warm-up failed; first order will connect.\n";
+    }
+
+    // BYBIT_WS=1: orders over the trade websocket, fills / order updates
+    // pushed from the private streams. REST stays the fallback while the
+    // trade socket is down, and for everything else.
+    BybitTradeWsClient ws(
+        env_or("BYBIT_API_KEY", ""),
+        env_or("BYBIT_API_SECRET", "")
+    );
+    if (bybit.ready() && env_or("BYBIT_WS", "0") == "1") {
+        ws.on_execution(on_ws_execution);
+        ws.on_order(on_ws_order);
+        ws.on_position(on_ws_position);
+        ws.on_private_down([] { g_risk.forget_positions(); });
+        if (!ws.start())
+            OutLine() << "[place_order] NOTE: websocket not up yet; orders use REST until it is.\n";
+    } else if (bybit.ready()) {
+        g_pos_seed_client = &bybit;   // REST-only: positions seeded per key (risk_id)
     }
 
+    // Venue whose quotes price manual orders
+    const std::string px_exchange = env_or("ORDER_PX_EXCHANGE", "bybit");
+
+    // "category|symbol" of every order sent this session (command thread);
+    // g_risk also has keys for whatever the private stream reported
+    std::unordered_set<std::string> sent_keys;
+
     std::atomic<bool> running{true};
     std::signal(SIGINT, on_sigint);
+    latency_install_sigusr1();
 
     // Thread: ZMQ receive (cache bid/ask from JSON)
     std::thread rx([&](){
@@ -715,46 +859,63 @@ int main() {
             zmq::message_t part1;
             if (!sub.recv(part1, zmq::recv_flags::none)) continue;
 
-            std::string payload;
-
             // Handle both: [payload] OR [topic][payload]
-            if (part1.more()) {
-                zmq::message_t part2;
-                if (!sub.recv(part2, zmq::recv_flags::none)) continue;
-                payload = std::string(static_cast<char*>(part2.data()), part2.size());
-            } else {
-                payload = std::string(static_cast<char*>(part1.data()), part1.size());
-            }
+            zmq::message_t part2;
+            if (part1.more() && !sub.recv(part2, zmq::recv_flags::none)) continue;
+            const zmq::message_t& msg = part1.more() ? part2 : part1;
+            const std::string_view payload(static_cast<const char*>(msg.data()), msg.size());
+
+            const std::uint64_t rx_ns = trace_now_ns();
+
+            if (latency_dump_requested())
+                OutLine() << latency_report("place_order");
 
             try {
-                auto j = nlohmann::json::parse(payload);
-
-                static int k = 0;
-                if (k < 2) {
-                    std::cout << "[KEYS] top-level: ";
-                    for (auto it = j.begin(); it != j.end(); ++it) std::cout << it.key() << " ";
-                    std::cout << "\n";
-                    k++;
+                // Fast path scans the hft_feeds layout in place; anything
+                // else goes through the full parser
+                MarketStateTob m;
+                std::string exchange, instrument;
+                if (!scan_market_state(payload, m)) {
+                    auto j = nlohmann::json::parse(payload);
+                    exchange   = j.value("exchange", "");
+                    instrument = j.value("instrument", "");
+                    auto& tob = j.at("top_of_book");
+                    m.exchange   = exchange;
+                    m.instrument = instrument;
+                    m.ts_ms = j.value("ts_ms", std::int64_t{0});
+                    m.bid = get_num_safe(tob.at("bid"));
+                    m.ask = get_num_safe(tob.at("ask"));
+                    trace_from_json(j, m.trace);
                 }
 
-                auto& tob = j.at("top_of_book");
-                double bid = get_num_safe(tob.at("bid"));
-                double ask = get_num_safe(tob.at("ask"));
+                TraceContext& tr = m.trace;
+                if (tr.id) {
+                    tr.rx_ns     = rx_ns;
+                    tr.parsed_ns = trace_now_ns();
+                    trace_span(LS_ZMQ, tr.pub_ns, rx_ns);
+                    trace_span(LS_RX_PARSE, rx_ns, tr.parsed_ns);
+                }
 
-                {
-                    std::lock_guard<std::mutex> lk(g_px_mtx);
-                    g_last_bid = bid;
-                    g_last_ask = ask;
+                const std::uint32_t id = g_tob.intern(m.exchange, m.instrument);
+                if (id == TopOfBookCache::NONE) {
+                    static bool full_logged = false;
+                    if (!full_logged) {
+                        OutLine() << "[ERR] top-of-book cache full (" << MAX_INSTRUMENTS
+                                  << "), dropping " << m.exchange << " " << m.instrument << "\n";
+                        full_logged = true;
+                    }
+                    continue;
                 }
+                g_tob.store(id, m.bid, m.ask, m.ts_ms, tr.id ? &tr : nullptr);
 
             } catch (const std::exception& e) {
-                std::cout << "[ERR] " << e.what() << "\n";
+                OutLine() << "[ERR] " << e.what() << "\n";
             }
         }
     });
 
     // Main thread: user commands
-    std::cout << "\nCommands:\n"
+    OutLine() << "\nCommands:\n"
               << "  px\n"
               << "  buy       <category> <symbol> <qty>\n"
               << "  sell      <category> <symbol> <qty>\n"
@@ -775,6 +936,10 @@ int main() {
               << "  realwL      <symbol> <minutes>\n"
               << "  lotsL       <category> <symbol>\n"
               << "  pnlFULL   <category> <symbol> <minutes>\n"
+              << "  lat       (latency report; or kill -USR1)\n"
+              << "  http      (REST connection reuse)\n"
+              << "  ws        (websocket order entry / private streams)\n"
+              << "  risk      (pre-trade limits: positions, open exposure, rejects)\n"
               << "  quit\n\n";
 
     std::string cmd;
@@ -782,19 +947,61 @@ int main() {
         if (cmd == "quit") break;
         if (g_sigint.load()) break;
 
+        // ---- lat ----
+        if (cmd == "lat") {
+            OutLine() << latency_report("place_order");
+            continue;
+        }
+
+        // ---- http ----
+        if (cmd == "http") {
+            const auto st = bybit.http_stats();
+            OutLine() << "[http] requests=" << st.requests
+                      << " new_connections=" << st.new_connections
+                      << " pings=" << st.pings
+                      << " handles=" << st.handles
+                      << " async_in_flight=" << st.async_in_flight << "\n";
+            continue;
+        }
+
+        // ---- ws ----
+        if (cmd == "ws") {
+            const auto st = ws.stats();
+            OutLine() << "[ws] ready=" << ws.ready()
+                      << " acks=" << st.acks
+                      << " orders=" << st.orders
+                      << " executions=" << st.executions
+                      << " positions=" << st.positions
+                      << " reconnects=" << st.reconnects << "\n";
+            continue;
+        }
+
+        // ---- risk ----
+        if (cmd == "risk") {
+            nlohmann::json out;
+            out["passed"] = g_risk.passed();
+            for (int b = 0; b < PreTradeRisk::R_COUNT; ++b)
+                out["rejected"][PreTradeRisk::reject_name(b)] = g_risk.rejected(b);
+            for (std::uint32_t id = 0; id < g_risk.size(); ++id) {
+                const auto v = g_risk.view(id);
+                out["instruments"][g_risk.key(id)] = {
+                    {"pos", v.pos}, {"pos_known", v.pos_known}, {"open_buy", v.open_buy},
+                    {"open_sell", v.open_sell}, {"open_notional", v.open_notional}};
+            }
+            OutLine() << out.dump() << "\n";
+            continue;
+        }
+
         // ---- px ----
         if (cmd == "px") {
-            double bid=0.0, ask=0.0;
-            {
-                std::lock_guard<std::mutex> lk(g_px_mtx);
-                bid = g_last_bid;
-                ask = g_last_ask;
-                std::cout << "[PXREAD] g_last_bid=" << g_last_bid
-                          << " g_last_ask=" << g_last_ask
-                          << " (addr bid=" << (void*)&g_last_bid
-                          << " ask=" << (void*)&g_last_ask << ")\n";
+            const std::uint32_t n = g_tob.size();
+            if (n == 0) OutLine() << "No bid/ask yet.\n";
+            for (std::uint32_t id = 0; id < n; ++id) {
+                TopOfBookCache::Quote q;
+                if (!g_tob.load(id, q)) continue;
+                OutLine() << g_tob.key(id) << " bid=" << q.bid << " ask=" << q.ask
+                          << " ts_ms=" << q.ts_ms << "\n";
             }
-            std::cout << "bid=" << bid << " ask=" << ask << "\n";
             continue;
         }
 
@@ -804,19 +1011,13 @@ int main() {
             std::cin >> category >> symbol >> orderId;
 
             if (!bybit.ready()) {
-                std::cout << "Set BYBIT_API_KEY and BYBIT_API_SECRET first.\n";
+                OutLine() << "Set BYBIT_API_KEY and BYBIT_API_SECRET first.\n";
                 continue;
             }
 
-            std::string resp = bybit.cancel_order(category, symbol, orderId);
-            std::cout << resp << "\n";
-
-            try {
-                auto j = nlohmann::json::parse(resp);
-                if (j.contains("retCode") && j["retCode"].is_number() && j["retCode"].get<int>() == 0) {
-                    untrack_order(orderId);
-                }
-            } catch (...) {}
+            auto cb = [orderId](std::string resp) { on_cancel_ack(resp, orderId); };
+            if (ws.ready()) ws.cancel_order(category, symbol, orderId, cb);
+            else            bybit.cancel_order_async(category, symbol, orderId, cb);
 
             continue;
         }
@@ -827,12 +1028,16 @@ int main() {
             std::cin >> category >> symbol;
 
             if (!bybit.ready()) {
-                std::cout << "Set BYBIT_API_KEY and BYBIT_API_SECRET first.\n";
+                OutLine() << "Set BYBIT_API_KEY and BYBIT_API_SECRET first.\n";
                 continue;
             }
 
-            std::string resp = bybit.close_position_market_reduce_only(category, symbol);
-            std::cout << resp << "\n";
+            // Position pushed by the private stream saves the REST lookup
+            double pos = 0.0;
+            std::string resp = g_risk.position(g_risk.find(category + "|" + symbol), pos)
+                ? bybit.close_position_market_reduce_only(category, symbol, pos)
+                : bybit.close_position_market_reduce_only(category, symbol);
+            OutLine() << resp << "\n";
             continue;
         }
 
@@ -842,12 +1047,12 @@ int main() {
             std::cin >> category >> symbol;
 
             if (!bybit.ready()) {
-                std::cout << "Set BYBIT_API_KEY and BYBIT_API_SECRET first.\n";
+                OutLine() << "Set BYBIT_API_KEY and BYBIT_API_SECRET first.\n";
                 continue;
             }
 
             std::string resp = bybit.get_positions(category, symbol);
-            std::cout << resp << "\n";
+            OutLine() << resp << "\n";
             continue;
         }
 
@@ -857,7 +1062,7 @@ int main() {
             std::cin >> category >> symbol;
 
             if (!bybit.ready()) {
-                std::cout << "Set BYBIT_API_KEY and BYBIT_API_SECRET first.\n";
+                OutLine() << "Set BYBIT_API_KEY and BYBIT_API_SECRET first.\n";
                 continue;
             }
 
@@ -866,13 +1071,13 @@ int main() {
             try {
                 auto j = nlohmann::json::parse(resp);
                 if (!j.contains("retCode") || j["retCode"].get<int>() != 0) {
-                    std::cout << resp << "\n";
+                    OutLine() << resp << "\n";
                     continue;
                 }
 
                 auto &list = j["result"]["list"];
                 if (!list.is_array() || list.empty()) {
-                    std::cout << "{\"error\":\"no position data\"}\n";
+                    OutLine() << "{\"error\":\"no position data\"}\n";
                     continue;
                 }
 
@@ -895,9 +1100,9 @@ int main() {
                 out["uPnL"]    = u;
                 out["cumRealisedPnl"] = r;
 
-                std::cout << out.dump() << "\n";
+                OutLine() << out.dump() << "\n";
             } catch (...) {
-                std::cout << resp << "\n";
+                OutLine() << resp << "\n";
             }
             continue;
         }
@@ -909,7 +1114,7 @@ int main() {
             std::cin >> category >> symbol >> minutes;
 
             if (!bybit.ready()) {
-                std::cout << "Set BYBIT_API_KEY and BYBIT_API_SECRET first.\n";
+                OutLine() << "Set BYBIT_API_KEY and BYBIT_API_SECRET first.\n";
                 continue;
             }
 
@@ -918,42 +1123,15 @@ int main() {
 
             double fee_sum = 0.0;
             long long exec_count = 0;
-            int pages = 0;
-
-            std::string cursor;
-
-            while (true) {
-                std::string resp = bybit.get_executions(category, symbol, start, cursor);
-
-                try {
-                    auto j = nlohmann::json::parse(resp);
-                    if (!j.contains("retCode") || j["retCode"].get<int>() != 0) {
-                        std::cout << resp << "\n";
-                        break;
-                    }
-
-                    if (j.contains("result") && j["result"].contains("list") && j["result"]["list"].is_array()) {
-                        for (auto &e : j["result"]["list"]) {
-                            if (e.contains("execFee")) fee_sum += get_num_safe(e["execFee"]);
-                            exec_count++;
-                        }
-                    }
-
-                    std::string next;
-                    if (j.contains("result") && j["result"].contains("nextPageCursor") && j["result"]["nextPageCursor"].is_string()) {
-                        next = j["result"]["nextPageCursor"].get<std::string>();
-                    }
-
-                    pages++;
-                    if (next.empty()) break;
-                    cursor = next;
 
-                    if (pages > 50) break;
-                } catch (...) {
-                    std::cout << resp << "\n";
-                    break;
-                }
-            }
+            const auto res = history.fetch(
+                history_query(HistorySync::Kind::EXECUTIONS, category, symbol, start, now),
+                [&](const nlohmann::json& e) {
+                    if (e.contains("execFee")) fee_sum += get_num_safe(e["execFee"]);
+                    exec_count++;
+                });
+            if (!res.error.empty()) OutLine() << res.error << "\n";
+            const int pages = res.pages;
 
             nlohmann::json out;
             out["symbol"] = symbol;
@@ -962,7 +1140,7 @@ int main() {
             out["exec_count"] = exec_count;
             out["fees"] = fee_sum;
 
-            std::cout << out.dump() << "\n";
+            OutLine() << out.dump() << "\n";
             continue;
         }
 
@@ -973,7 +1151,7 @@ int main() {
             std::cin >> category >> symbol >> minutes;
 
             if (!bybit.ready()) {
-                std::cout << "Set BYBIT_API_KEY and BYBIT_API_SECRET first.\n";
+                OutLine() << "Set BYBIT_API_KEY and BYBIT_API_SECRET first.\n";
                 continue;
             }
 
@@ -982,48 +1160,17 @@ int main() {
 
             double funding_sum = 0.0;
             long long event_count = 0;
-            int pages = 0;
 
-            std::string cursor;
-
-            while (true) {
-                std::string resp = bybit.get_transaction_log(category, symbol, start, now, cursor, "SETTLEMENT");
-
-                try {
-                    auto j = nlohmann::json::parse(resp);
-                    if (!j.contains("retCode") || j["retCode"].get<int>() != 0) {
-                        std::cout << resp << "\n";
-                        break;
-                    }
-
-                    if (j.contains("result") && j["result"].contains("list") && j["result"]["list"].is_array()) {
-                        for (auto &e : j["result"]["list"]) {
-                            if (e.contains("symbol") && e["symbol"].is_string()) {
-                                if (e["symbol"].get<std::string>() != symbol) continue;
-                            }
-
-                            if (e.contains("funding")) {
-                                funding_sum += get_num_safe(e["funding"]);
-                                event_count++;
-                            }
-                        }
-                    }
-
-                    std::string next;
-                    if (j.contains("result") && j["result"].contains("nextPageCursor") && j["result"]["nextPageCursor"].is_string()) {
-                        next = j["result"]["nextPageCursor"].get<std::string>();
-                    }
-
-                    pages++;
-                    if (next.empty()) break;
-                    cursor = next;
-
-                    if (pages > 50) break;
-                } catch (...) {
-                    std::cout << resp << "\n";
-                    break;
-                }
-            }
+            const auto res = history.fetch(
+                history_query(HistorySync::Kind::FUNDING, category, symbol, start, now),
+                [&](const nlohmann::json& e) {
+                    if (!is_funding_for(e, symbol)) return;
+                    funding_sum += get_num_safe(e["funding"]);
+                    event_count++;
+                },
+                [&](const nlohmann::json& e) { return make_fund_dedupe_key(e, symbol); });
+            if (!res.error.empty()) OutLine() << res.error << "\n";
+            const int pages = res.pages;
 
             nlohmann::json out;
             out["symbol"] = symbol;
@@ -1032,7 +1179,7 @@ int main() {
             out["event_count"] = event_count;
             out["funding"] = funding_sum;
 
-            std::cout << out.dump() << "\n";
+            OutLine() << out.dump() << "\n";
             continue;
         }
 
@@ -1043,7 +1190,7 @@ int main() {
             std::cin >> category >> symbol >> minutes;
 
             if (!bybit.ready()) {
-                std::cout << "Set BYBIT_API_KEY and BYBIT_API_SECRET first.\n";
+                OutLine() << "Set BYBIT_API_KEY and BYBIT_API_SECRET first.\n";
                 continue;
             }
 
@@ -1059,7 +1206,7 @@ int main() {
                 try {
                     auto j = nlohmann::json::parse(resp);
                     if (!j.contains("retCode") || j["retCode"].get<int>() != 0) {
-                        std::cout << resp << "\n";
+                        OutLine() << resp << "\n";
                         continue;
                     }
                     auto &list = j["result"]["list"];
@@ -1067,7 +1214,7 @@ int main() {
                         nlohmann::json out;
                         out["symbol"] = symbol;
                         out["error"] = "no position data";
-                        std::cout << out.dump() << "\n";
+                        OutLine() << out.dump() << "\n";
                         continue;
                     }
 
@@ -1079,79 +1226,33 @@ int main() {
                     uPnL = get_num_safe(p.value("unrealisedPnl", "0"));
                     cumRealisedPnl = get_num_safe(p.value("cumRealisedPnl", "0"));
                 } catch (...) {
-                    std::cout << resp << "\n";
+                    OutLine() << resp << "\n";
                     continue;
                 }
             }
 
-            // 2) Fees window
+            // 2) Fees window, 3) funding window
             double fees = 0.0;
             long long exec_count = 0;
-            int fee_pages = 0;
-            {
-                std::string cursor;
-                while (true) {
-                    std::string resp = bybit.get_executions(category, symbol, start, cursor);
-                    try {
-                        auto j = nlohmann::json::parse(resp);
-                        if (!j.contains("retCode") || j["retCode"].get<int>() != 0) break;
-
-                        if (j.contains("result") && j["result"].contains("list") && j["result"]["list"].is_array()) {
-                            for (auto &e : j["result"]["list"]) {
-                                if (e.contains("execFee")) fees += get_num_safe(e["execFee"]);
-                                exec_count++;
-                            }
-                        }
-
-                        std::string next;
-                        if (j.contains("result") && j["result"].contains("nextPageCursor") && j["result"]["nextPageCursor"].is_string()) {
-                            next = j["result"]["nextPageCursor"].get<std::string>();
-                        }
-
-                        fee_pages++;
-                        if (next.empty()) break;
-                        cursor = next;
-                        if (fee_pages > 50) break;
-                    } catch (...) { break; }
-                }
-            }
+            const auto fee_res = history.fetch(
+                history_query(HistorySync::Kind::EXECUTIONS, category, symbol, start, now),
+                [&](const nlohmann::json& e) {
+                    if (e.contains("execFee")) fees += get_num_safe(e["execFee"]);
+                    exec_count++;
+                });
+            const int fee_pages = fee_res.pages;
 
-            // 3) Funding window
             double funding = 0.0;
             long long funding_count = 0;
-            int fund_pages = 0;
-            {
-                std::string cursor;
-                while (true) {
-                    std::string resp = bybit.get_transaction_log(category, symbol, start, now, cursor, "SETTLEMENT");
-                    try {
-                        auto j = nlohmann::json::parse(resp);
-                        if (!j.contains("retCode") || j["retCode"].get<int>() != 0) break;
-
-                        if (j.contains("result") && j["result"].contains("list") && j["result"]["list"].is_array()) {
-                            for (auto &e : j["result"]["list"]) {
-                                if (e.contains("symbol") && e["symbol"].is_string()) {
-                                    if (e["symbol"].get<std::string>() != symbol) continue;
-                                }
-                                if (e.contains("funding")) {
-                                    funding += get_num_safe(e["funding"]);
-                                    funding_count++;
-                                }
-                            }
-                        }
-
-                        std::string next;
-                        if (j.contains("result") && j["result"].contains("nextPageCursor") && j["result"]["nextPageCursor"].is_string()) {
-                            next = j["result"]["nextPageCursor"].get<std::string>();
-                        }
-
-                        fund_pages++;
-                        if (next.empty()) break;
-                        cursor = next;
-                        if (fund_pages > 50) break;
-                    } catch (...) { break; }
-                }
-            }
+            const auto fund_res = history.fetch(
+                history_query(HistorySync::Kind::FUNDING, category, symbol, start, now),
+                [&](const nlohmann::json& e) {
+                    if (!is_funding_for(e, symbol)) return;
+                    funding += get_num_safe(e["funding"]);
+                    funding_count++;
+                },
+                [&](const nlohmann::json& e) { return make_fund_dedupe_key(e, symbol); });
+            const int fund_pages = fund_res.pages;
 
             double net_window_cashflow = fees + funding;
             double net_mixed_view = uPnL + cumRealisedPnl + fees + funding;
@@ -1177,7 +1278,7 @@ int main() {
             out["net_window_cashflow"] = net_window_cashflow;
             out["net_mixed_view"] = net_mixed_view;
 
-            std::cout << out.dump() << "\n";
+            OutLine() << out.dump() << "\n";
             continue;
         }
 
@@ -1188,65 +1289,40 @@ int main() {
             std::cin >> category >> symbol >> minutes;
 
             if (!bybit.ready()) {
-                std::cout << "Set BYBIT_API_KEY and BYBIT_API_SECRET first.\n";
+                OutLine() << "Set BYBIT_API_KEY and BYBIT_API_SECRET first.\n";
                 continue;
             }
 
             long long now = now_ms_local();
             long long start = now - (long long)minutes * 60 * 1000;
 
-            std::string cursor;
-            int pages = 0;
-            long long fetched = 0;
             long long appended = 0;
             long long dupes = 0;
 
-            while (true) {
-                std::string resp = bybit.get_executions(category, symbol, start, cursor);
-
-                try {
-                    auto j = nlohmann::json::parse(resp);
-                    if (!j.contains("retCode") || j["retCode"].get<int>() != 0) {
-                        std::cout << resp << "\n";
-                        break;
-                    }
-
-                    if (j.contains("result") && j["result"].contains("list") && j["result"]["list"].is_array()) {
-                        for (auto &e : j["result"]["list"]) {
-                            fetched++;
-                            bool ok = append_execution_to_ledger(e, category, symbol);
-                            if (ok) appended++;
-                            else dupes++;
-                        }
-                    }
-
-                    std::string next;
-                    if (j.contains("result") && j["result"].contains("nextPageCursor") && j["result"]["nextPageCursor"].is_string()) {
-                        next = j["result"]["nextPageCursor"].get<std::string>();
-                    }
-
-                    pages++;
-                    if (next.empty()) break;
-                    cursor = next;
-
-                    if (pages > 50) break;
-                } catch (...) {
-                    std::cout << resp << "\n";
-                    break;
-                }
-            }
+            const auto res = history.sync(
+                history_query(HistorySync::Kind::EXECUTIONS, category, symbol, start, now),
+                [&](const nlohmann::json& e) {
+                    if (record_execution(e, category, symbol)) appended++;
+                    else dupes++;
+                });
+            if (!res.error.empty()) OutLine() << res.error << "\n";
 
             nlohmann::json out;
             out["symbol"] = symbol;
             out["window_minutes"] = minutes;
-            out["pages"] = pages;
-            out["fetched"] = fetched;
+            out["from_ms"] = res.from_ms;
+            out["synced_to_ms"] = res.covered_to;
+            out["complete"] = res.complete;
+            out["slices"] = res.slices;
+            out["pages"] = res.pages;
+            out["retries"] = res.retries;
+            out["fetched"] = res.delivered;
             out["appended"] = appended;
             out["duplicates_or_skipped"] = dupes;
-            out["ledger_path"] = LEDGER_PATH;
-            out["seen_exec_ids"] = (long long)g_seen_exec_ids.size();
+            out["ledger_path"] = g_exec_ledger.path();
+            out["seen_exec_ids"] = (long long)g_exec_ledger.size();
 
-            std::cout << out.dump() << "\n";
+            OutLine() << out.dump() << "\n";
             continue;
         }
 
@@ -1257,70 +1333,44 @@ int main() {
             std::cin >> category >> symbol >> minutes;
 
             if (!bybit.ready()) {
-                std::cout << "Set BYBIT_API_KEY and BYBIT_API_SECRET first.\n";
+                OutLine() << "Set BYBIT_API_KEY and BYBIT_API_SECRET first.\n";
                 continue;
             }
 
             long long now = now_ms_local();
             long long start = now - (long long)minutes * 60 * 1000;
 
-            std::string cursor;
-            int pages = 0;
             long long fetched = 0;
             long long appended = 0;
             long long dupes = 0;
 
-            while (true) {
-                std::string resp = bybit.get_transaction_log(category, symbol, start, now, cursor, "SETTLEMENT");
-
-                try {
-                    auto j = nlohmann::json::parse(resp);
-                    if (!j.contains("retCode") || !j["retCode"].is_number() || j["retCode"].get<int>() != 0) {
-                        std::cout << resp << "\n";
-                        break;
-                    }
-
-                    if (j.contains("result") && j["result"].contains("list") && j["result"]["list"].is_array()) {
-                        for (auto &e : j["result"]["list"]) {
-                            if (e.contains("symbol") && e["symbol"].is_string()) {
-                                if (e["symbol"].get<std::string>() != symbol) continue;
-                            }
-                            if (!e.contains("funding")) continue;
-
-                            fetched++;
-                            bool ok = append_funding_to_ledger(e, category, symbol);
-                            if (ok) appended++;
-                            else dupes++;
-                        }
-                    }
-
-                    std::string next;
-                    if (j.contains("result") && j["result"].contains("nextPageCursor") && j["result"]["nextPageCursor"].is_string()) {
-                        next = j["result"]["nextPageCursor"].get<std::string>();
-                    }
-
-                    pages++;
-                    if (next.empty()) break;
-                    cursor = next;
-
-                    if (pages > 50) break;
-                } catch (...) {
-                    std::cout << resp << "\n";
-                    break;
-                }
-            }
+            const auto res = history.sync(
+                history_query(HistorySync::Kind::FUNDING, category, symbol, start, now),
+                [&](const nlohmann::json& e) {
+                    if (!is_funding_for(e, symbol)) return;
+                    fetched++;
+                    if (append_funding_to_ledger(e, category, symbol)) appended++;
+                    else dupes++;
+                },
+                [&](const nlohmann::json& e) { return make_fund_dedupe_key(e, symbol); });
+            if (!res.error.empty()) OutLine() << res.error << "\n";
 
             nlohmann::json out;
             out["symbol"] = symbol;
             out["window_minutes"] = minutes;
-            out["pages"] = pages;
+            out["from_ms"] = res.from_ms;
+            out["synced_to_ms"] = res.covered_to;
+            out["complete"] = res.complete;
+            out["slices"] = res.slices;
+            out["pages"] = res.pages;
+            out["retries"] = res.retries;
             out["fetched"] = fetched;
             out["appended"] = appended;
             out["duplicates_or_skipped"] = dupes;
             out["ledger_path"] = FUND_LEDGER_PATH;
             out["seen_fund_ids"] = (long long)g_seen_fund_ids.size();
 
-            std::cout << out.dump() << "\n";
+            OutLine() << out.dump() << "\n";
             continue;
         }
 
@@ -1333,7 +1383,7 @@ int main() {
 
             auto out = sum_exec_fees_from_ledger(symbol, start_ms, end_ms);
             out["window_minutes"] = minutes;
-            std::cout << out.dump() << "\n";
+            OutLine() << out.dump() << "\n";
             continue;
         }
 
@@ -1346,7 +1396,7 @@ int main() {
 
             auto out = sum_funding_from_ledger(symbol, start_ms, end_ms);
             out["window_minutes"] = minutes;
-            std::cout << out.dump() << "\n";
+            OutLine() << out.dump() << "\n";
             continue;
         }
 
@@ -1356,7 +1406,7 @@ int main() {
             std::cin >> category >> symbol >> minutes;
 
             if (!bybit.ready()) {
-                std::cout << "Set BYBIT_API_KEY and BYBIT_API_SECRET first.\n";
+                OutLine() << "Set BYBIT_API_KEY and BYBIT_API_SECRET first.\n";
                 continue;
             }
 
@@ -1371,7 +1421,7 @@ int main() {
                 try {
                     auto j = nlohmann::json::parse(resp);
                     if (!j.contains("retCode") || j["retCode"].get<int>() != 0) {
-                        std::cout << resp << "\n";
+                        OutLine() << resp << "\n";
                         continue;
                     }
                     auto &list = j["result"]["list"];
@@ -1379,7 +1429,7 @@ int main() {
                         nlohmann::json out;
                         out["symbol"] = symbol;
                         out["error"] = "no position data";
-                        std::cout << out.dump() << "\n";
+                        OutLine() << out.dump() << "\n";
                         continue;
                     }
 
@@ -1391,7 +1441,7 @@ int main() {
                     uPnL = get_num_safe(p.value("unrealisedPnl", "0"));
                     cumRealisedPnl = get_num_safe(p.value("cumRealisedPnl", "0"));
                 } catch (...) {
-                    std::cout << resp << "\n";
+                    OutLine() << resp << "\n";
                     continue;
                 }
             }
@@ -1425,7 +1475,7 @@ int main() {
             out["net_window_cashflow_ledger"] = net_window_cashflow;
             out["net_mixed_view_ledger"] = net_mixed_view;
 
-            std::cout << out.dump() << "\n";
+            OutLine() << out.dump() << "\n";
             continue;
         }
 
@@ -1439,7 +1489,7 @@ int main() {
             std::cin >> category >> symbol >> minutes;
 
             if (!bybit.ready()) {
-                std::cout << "Set BYBIT_API_KEY and BYBIT_API_SECRET first.\n";
+                OutLine() << "Set BYBIT_API_KEY and BYBIT_API_SECRET first.\n";
                 continue;
             }
 
@@ -1448,70 +1498,25 @@ int main() {
 
             double api_fees = 0.0;
             long long api_exec_count = 0;
-            int api_fee_pages = 0;
-            {
-                std::string cursor;
-                while (true) {
-                    std::string resp = bybit.get_executions(category, symbol, start_ms, cursor);
-                    try {
-                        auto j = nlohmann::json::parse(resp);
-                        if (!j.contains("retCode") || j["retCode"].get<int>() != 0) break;
-
-                        if (j.contains("result") && j["result"].contains("list") && j["result"]["list"].is_array()) {
-                            for (auto &e : j["result"]["list"]) {
-                                if (e.contains("execFee")) api_fees += get_num_safe(e["execFee"]);
-                                api_exec_count++;
-                            }
-                        }
-
-                        std::string next;
-                        if (j.contains("result") && j["result"].contains("nextPageCursor") && j["result"]["nextPageCursor"].is_string())
-                            next = j["result"]["nextPageCursor"].get<std::string>();
-
-                        api_fee_pages++;
-                        if (next.empty()) break;
-                        cursor = next;
-
-                        if (api_fee_pages > 50) break;
-                    } catch (...) { break; }
-                }
-            }
+            const auto fee_res = history.fetch(
+                history_query(HistorySync::Kind::EXECUTIONS, category, symbol, start_ms, end_ms),
+                [&](const nlohmann::json& e) {
+                    if (e.contains("execFee")) api_fees += get_num_safe(e["execFee"]);
+                    api_exec_count++;
+                });
+            const int api_fee_pages = fee_res.pages;
 
             double api_funding = 0.0;
             long long api_fund_count = 0;
-            int api_fund_pages = 0;
-            {
-                std::string cursor;
-                while (true) {
-                    std::string resp = bybit.get_transaction_log(category, symbol, start_ms, end_ms, cursor, "SETTLEMENT");
-                    try {
-                        auto j = nlohmann::json::parse(resp);
-                        if (!j.contains("retCode") || j["retCode"].get<int>() != 0) break;
-
-                        if (j.contains("result") && j["result"].contains("list") && j["result"]["list"].is_array()) {
-                            for (auto &e : j["result"]["list"]) {
-                                if (e.contains("symbol") && e["symbol"].is_string()) {
-                                    if (e["symbol"].get<std::string>() != symbol) continue;
-                                }
-                                if (e.contains("funding")) {
-                                    api_funding += get_num_safe(e["funding"]);
-                                    api_fund_count++;
-                                }
-                            }
-                        }
-
-                        std::string next;
-                        if (j.contains("result") && j["result"].contains("nextPageCursor") && j["result"]["nextPageCursor"].is_string())
-                            next = j["result"]["nextPageCursor"].get<std::string>();
-
-                        api_fund_pages++;
-                        if (next.empty()) break;
-                        cursor = next;
-
-                        if (api_fund_pages > 50) break;
-                    } catch (...) { break; }
-                }
-            }
+            const auto fund_res = history.fetch(
+                history_query(HistorySync::Kind::FUNDING, category, symbol, start_ms, end_ms),
+                [&](const nlohmann::json& e) {
+                    if (!is_funding_for(e, symbol)) return;
+                    api_funding += get_num_safe(e["funding"]);
+                    api_fund_count++;
+                },
+                [&](const nlohmann::json& e) { return make_fund_dedupe_key(e, symbol); });
+            const int api_fund_pages = fund_res.pages;
 
             auto ledFees = sum_exec_fees_from_ledger(symbol, start_ms, end_ms);
             auto ledFund = sum_funding_from_ledger(symbol, start_ms, end_ms);
@@ -1546,12 +1551,18 @@ int main() {
             out["delta_funding"] = (led_funding - api_funding);
             out["delta_funding_count"] = (led_fund_count - api_fund_count);
 
-            out["ok"] = (std::abs(out["delta_fees"].get<double>()) < 1e-9) &&
+            // a window the API did not return in full cannot reconcile
+            out["api_complete"] = fee_res.complete && fund_res.complete;
+            if (!fee_res.error.empty()) out["api_fee_error"] = fee_res.error;
+            if (!fund_res.error.empty()) out["api_funding_error"] = fund_res.error;
+
+            out["ok"] = out["api_complete"].get<bool>() &&
+                        (std::abs(out["delta_fees"].get<double>()) < 1e-9) &&
                         (std::abs(out["delta_funding"].get<double>()) < 1e-9) &&
                         (out["delta_exec_count"].get<long long>() == 0) &&
                         (out["delta_funding_count"].get<long long>() == 0);
 
-            std::cout << out.dump() << "\n";
+            OutLine() << out.dump() << "\n";
             continue;
         }
 
@@ -1560,32 +1571,24 @@ int main() {
             std::string category, symbol;
             std::cin >> category >> symbol;
 
-            auto execs = load_execs_from_ledger(category, symbol);
-
-            std::vector<Lot> lots;
-            long long closed_events = 0;
-            double gross_sum = 0.0;
-            double net_sum = 0.0;
-
-            for (auto& e : execs) {
-                process_fill_and_emit_trades(category, symbol, e, lots, closed_events, gross_sum, net_sum);
-            }
+            LotSyncStats st;
+            const LotBook& book = sync_lot_book(category, symbol, st);
 
             double long_qty = 0.0, short_qty = 0.0;
             double long_notional = 0.0, short_notional = 0.0;
-            for (auto& l : lots) {
-                if (l.side == LotSide::LONG)  { long_qty += l.qty;  long_notional += l.qty * l.px; }
-                if (l.side == LotSide::SHORT) { short_qty += l.qty; short_notional += l.qty * l.px; }
-            }
+            for (auto& l : book.longs)  { long_qty += l.qty;  long_notional += l.qty * l.px; }
+            for (auto& l : book.shorts) { short_qty += l.qty; short_notional += l.qty * l.px; }
 
             nlohmann::json out;
             out["symbol"] = symbol;
             out["category"] = category;
-            out["execs_loaded"] = (long long)execs.size();
+            out["execs_loaded"] = st.applied;
+            out["execs_total"] = (long long)book.fills;
+            out["rebuilt"] = st.rebuilt;
 
-            out["trade_close_events_appended_or_existing"] = closed_events;
-            out["gross_realized_sum_new_appends"] = gross_sum;
-            out["net_realized_sum_new_appends"] = net_sum;
+            out["trade_close_events_appended_or_existing"] = st.closed_events;
+            out["gross_realized_sum_new_appends"] = st.gross_realized_sum;
+            out["net_realized_sum_new_appends"] = st.net_realized_sum;
 
             out["open_long_qty"] = long_qty;
             out["open_short_qty"] = short_qty;
@@ -1595,7 +1598,7 @@ int main() {
             out["trade_ledger_path"] = TRADE_LEDGER_PATH;
             out["seen_trade_ids"] = (long long)g_seen_trade_ids.size();
 
-            std::cout << out.dump() << "\n";
+            OutLine() << out.dump() << "\n";
             continue;
         }
 
@@ -1609,7 +1612,7 @@ int main() {
 
             auto out = sum_realized_from_trade_ledger(symbol, start_ms, end_ms);
             out["window_minutes"] = minutes;
-            std::cout << out.dump() << "\n";
+            OutLine() << out.dump() << "\n";
             continue;
         }
 
@@ -1618,34 +1621,32 @@ int main() {
             std::string category, symbol;
             std::cin >> category >> symbol;
 
-            auto execs = load_execs_from_ledger(category, symbol);
-            std::vector<Lot> lots;
-
-            long long dummy_closed = 0;
-            double dummy_gross = 0.0, dummy_net = 0.0;
-
-            for (auto& e : execs) {
-                process_fill_and_emit_trades(category, symbol, e, lots, dummy_closed, dummy_gross, dummy_net);
-            }
+            LotSyncStats st;
+            const LotBook& book = sync_lot_book(category, symbol, st);
 
             nlohmann::json out;
             out["symbol"] = symbol;
             out["category"] = category;
-            out["execs_loaded"] = (long long)execs.size();
+            out["execs_loaded"] = st.applied;
+            out["execs_total"] = (long long)book.fills;
 
             nlohmann::json arr = nlohmann::json::array();
-            for (auto& l : lots) {
-                nlohmann::json j;
-                j["side"] = lot_side_str(l.side);
-                j["qty"] = l.qty;
-                j["px"] = l.px;
-                j["open_execId"] = l.execId;
-                j["open_ts_ms"] = l.ts_ms;
-                j["open_fee_rem"] = l.fee_rem;
-                arr.push_back(j);
-            }
+            auto add_lots = [&](const std::deque<Lot>& lots) {
+                for (auto& l : lots) {
+                    nlohmann::json j;
+                    j["side"] = lot_side_str(l.side);
+                    j["qty"] = l.qty;
+                    j["px"] = l.px;
+                    j["open_execId"] = l.execId;
+                    j["open_ts_ms"] = l.ts_ms;
+                    j["open_fee_rem"] = l.fee_rem;
+                    arr.push_back(j);
+                }
+            };
+            add_lots(book.longs);
+            add_lots(book.shorts);
             out["open_lots"] = arr;
-            std::cout << out.dump() << "\n";
+            OutLine() << out.dump() << "\n";
             continue;
         }
 
@@ -1656,7 +1657,7 @@ int main() {
             std::cin >> category >> symbol >> minutes;
 
             if (!bybit.ready()) {
-                std::cout << "Set BYBIT_API_KEY and BYBIT_API_SECRET first.\n";
+                OutLine() << "Set BYBIT_API_KEY and BYBIT_API_SECRET first.\n";
                 continue;
             }
 
@@ -1672,7 +1673,7 @@ int main() {
                 try {
                     auto j = nlohmann::json::parse(resp);
                     if (!j.contains("retCode") || j["retCode"].get<int>() != 0) {
-                        std::cout << resp << "\n";
+                        OutLine() << resp << "\n";
                         continue;
                     }
                     auto &list = j["result"]["list"];
@@ -1680,7 +1681,7 @@ int main() {
                         nlohmann::json out;
                         out["symbol"] = symbol;
                         out["error"] = "no position data";
-                        std::cout << out.dump() << "\n";
+                        OutLine() << out.dump() << "\n";
                         continue;
                     }
                     auto &p = list[0];
@@ -1692,7 +1693,7 @@ int main() {
                     uPnL = get_num_safe(p.value("unrealisedPnl", "0"));
                     cumRealisedPnl_api = get_num_safe(p.value("cumRealisedPnl", "0"));
                 } catch (...) {
-                    std::cout << resp << "\n";
+                    OutLine() << resp << "\n";
                     continue;
                 }
             }
@@ -1742,7 +1743,7 @@ int main() {
             out["delta_realized_api_minus_ledger_all"] = delta_realized;
             out["ok_realized"] = ok_realized;
 
-            std::cout << out.dump() << "\n";
+            OutLine() << out.dump() << "\n";
             continue;
         }
 
@@ -1752,56 +1753,72 @@ int main() {
         std::cin >> category >> symbol >> qty;
 
         if (!bybit.ready()) {
-            std::cout << "Set BYBIT_API_KEY and BYBIT_API_SECRET first.\n";
+            OutLine() << "Set BYBIT_API_KEY and BYBIT_API_SECRET first.\n";
             continue;
         }
 
-        double bid=0.0, ask=0.0;
-        { std::lock_guard<std::mutex> lk(g_px_mtx); bid=g_last_bid; ask=g_last_ask; }
-
-        if (bid <= 0.0 || ask <= 0.0) {
-            std::cout << "No bid/ask yet. Wait for ZMQ ticks then run: px\n";
+        TopOfBookCache::Quote q;
+        if (!g_tob.load(g_tob.find(px_exchange, symbol), q) || q.bid <= 0.0 || q.ask <= 0.0) {
+            OutLine() << "No bid/ask for " << symbol << " yet. Wait for ZMQ ticks then run: px\n";
             continue;
         }
+        const double bid = q.bid, ask = q.ask;
+        const TraceContext tr = q.trace;
+
+        // Acks come back on the gateway / ws thread; the prompt is free for the next order
+        if (cmd == "buy" || cmd == "sell") {
+            const bool buy = cmd == "buy";
+            PreTradeRisk::Hold hold;
+            const unsigned rej = g_risk.check_and_reserve(risk_id(category, symbol), buy, qty,
+                                                          buy ? ask : bid, trace_now_ns(), hold);
+            if (rej) {
+                OutLine() << "{\"error\":\"risk\",\"reject\":\"" << PreTradeRisk::describe(rej) << "\"}\n";
+                continue;
+            }
 
-        if (cmd == "buy") {
-            std::string resp = bybit.place_limit_order(category, symbol, "Buy", qty, ask);
-            std::cout << resp << "\n";
-            try {
-                auto j = nlohmann::json::parse(resp);
-                if (j.contains("retCode") && j["retCode"].is_number() && j["retCode"].get<int>() == 0) {
-                    auto oid = j["result"]["orderId"].get<std::string>();
-                    track_order(oid, category, symbol);
-                    std::cout << "[TRACK] orderId=" << oid << "\n";
-                }
-            } catch (...) {}
-        } else if (cmd == "sell") {
-            std::string resp = bybit.place_limit_order(category, symbol, "Sell", qty, bid);
-            std::cout << resp << "\n";
-            try {
-                auto j = nlohmann::json::parse(resp);
-                if (j.contains("retCode") && j["retCode"].is_number() && j["retCode"].get<int>() == 0) {
-                    auto oid = j["result"]["orderId"].get<std::string>();
-                    track_order(oid, category, symbol);
-                    std::cout << "[TRACK] orderId=" << oid << "\n";
-                }
-            } catch (...) {}
+            sent_keys.insert(category + "|" + symbol);
+            auto cb = [category, symbol, tr, hold](std::string resp) { on_order_ack(resp, category, symbol, tr, hold); };
+            if (ws.ready()) ws.place_limit_order(category, symbol, buy ? "Buy" : "Sell", qty, buy ? ask : bid, "GTC", cb);
+            else            bybit.place_limit_order_async(category, symbol, buy ? "Buy" : "Sell", qty, buy ? ask : bid, "GTC", cb);
         } else {
-            std::cout << "Unknown command.\n";
+            OutLine() << "Unknown command.\n";
         }
     }
 
-    // Kill-switch cancel-all before exit
+    // Kill-switch cancel-all before exit: every cancel in flight at once.
+    // Orders still waiting for their ack are not in g_open_orders yet, so
+    // wait (KILL_DRAIN_MS, default 3000) for REST and websocket requests to
+    // complete first; if some never do, cancel-all every symbol this session
+    // sent orders for (and no other: resting orders elsewhere are not ours).
     if (bybit.ready()) {
+        const auto drain_until = std::chrono::steady_clock::now() +
+                                 std::chrono::milliseconds(std::stol(env_or("KILL_DRAIN_MS", "3000")));
+        auto in_flight = [&] { return bybit.http_stats().async_in_flight + ws.stats().in_flight; };
+        while (in_flight() > 0 && std::chrono::steady_clock::now() < drain_until)
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+        if (const std::uint64_t left = in_flight()) {
+            OutLine() << "[KILL] " << left << " requests still unacked; cancelling all orders per symbol\n";
+            for (const std::string& key : sent_keys) {
+                const auto bar = key.find('|');
+                OutLine() << "[KILL] cancel-all " << key << "\n"
+                          << bybit.cancel_all_orders(key.substr(0, bar), key.substr(bar + 1)) << "\n";
+            }
+        }
+
         auto open = snapshot_open_orders();
-        for (auto &it : open) {
-            const std::string &oid = it.first;
-            const auto &info = it.second;
-            std::cout << "[KILL] cancel orderId=" << oid << "\n";
-            std::cout << bybit.cancel_order(info.category, info.symbol, oid) << "\n";
+        std::vector<BybitDemoClient::CancelRequest> reqs;
+        reqs.reserve(open.size());
+        for (auto &it : open) reqs.push_back({it.second.category, it.second.symbol, it.first});
+
+        const auto resps = bybit.cancel_orders(reqs);
+        for (std::size_t i = 0; i < resps.size(); ++i) {
+            OutLine() << "[KILL] cancel orderId=" << reqs[i].orderId << "\n";
+            OutLine() << resps[i] << "\n";
         }
     }
 
+    ws.stop();
     running = false;
     try { sub.close(); } catch (...) {}
     if (rx.joinable()) rx.join();
@@ -0,0 +1,55 @@
+#include "top_of_book_cache.hpp"
+
+#include <charconv>
+
+// Position just past `"key":` at or after from, npos if absent
+static std::size_t after_key(std::string_view s, std::string_view key, std::size_t from = 0) {
+    std::size_t p = from;
+    while ((p = s.find(key, p)) != std::string_view::npos) {
+        const std::size_t q = p + key.size();
+        if (p > 0 && s[p - 1] == '"' && q + 1 < s.size() && s[q] == '"' && s[q + 1] == ':') return q + 2;
+        p = q;
+    }
+    return std::string_view::npos;
+}
+
+static bool scan_string(std::string_view s, std::string_view key, std::string_view& out) {
+    std::size_t p = after_key(s, key);
+    if (p == std::string_view::npos || p >= s.size() || s[p] != '"') return false;
+    const std::size_t e = s.find('"', ++p);
+    if (e == std::string_view::npos) return false;
+    out = s.substr(p, e - p);
+    return true;
+}
+
+template <class T>
+static bool scan_number(std::string_view s, std::string_view key, T& out, std::size_t from = 0) {
+    const std::size_t p = after_key(s, key, from);
+    if (p == std::string_view::npos) return false;
+    const char* end = s.data() + s.size();
+    return std::from_chars(s.data() + p, end, out).ec == std::errc();
+}
+
+bool scan_market_state(std::string_view s, MarketStateTob& out) {
+    if (!scan_string(s, "exchange", out.exchange) || !scan_string(s, "instrument", out.instrument))
+        return false;
+    if (!scan_number(s, "ts_ms", out.ts_ms)) out.ts_ms = 0;
+
+    const std::size_t tob = after_key(s, "top_of_book");
+    if (tob == std::string_view::npos) return false;
+    if (!scan_number(s, "bid", out.bid, tob) || !scan_number(s, "ask", out.ask, tob)) return false;
+
+    // hft_feeds writes "trace" before "top_of_book", only on the first
+    // snapshot that carries a quote
+    out.trace = TraceContext{};
+    const std::size_t tr = after_key(s.substr(0, tob), "trace");
+    if (tr != std::string_view::npos) {
+        const std::string_view t = s.substr(tr, tob - tr);
+        scan_number(t, "id", out.trace.id);
+        scan_number(t, "recv_ns", out.trace.recv_ns);
+        scan_number(t, "quote_ns", out.trace.quote_ns);
+        scan_number(t, "snap_ns", out.trace.snap_ns);
+        scan_number(t, "pub_ns", out.trace.pub_ns);
+    }
+    return true;
+}
@@ -0,0 +1,133 @@
+#include "window_sums.hpp"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+
+WindowSums::WindowSums(std::string idx_path) : idx_path_(std::move(idx_path)) {}
+
+bool WindowSums::load() {
+    by_symbol_.clear();
+    n_points_ = 0;
+    mark_ = 0;
+    if (out_.is_open()) out_.close();
+
+    std::ifstream in(idx_path_, std::ios::binary);
+    const bool found = in.good();
+
+    std::uint64_t valid_bytes = 0;
+    std::string line;
+    while (found && std::getline(in, line)) {
+        if (in.eof()) break;   // no trailing newline: torn write
+
+        char* p = line.data();
+        char* end = nullptr;
+        const std::uint64_t mark = std::strtoull(p, &end, 10);
+        if (end == p) break;
+        p = end;
+        const std::int64_t ts = std::strtoll(p, &end, 10);
+        if (end == p) break;
+        p = end;
+
+        Values v{};
+        bool ok = true;
+        for (double& x : v) {
+            x = std::strtod(p, &end);
+            if (end == p) { ok = false; break; }
+            p = end;
+        }
+        if (!ok || *p != ' ' || p[1] == '\0') break;
+
+        insert_point(std::string(p + 1), ts, v);
+        mark_ = mark;
+        valid_bytes += line.size() + 1;
+    }
+    in.close();
+
+    std::error_code ec;
+    if (found && std::filesystem::file_size(idx_path_, ec) != valid_bytes && !ec) {
+        std::cerr << "[WindowSums] " << idx_path_ << ": dropping bytes after " << valid_bytes << "\n";
+        std::filesystem::resize_file(idx_path_, valid_bytes, ec);
+    }
+
+    out_.open(idx_path_, std::ios::binary | std::ios::app);
+    return found;
+}
+
+void WindowSums::reset() {
+    by_symbol_.clear();
+    n_points_ = 0;
+    mark_ = 0;
+    if (out_.is_open()) out_.close();
+    out_.open(idx_path_, std::ios::binary | std::ios::trunc);
+}
+
+void WindowSums::insert_point(const std::string& symbol, std::int64_t ts_ms, const Values& v) {
+    auto& pts = by_symbol_[symbol];
+    n_points_++;
+
+    if (pts.empty() || pts.back().ts_ms <= ts_ms) {
+        Point p{ts_ms, v};
+        if (!pts.empty())
+            for (int i = 0; i < N_VALUES; ++i) p.cum[i] += pts.back().cum[i];
+        pts.push_back(p);
+        return;
+    }
+
+    // Backfill: after any equal timestamps, then shift the later prefixes
+    auto it = std::upper_bound(pts.begin(), pts.end(), ts_ms,
+                               [](std::int64_t t, const Point& p) { return t < p.ts_ms; });
+    Point p{ts_ms, v};
+    if (it != pts.begin())
+        for (int i = 0; i < N_VALUES; ++i) p.cum[i] += std::prev(it)->cum[i];
+    it = pts.insert(it, p);
+    for (++it; it != pts.end(); ++it)
+        for (int i = 0; i < N_VALUES; ++i) it->cum[i] += v[i];
+}
+
+void WindowSums::add(const std::string& symbol, std::int64_t ts_ms, const Values& v, std::uint64_t mark) {
+    insert_point(symbol, ts_ms, v);
+    mark_ = std::max(mark_, mark);
+
+    if (!out_.is_open()) return;
+    char buf[160];
+    const int n = std::snprintf(buf, sizeof(buf), "%" PRIu64 " %" PRId64 " %.17g %.17g ",
+                                mark, ts_ms, v[0], v[1]);
+    out_.write(buf, n);
+    out_ << symbol << '\n';
+}
+
+void WindowSums::flush() {
+    if (out_.is_open()) out_.flush();
+}
+
+WindowSums::Window WindowSums::query(const std::string& symbol, std::int64_t from_ms, std::int64_t to_ms) const {
+    Window w;
+    auto s = by_symbol_.find(symbol);
+    if (s == by_symbol_.end() || from_ms > to_ms) return w;
+    const auto& pts = s->second;
+
+    const auto lo = std::lower_bound(pts.begin(), pts.end(), from_ms,
+                                     [](const Point& p, std::int64_t t) { return p.ts_ms < t; });
+    const auto hi = std::upper_bound(lo, pts.end(), to_ms,
+                                     [](std::int64_t t, const Point& p) { return t < p.ts_ms; });
+    w.count = hi - lo;
+    if (w.count == 0) return w;
+
+    for (int i = 0; i < N_VALUES; ++i) {
+        w.sum[i] = std::prev(hi)->cum[i] - (lo == pts.begin() ? 0.0 : std::prev(lo)->cum[i]);
+    }
+    return w;
+}
+
+WindowSums::Window WindowSums::total(const std::string& symbol) const {
+    Window w;
+    auto s = by_symbol_.find(symbol);
+    if (s == by_symbol_.end() || s->second.empty()) return w;
+    w.sum = s->second.back().cum;
+    w.count = static_cast<std::int64_t>(s->second.size());
+    return w;
+}
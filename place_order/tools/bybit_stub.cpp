@@ -0,0 +1,437 @@
+// bybit_stub: local HTTPS stand-in for the Bybit v5 REST endpoints BybitDemoClient uses.
+//
+// Usage: bybit_stub [--port 8443] [--cert-out bybit_stub.pem] [--secret S] [--delay-ms 0]
+//                   [--history-per-hour 0] [--history-days 30] [--rate-limit 0]
+//
+// Generates a throwaway self-signed certificate for localhost / 127.0.0.1 and
+// writes it to --cert-out. Point place_order at it with:
+//   BYBIT_BASE_URL=https://127.0.0.1:8443 BYBIT_CA_FILE=bybit_stub.pem place_order
+//
+// HTTP/1.1 keep-alive, one thread per connection. Every closed connection logs
+// how many requests it carried, so connection reuse shows up directly.
+//
+//   --secret    verify X-BAPI-SIGN with this API secret (retCode 10004 on mismatch)
+//   --delay-ms  sleep before every response (server-side processing time)
+//   --history-per-hour  synthetic fills per hour over the last --history-days
+//               (plus a funding settlement every 8h) for /v5/execution/list and
+//               /v5/account/transaction-log, newest first, cursor-paginated,
+//               windows over 7 days rejected like the exchange does
+//   --rate-limit  requests per second per route; X-Bapi-Limit* headers on
+//               every response, retCode 10006 past the limit
+//
+// Routes: GET /v5/market/time, POST /v5/order/create, POST /v5/order/cancel,
+// GET /v5/position/list, /v5/execution/list, /v5/account/transaction-log
+// (empty lists unless --history-per-hour). Anything else is a 404.
+
+#include <nlohmann/json.hpp>
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/pem.h>
+#include <openssl/ssl.h>
+#include <openssl/x509v3.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+
+using json = nlohmann::json;
+
+struct StubOptions {
+    unsigned short port = 8443;
+    std::string cert_out = "bybit_stub.pem";
+    std::string secret;
+    int delay_ms = 0;
+    int history_per_hour = 0;
+    int history_days = 30;
+    int rate_limit = 0;
+};
+
+static std::atomic<std::uint64_t> g_order_seq{0};
+static std::atomic<std::uint64_t> g_conn_seq{0};
+static std::mutex g_log_mtx;
+
+static long long now_ms() {
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
+}
+
+// ------------------------------------------------------------
+// Certificate
+// ------------------------------------------------------------
+static bool make_self_signed(SSL_CTX* ctx, const std::string& pem_path) {
+    EVP_PKEY* key = EVP_EC_gen("P-256");
+    X509* cert = X509_new();
+    if (!key || !cert) return false;
+
+    X509_set_version(cert, 2);
+    ASN1_INTEGER_set(X509_get_serialNumber(cert), static_cast<long>(now_ms() & 0x7fffffff));
+    X509_gmtime_adj(X509_getm_notBefore(cert), -60);
+    X509_gmtime_adj(X509_getm_notAfter(cert), 7 * 24 * 3600);
+    X509_set_pubkey(cert, key);
+
+    X509_NAME* name = X509_get_subject_name(cert);
+    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC,
+                               reinterpret_cast<const unsigned char*>("localhost"), -1, -1, 0);
+    X509_set_issuer_name(cert, name);
+
+    X509V3_CTX v3;
+    X509V3_set_ctx_nodb(&v3);
+    X509V3_set_ctx(&v3, cert, cert, nullptr, nullptr, 0);
+    for (const auto& [nid, value] : {std::pair<int, const char*>{NID_subject_alt_name, "DNS:localhost,IP:127.0.0.1"},
+                                     {NID_basic_constraints, "critical,CA:TRUE"}}) {
+        X509_EXTENSION* ext = X509V3_EXT_conf_nid(nullptr, &v3, nid, value);
+        if (!ext) return false;
+        X509_add_ext(cert, ext, -1);
+        X509_EXTENSION_free(ext);
+    }
+    if (!X509_sign(cert, key, EVP_sha256())) return false;
+
+    FILE* f = std::fopen(pem_path.c_str(), "w");
+    if (!f) {
+        std::cerr << "[STUB] cannot write " << pem_path << "\n";
+        return false;
+    }
+    PEM_write_X509(f, cert);
+    std::fclose(f);
+
+    const bool ok = SSL_CTX_use_certificate(ctx, cert) == 1 && SSL_CTX_use_PrivateKey(ctx, key) == 1;
+    X509_free(cert);
+    EVP_PKEY_free(key);
+    return ok;
+}
+
+// ------------------------------------------------------------
+// HTTP
+// ------------------------------------------------------------
+struct Request {
+    std::string method, target, path, query, body;
+    std::string api_key, sign, timestamp, recv_window;
+    bool keep_alive = true;
+};
+
+static std::string lower(std::string s) {
+    for (auto& c : s) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    return s;
+}
+
+// Reads one request; false on EOF / error. buf carries bytes past the request.
+static bool read_request(SSL* ssl, std::string& buf, Request& req) {
+    char chunk[4096];
+    std::size_t head_end;
+    while ((head_end = buf.find("\r\n\r\n")) == std::string::npos) {
+        const int n = SSL_read(ssl, chunk, sizeof(chunk));
+        if (n <= 0) return false;
+        buf.append(chunk, static_cast<std::size_t>(n));
+    }
+
+    std::istringstream head(buf.substr(0, head_end));
+    std::string line;
+    std::getline(head, line);
+    std::istringstream first(line);
+    std::string version;
+    first >> req.method >> req.target >> version;
+
+    const auto q = req.target.find('?');
+    req.path = req.target.substr(0, q);
+    req.query = q == std::string::npos ? "" : req.target.substr(q + 1);
+
+    std::size_t content_length = 0;
+    while (std::getline(head, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        const auto colon = line.find(':');
+        if (colon == std::string::npos) continue;
+        const std::string k = lower(line.substr(0, colon));
+        std::string v = line.substr(colon + 1);
+        while (!v.empty() && v.front() == ' ') v.erase(0, 1);
+
+        if (k == "content-length") content_length = std::stoul(v);
+        else if (k == "connection") req.keep_alive = lower(v) != "close";
+        else if (k == "x-bapi-api-key") req.api_key = v;
+        else if (k == "x-bapi-sign") req.sign = v;
+        else if (k == "x-bapi-timestamp") req.timestamp = v;
+        else if (k == "x-bapi-recv-window") req.recv_window = v;
+    }
+
+    buf.erase(0, head_end + 4);
+    while (buf.size() < content_length) {
+        const int n = SSL_read(ssl, chunk, sizeof(chunk));
+        if (n <= 0) return false;
+        buf.append(chunk, static_cast<std::size_t>(n));
+    }
+    req.body = buf.substr(0, content_length);
+    buf.erase(0, content_length);
+    return true;
+}
+
+static std::string hmac_hex(const std::string& key, const std::string& msg) {
+    unsigned char out[EVP_MAX_MD_SIZE];
+    unsigned int len = 0;
+    HMAC(EVP_sha256(), key.data(), static_cast<int>(key.size()),
+         reinterpret_cast<const unsigned char*>(msg.data()), msg.size(), out, &len);
+    std::ostringstream oss;
+    for (unsigned int i = 0; i < len; ++i)
+        oss << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(out[i]);
+    return oss.str();
+}
+
+static json envelope(int code, const std::string& msg, json result) {
+    return json{{"retCode", code}, {"retMsg", msg}, {"result", std::move(result)},
+                {"retExtInfo", json::object()}, {"time", now_ms()}};
+}
+
+static std::string query_param(const std::string& query, const std::string& name) {
+    std::size_t pos = 0;
+    while (pos <= query.size()) {
+        const std::size_t amp = std::min(query.find('&', pos), query.size());
+        const std::size_t eq = query.find('=', pos);
+        if (eq < amp && query.compare(pos, eq - pos, name) == 0) return query.substr(eq + 1, amp - eq - 1);
+        pos = amp + 1;
+    }
+    return "";
+}
+
+// Per-route one-second windows, reported the way Bybit does
+static bool take_rate_limit(const StubOptions& opt, const std::string& path, std::string& headers) {
+    if (opt.rate_limit <= 0) return true;
+
+    static std::mutex mtx;
+    static std::map<std::string, std::pair<long long, int>> windows;   // path -> (second, used)
+
+    std::lock_guard<std::mutex> lk(mtx);
+    const long long sec = now_ms() / 1000;
+    auto& w = windows[path];
+    if (w.first != sec) w = {sec, 0};
+    const bool ok = w.second < opt.rate_limit;
+    if (ok) ++w.second;
+
+    headers += "X-Bapi-Limit: " + std::to_string(opt.rate_limit) + "\r\n" +
+               "X-Bapi-Limit-Status: " + std::to_string(opt.rate_limit - w.second) + "\r\n" +
+               "X-Bapi-Limit-Reset-Timestamp: " + std::to_string((sec + 1) * 1000) + "\r\n";
+    return ok;
+}
+
+// Synthetic history: one record every step_ms on a fixed grid, newest
+// first; the cursor is the offset into the window
+static json history_page(const StubOptions& opt, const Request& req, bool funding, int& code, std::string& msg) {
+    const long long now = now_ms();
+    const long long step = funding ? 8LL * 3600 * 1000 : 3600LL * 1000 / opt.history_per_hour;
+    const long long first = now - static_cast<long long>(opt.history_days) * 24 * 3600 * 1000;
+
+    const std::string st = query_param(req.query, "startTime");
+    const std::string et = query_param(req.query, "endTime");
+    const std::string lim = query_param(req.query, "limit");
+    const std::string cur = query_param(req.query, "cursor");
+    const std::string symbol = query_param(req.query, "symbol");
+
+    const long long start = st.empty() ? now - 7LL * 24 * 3600 * 1000 : std::stoll(st);
+    const long long end = et.empty() ? start + 7LL * 24 * 3600 * 1000 : std::stoll(et);
+    if (end - start > 7LL * 24 * 3600 * 1000) {
+        code = 10001;
+        msg = "The time range between startTime and endTime cannot exceed 7 days";
+        return json::object();
+    }
+    const int limit = lim.empty() ? (funding ? 20 : 50) : std::stoi(lim);
+    const long long offset = cur.empty() ? 0 : std::stoll(cur);
+
+    // grid points in [max(start, first), min(end, now)], newest first
+    const long long lo = std::max(start, first);
+    const long long hi = std::min(end, now);
+    json list = json::array();
+    long long newest = hi - ((hi % step) + step) % step;
+    long long count = 0;
+    for (long long t = newest - offset * step; t >= lo && count < limit; t -= step, ++count) {
+        const long long k = t / step;
+        if (funding) {
+            list.push_back({{"id", "f" + std::to_string(t)}, {"symbol", symbol}, {"category", "linear"},
+                            {"type", "SETTLEMENT"}, {"transactionTime", std::to_string(t)},
+                            {"funding", "-0.05"}, {"currency", "USDT"}});
+        } else {
+            list.push_back({{"execId", "h" + std::to_string(t)}, {"symbol", symbol}, {"category", "linear"},
+                            {"orderId", "ho" + std::to_string(k / 4)}, {"side", k % 2 ? "Sell" : "Buy"},
+                            {"execPrice", "100"}, {"execQty", "0.1"}, {"execFee", "0.01"},
+                            {"feeCurrency", "USDT"}, {"execType", "Trade"}, {"orderType", "Limit"},
+                            {"execTime", std::to_string(t)}, {"seq", k}});
+        }
+    }
+    const long long next_t = newest - (offset + count) * step;
+    const std::string next = (count == limit && next_t >= lo) ? std::to_string(offset + count) : "";
+    code = 0;
+    msg = "OK";
+    return {{"list", list}, {"nextPageCursor", next}};
+}
+
+static int route(const StubOptions& opt, const Request& req, json& out, std::string& headers) {
+    if (req.path == "/v5/market/time") {
+        const long long ms = now_ms();
+        out = envelope(0, "OK", {{"timeSecond", std::to_string(ms / 1000)},
+                                 {"timeNano", std::to_string(ms * 1000000)}});
+        return 200;
+    }
+
+    // Everything else is signed: ts + key + recv_window + (body | query)
+    if (!opt.secret.empty()) {
+        const std::string payload = req.timestamp + req.api_key + req.recv_window +
+                                    (req.method == "POST" ? req.body : req.query);
+        if (req.sign != hmac_hex(opt.secret, payload)) {
+            out = envelope(10004, "error sign!", json::object());
+            return 200;
+        }
+    }
+
+    if (!take_rate_limit(opt, req.path, headers)) {
+        out = envelope(10006, "Too many visits!", json::object());
+        return 200;
+    }
+
+    if (req.method == "POST" && req.path == "/v5/order/create") {
+        out = envelope(0, "OK", {{"orderId", "stub-" + std::to_string(++g_order_seq)}, {"orderLinkId", ""}});
+        return 200;
+    }
+    if (req.method == "POST" && req.path == "/v5/order/cancel") {
+        std::string oid;
+        try {
+            oid = json::parse(req.body).value("orderId", "");
+        } catch (...) {}
+        out = envelope(0, "OK", {{"orderId", oid}, {"orderLinkId", ""}});
+        return 200;
+    }
+    if (req.method == "GET" && opt.history_per_hour > 0 &&
+        (req.path == "/v5/execution/list" || req.path == "/v5/account/transaction-log")) {
+        int code = 0;
+        std::string msg;
+        json result = history_page(opt, req, req.path != "/v5/execution/list", code, msg);
+        out = envelope(code, msg, std::move(result));
+        return 200;
+    }
+    if (req.method == "GET" && (req.path == "/v5/position/list" || req.path == "/v5/execution/list" ||
+                                req.path == "/v5/account/transaction-log")) {
+        out = envelope(0, "OK", {{"list", json::array()}, {"nextPageCursor", ""}});
+        return 200;
+    }
+
+    out = envelope(10001, "unknown route " + req.method + " " + req.path, json::object());
+    return 404;
+}
+
+static bool write_all(SSL* ssl, const std::string& s) {
+    std::size_t off = 0;
+    while (off < s.size()) {
+        const int n = SSL_write(ssl, s.data() + off, static_cast<int>(s.size() - off));
+        if (n <= 0) return false;
+        off += static_cast<std::size_t>(n);
+    }
+    return true;
+}
+
+static void serve(SSL_CTX* ctx, int fd, const StubOptions& opt) {
+    const std::uint64_t id = ++g_conn_seq;
+    const int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    SSL* ssl = SSL_new(ctx);
+    SSL_set_fd(ssl, fd);
+
+    std::uint64_t served = 0;
+    const auto t0 = std::chrono::steady_clock::now();
+    if (SSL_accept(ssl) == 1) {
+        std::string buf;
+        Request req;
+        while (read_request(ssl, buf, req)) {
+            json body;
+            std::string extra_headers;
+            const int status = route(opt, req, body, extra_headers);
+            if (opt.delay_ms > 0) std::this_thread::sleep_for(std::chrono::milliseconds(opt.delay_ms));
+
+            const std::string payload = body.dump();
+            std::ostringstream resp;
+            resp << "HTTP/1.1 " << status << (status == 200 ? " OK" : " Not Found") << "\r\n"
+                 << "Content-Type: application/json\r\n"
+                 << "Content-Length: " << payload.size() << "\r\n"
+                 << extra_headers
+                 << "Connection: " << (req.keep_alive ? "keep-alive" : "close") << "\r\n\r\n"
+                 << payload;
+            if (!write_all(ssl, resp.str())) break;
+            ++served;
+            if (!req.keep_alive) break;
+            req = Request{};
+        }
+        SSL_shutdown(ssl);
+    }
+    SSL_free(ssl);
+    close(fd);
+
+    const double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    std::lock_guard<std::mutex> lk(g_log_mtx);
+    std::cout << "[STUB] conn #" << id << " closed: " << served << " requests in "
+              << std::fixed << std::setprecision(1) << secs << "s\n";
+}
+
+static void usage() {
+    std::cerr << "Usage: bybit_stub [--port 8443] [--cert-out bybit_stub.pem] [--secret S] [--delay-ms 0]\n"
+                 "                  [--history-per-hour 0] [--history-days 30] [--rate-limit 0]\n";
+}
+
+int main(int argc, char** argv) {
+    StubOptions opt;
+    for (int i = 1; i < argc; ++i) {
+        const std::string a = argv[i];
+        const bool has_val = i + 1 < argc;
+        if (a == "--port" && has_val) opt.port = static_cast<unsigned short>(std::stoi(argv[++i]));
+        else if (a == "--cert-out" && has_val) opt.cert_out = argv[++i];
+        else if (a == "--secret" && has_val) opt.secret = argv[++i];
+        else if (a == "--delay-ms" && has_val) opt.delay_ms = std::stoi(argv[++i]);
+        else if (a == "--history-per-hour" && has_val) opt.history_per_hour = std::stoi(argv[++i]);
+        else if (a == "--history-days" && has_val) opt.history_days = std::stoi(argv[++i]);
+        else if (a == "--rate-limit" && has_val) opt.rate_limit = std::stoi(argv[++i]);
+        else {
+            usage();
+            return 1;
+        }
+    }
+
+    std::signal(SIGPIPE, SIG_IGN);
+
+    SSL_CTX* ctx = SSL_CTX_new(TLS_server_method());
+    if (!ctx || !make_self_signed(ctx, opt.cert_out)) {
+        ERR_print_errors_fp(stderr);
+        return 1;
+    }
+
+    const int lfd = socket(AF_INET, SOCK_STREAM, 0);
+    const int one = 1;
+    setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(opt.port);
+    if (bind(lfd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(lfd, 64) != 0) {
+        std::perror("[STUB] bind/listen");
+        return 1;
+    }
+
+    std::cout << "[STUB] https://127.0.0.1:" << opt.port << " cert=" << opt.cert_out
+              << (opt.secret.empty() ? " (signatures not checked)" : " (verifying signatures)") << "\n";
+
+    while (true) {
+        const int fd = accept(lfd, nullptr, nullptr);
+        if (fd < 0) continue;
+        std::thread(serve, ctx, fd, std::cref(opt)).detach();
+    }
+}
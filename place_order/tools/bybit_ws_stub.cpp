@@ -0,0 +1,375 @@
+// bybit_ws_stub: local stand-in for the Bybit v5 websockets BybitTradeWsClient uses.
+//
+// Usage: bybit_ws_stub [--port 9443] [--secret S] [--fill-ms 5] [--rest] [--delay-ms 0]
+//
+// Plain ws:// on 127.0.0.1, one io thread. The path picks the API:
+//   /v5/trade    auth, order.create, order.cancel, ping
+//   /v5/private  auth, subscribe (order / execution / position), ping
+// Point place_order at it with:
+//   BYBIT_WS_TRADE_URL=ws://127.0.0.1:9443/v5/trade
+//   BYBIT_WS_PRIVATE_URL=ws://127.0.0.1:9443/v5/private
+//
+// Every accepted order is acked at once and pushed as "New" on the private
+// streams; --fill-ms later it fills in full at its limit price (order
+// "Filled", one execution, the position) unless --rest keeps orders open
+// until cancelled.
+//
+//   --secret    verify the auth signature with this API secret
+//   --delay-ms  wait before every trade ack (server-side processing time)
+
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+#include <boost/beast/websocket.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <nlohmann/json.hpp>
+#include <openssl/hmac.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace beast     = boost::beast;
+namespace http      = beast::http;
+namespace websocket = beast::websocket;
+namespace net       = boost::asio;
+using tcp           = net::ip::tcp;
+using json          = nlohmann::json;
+
+struct StubOptions {
+    unsigned short port = 9443;
+    std::string secret;
+    int fill_ms = 5;
+    bool rest = false;
+    int delay_ms = 0;
+};
+
+static long long now_ms() {
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
+}
+
+static std::string hmac_sha256_hex(const std::string& key, const std::string& msg) {
+    unsigned int outlen = 0;
+    unsigned char out[EVP_MAX_MD_SIZE];
+    HMAC(EVP_sha256(), key.data(), (int)key.size(),
+         (const unsigned char*)msg.data(), msg.size(), out, &outlen);
+    std::ostringstream oss;
+    for (unsigned int i = 0; i < outlen; i++)
+        oss << std::hex << std::setw(2) << std::setfill('0') << (int)out[i];
+    return oss.str();
+}
+
+static std::string num_str(double x) {
+    std::ostringstream oss;
+    oss << std::setprecision(12) << x;
+    return oss.str();
+}
+
+// ------------------------------------------------------------
+// Exchange state (io thread only)
+// ------------------------------------------------------------
+struct StubOrder {
+    std::string category, symbol, side, orderId;
+    double qty = 0.0, price = 0.0;
+    std::string status = "New";
+};
+
+struct StubPosition {
+    double size = 0.0;   // signed
+    double avg = 0.0;
+};
+
+class Conn;
+
+static StubOptions g_opt;
+static std::uint64_t g_conn_seq = 0;
+static std::uint64_t g_order_seq = 0;
+static std::uint64_t g_exec_seq = 0;
+static std::unordered_map<std::string, StubOrder> g_orders;
+static std::unordered_map<std::string, StubPosition> g_positions;   // category:symbol
+static std::vector<std::weak_ptr<Conn>> g_private;                  // subscribed sockets
+
+static void publish(const std::string& topic, const json& rec);
+
+// ------------------------------------------------------------
+// One websocket connection
+// ------------------------------------------------------------
+class Conn : public std::enable_shared_from_this<Conn> {
+public:
+    Conn(tcp::socket sock) : ws_(std::move(sock)), id_(++g_conn_seq) {}
+
+    void start() {
+        beast::get_lowest_layer(ws_).socket().set_option(tcp::no_delay(true));
+        http::async_read(ws_.next_layer(), hbuf_, req_,
+                         [self = shared_from_this()](beast::error_code ec, std::size_t) {
+            if (ec) return;
+            self->trade_ = self->req_.target().find("/v5/trade") != beast::string_view::npos;
+            self->ws_.async_accept(self->req_, [self](beast::error_code ec) {
+                if (ec) return;
+                std::cout << "[STUB] conn #" << self->id_ << " " << (self->trade_ ? "trade" : "private") << "\n";
+                self->read();
+            });
+        });
+    }
+
+    void send(std::string msg) {
+        outq_.push_back(std::move(msg));
+        if (outq_.size() == 1) write_next();
+    }
+
+    bool subscribed(const std::string& topic) const {
+        for (const auto& t : topics_)
+            if (t == topic) return true;
+        return false;
+    }
+
+private:
+    void read() {
+        ws_.async_read(rx_, [self = shared_from_this()](beast::error_code ec, std::size_t) {
+            if (ec) {
+                std::cout << "[STUB] conn #" << self->id_ << " closed: " << self->msgs_ << " messages\n";
+                return;
+            }
+            ++self->msgs_;
+            const std::string msg = beast::buffers_to_string(self->rx_.data());
+            self->rx_.consume(self->rx_.size());
+            self->on_message(msg);
+            self->read();
+        });
+    }
+
+    void write_next() {
+        ws_.text(true);
+        ws_.async_write(net::buffer(outq_.front()), [self = shared_from_this()](beast::error_code ec, std::size_t) {
+            if (ec) return;
+            self->outq_.pop_front();
+            if (!self->outq_.empty()) self->write_next();
+        });
+    }
+
+    bool check_auth(const json& j) const {
+        const auto& a = j.value("args", json::array());
+        if (a.size() != 3) return false;
+        if (g_opt.secret.empty()) return true;
+
+        const long long expires = a[1].is_number() ? a[1].get<long long>() : std::stoll(a[1].get<std::string>());
+        return expires > now_ms() &&
+               a[2].get<std::string>() == hmac_sha256_hex(g_opt.secret, "GET/realtime" + std::to_string(expires));
+    }
+
+    void on_message(const std::string& msg) {
+        const json j = json::parse(msg, nullptr, false);
+        if (j.is_discarded() || !j.is_object()) return;
+        const std::string op = j.value("op", "");
+
+        if (op == "ping") {
+            if (trade_) send(json{{"op", "pong"}, {"retCode", 0}, {"retMsg", "OK"}, {"connId", id_}}.dump());
+            else send(json{{"success", true}, {"ret_msg", "pong"}, {"op", "ping"}, {"conn_id", id_}}.dump());
+            return;
+        }
+        if (op == "auth") {
+            authed_ = check_auth(j);
+            if (trade_) send(json{{"op", "auth"}, {"retCode", authed_ ? 0 : 10004},
+                                  {"retMsg", authed_ ? "OK" : "Invalid sign"}, {"connId", id_}}.dump());
+            else send(json{{"success", authed_}, {"ret_msg", authed_ ? "" : "Invalid sign"},
+                           {"op", "auth"}, {"conn_id", id_}}.dump());
+            return;
+        }
+        if (!authed_) {
+            send(json{{"op", op}, {"retCode", 10003}, {"retMsg", "not authenticated"}}.dump());
+            return;
+        }
+
+        if (!trade_) {
+            if (op == "subscribe") {
+                for (const auto& t : j.value("args", json::array())) topics_.push_back(t.get<std::string>());
+                g_private.push_back(shared_from_this());
+                send(json{{"success", true}, {"ret_msg", ""}, {"op", "subscribe"}, {"conn_id", id_}}.dump());
+            }
+            return;
+        }
+
+        json ack;
+        ack["reqId"] = j.value("reqId", "");
+        ack["op"] = op;
+        ack["retExtInfo"] = json::object();
+        ack["header"] = {{"Timenow", std::to_string(now_ms())}};
+        ack["connId"] = id_;
+
+        const json a = j.contains("args") && j["args"].is_array() && !j["args"].empty() ? j["args"][0] : json::object();
+        StubOrder* fill = nullptr;
+
+        if (op == "order.create") {
+            StubOrder o;
+            o.category = a.value("category", "");
+            o.symbol = a.value("symbol", "");
+            o.side = a.value("side", "");
+            o.qty = std::stod(a.value("qty", "0"));
+            o.price = std::stod(a.value("price", "0"));
+            o.orderId = "stub-" + std::to_string(++g_order_seq);
+
+            if (o.qty <= 0.0 || o.price <= 0.0 || (o.side != "Buy" && o.side != "Sell")) {
+                ack["retCode"] = 10001;
+                ack["retMsg"] = "invalid order";
+            } else {
+                ack["retCode"] = 0;
+                ack["retMsg"] = "OK";
+                ack["data"] = {{"orderId", o.orderId}, {"orderLinkId", ""}};
+                fill = &(g_orders[o.orderId] = o);
+            }
+        } else if (op == "order.cancel") {
+            auto it = g_orders.find(a.value("orderId", ""));
+            if (it == g_orders.end() || it->second.status != "New") {
+                ack["retCode"] = 110001;
+                ack["retMsg"] = "order not exists or too late to cancel";
+            } else {
+                it->second.status = "Cancelled";
+                ack["retCode"] = 0;
+                ack["retMsg"] = "OK";
+                ack["data"] = {{"orderId", it->first}, {"orderLinkId", ""}};
+            }
+        } else {
+            ack["retCode"] = 10001;
+            ack["retMsg"] = "unknown op";
+        }
+
+        const std::string order_id = fill ? fill->orderId : a.value("orderId", "");
+        const bool cancelled = op == "order.cancel" && ack["retCode"] == 0;
+        const bool created = fill != nullptr;
+
+        after(g_opt.delay_ms, [self = shared_from_this(), ack = ack.dump(), order_id, created, cancelled] {
+            self->send(ack);
+            if (created || cancelled) publish_order(order_id);
+            if (created && !g_opt.rest)
+                self->after(g_opt.fill_ms, [order_id] { fill_order(order_id); });
+        });
+    }
+
+    template <class F>
+    void after(int ms, F f) {
+        if (ms <= 0) {
+            f();
+            return;
+        }
+        auto t = std::make_shared<net::steady_timer>(ws_.get_executor(), std::chrono::milliseconds(ms));
+        t->async_wait([t, f = std::move(f)](beast::error_code ec) mutable {
+            if (!ec) f();
+        });
+    }
+
+    static json order_rec(const StubOrder& o) {
+        const bool filled = o.status == "Filled";
+        return {{"category", o.category}, {"symbol", o.symbol}, {"orderId", o.orderId}, {"orderLinkId", ""},
+                {"side", o.side}, {"orderType", "Limit"}, {"price", num_str(o.price)}, {"qty", num_str(o.qty)},
+                {"orderStatus", o.status}, {"cumExecQty", filled ? num_str(o.qty) : "0"},
+                {"leavesQty", o.status == "New" ? num_str(o.qty) : "0"},
+                {"avgPrice", filled ? num_str(o.price) : ""}, {"timeInForce", "GTC"},
+                {"updatedTime", std::to_string(now_ms())}};
+    }
+
+    static void publish_order(const std::string& order_id) {
+        auto it = g_orders.find(order_id);
+        if (it != g_orders.end()) publish("order", order_rec(it->second));
+    }
+
+    static void fill_order(const std::string& order_id) {
+        auto it = g_orders.find(order_id);
+        if (it == g_orders.end() || it->second.status != "New") return;
+        StubOrder& o = it->second;
+        o.status = "Filled";
+
+        const long long ts = now_ms();
+        const double fee = o.qty * o.price * 0.00055;
+        publish("execution", {{"category", o.category}, {"symbol", o.symbol},
+                              {"execId", "stub-exec-" + std::to_string(++g_exec_seq)},
+                              {"orderId", o.orderId}, {"orderLinkId", ""}, {"side", o.side},
+                              {"execPrice", num_str(o.price)}, {"execQty", num_str(o.qty)},
+                              {"execFee", num_str(fee)}, {"feeCurrency", "USDT"},
+                              {"execType", "Trade"}, {"orderType", "Limit"}, {"isMaker", false},
+                              {"execTime", std::to_string(ts)}, {"seq", static_cast<long long>(g_exec_seq)}});
+        publish("order", order_rec(o));
+
+        // Netted position, average price of the open side
+        StubPosition& p = g_positions[o.category + ":" + o.symbol];
+        const double d = o.side == "Buy" ? o.qty : -o.qty;
+        if (p.size == 0.0 || (p.size > 0.0) == (d > 0.0)) p.avg = (p.avg * std::abs(p.size) + o.price * o.qty) / (std::abs(p.size) + o.qty);
+        else if (std::abs(d) > std::abs(p.size)) p.avg = o.price;
+        p.size += d;
+        if (std::abs(p.size) < 1e-12) p = StubPosition{};
+        publish("position", {{"category", o.category}, {"symbol", o.symbol},
+                             {"side", p.size > 0.0 ? "Buy" : p.size < 0.0 ? "Sell" : ""},
+                             {"size", num_str(std::abs(p.size))}, {"entryPrice", num_str(p.avg)},
+                             {"updatedTime", std::to_string(ts)}});
+    }
+
+    websocket::stream<beast::tcp_stream> ws_;
+    beast::flat_buffer hbuf_;
+    http::request<http::string_body> req_;
+    beast::flat_buffer rx_;
+    std::deque<std::string> outq_;
+    std::vector<std::string> topics_;
+    std::uint64_t id_;
+    std::uint64_t msgs_ = 0;
+    bool trade_ = false;
+    bool authed_ = false;
+};
+
+static void publish(const std::string& topic, const json& rec) {
+    const std::string msg = json{{"topic", topic}, {"id", std::to_string(now_ms())},
+                                 {"creationTime", now_ms()}, {"data", json::array({rec})}}.dump();
+    for (auto it = g_private.begin(); it != g_private.end();) {
+        auto c = it->lock();
+        if (!c) {
+            it = g_private.erase(it);
+            continue;
+        }
+        if (c->subscribed(topic)) c->send(msg);
+        ++it;
+    }
+}
+
+static void accept_loop(tcp::acceptor& acc) {
+    acc.async_accept([&acc](beast::error_code ec, tcp::socket sock) {
+        if (!ec) std::make_shared<Conn>(std::move(sock))->start();
+        accept_loop(acc);
+    });
+}
+
+static void usage() {
+    std::cerr << "Usage: bybit_ws_stub [--port 9443] [--secret S] [--fill-ms 5] [--rest] [--delay-ms 0]\n";
+}
+
+int main(int argc, char** argv) {
+    for (int i = 1; i < argc; ++i) {
+        const std::string a = argv[i];
+        const bool has_val = i + 1 < argc;
+        if (a == "--port" && has_val) g_opt.port = static_cast<unsigned short>(std::stoi(argv[++i]));
+        else if (a == "--secret" && has_val) g_opt.secret = argv[++i];
+        else if (a == "--fill-ms" && has_val) g_opt.fill_ms = std::stoi(argv[++i]);
+        else if (a == "--rest") g_opt.rest = true;
+        else if (a == "--delay-ms" && has_val) g_opt.delay_ms = std::stoi(argv[++i]);
+        else {
+            usage();
+            return 1;
+        }
+    }
+
+    net::io_context ioc;
+    tcp::acceptor acc(ioc, tcp::endpoint(net::ip::make_address("127.0.0.1"), g_opt.port));
+    accept_loop(acc);
+
+    std::cout << "[STUB] ws://127.0.0.1:" << g_opt.port << " /v5/trade /v5/private"
+              << (g_opt.secret.empty() ? " (signatures not checked)" : " (verifying signatures)")
+              << (g_opt.rest ? " orders rest" : " fills after " + std::to_string(g_opt.fill_ms) + "ms") << "\n";
+    ioc.run();
+    return 0;
+}
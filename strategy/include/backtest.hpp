@@ -0,0 +1,356 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <ostream>
+#include <queue>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "StateReader.hpp"
+#include "imbalance_taker.hpp"
+#include "order_intent.hpp"
+#include "paper_execution_engine.hpp"
+
+// Backtest: historical MarketState -> strategy -> PaperExecutionEngine on a
+// simulated clock, as fast as the source can be read.
+//
+// Every key (exchange|instrument) gets its own strategy instance and its own
+// paper engine / wallet, exactly like one live strategy per symbol; the run
+// reports the sum of those wallets.
+
+// ------------------------------------------------------------
+// Sources
+// ------------------------------------------------------------
+struct BacktestEvent {
+    std::uint32_t key = 0;               // index into BacktestSource::keys()
+    const MarketState* state = nullptr;  // valid until the next next()
+};
+
+class BacktestSource {
+public:
+    virtual ~BacktestSource() = default;
+
+    // Next state in time order; false at the end
+    virtual bool next(BacktestEvent& ev) = 0;
+
+    // "exchange|instrument" per key id (may grow while reading)
+    const std::vector<std::string>& keys() const { return keys_; }
+
+protected:
+    std::vector<std::string> keys_;
+};
+
+// market_state.db (v2): one StateReader cursor per key, merged by ts_ms.
+// The DB stores mid/spread only, so bid/ask are rebuilt as mid -/+ spread/2.
+class StateDbSource : public BacktestSource {
+public:
+    StateDbSource(std::string db_path, std::uint64_t from_ms, std::uint64_t to_ms);
+
+    // Keys to replay; all instruments in the DB when empty.
+    // exchange / instrument filters apply when non-empty.
+    bool open(const std::string& exchange_filter, const std::string& instrument_filter);
+
+    bool next(BacktestEvent& ev) override;
+
+private:
+    static constexpr std::size_t CHUNK_ROWS = 4096;
+
+    struct Stream {
+        std::unique_ptr<StateReader> reader;
+        StateReader::Cursor cur;
+        std::vector<StateSnapshot> buf;
+        std::size_t pos = 0;
+        std::size_t n = 0;
+        MarketState state;   // names set once, numbers per row
+    };
+
+    bool refill(Stream& s);
+
+    std::string db_path_;
+    std::uint64_t from_ms_, to_ms_;
+    std::vector<std::unique_ptr<Stream>> streams_;
+
+    // (ts_ms, key) of each stream's next row; smallest first
+    using HeapItem = std::pair<std::uint64_t, std::uint32_t>;
+    std::priority_queue<HeapItem, std::vector<HeapItem>, std::greater<HeapItem>> heap_;
+};
+
+// market_state_v1 JSON lines, e.g. hft_feeds --replay --features output.
+// Files are read one after another, lines in file order.
+class JsonlSource : public BacktestSource {
+public:
+    JsonlSource(std::vector<std::string> paths, std::uint64_t from_ms, std::uint64_t to_ms,
+                std::string exchange_filter, std::string instrument_filter);
+
+    bool next(BacktestEvent& ev) override;
+
+    std::uint64_t bad_lines() const { return bad_lines_; }
+
+private:
+    bool open_next_file();
+
+    std::vector<std::string> paths_;
+    std::size_t next_path_ = 0;
+    std::ifstream in_;
+    std::string line_;
+
+    std::uint64_t from_ms_, to_ms_;
+    std::string exchange_filter_, instrument_filter_;
+
+    std::unordered_map<std::string, std::uint32_t> ids_;
+    MarketState state_;
+    std::uint64_t bad_lines_ = 0;
+};
+
+// ------------------------------------------------------------
+// Columnar dataset: a source loaded once, replayed many times
+// ------------------------------------------------------------
+
+// One column per MarketState field the strategies and the paper engine use
+// (the depth ones for FillModel::Depth). Read-only once loaded, so any number
+// of threads can replay it at once.
+struct MarketColumns {
+    std::vector<std::string> keys;        // "exchange|instrument" per key id
+    std::vector<MarketState> templates;   // per key id: schema / names, numbers unset
+
+    std::vector<std::uint32_t> key;
+    std::vector<std::int64_t> ts_ms;
+    std::vector<double> bid, ask, mid, spread;
+    std::vector<double> r1, r5, r10;
+    std::vector<double> imbalance;
+    std::vector<std::array<double, 5>> bid_vol, ask_vol;
+    std::vector<std::array<double, 5>> bid_px, ask_px;   // empty when the source has no level prices
+
+    std::size_t size() const { return key.size(); }
+};
+
+// Drains src into cols; returns events loaded
+std::size_t load_columns(BacktestSource& src, MarketColumns& cols);
+
+// Cursor over shared MarketColumns; each thread uses its own
+class ColumnarSource : public BacktestSource {
+public:
+    explicit ColumnarSource(const MarketColumns& cols);
+
+    bool next(BacktestEvent& ev) override;
+
+private:
+    const MarketColumns& cols_;
+    std::vector<MarketState> states_;   // per key, refreshed per event
+    std::size_t i_ = 0;
+};
+
+// ------------------------------------------------------------
+// Driver
+// ------------------------------------------------------------
+
+// Market time of the replay: the latest event timestamp seen so far
+struct SimClock {
+    std::int64_t now_ms = 0;
+
+    void advance(std::int64_t ts_ms) {
+        if (ts_ms > now_ms) now_ms = ts_ms;
+    }
+};
+
+struct BacktestParams {
+    double qty = 0.01;                      // position size per unit of strategy position
+    PaperExecutionEngine::Params exec;      // per key: each key starts with exec.initial_cash
+                                            // (exec.rest_limits: orders are limits, see run_backtest)
+
+    std::int64_t curve_ms = 1000;           // equity curve sample period (simulated time)
+    std::ostream* trades_out = nullptr;     // CSV, one row per fill
+    std::ostream* curve_out = nullptr;      // CSV, one row per curve_ms
+};
+
+struct BacktestKeyResult {
+    std::string key;
+    std::uint64_t events = 0;
+    std::uint64_t fills = 0;
+    std::uint64_t resting_fills = 0;   // of fills: resting limit orders filled by on_market
+    std::uint64_t rejects = 0;
+    double turnover = 0.0;   // traded notional
+    WalletSnapshot wallet;
+};
+
+struct BacktestResult {
+    std::uint64_t events = 0;
+    std::uint64_t fills = 0;
+    std::uint64_t resting_fills = 0;   // of fills: resting limit orders filled by on_market
+    std::uint64_t rejects = 0;
+    double turnover = 0.0;   // traded notional, all keys
+    std::int64_t first_ts_ms = 0;
+    std::int64_t last_ts_ms = 0;
+
+    double start_equity = 0.0;
+    double end_equity = 0.0;
+    double max_drawdown = 0.0;   // largest peak-to-trough drop of the summed equity
+
+    double wall_s = 0.0;
+    std::vector<BacktestKeyResult> keys;
+};
+
+inline void backtest_write_csv_headers(const BacktestParams& p) {
+    if (p.trades_out)
+        *p.trades_out << "ts_ms,key,side,price,qty,pos_after,cash_after,realized_pnl,resting\n";
+    if (p.curve_out)
+        *p.curve_out << "ts_ms,equity,cash,realized_pnl,unrealized_pnl,fills\n";
+}
+
+// Strategy needs: int on_state(const MarketState&) (+1 buy / -1 sell / 0 hold)
+// and int position() const (+1 long / 0 flat / -1 short). On a signal the
+// book trades to position() * qty with a marketable order at bid/ask.
+// With p.exec.rest_limits the order is a limit at the touch (ask for a buy,
+// bid for a sell): it takes what the touch shows and the rest queues there,
+// filled later by on_market. A new signal cancels whatever still rests.
+template <class Strategy, class MakeStrategy>
+BacktestResult run_backtest(BacktestSource& src, MakeStrategy make_strategy, const BacktestParams& p) {
+    struct Book {
+        Strategy strat;
+        PaperExecutionEngine exec;
+        double equity;
+        std::uint64_t events = 0;
+        std::uint64_t fills = 0;
+        std::uint64_t resting_fills = 0;
+        std::uint64_t rejects = 0;
+        double turnover = 0.0;
+    };
+
+    std::vector<Book> books;
+    BacktestResult r;
+    SimClock clock;
+
+    double equity = 0.0, peak = 0.0;
+    double cash = 0.0, realized = 0.0, unrealized = 0.0;
+    std::int64_t next_curve_ms = 0;
+
+    auto write_curve = [&](std::int64_t ts_ms) {
+        cash = realized = unrealized = 0.0;
+        for (const auto& b : books) {
+            const auto& w = b.exec.wallet().snap();
+            cash += w.cash;
+            realized += w.realized_pnl;
+            unrealized += w.unrealized_pnl;
+        }
+        *p.curve_out << ts_ms << ',' << equity << ',' << cash << ',' << realized << ','
+                     << unrealized << ',' << r.fills << '\n';
+    };
+
+    auto record_fill = [&](Book& b, const Trade& t, bool resting) {
+        ++b.fills;
+        ++r.fills;
+        if (resting) {
+            ++b.resting_fills;
+            ++r.resting_fills;
+        }
+        b.turnover += t.qty * t.price;
+        r.turnover += t.qty * t.price;
+        if (p.trades_out) {
+            const auto& w = b.exec.wallet().snap();
+            *p.trades_out << t.ts_ms << ',' << t.key << ','
+                          << (t.side == Side::Buy ? "BUY" : "SELL") << ','
+                          << t.price << ',' << t.qty << ',' << t.pos_after << ','
+                          << w.cash << ',' << w.realized_pnl << ',' << (resting ? 1 : 0) << '\n';
+        }
+    };
+
+    const auto t0 = std::chrono::steady_clock::now();
+
+    BacktestEvent ev;
+    while (src.next(ev)) {
+        const MarketState& s = *ev.state;
+
+        if (r.events++ == 0) {
+            r.first_ts_ms = s.ts_ms;
+            if (p.curve_ms > 0) next_curve_ms = (s.ts_ms / p.curve_ms) * p.curve_ms;
+        }
+        clock.advance(s.ts_ms);
+
+        // Curve rows show the book as of the end of each period
+        if (p.curve_out && p.curve_ms > 0 && clock.now_ms >= next_curve_ms) {
+            if (!books.empty()) write_curve(next_curve_ms);
+            next_curve_ms = (clock.now_ms / p.curve_ms + 1) * p.curve_ms;
+        }
+
+        while (books.size() <= ev.key) {
+            books.push_back(Book{make_strategy(), PaperExecutionEngine(p.exec), p.exec.initial_cash});
+            equity += p.exec.initial_cash;
+            r.start_equity += p.exec.initial_cash;
+            peak = std::max(peak, equity);
+        }
+        Book& b = books[ev.key];
+        ++b.events;
+
+        // Resting fills are the last n trades; cash_after in the CSV is the
+        // wallet after all of them
+        if (const std::size_t n = b.exec.on_market(s)) {
+            const auto& trades = b.exec.trades();
+            for (std::size_t i = trades.size() - n; i < trades.size(); ++i) record_fill(b, trades[i], true);
+        }
+        const int sig = b.strat.on_state(s);
+
+        if (sig != 0) {
+            if (p.exec.rest_limits) b.exec.cancel_resting();
+            double target = b.strat.position() * p.qty;
+            if (!p.exec.allow_short && target < 0.0) target = 0.0;
+            const double delta = target - b.exec.wallet().snap().pos;
+
+            if (std::fabs(delta) > 1e-12) {
+                OrderIntent oi;
+                oi.key   = src.keys()[ev.key];
+                oi.side  = delta > 0.0 ? Side::Buy : Side::Sell;
+                if (p.exec.rest_limits) {
+                    oi.price = delta > 0.0 ? s.ask : s.bid;
+                } else {
+                    // Market order: the engine's fill model sets the price
+                    oi.price = delta > 0.0 ? std::numeric_limits<double>::infinity() : 0.0;
+                }
+                oi.qty   = std::fabs(delta);
+                oi.ts_ms = clock.now_ms;
+
+                if (auto t = b.exec.submit(s, oi)) {
+                    record_fill(b, *t, false);
+                } else if (!b.exec.resting()) {
+                    // A limit that only queued is not a reject
+                    ++b.rejects;
+                    ++r.rejects;
+                }
+            }
+        }
+
+        const auto& w = b.exec.wallet().snap();
+        const double eq = w.cash + w.pos * s.mid;
+        equity += eq - b.equity;
+        b.equity = eq;
+
+        peak = std::max(peak, equity);
+        r.max_drawdown = std::max(r.max_drawdown, peak - equity);
+    }
+
+    r.wall_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    r.last_ts_ms = clock.now_ms;
+    r.end_equity = equity;
+    if (p.curve_out && !books.empty()) write_curve(clock.now_ms);
+
+    for (std::size_t k = 0; k < books.size(); ++k) {
+        BacktestKeyResult kr;
+        kr.key = src.keys()[k];
+        kr.events = books[k].events;
+        kr.fills = books[k].fills;
+        kr.resting_fills = books[k].resting_fills;
+        kr.rejects = books[k].rejects;
+        kr.turnover = books[k].turnover;
+        kr.wallet = books[k].exec.wallet().snap();
+        r.keys.push_back(std::move(kr));
+    }
+    return r;
+}
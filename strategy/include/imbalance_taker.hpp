@@ -5,6 +5,8 @@
 #include <string>
 #include <unordered_map>
 
+#include "latency_trace.hpp"
+
 // Parsed message your MarketDataManager publishes
 struct MarketState {
     std::string schema;
@@ -23,17 +25,32 @@ struct MarketState {
     double r5 = 0.0;
     double r10 = 0.0;
 
-    // depth top-5 volumes
+    // depth top-5 volumes and their prices (0 = price not published)
     std::array<double, 5> bid_vol{};
     std::array<double, 5> ask_vol{};
+    std::array<double, 5> bid_px{};
+    std::array<double, 5> ask_px{};
 
     // features
     double imbalance = 0.0;
 
+    // latency stamps: hft_feeds part from the payload, rest filled locally
+    TraceContext trace;
+
     // Helper: key for maps
     std::string key() const { return exchange + "|" + instrument; }
 };
 
+// Top-5 depth imbalance in [-1, 1]: (bid - ask) / (bid + ask)
+inline double depth_imbalance(const double* bid_vol, const double* ask_vol) {
+    double bid_sum = 0.0, ask_sum = 0.0;
+    for (int i = 0; i < 5; ++i) {
+        bid_sum += bid_vol[i];
+        ask_sum += ask_vol[i];
+    }
+    return (bid_sum - ask_sum) / (bid_sum + ask_sum + 1e-9);
+}
+
 class ImbalanceTaker {
 public:
     ImbalanceTaker(double thresh = 0.6, int hold_ticks = 150)
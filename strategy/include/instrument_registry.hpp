@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+// Dense integer ids for "exchange|instrument" keys, so the hot path routes and
+// indexes by id instead of hashing strings per message.
+//
+// One thread (the receiver) interns; any thread may read back keys for ids
+// below size(). Ids are never reused and the key storage never moves.
+class InstrumentRegistry {
+public:
+    static constexpr std::uint32_t NONE = 0xffffffffu;
+
+    explicit InstrumentRegistry(std::uint32_t capacity)
+        : capacity_(capacity), keys_(new std::string[capacity]) {}
+
+    // Interning thread only: id of exchange|instrument, assigned on first
+    // sight; NONE once capacity ids are taken
+    std::uint32_t intern(const std::string& exchange, const std::string& instrument) {
+        scratch_.assign(exchange).append("|").append(instrument);
+        auto it = ids_.find(scratch_);
+        if (it != ids_.end()) return it->second;
+
+        const std::uint32_t id = count_.load(std::memory_order_relaxed);
+        if (id >= capacity_) return NONE;
+
+        keys_[id] = scratch_;
+        ids_.emplace(scratch_, id);
+        count_.store(id + 1, std::memory_order_release);   // publishes keys_[id]
+        return id;
+    }
+
+    // Any thread
+    std::uint32_t size() const { return count_.load(std::memory_order_acquire); }
+    std::uint32_t capacity() const { return capacity_; }
+
+    // Any thread, id < size()
+    const std::string& key(std::uint32_t id) const { return keys_[id]; }
+
+    // Any thread; linear scan, for occasional lookups (manual orders)
+    std::uint32_t find(const std::string& key) const {
+        const std::uint32_t n = size();
+        for (std::uint32_t id = 0; id < n; ++id)
+            if (keys_[id] == key) return id;
+        return NONE;
+    }
+
+private:
+    const std::uint32_t capacity_;
+    std::unique_ptr<std::string[]> keys_;
+    std::atomic<std::uint32_t> count_{0};
+
+    // Interning thread only
+    std::unordered_map<std::string, std::uint32_t> ids_;
+    std::string scratch_;
+};
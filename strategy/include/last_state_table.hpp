@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+#include "packed_market_state.hpp"
+
+// Latest PackedMarketState per instrument id, without locks.
+//
+// Each id has exactly one writer (the shard worker that owns it); readers on
+// any thread copy the slot seqlock style and retry if a write overlapped.
+class LastStateTable {
+public:
+    explicit LastStateTable(std::uint32_t capacity)
+        : capacity_(capacity), slots_(new Slot[capacity]) {}
+
+    // Owning worker only
+    void store(std::uint32_t id, const PackedMarketState& st) {
+        if (id >= capacity_) return;
+        Slot& s = slots_[id];
+        const std::uint32_t seq = s.seq.load(std::memory_order_relaxed);
+
+        s.seq.store(seq + 1, std::memory_order_relaxed);   // odd: write in progress
+        std::atomic_thread_fence(std::memory_order_release);
+        std::memcpy(&s.st, &st, sizeof(st));
+        s.seq.store(seq + 2, std::memory_order_release);
+    }
+
+    // Any thread; false until the first store for id
+    bool load(std::uint32_t id, PackedMarketState& out) const {
+        if (id >= capacity_) return false;
+        const Slot& s = slots_[id];
+        while (true) {
+            const std::uint32_t seq1 = s.seq.load(std::memory_order_acquire);
+            if (seq1 == 0) return false;
+            if (seq1 & 1) continue;
+
+            std::memcpy(&out, &s.st, sizeof(out));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (s.seq.load(std::memory_order_relaxed) == seq1) return true;
+        }
+    }
+
+    // Any thread; changes on every store (0 = never stored, odd = mid-write)
+    std::uint32_t version(std::uint32_t id) const {
+        return id < capacity_ ? slots_[id].seq.load(std::memory_order_acquire) : 0;
+    }
+
+private:
+    struct alignas(64) Slot {
+        std::atomic<std::uint32_t> seq{0};
+        PackedMarketState st;
+    };
+
+    const std::uint32_t capacity_;
+    std::unique_ptr<Slot[]> slots_;
+};
@@ -2,6 +2,8 @@
 #include <cstdint>
 #include <string>
 
+#include "latency_trace.hpp"
+
 enum class Side { Buy, Sell };
 
 struct OrderIntent {
@@ -10,4 +12,5 @@ struct OrderIntent {
     double price;          // limit price
     double qty;            // base qty (ETH)
     std::int64_t ts_ms;
+    TraceContext trace;    // market tick it was priced on + intent/exec stamps
 };
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include "imbalance_taker.hpp"   // MarketState
+#include "latency_trace.hpp"
+
+// MarketState without heap members, for SpscRing: fixed-size, NUL-terminated
+// names (longer ones are truncated; real exchange/symbol names are far shorter)
+struct PackedMarketState {
+    std::uint32_t instrument_id;   // InstrumentRegistry id of exchange|instrument
+    char schema[24];
+    char exchange[16];
+    char instrument[32];
+    std::int64_t ts_ms;
+
+    double bid, ask, mid, spread;
+    double r1, r5, r10;
+    std::array<double, 5> bid_vol;
+    std::array<double, 5> ask_vol;
+    std::array<double, 5> bid_px;
+    std::array<double, 5> ask_px;
+    double imbalance;
+
+    TraceContext trace;
+};
+
+template <std::size_t N>
+inline void pack_name(char (&dst)[N], const std::string& src) {
+    const std::size_t n = src.size() < N - 1 ? src.size() : N - 1;
+    std::memcpy(dst, src.data(), n);
+    dst[n] = '\0';
+}
+
+inline void pack_market_state(const MarketState& s, std::uint32_t instrument_id, PackedMarketState& p) {
+    p.instrument_id = instrument_id;
+    pack_name(p.schema, s.schema);
+    pack_name(p.exchange, s.exchange);
+    pack_name(p.instrument, s.instrument);
+    p.ts_ms = s.ts_ms;
+    p.bid = s.bid;
+    p.ask = s.ask;
+    p.mid = s.mid;
+    p.spread = s.spread;
+    p.r1 = s.r1;
+    p.r5 = s.r5;
+    p.r10 = s.r10;
+    p.bid_vol = s.bid_vol;
+    p.ask_vol = s.ask_vol;
+    p.bid_px = s.bid_px;
+    p.ask_px = s.ask_px;
+    p.imbalance = s.imbalance;
+    p.trace = s.trace;
+}
+
+// Reuses s's string buffers, so a long-lived MarketState does not allocate
+inline void unpack_market_state(const PackedMarketState& p, MarketState& s) {
+    s.schema.assign(p.schema);
+    s.exchange.assign(p.exchange);
+    s.instrument.assign(p.instrument);
+    s.ts_ms = p.ts_ms;
+    s.bid = p.bid;
+    s.ask = p.ask;
+    s.mid = p.mid;
+    s.spread = p.spread;
+    s.r1 = p.r1;
+    s.r5 = p.r5;
+    s.r10 = p.r10;
+    s.bid_vol = p.bid_vol;
+    s.ask_vol = p.ask_vol;
+    s.bid_px = p.bid_px;
+    s.ask_px = p.ask_px;
+    s.imbalance = p.imbalance;
+    s.trace = p.trace;
+}
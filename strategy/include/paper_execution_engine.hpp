@@ -1,4 +1,6 @@
 #pragma once
+#include <array>
+#include <cstddef>
 #include <optional>
 #include <vector>
 
@@ -7,28 +9,63 @@
 #include "virtual_wallet.hpp"
 #include "imbalance_taker.hpp"   // MUST define MarketState
 
+// How submit() prices an order against the book:
+//   Touch: full qty at ask (buy) / bid (sell), whatever the size
+//   Depth: walk the five published levels up to the limit price; the fill
+//          is the VWAP of what was taken, the rest is not filled (IOC) or,
+//          with rest_limits, rests at the limit price in a simulated queue.
+//          Level prices missing from the state (market_state.db rows) are
+//          assumed one spread apart; a book with no volumes falls back to Touch.
+enum class FillModel { Touch, Depth };
+
 class PaperExecutionEngine {
 public:
     struct Params {
         double initial_cash;
         bool allow_short;
         bool require_cash;
+        FillModel fill = FillModel::Touch;
+        bool rest_limits = false;   // Depth only: unfilled limit qty joins the queue
 
         Params(double cash = 10000.0, bool allow = false, bool require = true)
             : initial_cash(cash), allow_short(allow), require_cash(require) {}
     };
 
+    // Resting orders per engine; submit() fills what it can and drops the
+    // rest when all slots are taken
+    static constexpr std::size_t MAX_RESTING = 8;
+
     PaperExecutionEngine();                 // default constructor
     explicit PaperExecutionEngine(Params p); // NO default argument
 
-    void on_market(const MarketState& s);
+    // Marks the wallet and, with resting orders, advances the queues of those
+    // on s's key. Returns the number of resting fills appended to trades().
+    // The book walk uses fixed arrays only; rest() copies the intent (its key
+    // string) and every fill appends to trades(), which may allocate.
+    std::size_t on_market(const MarketState& s);
     std::optional<Trade> submit(const MarketState& s, const OrderIntent& oi);
 
+    std::size_t resting() const;
+    void cancel_resting();
+
     const VirtualWallet& wallet() const { return wallet_; }
     const std::vector<Trade>& trades() const { return trades_; }
 
 private:
+    struct Resting {
+        bool live = false;
+        OrderIntent oi;             // qty = what is still open
+        double queue_ahead = 0.0;   // displayed qty in front of us at oi.price
+        double level_vol = 0.0;     // that level's qty on the last state
+    };
+
+    std::optional<Trade> submit_touch(const MarketState& s, const OrderIntent& oi);
+    std::optional<Trade> submit_depth(const MarketState& s, const OrderIntent& oi);
+    bool rest(const MarketState& s, const OrderIntent& oi, double qty);
+    Trade fill(Side side, double qty, double price, const OrderIntent& oi, double mid);
+
     Params p_;
     VirtualWallet wallet_;
     std::vector<Trade> trades_;
+    std::array<Resting, MAX_RESTING> resting_;
 };
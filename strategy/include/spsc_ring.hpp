@@ -0,0 +1,157 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+// Single-producer / single-consumer ring that never blocks the producer:
+// when the consumer falls N behind, the oldest entries are overwritten
+// (drop-oldest) instead of the producer waiting or taking a lock.
+//
+// Each slot carries a sequence number (odd while being written, 2*pos+2 once
+// entry pos is complete), so the consumer can tell that the slot it is
+// copying was lapped and skip it, seqlock style. That is why T must be
+// trivially copyable.
+//
+// The consumer either busy-spins (lowest latency, burns a core) or spins
+// briefly and then sleeps on a condition variable; the producer only touches
+// the mutex when the consumer has announced it is going to sleep.
+template <class T, std::size_t N>
+class SpscRing {
+    static_assert(std::is_trivially_copyable<T>::value, "SpscRing needs a trivially copyable T");
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscRing size must be a power of two");
+
+public:
+    SpscRing() : slots_(new Slot[N]) {}
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    // Producer thread only
+    void push(const T& v) {
+        const std::uint64_t pos = head_.load(std::memory_order_relaxed);
+        Slot& s = slots_[pos & (N - 1)];
+
+        s.seq.store(2 * pos + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        std::memcpy(&s.value, &v, sizeof(T));
+        s.seq.store(2 * pos + 2, std::memory_order_release);
+
+        // seq_cst pairs with the consumer's waiting_ store / head_ re-check
+        head_.store(pos + 1, std::memory_order_seq_cst);
+        if (waiting_.load(std::memory_order_seq_cst)) {
+            { std::lock_guard<std::mutex> lk(mtx_); }
+            cv_.notify_one();
+        }
+    }
+
+    // Consumer thread only; false when empty
+    bool try_pop(T& out) {
+        while (true) {
+            const std::uint64_t head = head_.load(std::memory_order_acquire);
+            if (tail_ == head) return false;
+
+            if (head - tail_ > N) {
+                drop(head - tail_ - N);
+                tail_ = head - N;
+            }
+
+            const Slot& s = slots_[tail_ & (N - 1)];
+            const std::uint64_t seq1 = s.seq.load(std::memory_order_acquire);
+            if (seq1 != 2 * tail_ + 2) {
+                // Producer has lapped this entry (or is writing over it right now)
+                drop(1);
+                ++tail_;
+                continue;
+            }
+
+            std::memcpy(&out, &s.value, sizeof(T));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (s.seq.load(std::memory_order_relaxed) != seq1) {
+                drop(1);   // overwritten while we copied it
+                ++tail_;
+                continue;
+            }
+
+            ++tail_;
+            return true;
+        }
+    }
+
+    // Consumer thread only: next entry, or false once stop() returns true
+    template <class Stop>
+    bool wait_pop(T& out, bool busy_spin, Stop stop) {
+        while (true) {
+            if (try_pop(out)) return true;
+            if (stop()) return false;
+
+            if (busy_spin) {
+                cpu_relax();
+                continue;
+            }
+
+            // Short spin first: a burst usually refills the ring within microseconds
+            for (int i = 0; i < SPIN_BEFORE_SLEEP && empty(); ++i) cpu_relax();
+            if (!empty()) continue;
+
+            std::unique_lock<std::mutex> lk(mtx_);
+            waiting_.store(true, std::memory_order_seq_cst);
+            cv_.wait_for(lk, std::chrono::milliseconds(100),
+                         [&] { return !empty() || stop(); });
+            waiting_.store(false, std::memory_order_relaxed);
+        }
+    }
+
+    // Any thread: wake a sleeping consumer so it re-checks stop()
+    void wake() {
+        { std::lock_guard<std::mutex> lk(mtx_); }
+        cv_.notify_all();
+    }
+
+    // Entries overwritten before the consumer got to them (any thread)
+    std::uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+    static constexpr std::size_t capacity() { return N; }
+
+private:
+    static constexpr int SPIN_BEFORE_SLEEP = 2000;
+
+    struct alignas(64) Slot {
+        std::atomic<std::uint64_t> seq{0};
+        T value;
+    };
+
+    bool empty() const { return head_.load(std::memory_order_seq_cst) == tail_; }
+
+    void drop(std::uint64_t n) {
+        dropped_.store(dropped_.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    std::unique_ptr<Slot[]> slots_;
+
+    alignas(64) std::atomic<std::uint64_t> head_{0};   // next position to write (producer)
+    alignas(64) std::uint64_t tail_ = 0;                // next position to read (consumer)
+    std::atomic<std::uint64_t> dropped_{0};             // written by the consumer only
+
+    alignas(64) std::atomic<bool> waiting_{false};
+    std::mutex mtx_;
+    std::condition_variable cv_;
+};
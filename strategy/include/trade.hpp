@@ -10,4 +10,5 @@ struct Trade {
     double qty;
     std::int64_t ts_ms;
     double pos_after;
+    TraceContext trace;    // OrderIntent's trace, submit_ns set at fill
 };
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed thread pool with one task deque per worker. A worker runs its own
+// deque newest-first and, when that is empty, steals the oldest task of
+// another worker, so uneven task lengths still keep every core busy.
+//
+// Meant for coarse tasks (a whole backtest each): the deques are mutex-
+// guarded, which costs nothing next to the task itself.
+class WorkStealingPool {
+public:
+    explicit WorkStealingPool(unsigned threads)
+        : queues_(std::max(1u, threads))
+    {
+        for (auto& q : queues_) q = std::make_unique<Queue>();
+        for (unsigned i = 0; i < queues_.size(); ++i)
+            threads_.emplace_back([this, i] { run(i); });
+    }
+
+    ~WorkStealingPool() {
+        {
+            std::lock_guard<std::mutex> lk(idle_mtx_);
+            stop_ = true;
+        }
+        work_cv_.notify_all();
+        for (auto& t : threads_)
+            if (t.joinable()) t.join();
+    }
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    unsigned size() const { return static_cast<unsigned>(queues_.size()); }
+
+    // Tasks are dealt round-robin; stealing evens out the rest
+    void submit(std::function<void()> task) {
+        Queue& q = *queues_[next_queue_++ % queues_.size()];
+        {
+            std::lock_guard<std::mutex> lk(q.mtx);
+            q.tasks.push_back(std::move(task));
+        }
+        {
+            std::lock_guard<std::mutex> lk(idle_mtx_);
+            ++pending_;
+        }
+        work_cv_.notify_one();
+    }
+
+    // Blocks until every submitted task has finished
+    void wait_idle() {
+        std::unique_lock<std::mutex> lk(idle_mtx_);
+        idle_cv_.wait(lk, [this] { return pending_ == 0; });
+    }
+
+    std::size_t steals() const { return steals_.load(std::memory_order_relaxed); }
+
+private:
+    struct Queue {
+        std::mutex mtx;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    bool pop_own(unsigned i, std::function<void()>& out) {
+        Queue& q = *queues_[i];
+        std::lock_guard<std::mutex> lk(q.mtx);
+        if (q.tasks.empty()) return false;
+        out = std::move(q.tasks.back());
+        q.tasks.pop_back();
+        return true;
+    }
+
+    bool steal(unsigned thief, std::function<void()>& out) {
+        const std::size_t n = queues_.size();
+        for (std::size_t k = 1; k < n; ++k) {
+            Queue& q = *queues_[(thief + k) % n];
+            std::lock_guard<std::mutex> lk(q.mtx);
+            if (q.tasks.empty()) continue;
+            out = std::move(q.tasks.front());
+            q.tasks.pop_front();
+            steals_.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+        return false;
+    }
+
+    void run(unsigned i) {
+        std::function<void()> task;
+        while (true) {
+            if (pop_own(i, task) || steal(i, task)) {
+                task();
+                task = nullptr;
+
+                std::lock_guard<std::mutex> lk(idle_mtx_);
+                if (--pending_ == 0) idle_cv_.notify_all();
+                continue;
+            }
+
+            // Nothing anywhere: sleep until a submit (pending_ counts tasks
+            // not yet finished, so it can be > 0 while all are running)
+            std::unique_lock<std::mutex> lk(idle_mtx_);
+            if (stop_) return;
+            work_cv_.wait_for(lk, std::chrono::milliseconds(10));
+        }
+    }
+
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::vector<std::thread> threads_;
+    std::atomic<std::size_t> next_queue_{0};
+    std::atomic<std::size_t> steals_{0};
+
+    std::mutex idle_mtx_;
+    std::condition_variable work_cv_;   // a task was submitted / stop
+    std::condition_variable idle_cv_;   // pending_ reached 0
+    std::size_t pending_ = 0;
+    bool stop_ = false;
+};
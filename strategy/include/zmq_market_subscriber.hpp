@@ -18,8 +18,8 @@ public:
     // Returns std::nullopt if message is malformed (keeps running).
     std::optional<MarketState> recv_one(std::string* out_topic = nullptr);
 
-private:
-    std::optional<MarketState> parse_market_state_json(const std::string& payload);
+    // market_state_v1 JSON -> MarketState; std::nullopt if malformed
+    static std::optional<MarketState> parse_market_state_json(const std::string& payload);
 
 private:
     std::string endpoint_;
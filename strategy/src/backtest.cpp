@@ -0,0 +1,215 @@
+#include "backtest.hpp"
+#include "zmq_market_subscriber.hpp"   // parse_market_state_json
+
+#include <iostream>
+
+// ------------------------------------------------------------
+// StateDbSource
+// ------------------------------------------------------------
+StateDbSource::StateDbSource(std::string db_path, std::uint64_t from_ms, std::uint64_t to_ms)
+    : db_path_(std::move(db_path)), from_ms_(from_ms), to_ms_(to_ms) {}
+
+bool StateDbSource::open(const std::string& exchange_filter, const std::string& instrument_filter) {
+    StateReader index(db_path_);
+    if (!index.open()) return false;
+
+    for (const auto& k : index.instruments()) {
+        if (!exchange_filter.empty() && k.exchange != exchange_filter) continue;
+        if (!instrument_filter.empty() && k.instrument != instrument_filter) continue;
+
+        // A cursor holds its reader's statements, so every key needs its own reader
+        auto s = std::make_unique<Stream>();
+        s->reader = std::make_unique<StateReader>(db_path_);
+        if (!s->reader->open()) return false;
+
+        s->cur = s->reader->scan(k.exchange, k.instrument, from_ms_, to_ms_);
+        s->buf.resize(CHUNK_ROWS);
+        s->state.schema     = "market_state_v2";
+        s->state.exchange   = k.exchange;
+        s->state.instrument = k.instrument;
+
+        const auto key = static_cast<std::uint32_t>(streams_.size());
+        keys_.push_back(k.exchange + "|" + k.instrument);
+        streams_.push_back(std::move(s));
+
+        if (refill(*streams_.back()))
+            heap_.emplace(streams_.back()->buf[0].ts_ms, key);
+    }
+
+    if (streams_.empty()) {
+        std::cerr << "[BACKTEST] no matching instruments in " << db_path_ << "\n";
+        return false;
+    }
+    return true;
+}
+
+bool StateDbSource::refill(Stream& s) {
+    s.pos = 0;
+    s.n = s.cur.fetch(s.buf.data(), s.buf.size());
+    return s.n > 0;
+}
+
+bool StateDbSource::next(BacktestEvent& ev) {
+    if (heap_.empty()) return false;
+
+    const std::uint32_t key = heap_.top().second;
+    heap_.pop();
+
+    Stream& s = *streams_[key];
+    const StateSnapshot& row = s.buf[s.pos++];
+    MarketState& m = s.state;
+
+    m.ts_ms  = static_cast<std::int64_t>(row.ts_ms);
+    m.mid    = row.mid;
+    m.spread = row.spread;
+    m.bid    = row.mid - row.spread * 0.5;
+    m.ask    = row.mid + row.spread * 0.5;
+    m.r1     = row.r1;
+    m.r5     = row.r5;
+    m.r10    = row.r10;
+    for (int i = 0; i < 5; ++i) {
+        m.bid_vol[i] = row.bid_vol[i];
+        m.ask_vol[i] = row.ask_vol[i];
+    }
+    m.imbalance = depth_imbalance(m.bid_vol.data(), m.ask_vol.data());   // as the live subscriber does
+
+    if (s.pos < s.n || refill(s))
+        heap_.emplace(s.buf[s.pos].ts_ms, key);
+
+    ev.key = key;
+    ev.state = &m;
+    return true;
+}
+
+// ------------------------------------------------------------
+// JsonlSource
+// ------------------------------------------------------------
+JsonlSource::JsonlSource(std::vector<std::string> paths, std::uint64_t from_ms, std::uint64_t to_ms,
+                         std::string exchange_filter, std::string instrument_filter)
+    : paths_(std::move(paths)),
+      from_ms_(from_ms), to_ms_(to_ms),
+      exchange_filter_(std::move(exchange_filter)),
+      instrument_filter_(std::move(instrument_filter)) {}
+
+bool JsonlSource::open_next_file() {
+    while (next_path_ < paths_.size()) {
+        in_.close();
+        in_.clear();
+        const std::string& path = paths_[next_path_++];
+        in_.open(path);
+        if (in_.is_open()) return true;
+        std::cerr << "[BACKTEST] cannot open " << path << " (skipped)\n";
+    }
+    return false;
+}
+
+bool JsonlSource::next(BacktestEvent& ev) {
+    while (true) {
+        if (!in_.is_open() || !std::getline(in_, line_)) {
+            if (!open_next_file()) return false;
+            continue;
+        }
+        if (line_.empty()) continue;
+
+        auto s = ZmqMarketSubscriber::parse_market_state_json(line_);
+        if (!s) {
+            ++bad_lines_;
+            continue;
+        }
+
+        const auto ts = static_cast<std::uint64_t>(s->ts_ms);
+        if (ts < from_ms_ || ts >= to_ms_) continue;
+        if (!exchange_filter_.empty() && s->exchange != exchange_filter_) continue;
+        if (!instrument_filter_.empty() && s->instrument != instrument_filter_) continue;
+
+        state_ = std::move(*s);
+
+        std::string key = state_.key();
+        auto it = ids_.find(key);
+        if (it == ids_.end()) {
+            it = ids_.emplace(key, static_cast<std::uint32_t>(keys_.size())).first;
+            keys_.push_back(std::move(key));
+        }
+
+        ev.key = it->second;
+        ev.state = &state_;
+        return true;
+    }
+}
+
+// ------------------------------------------------------------
+// MarketColumns / ColumnarSource
+// ------------------------------------------------------------
+std::size_t load_columns(BacktestSource& src, MarketColumns& cols) {
+    BacktestEvent ev;
+    bool any_px = false;
+    while (src.next(ev)) {
+        const MarketState& s = *ev.state;
+
+        while (cols.templates.size() <= ev.key) {
+            MarketState t;
+            t.schema     = s.schema;
+            t.exchange   = s.exchange;
+            t.instrument = s.instrument;
+            cols.templates.push_back(std::move(t));
+        }
+
+        cols.key.push_back(ev.key);
+        cols.ts_ms.push_back(s.ts_ms);
+        cols.bid.push_back(s.bid);
+        cols.ask.push_back(s.ask);
+        cols.mid.push_back(s.mid);
+        cols.spread.push_back(s.spread);
+        cols.r1.push_back(s.r1);
+        cols.r5.push_back(s.r5);
+        cols.r10.push_back(s.r10);
+        cols.imbalance.push_back(s.imbalance);
+        cols.bid_vol.push_back(s.bid_vol);
+        cols.ask_vol.push_back(s.ask_vol);
+        cols.bid_px.push_back(s.bid_px);
+        cols.ask_px.push_back(s.ask_px);
+        any_px = any_px || s.bid_px[0] > 0.0 || s.ask_px[0] > 0.0;
+    }
+    cols.keys = src.keys();
+
+    if (!any_px) {
+        cols.bid_px.clear();
+        cols.bid_px.shrink_to_fit();
+        cols.ask_px.clear();
+        cols.ask_px.shrink_to_fit();
+    }
+    return cols.size();
+}
+
+ColumnarSource::ColumnarSource(const MarketColumns& cols)
+    : cols_(cols), states_(cols.templates)
+{
+    keys_ = cols.keys;
+}
+
+bool ColumnarSource::next(BacktestEvent& ev) {
+    if (i_ >= cols_.size()) return false;
+
+    const std::uint32_t key = cols_.key[i_];
+    MarketState& m = states_[key];
+    m.ts_ms     = cols_.ts_ms[i_];
+    m.bid       = cols_.bid[i_];
+    m.ask       = cols_.ask[i_];
+    m.mid       = cols_.mid[i_];
+    m.spread    = cols_.spread[i_];
+    m.r1        = cols_.r1[i_];
+    m.r5        = cols_.r5[i_];
+    m.r10       = cols_.r10[i_];
+    m.imbalance = cols_.imbalance[i_];
+    m.bid_vol   = cols_.bid_vol[i_];
+    m.ask_vol   = cols_.ask_vol[i_];
+    if (!cols_.bid_px.empty()) {
+        m.bid_px = cols_.bid_px[i_];
+        m.ask_px = cols_.ask_px[i_];
+    }
+    ++i_;
+
+    ev.key = key;
+    ev.state = &m;
+    return true;
+}
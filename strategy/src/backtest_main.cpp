@@ -0,0 +1,165 @@
+// backtest: replay historical market state through a strategy + PaperExecutionEngine.
+//
+//   backtest --db market_state.db [--from ms] [--to ms]
+//   backtest --jsonl features.jsonl [--jsonl more.jsonl ...]
+//
+//   common: [--exchange X] [--instrument Y] [--strategy imbalance]
+//           [--thresh 0.6] [--hold 150] [--qty 0.01] [--cash 10000]
+//           [--allow-short] [--no-require-cash] [--fill touch|depth] [--rest-limits]
+//           [--trades trades.csv] [--curve curve.csv] [--curve-ms 1000]
+//
+// --db streams rows straight out of market_state.db (fast path); --jsonl reads
+// market_state_v1 lines such as hft_feeds --replay --features output.
+// --rest-limits (with --fill depth) sends limit orders at the touch and lets
+// the unfilled part rest in the paper engine's queue.
+
+#include "backtest.hpp"
+#include "imbalance_taker.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+static void usage() {
+    std::cerr << "Usage:\n"
+              << "  backtest --db market_state.db [--from ms] [--to ms] [options]\n"
+              << "  backtest --jsonl features.jsonl [--jsonl more.jsonl ...] [options]\n"
+              << "options: [--exchange X] [--instrument Y] [--strategy imbalance]\n"
+              << "         [--thresh 0.6] [--hold 150] [--qty 0.01] [--cash 10000]\n"
+              << "         [--allow-short] [--no-require-cash] [--fill touch|depth] [--rest-limits]\n"
+              << "         [--trades trades.csv] [--curve curve.csv] [--curve-ms 1000]\n";
+}
+
+static void print_result(const BacktestResult& r) {
+    const double span_s = (r.last_ts_ms - r.first_ts_ms) / 1000.0;
+
+    std::printf("[BACKTEST] events=%llu keys=%zu span=%.1fs wall=%.3fs rate=%.0f events/s (%.0fx real time)\n",
+                static_cast<unsigned long long>(r.events), r.keys.size(), span_s, r.wall_s,
+                r.wall_s > 0 ? r.events / r.wall_s : 0.0,
+                r.wall_s > 0 ? span_s / r.wall_s : 0.0);
+    std::printf("[BACKTEST] fills=%llu (resting %llu) rejected=%llu equity %.4f -> %.4f (%+.4f%%) max_drawdown=%.4f\n",
+                static_cast<unsigned long long>(r.fills), static_cast<unsigned long long>(r.resting_fills),
+                static_cast<unsigned long long>(r.rejects),
+                r.start_equity, r.end_equity,
+                r.start_equity > 0 ? (r.end_equity - r.start_equity) / r.start_equity * 100.0 : 0.0,
+                r.max_drawdown);
+
+    std::printf("%-28s %10s %7s %7s %7s %12s %12s %12s\n",
+                "key", "events", "fills", "resting", "rejects", "pos", "realized", "unrealized");
+    for (const auto& k : r.keys) {
+        std::printf("%-28s %10llu %7llu %7llu %7llu %12.6f %12.4f %12.4f\n",
+                    k.key.c_str(), static_cast<unsigned long long>(k.events),
+                    static_cast<unsigned long long>(k.fills), static_cast<unsigned long long>(k.resting_fills),
+                    static_cast<unsigned long long>(k.rejects),
+                    k.wallet.pos, k.wallet.realized_pnl, k.wallet.unrealized_pnl);
+    }
+}
+
+int main(int argc, char** argv) {
+    std::string db_path;
+    std::vector<std::string> jsonl_paths;
+    std::uint64_t from_ms = 0;
+    std::uint64_t to_ms = static_cast<std::uint64_t>(std::numeric_limits<std::int64_t>::max());
+    std::string exchange, instrument;
+    std::string strategy = "imbalance";
+    double thresh = 0.6;
+    int hold = 150;
+    std::string trades_path, curve_path;
+    std::string fill = "touch";
+
+    BacktestParams p;
+    p.exec = PaperExecutionEngine::Params(10000.0, false, true);
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string a = argv[i];
+        const bool has_val = i + 1 < argc;
+        if (a == "--db" && has_val) db_path = argv[++i];
+        else if (a == "--jsonl" && has_val) jsonl_paths.push_back(argv[++i]);
+        else if (a == "--from" && has_val) from_ms = std::stoull(argv[++i]);
+        else if (a == "--to" && has_val) to_ms = std::stoull(argv[++i]);
+        else if (a == "--exchange" && has_val) exchange = argv[++i];
+        else if (a == "--instrument" && has_val) instrument = argv[++i];
+        else if (a == "--strategy" && has_val) strategy = argv[++i];
+        else if (a == "--thresh" && has_val) thresh = std::stod(argv[++i]);
+        else if (a == "--hold" && has_val) hold = std::stoi(argv[++i]);
+        else if (a == "--qty" && has_val) p.qty = std::stod(argv[++i]);
+        else if (a == "--cash" && has_val) p.exec.initial_cash = std::stod(argv[++i]);
+        else if (a == "--allow-short") p.exec.allow_short = true;
+        else if (a == "--no-require-cash") p.exec.require_cash = false;
+        else if (a == "--fill" && has_val) fill = argv[++i];
+        else if (a == "--rest-limits") p.exec.rest_limits = true;
+        else if (a == "--trades" && has_val) trades_path = argv[++i];
+        else if (a == "--curve" && has_val) curve_path = argv[++i];
+        else if (a == "--curve-ms" && has_val) p.curve_ms = std::stoll(argv[++i]);
+        else {
+            usage();
+            return 1;
+        }
+    }
+
+    if (db_path.empty() == jsonl_paths.empty()) {
+        usage();
+        return 1;
+    }
+    if (fill == "depth") p.exec.fill = FillModel::Depth;
+    else if (fill != "touch") {
+        std::cerr << "[BACKTEST] unknown --fill '" << fill << "' (touch | depth)\n";
+        return 1;
+    }
+    if (p.exec.rest_limits && p.exec.fill != FillModel::Depth) {
+        std::cerr << "[BACKTEST] --rest-limits needs --fill depth\n";
+        return 1;
+    }
+
+    // ----------- source -----------
+    std::unique_ptr<BacktestSource> src;
+    if (!db_path.empty()) {
+        auto db = std::make_unique<StateDbSource>(db_path, from_ms, to_ms);
+        if (!db->open(exchange, instrument)) return 1;
+        src = std::move(db);
+    } else {
+        src = std::make_unique<JsonlSource>(jsonl_paths, from_ms, to_ms, exchange, instrument);
+    }
+
+    // ----------- outputs -----------
+    std::ofstream trades_out, curve_out;
+    if (!trades_path.empty()) {
+        trades_out.open(trades_path);
+        if (!trades_out) {
+            std::cerr << "[BACKTEST] cannot write " << trades_path << "\n";
+            return 1;
+        }
+        trades_out << std::fixed << std::setprecision(8);
+        p.trades_out = &trades_out;
+    }
+    if (!curve_path.empty()) {
+        curve_out.open(curve_path);
+        if (!curve_out) {
+            std::cerr << "[BACKTEST] cannot write " << curve_path << "\n";
+            return 1;
+        }
+        curve_out << std::fixed << std::setprecision(8);
+        p.curve_out = &curve_out;
+    }
+    backtest_write_csv_headers(p);
+
+    // ----------- strategy -----------
+    BacktestResult r;
+    if (strategy == "imbalance") {
+        r = run_backtest<ImbalanceTaker>(*src, [&] { return ImbalanceTaker(thresh, hold); }, p);
+    } else {
+        std::cerr << "[BACKTEST] unknown strategy '" << strategy << "' (available: imbalance)\n";
+        return 1;
+    }
+
+    if (auto* js = dynamic_cast<JsonlSource*>(src.get()); js && js->bad_lines())
+        std::cerr << "[BACKTEST] skipped " << js->bad_lines() << " unparseable lines\n";
+
+    print_result(r);
+    return r.events > 0 ? 0 : 1;
+}
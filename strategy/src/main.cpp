@@ -1,8 +1,12 @@
+#include <algorithm>
 #include <csignal>
 #include <iomanip>
 #include <iostream>
+#include <memory>
 #include <thread>
-#include <unordered_map>
+#include <vector>
+
+#include <pthread.h>
 
 // threading
 #include <condition_variable>
@@ -14,73 +18,47 @@
 #include <sstream>
 
 #include "imbalance_taker.hpp"
+#include "instrument_registry.hpp"
+#include "last_state_table.hpp"
+#include "packed_market_state.hpp"
+#include "spsc_ring.hpp"
 #include "zmq_market_subscriber.hpp"
 #include "paper_execution_engine.hpp"
 #include "order_intent.hpp"
+#include "latency_trace.hpp"
+#include "pre_trade_risk.hpp"
 
 // ------------------- shutdown -------------------
 static volatile std::sig_atomic_t g_stop = 0;
 static void on_sigint(int) { g_stop = 1; }
 
-// ------------------- market queue -------------------
-static std::mutex g_mtx;
-static std::condition_variable g_cv;
-static std::queue<MarketState> g_q;
-static constexpr size_t MAX_Q = 200000;
-
-static void push_state(MarketState&& s) {
-    std::unique_lock<std::mutex> lk(g_mtx);
-    if (g_q.size() >= MAX_Q) g_q.pop();   // drop oldest
-    g_q.push(std::move(s));
-    lk.unlock();
-    g_cv.notify_one();
-}
+// ------------------- instruments -------------------
+// exchange|instrument -> dense id; interned by the receiver only
+static constexpr std::uint32_t MAX_INSTRUMENTS = 4096;
+static InstrumentRegistry g_instruments(MAX_INSTRUMENTS);
 
-static bool pop_state(MarketState& out) {
-    std::unique_lock<std::mutex> lk(g_mtx);
-    g_cv.wait(lk, [] { return g_stop || !g_q.empty(); });
-    if (g_stop && g_q.empty()) return false;
-    out = std::move(g_q.front());
-    g_q.pop();
-    return true;
-}
-
-// ------------------- current key (for manual input default) -------------------
-static std::mutex g_key_mtx;
-static std::string g_current_key;
-
-static void set_current_key(const std::string& k) {
-    std::lock_guard<std::mutex> lk(g_key_mtx);
-    g_current_key = k;
-}
+// Last id the receiver saw (default key for manual input)
+static std::atomic<std::uint32_t> g_current_id{InstrumentRegistry::NONE};
 
 static std::string get_current_key() {
-    std::lock_guard<std::mutex> lk(g_key_mtx);
-    return g_current_key;
+    const std::uint32_t id = g_current_id.load(std::memory_order_acquire);
+    return id == InstrumentRegistry::NONE ? std::string() : g_instruments.key(id);
 }
 
-// ------------------- latest market snapshot (per symbol key) -------------------
-static std::mutex g_last_mtx;
-static std::unordered_map<std::string, MarketState> g_last;
-
-static void update_last(const MarketState& s) {
-    std::lock_guard<std::mutex> lk(g_last_mtx);
-    g_last[s.key()] = s;
-}
-
-static bool get_last(const std::string& key, MarketState& out) {
-    std::lock_guard<std::mutex> lk(g_last_mtx);
-    auto it = g_last.find(key);
-    if (it == g_last.end()) return false;
-    out = it->second;
-    return true;
-}
+// ------------------- latest market snapshot (per instrument id) -------------------
+// Written only by the shard that owns the id; read lock-free by the exec thread
+static LastStateTable g_last(MAX_INSTRUMENTS);
 
 // Wait a short time for first snapshot (so first order can fill immediately)
 static bool wait_last(const std::string& key, MarketState& out, int max_wait_ms = 2000) {
     auto start = std::chrono::steady_clock::now();
+    PackedMarketState p;
     while (!g_stop) {
-        if (get_last(key, out)) return true;
+        const std::uint32_t id = g_instruments.find(key);
+        if (id != InstrumentRegistry::NONE && g_last.load(id, p)) {
+            unpack_market_state(p, out);
+            return true;
+        }
         auto now = std::chrono::steady_clock::now();
         if (std::chrono::duration_cast<std::chrono::milliseconds>(now - start).count() > max_wait_ms)
             return false;
@@ -89,12 +67,91 @@ static bool wait_last(const std::string& key, MarketState& out, int max_wait_ms
     return false;
 }
 
+// ------------------- strategy shards -------------------
+// Instrument id -> shard (id % N). Each shard is one worker thread with its own
+// SPSC ring from the receiver and its own strategies; nothing is shared
+// between shards on the hot path.
+static constexpr size_t SHARD_RING_SIZE = 1 << 13;
+
+struct StrategyShard {
+    SpscRing<PackedMarketState, SHARD_RING_SIZE> ring;   // receiver -> this worker
+    std::thread thread;
+};
+
+static void pin_thread(std::thread& t, unsigned cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    const int rc = pthread_setaffinity_np(t.native_handle(), sizeof(set), &set);
+    if (rc != 0)
+        std::cerr << "[SHARD] pinning to cpu " << cpu << " failed rc=" << rc << "\n";
+}
+
+// Shard worker: strategy decisions only (NO execution / NO wallet here)
+static void run_shard(StrategyShard& sh, unsigned shard, unsigned nshards, bool spin,
+                      const ImbalanceTaker& proto) {
+    // Local slot of instrument id = id / nshards
+    std::vector<ImbalanceTaker> strats;
+    std::uint64_t seen = 0;
+
+    PackedMarketState p;
+    MarketState s;
+    while (sh.ring.wait_pop(p, spin, [] { return g_stop != 0; })) {
+        p.trace.dequeue_ns = trace_now_ns();
+        g_last.store(p.instrument_id, p);
+        unpack_market_state(p, s);
+
+        const std::uint32_t slot = p.instrument_id / nshards;
+        if (slot >= strats.size()) strats.resize(slot + 1, proto);
+        ImbalanceTaker& strat = strats[slot];
+
+        int sig = strat.on_state(s);
+
+        if (s.trace.id) {
+            s.trace.signal_ns = trace_now_ns();
+            trace_span(LS_STRAT_QUEUE, s.trace.parsed_ns, s.trace.dequeue_ns);
+            trace_span(LS_STRAT_SIGNAL, s.trace.dequeue_ns, s.trace.signal_ns);
+            trace_span(LS_TICK_TO_SIGNAL, s.trace.recv_ns, s.trace.signal_ns);
+        }
+
+        // Throttle printing so humans can type; one write per line so
+        // shards do not interleave mid-line
+        if (++seen % 50 == 0) {
+            std::ostringstream line;
+            line.setf(std::ios::fixed);
+            line << std::setprecision(8)
+                 << "[RX" << shard << "] " << s.exchange << " " << s.instrument
+                 << " TS=" << s.ts_ms
+                 << " BID=" << s.bid
+                 << " ASK=" << s.ask
+                 << " MID=" << s.mid
+                 << " SPR=" << s.spread
+                 << " r1=" << s.r1
+                 << " r5=" << s.r5
+                 << " r10=" << s.r10
+                 << " IMB=" << s.imbalance;
+
+            if (sig == +1) line << " => BUY (pos=" << strat.position() << ")";
+            else if (sig == -1) line << " => SELL (pos=" << strat.position() << ")";
+            else line << " => HOLD (pos=" << strat.position() << ")";
+
+            line << "\n";
+            std::cout << line.str();
+        }
+
+        // (Optional later) If you want strategy-driven orders:
+        // if (sig == +1) push_exec(OrderIntent{...});
+        // if (sig == -1) push_exec(OrderIntent{...});
+    }
+}
+
 // ------------------- execution queue (orders to execute) -------------------
 static std::mutex g_exec_mtx;
 static std::condition_variable g_exec_cv;
 static std::queue<OrderIntent> g_exec_q;
 
 static void push_exec(OrderIntent&& oi) {
+    oi.trace.intent_ns = trace_now_ns();
     {
         std::lock_guard<std::mutex> lk(g_exec_mtx);
         g_exec_q.push(std::move(oi));
@@ -102,35 +159,49 @@ static void push_exec(OrderIntent&& oi) {
     g_exec_cv.notify_one();
 }
 
-static bool pop_exec(OrderIntent& out) {
+// Waits at most `wait`; false on timeout or stop with nothing queued
+static bool pop_exec(OrderIntent& out, std::chrono::milliseconds wait) {
     std::unique_lock<std::mutex> lk(g_exec_mtx);
-    g_exec_cv.wait(lk, [] { return g_stop || !g_exec_q.empty(); });
-    if (g_stop && g_exec_q.empty()) return false;
+    g_exec_cv.wait_for(lk, wait, [] { return g_stop || !g_exec_q.empty(); });
+    if (g_exec_q.empty()) return false;
     out = std::move(g_exec_q.front());
     g_exec_q.pop();
     return true;
 }
 
-// ------------------- throttle printing -------------------
-static std::atomic<uint64_t> g_rx_print_ctr{0};
-
 // ------------------- main -------------------
 int main(int argc, char** argv) {
     std::signal(SIGINT, on_sigint);
 
     std::string endpoint = "tcp://127.0.0.1:5555";
     std::string filter   = "state.";
+    bool spin = false;     // --spin: workers busy-poll their rings (one core each at 100%)
+    unsigned workers = 1;  // --workers N: strategy shards
+    bool pin = true;       // --no-pin: leave worker placement to the OS
+    double thresh = 0.6;   // --thresh / --hold: ImbalanceTaker parameters (see sweep)
+    int hold = 150;
 
     for (int i = 1; i < argc; ++i) {
         std::string a = argv[i];
         if (a == "--endpoint" && i + 1 < argc) endpoint = argv[++i];
         else if (a == "--filter" && i + 1 < argc) filter = argv[++i];
+        else if (a == "--spin") spin = true;
+        else if (a == "--workers" && i + 1 < argc) workers = std::max(1, std::stoi(argv[++i]));
+        else if (a == "--no-pin") pin = false;
+        else if (a == "--thresh" && i + 1 < argc) thresh = std::stod(argv[++i]);
+        else if (a == "--hold" && i + 1 < argc) hold = std::stoi(argv[++i]);
     }
 
     std::cout << "SUB endpoint: " << endpoint << "\n";
     std::cout << "SUB filter  : " << filter << "\n";
+    std::cout << "Workers     : " << workers << (pin ? " (pinned)" : "")
+              << ", " << (spin ? "busy-spin" : "spin, then sleep") << "\n";
+    std::cout << "Strategy    : imbalance thresh=" << thresh << " hold=" << hold << "\n";
     std::cout << "Press Ctrl+C to stop.\n\n";
 
+    std::cout.setf(std::ios::fixed);
+    std::cout << std::setprecision(8);
+
     // ----------- ZMQ subscriber (receiver thread owns it) -----------
     ZmqMarketSubscriber sub(endpoint, filter);
 
@@ -151,8 +222,13 @@ int main(int argc, char** argv) {
             double qty;
             ss >> side >> qty;
 
+            if (line == "lat") {
+                std::cout << latency_report("strategy_runner");
+                continue;
+            }
+
             if (!ss || qty <= 0.0 || (side != 'b' && side != 's')) {
-                std::cout << "[INPUT] Invalid. Use: b 0.01 or s 0.01\n";
+                std::cout << "[INPUT] Invalid. Use: b 0.01 or s 0.01 (lat = latency report)\n";
                 continue;
             }
 
@@ -181,49 +257,17 @@ int main(int argc, char** argv) {
         }
     });
 
-    // ----------- strategy worker thread (NO execution / NO wallet here) -----------
-    std::thread worker([&]() {
-        std::unordered_map<std::string, ImbalanceTaker> strat_map;
-
-        std::cout.setf(std::ios::fixed);
-        std::cout << std::setprecision(8);
-
-        MarketState s;
-        while (pop_state(s)) {
-            set_current_key(s.key());
-            update_last(s);
-
-            auto& strat =
-                strat_map.try_emplace(s.key(), ImbalanceTaker(0.6, 150)).first->second;
-
-            int sig = strat.on_state(s);
-
-            // Throttle printing so humans can type
-            if (++g_rx_print_ctr % 50 == 0) {
-                std::cout
-                    << "[RX] " << s.exchange << " " << s.instrument
-                    << " TS=" << s.ts_ms
-                    << " BID=" << s.bid
-                    << " ASK=" << s.ask
-                    << " MID=" << s.mid
-                    << " SPR=" << s.spread
-                    << " r1=" << s.r1
-                    << " r5=" << s.r5
-                    << " r10=" << s.r10
-                    << " IMB=" << s.imbalance;
-
-                if (sig == +1) std::cout << " => BUY (pos=" << strat.position() << ")";
-                else if (sig == -1) std::cout << " => SELL (pos=" << strat.position() << ")";
-                else std::cout << " => HOLD (pos=" << strat.position() << ")";
-
-                std::cout << "\n";
-            }
-
-            // (Optional later) If you want strategy-driven orders:
-            // if (sig == +1) push_exec(OrderIntent{...});
-            // if (sig == -1) push_exec(OrderIntent{...});
-        }
-    });
+    // ----------- strategy shards (pinned workers) -----------
+    std::vector<std::unique_ptr<StrategyShard>> shards;
+    const unsigned ncpu = std::max(1u, std::thread::hardware_concurrency());
+    const ImbalanceTaker proto(thresh, hold);
+    for (unsigned i = 0; i < workers; ++i) {
+        shards.push_back(std::make_unique<StrategyShard>());
+        StrategyShard& sh = *shards.back();
+        sh.thread = std::thread(run_shard, std::ref(sh), i, workers, spin, std::cref(proto));
+        // cpu 0 is left to the receiver when there is more than one
+        if (pin) pin_thread(sh.thread, ncpu > 1 ? 1 + i % (ncpu - 1) : 0);
+    }
 
     // ----------- execution thread (ONLY place that owns PaperExecutionEngine) -----------
     std::thread exec_thread([&]() {
@@ -234,9 +278,39 @@ int main(int argc, char** argv) {
 
         PaperExecutionEngine exec(p);
 
+        // RISK_* limits; positions follow the paper fills
+        PreTradeRisk risk(MAX_INSTRUMENTS, PreTradeRisk::Limits::from_env());
+        auto risk_fills = [&](std::size_t n) {
+            const auto& tr = exec.trades();
+            for (std::size_t i = tr.size() - n; i < tr.size(); ++i)
+                risk.on_fill(risk.intern(tr[i].key), tr[i].side == Side::Buy, tr[i].qty);
+        };
+
+        // The engine has one wallet: its position and any resting order are on
+        // the instrument last traded. Every new state of that one goes through
+        // on_market (marks, resting fills), checked at least each ms; other
+        // instruments' states would mark the wallet at the wrong mid.
+        std::uint32_t exec_id = InstrumentRegistry::NONE;
+        std::uint32_t marked = 0;   // g_last version of exec_id seen
+        auto poll_market = [&]() {
+            const std::uint32_t v = g_last.version(exec_id);
+            PackedMarketState p;
+            if (v == 0 || (v & 1) || v == marked || !g_last.load(exec_id, p)) return;
+            marked = v;
+            MarketState ms;
+            unpack_market_state(p, ms);
+            risk_fills(exec.on_market(ms));
+        };
+
         while (!g_stop) {
             OrderIntent oi;
-            if (!pop_exec(oi)) break;
+            const bool got = pop_exec(oi, std::chrono::milliseconds(1));
+            poll_market();
+            if (!got) continue;
+
+            const std::uint64_t intent_ns  = oi.trace.intent_ns;
+            const std::uint64_t dequeue_ns = trace_now_ns();
+            trace_span(LS_EXEC_QUEUE, intent_ns, dequeue_ns);
 
             MarketState s;
             if (!wait_last(oi.key, s, 2000)) {
@@ -244,19 +318,50 @@ int main(int argc, char** argv) {
                 continue;
             }
 
+            // Switching instruments: what rests on the old one is dropped
+            const std::uint32_t id = g_instruments.find(oi.key);
+            if (id != exec_id) {
+                exec.cancel_resting();
+                exec_id = id;
+                marked = 0;
+                poll_market();
+            }
+
             // Marketable Day-1 behavior
             if (oi.side == Side::Buy) oi.price = s.ask;
             else                     oi.price = s.bid;
 
             oi.ts_ms = s.ts_ms;
 
+            // Trace of the tick this order is priced on, plus our own stamps
+            oi.trace            = s.trace;
+            oi.trace.intent_ns  = intent_ns;
+            oi.trace.dequeue_ns = dequeue_ns;
+
             std::cout << "\n[ORDER] " << (oi.side == Side::Buy ? "BUY " : "SELL ")
                       << oi.qty << " @ " << oi.price
                       << " key=" << oi.key << "\n";
 
-            exec.on_market(s);
+            PreTradeRisk::Hold reserved;
+            const unsigned rej = risk.check_and_reserve(risk.intern(oi.key), oi.side == Side::Buy,
+                                                        oi.qty, oi.price, trace_now_ns(), reserved);
+            if (rej) {
+                std::cout << "[RISK ] rejected (" << PreTradeRisk::describe(rej) << ")\n\n";
+                continue;
+            }
+
+            const std::uint64_t submit_t0 = trace_now_ns();
             auto trade = exec.submit(s, oi);
 
+            // Paper fills are immediate: nothing stays open at the gate
+            risk.release(reserved, reserved.qty);
+            if (trade) risk.on_fill(reserved.id, trade->side == Side::Buy, trade->qty);
+
+            if (trade) {
+                trace_span(LS_EXEC_SUBMIT, submit_t0, trade->trace.submit_ns);
+                trace_span(LS_TICK_TO_TRADE, trade->trace.recv_ns, trade->trace.submit_ns);
+            }
+
             if (trade) {
                 std::cout << "[FILL ] " << (trade->side == Side::Buy ? "BUY " : "SELL ")
                           << trade->qty << " @ " << trade->price
@@ -276,21 +381,48 @@ int main(int argc, char** argv) {
     });
 
     // ----------- receiver loop (main thread) -----------
+    // kill -USR1 <pid> dumps latency histograms (checked per received message)
+    latency_install_sigusr1();
+
+    PackedMarketState packed;
+    bool registry_full_logged = false;
     while (!g_stop) {
         auto ms = sub.recv_one();
+        if (latency_dump_requested())
+            std::cout << latency_report("strategy_runner");
         if (!ms) continue;
-        push_state(std::move(*ms));
+
+        const std::uint32_t id = g_instruments.intern(ms->exchange, ms->instrument);
+        if (id == InstrumentRegistry::NONE) {
+            if (!registry_full_logged) {
+                std::cerr << "[RX] more than " << MAX_INSTRUMENTS << " instruments, ignoring "
+                          << ms->key() << " and any further new ones\n";
+                registry_full_logged = true;
+            }
+            continue;
+        }
+
+        pack_market_state(*ms, id, packed);
+        shards[id % workers]->ring.push(packed);
+        g_current_id.store(id, std::memory_order_release);
     }
 
     // ----------- shutdown / join -----------
     g_stop = 1;
-    g_cv.notify_all();
+    for (auto& sh : shards) sh->ring.wake();
     g_exec_cv.notify_all();
 
     if (input_thread.joinable()) input_thread.join();
-    if (worker.joinable()) worker.join();
+    for (auto& sh : shards)
+        if (sh->thread.joinable()) sh->thread.join();
     if (exec_thread.joinable()) exec_thread.join();
 
+    std::cout << latency_report("strategy_runner");
+    for (unsigned i = 0; i < workers; ++i) {
+        if (shards[i]->ring.dropped())
+            std::cout << "[RING] shard " << i << ": " << shards[i]->ring.dropped()
+                      << " market states dropped (worker fell " << SHARD_RING_SIZE << " behind)\n";
+    }
     std::cout << "\nStopping strategy.\n";
     return 0;
 }
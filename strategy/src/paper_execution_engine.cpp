@@ -1,10 +1,59 @@
 #include "paper_execution_engine.hpp"
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+// ------------------------------------------------------------
+// Book levels (five per side, best first)
+// ------------------------------------------------------------
+
+// Price of level i; unknown prices (0) are one spread apart from the touch.
+// dir: +1 asks (rising), -1 bids (falling)
+static double level_px(const std::array<double, 5>& px, double touch, double step, int dir, int i) {
+    return px[i] > 0.0 ? px[i] : touch + dir * i * step;
+}
+
+static int find_level(const std::array<double, 5>& px, double touch, double step, int dir, double price) {
+    for (int i = 0; i < 5; ++i)
+        if (std::fabs(level_px(px, touch, step, dir, i) - price) <= 1e-9 * std::fabs(price)) return i;
+    return -1;
+}
+
+static bool has_depth(const std::array<double, 5>& vol) {
+    for (double v : vol)
+        if (v > 0.0) return true;
+    return false;
+}
+
+// key == exchange|instrument of s, without building the string
+static bool same_key(const std::string& key, const MarketState& s) {
+    const std::size_t ex = s.exchange.size();
+    return key.size() == ex + 1 + s.instrument.size() &&
+           key.compare(0, ex, s.exchange) == 0 && key[ex] == '|' &&
+           key.compare(ex + 1, std::string::npos, s.instrument) == 0;
+}
+
+// Market orders carry no usable limit: +inf / <= 0 (see run_backtest)
+static bool is_limit(const OrderIntent& oi) {
+    return oi.price > 0.0 && std::isfinite(oi.price);
+}
+
+// ------------------------------------------------------------
+// PaperExecutionEngine
+// ------------------------------------------------------------
 PaperExecutionEngine::PaperExecutionEngine(Params p)
     : p_(p), wallet_(p.initial_cash) {}
 
-void PaperExecutionEngine::on_market(const MarketState& s) {
-    wallet_.mark(s.mid);
+Trade PaperExecutionEngine::fill(Side side, double qty, double price, const OrderIntent& oi, double mid) {
+    if (side == Side::Buy) wallet_.on_fill_buy(qty, price);
+    else                   wallet_.on_fill_sell(qty, price);
+    wallet_.mark(mid);
+
+    Trade t{oi.key, side, price, qty, oi.ts_ms, wallet_.snap().pos, oi.trace};
+    t.trace.submit_ns = trace_now_ns();
+    trades_.push_back(t);
+    return t;
 }
 
 std::optional<Trade> PaperExecutionEngine::submit(
@@ -14,17 +63,21 @@ std::optional<Trade> PaperExecutionEngine::submit(
     if (oi.qty <= 0.0) return std::nullopt;
     if (s.bid <= 0.0 || s.ask <= 0.0) return std::nullopt;
 
+    if (p_.fill == FillModel::Depth)
+        return submit_depth(s, oi);
+    return submit_touch(s, oi);
+}
+
+std::optional<Trade> PaperExecutionEngine::submit_touch(
+    const MarketState& s,
+    const OrderIntent& oi)
+{
     if (oi.side == Side::Buy) {
         if (oi.price < s.ask) return std::nullopt;
         if (p_.require_cash && wallet_.snap().cash < oi.qty * s.ask)
             return std::nullopt;
 
-        wallet_.on_fill_buy(oi.qty, s.ask);
-        wallet_.mark(s.mid);
-
-        Trade t{oi.key, Side::Buy, s.ask, oi.qty, oi.ts_ms, wallet_.snap().pos};
-        trades_.push_back(t);
-        return t;
+        return fill(Side::Buy, oi.qty, s.ask, oi, s.mid);
     }
 
     if (!p_.allow_short && wallet_.snap().pos < oi.qty)
@@ -32,10 +85,140 @@ std::optional<Trade> PaperExecutionEngine::submit(
 
     if (oi.price > s.bid) return std::nullopt;
 
-    wallet_.on_fill_sell(oi.qty, s.bid);
-    wallet_.mark(s.mid);
+    return fill(Side::Sell, oi.qty, s.bid, oi, s.mid);
+}
 
-    Trade t{oi.key, Side::Sell, s.bid, oi.qty, oi.ts_ms, wallet_.snap().pos};
-    trades_.push_back(t);
+std::optional<Trade> PaperExecutionEngine::submit_depth(
+    const MarketState& s,
+    const OrderIntent& oi)
+{
+    const bool buy = oi.side == Side::Buy;
+    if (!buy && !p_.allow_short && wallet_.snap().pos < oi.qty)
+        return std::nullopt;
+
+    const auto& vol = buy ? s.ask_vol : s.bid_vol;
+    if (!has_depth(vol)) return submit_touch(s, oi);   // no book published
+
+    const auto& px = buy ? s.ask_px : s.bid_px;
+    const double touch = buy ? s.ask : s.bid;
+    const int dir = buy ? 1 : -1;
+    const double step = std::max(s.spread, 0.0);
+
+    double cash_left = buy && p_.require_cash ? wallet_.snap().cash : std::numeric_limits<double>::infinity();
+    double remaining = oi.qty;
+    double filled = 0.0, cost = 0.0;
+
+    for (int i = 0; i < 5 && remaining > 1e-12; ++i) {
+        const double lp = level_px(px, touch, step, dir, i);
+        if (buy ? lp > oi.price : lp < oi.price) break;   // past the limit
+
+        double take = std::min(remaining, vol[i]);
+        if (buy) take = std::min(take, cash_left / lp);
+        if (take <= 0.0) {
+            if (vol[i] > 0.0) break;   // out of cash
+            continue;
+        }
+
+        filled += take;
+        cost += take * lp;
+        remaining -= take;
+        if (buy) cash_left -= take * lp;
+    }
+
+    std::optional<Trade> t;
+    if (filled > 0.0) t = fill(oi.side, filled, cost / filled, oi, s.mid);
+
+    if (remaining > 1e-12 && p_.rest_limits && is_limit(oi))
+        rest(s, oi, remaining);
     return t;
 }
+
+// Queue position on entry: behind everything displayed at our price, or
+// first in line when the price improves the touch. Deeper than the five
+// published levels the queue is unknown and the order fills only when the
+// market trades through it.
+bool PaperExecutionEngine::rest(const MarketState& s, const OrderIntent& oi, double qty) {
+    for (auto& r : resting_) {
+        if (r.live) continue;
+
+        r.live = true;
+        r.oi = oi;
+        r.oi.qty = qty;
+        r.queue_ahead = r.level_vol = 0.0;
+
+        const bool buy = oi.side == Side::Buy;
+        const double touch = buy ? s.bid : s.ask;
+        const bool improves = buy ? oi.price > touch : oi.price < touch;
+        if (!improves) {
+            const int lvl = find_level(buy ? s.bid_px : s.ask_px, touch, std::max(s.spread, 0.0),
+                                       buy ? -1 : 1, oi.price);
+            if (lvl >= 0) r.queue_ahead = r.level_vol = (buy ? s.bid_vol : s.ask_vol)[lvl];
+        }
+        return true;
+    }
+    return false;
+}
+
+// Every drop in our level's displayed qty is taken as trading at the front
+// of the queue (cancels cannot be told apart without a trade feed); once
+// the qty ahead of us is gone, further drops fill us.
+std::size_t PaperExecutionEngine::on_market(const MarketState& s) {
+    wallet_.mark(s.mid);
+
+    std::size_t fills = 0;
+    for (auto& r : resting_) {
+        if (!r.live || !same_key(r.oi.key, s)) continue;
+        if (s.bid <= 0.0 || s.ask <= 0.0) break;
+
+        const bool buy = r.oi.side == Side::Buy;
+        const double price = r.oi.price;
+        double qty = 0.0;
+
+        if (buy ? s.ask <= price : s.bid >= price) {
+            qty = r.oi.qty;   // traded through
+        } else if (buy ? price > s.bid : price < s.ask) {
+            r.queue_ahead = r.level_vol = 0.0;   // alone at the best price
+        } else {
+            const int lvl = find_level(buy ? s.bid_px : s.ask_px, buy ? s.bid : s.ask,
+                                       std::max(s.spread, 0.0), buy ? -1 : 1, price);
+            if (lvl >= 0) {
+                const double v = (buy ? s.bid_vol : s.ask_vol)[lvl];
+                if (v < r.level_vol) {
+                    double traded = r.level_vol - v;
+                    const double ahead = std::min(traded, r.queue_ahead);
+                    r.queue_ahead -= ahead;
+                    traded -= ahead;
+                    qty = std::min(traded, r.oi.qty);
+                }
+                r.level_vol = v;
+            }
+        }
+        if (qty <= 0.0) continue;
+
+        // Wallet limits apply at fill time, as for submit()
+        if (buy && p_.require_cash) qty = std::min(qty, wallet_.snap().cash / price);
+        if (!buy && !p_.allow_short) qty = std::min(qty, wallet_.snap().pos);
+        if (qty <= 1e-12) {
+            r.live = false;
+            continue;
+        }
+
+        r.oi.ts_ms = s.ts_ms;
+        fill(r.oi.side, qty, price, r.oi, s.mid);
+        ++fills;
+
+        r.oi.qty -= qty;
+        if (r.oi.qty <= 1e-12) r.live = false;
+    }
+    return fills;
+}
+
+std::size_t PaperExecutionEngine::resting() const {
+    std::size_t n = 0;
+    for (const auto& r : resting_) n += r.live ? 1 : 0;
+    return n;
+}
+
+void PaperExecutionEngine::cancel_resting() {
+    for (auto& r : resting_) r.live = false;
+}
@@ -0,0 +1,272 @@
+// sweep: evaluate many strategy parameter sets over one historical dataset.
+//
+//   sweep --db market_state.db [--from ms] [--to ms]
+//   sweep --jsonl features.jsonl [--jsonl more.jsonl ...]
+//
+//   grid:   [--thresh 0.3:0.9:0.1] [--hold 50:300:50]     (start:stop:step or a,b,c)
+//   random: [--random N] [--seed S]                        (N points inside those ranges)
+//   common: [--exchange X] [--instrument Y] [--threads N]
+//           [--qty 0.01] [--cash 10000] [--allow-short] [--no-require-cash]
+//           [--fill touch|depth] [--rest-limits] [--top 20] [--csv results.csv]
+//
+// The dataset is loaded once into MarketColumns and shared read-only by all
+// workers; every parameter set is a full backtest (own strategies, own
+// PaperExecutionEngine per key) run as one task on a WorkStealingPool.
+// Results are ranked by PnL.
+
+#include "backtest.hpp"
+#include "imbalance_taker.hpp"
+#include "work_stealing_pool.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+static void usage() {
+    std::cerr << "Usage:\n"
+              << "  sweep --db market_state.db [--from ms] [--to ms] [options]\n"
+              << "  sweep --jsonl features.jsonl [--jsonl more.jsonl ...] [options]\n"
+              << "grid:   [--thresh 0.3:0.9:0.1] [--hold 50:300:50]   (start:stop:step or a,b,c)\n"
+              << "random: [--random N] [--seed S]                      (N points inside those ranges)\n"
+              << "options: [--exchange X] [--instrument Y] [--threads N]\n"
+              << "         [--qty 0.01] [--cash 10000] [--allow-short] [--no-require-cash]\n"
+              << "         [--fill touch|depth] [--rest-limits] [--top 20] [--csv results.csv]\n";
+}
+
+// "start:stop:step" (inclusive) or "a,b,c" or a single value
+static bool parse_values(const std::string& spec, std::vector<double>& out) {
+    out.clear();
+    try {
+        const auto c1 = spec.find(':');
+        if (c1 != std::string::npos) {
+            const auto c2 = spec.find(':', c1 + 1);
+            if (c2 == std::string::npos) return false;
+            const double start = std::stod(spec.substr(0, c1));
+            const double stop  = std::stod(spec.substr(c1 + 1, c2 - c1 - 1));
+            const double step  = std::stod(spec.substr(c2 + 1));
+            if (step <= 0.0 || stop < start) return false;
+            // Index-based so float steps do not drift past / short of stop
+            const auto n = static_cast<long>((stop - start) / step + 1e-9);
+            for (long i = 0; i <= n; ++i) out.push_back(start + i * step);
+            return true;
+        }
+
+        std::size_t pos = 0;
+        while (pos <= spec.size()) {
+            const auto comma = spec.find(',', pos);
+            const auto end = comma == std::string::npos ? spec.size() : comma;
+            out.push_back(std::stod(spec.substr(pos, end - pos)));
+            if (comma == std::string::npos) break;
+            pos = comma + 1;
+        }
+    } catch (const std::exception&) {
+        return false;
+    }
+    return !out.empty();
+}
+
+struct SweepPoint {
+    double thresh = 0.6;
+    int hold = 150;
+};
+
+struct SweepRow {
+    SweepPoint pt;
+    BacktestResult r;   // keys dropped, totals only
+
+    double pnl() const { return r.end_equity - r.start_equity; }
+};
+
+static std::vector<SweepPoint> grid_points(const std::vector<double>& threshs, const std::vector<double>& holds) {
+    std::vector<SweepPoint> pts;
+    for (double t : threshs)
+        for (double h : holds)
+            pts.push_back(SweepPoint{t, static_cast<int>(h + 0.5)});
+    return pts;
+}
+
+// Uniform over [min, max] of each axis; hold is an integer tick count
+static std::vector<SweepPoint> random_points(const std::vector<double>& threshs, const std::vector<double>& holds,
+                                             std::size_t n, std::uint64_t seed) {
+    const auto [t_lo, t_hi] = std::minmax_element(threshs.begin(), threshs.end());
+    const auto [h_lo, h_hi] = std::minmax_element(holds.begin(), holds.end());
+
+    std::mt19937_64 rng(seed);
+    std::uniform_real_distribution<double> td(*t_lo, *t_hi);
+    std::uniform_int_distribution<int> hd(static_cast<int>(*h_lo + 0.5), static_cast<int>(*h_hi + 0.5));
+
+    std::vector<SweepPoint> pts(n);
+    for (auto& p : pts) {
+        p.thresh = td(rng);
+        p.hold = hd(rng);
+    }
+    return pts;
+}
+
+int main(int argc, char** argv) {
+    std::string db_path;
+    std::vector<std::string> jsonl_paths;
+    std::uint64_t from_ms = 0;
+    std::uint64_t to_ms = static_cast<std::uint64_t>(std::numeric_limits<std::int64_t>::max());
+    std::string exchange, instrument;
+    std::string thresh_spec = "0.3:0.9:0.1";
+    std::string hold_spec = "50:300:50";
+    std::size_t random_n = 0;
+    std::uint64_t seed = 1;
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    std::size_t top = 20;
+    std::string csv_path;
+    std::string fill = "touch";
+
+    BacktestParams p;
+    p.exec = PaperExecutionEngine::Params(10000.0, false, true);
+    p.curve_ms = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string a = argv[i];
+        const bool has_val = i + 1 < argc;
+        if (a == "--db" && has_val) db_path = argv[++i];
+        else if (a == "--jsonl" && has_val) jsonl_paths.push_back(argv[++i]);
+        else if (a == "--from" && has_val) from_ms = std::stoull(argv[++i]);
+        else if (a == "--to" && has_val) to_ms = std::stoull(argv[++i]);
+        else if (a == "--exchange" && has_val) exchange = argv[++i];
+        else if (a == "--instrument" && has_val) instrument = argv[++i];
+        else if (a == "--thresh" && has_val) thresh_spec = argv[++i];
+        else if (a == "--hold" && has_val) hold_spec = argv[++i];
+        else if (a == "--random" && has_val) random_n = std::stoull(argv[++i]);
+        else if (a == "--seed" && has_val) seed = std::stoull(argv[++i]);
+        else if (a == "--threads" && has_val) threads = std::max(1, std::stoi(argv[++i]));
+        else if (a == "--qty" && has_val) p.qty = std::stod(argv[++i]);
+        else if (a == "--cash" && has_val) p.exec.initial_cash = std::stod(argv[++i]);
+        else if (a == "--allow-short") p.exec.allow_short = true;
+        else if (a == "--no-require-cash") p.exec.require_cash = false;
+        else if (a == "--fill" && has_val) fill = argv[++i];
+        else if (a == "--rest-limits") p.exec.rest_limits = true;
+        else if (a == "--top" && has_val) top = std::stoull(argv[++i]);
+        else if (a == "--csv" && has_val) csv_path = argv[++i];
+        else {
+            usage();
+            return 1;
+        }
+    }
+
+    if (db_path.empty() == jsonl_paths.empty()) {
+        usage();
+        return 1;
+    }
+    if (fill == "depth") p.exec.fill = FillModel::Depth;
+    else if (fill != "touch") {
+        std::cerr << "[SWEEP] unknown --fill '" << fill << "' (touch | depth)\n";
+        return 1;
+    }
+    if (p.exec.rest_limits && p.exec.fill != FillModel::Depth) {
+        std::cerr << "[SWEEP] --rest-limits needs --fill depth\n";
+        return 1;
+    }
+
+    std::vector<double> threshs, holds;
+    if (!parse_values(thresh_spec, threshs) || !parse_values(hold_spec, holds)) {
+        std::cerr << "[SWEEP] bad --thresh / --hold spec\n";
+        return 1;
+    }
+    const std::vector<SweepPoint> pts = random_n > 0 ? random_points(threshs, holds, random_n, seed)
+                                                     : grid_points(threshs, holds);
+
+    std::ofstream csv_out;
+    if (!csv_path.empty()) {
+        csv_out.open(csv_path);
+        if (!csv_out) {
+            std::cerr << "[SWEEP] cannot write " << csv_path << "\n";
+            return 1;
+        }
+    }
+
+    // ----------- dataset (loaded once) -----------
+    MarketColumns cols;
+    {
+        std::unique_ptr<BacktestSource> src;
+        if (!db_path.empty()) {
+            auto db = std::make_unique<StateDbSource>(db_path, from_ms, to_ms);
+            if (!db->open(exchange, instrument)) return 1;
+            src = std::move(db);
+        } else {
+            src = std::make_unique<JsonlSource>(jsonl_paths, from_ms, to_ms, exchange, instrument);
+        }
+
+        const auto t0 = std::chrono::steady_clock::now();
+        load_columns(*src, cols);
+        const double load_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+        if (cols.size() == 0) {
+            std::cerr << "[SWEEP] no events in range\n";
+            return 1;
+        }
+        std::printf("[SWEEP] loaded %zu events, %zu keys in %.3fs\n", cols.size(), cols.keys.size(), load_s);
+    }
+
+    // ----------- sweep -----------
+    std::vector<SweepRow> rows(pts.size());
+    const auto t0 = std::chrono::steady_clock::now();
+    std::size_t steals = 0;
+    {
+        WorkStealingPool pool(threads);
+        std::printf("[SWEEP] %zu parameter sets on %u threads\n", pts.size(), pool.size());
+
+        for (std::size_t i = 0; i < pts.size(); ++i) {
+            pool.submit([&, i] {
+                const SweepPoint pt = pts[i];
+                ColumnarSource view(cols);
+                rows[i].pt = pt;
+                rows[i].r = run_backtest<ImbalanceTaker>(view, [pt] { return ImbalanceTaker(pt.thresh, pt.hold); }, p);
+                rows[i].r.keys.clear();
+            });
+        }
+        pool.wait_idle();
+        steals = pool.steals();
+    }
+    const double wall_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    std::printf("[SWEEP] wall=%.3fs %.1f sets/s %.0f events/s (all threads) steals=%zu\n",
+                wall_s, wall_s > 0 ? rows.size() / wall_s : 0.0,
+                wall_s > 0 ? static_cast<double>(rows.size()) * cols.size() / wall_s : 0.0, steals);
+
+    // ----------- ranking -----------
+    std::sort(rows.begin(), rows.end(), [](const SweepRow& a, const SweepRow& b) {
+        if (a.pnl() != b.pnl()) return a.pnl() > b.pnl();
+        return a.r.turnover < b.r.turnover;   // same PnL: less trading first
+    });
+
+    std::printf("%5s %8s %6s %14s %9s %8s %16s %12s %10s\n",
+                "rank", "thresh", "hold", "pnl", "ret%", "fills", "turnover", "max_dd", "pnl/turn");
+    for (std::size_t i = 0; i < rows.size() && i < top; ++i) {
+        const SweepRow& row = rows[i];
+        const BacktestResult& r = row.r;
+        std::printf("%5zu %8.4f %6d %14.4f %9.4f %8llu %16.4f %12.4f %9.2fbp\n",
+                    i + 1, row.pt.thresh, row.pt.hold, row.pnl(),
+                    r.start_equity > 0 ? row.pnl() / r.start_equity * 100.0 : 0.0,
+                    static_cast<unsigned long long>(r.fills), r.turnover, r.max_drawdown,
+                    r.turnover > 0 ? row.pnl() / r.turnover * 1e4 : 0.0);
+    }
+
+    if (csv_out.is_open()) {
+        csv_out << std::fixed << std::setprecision(8);
+        csv_out << "rank,thresh,hold,pnl,return_pct,fills,resting_fills,rejects,turnover,max_drawdown\n";
+        for (std::size_t i = 0; i < rows.size(); ++i) {
+            const SweepRow& row = rows[i];
+            const BacktestResult& r = row.r;
+            csv_out << i + 1 << ',' << row.pt.thresh << ',' << row.pt.hold << ',' << row.pnl() << ','
+                    << (r.start_equity > 0 ? row.pnl() / r.start_equity * 100.0 : 0.0) << ','
+                    << r.fills << ',' << r.resting_fills << ',' << r.rejects << ',' << r.turnover << ',' << r.max_drawdown << '\n';
+        }
+    }
+    return 0;
+}
@@ -39,7 +39,15 @@ std::optional<MarketState> ZmqMarketSubscriber::recv_one(std::string* out_topic)
 
     if (out_topic) *out_topic = topic;
 
-    return parse_market_state_json(payload);
+    const std::uint64_t rx_ns = trace_now_ns();
+    auto s = parse_market_state_json(payload);
+    if (s && s->trace.id) {
+        s->trace.rx_ns     = rx_ns;
+        s->trace.parsed_ns = trace_now_ns();
+        trace_span(LS_ZMQ, s->trace.pub_ns, rx_ns);
+        trace_span(LS_RX_PARSE, rx_ns, s->trace.parsed_ns);
+    }
+    return s;
 }
 
 std::optional<MarketState> ZmqMarketSubscriber::parse_market_state_json(const std::string& payload) {
@@ -51,6 +59,7 @@ std::optional<MarketState> ZmqMarketSubscriber::parse_market_state_json(const st
         s.exchange   = j.value("exchange", "");
         s.instrument = j.value("instrument", "");
         s.ts_ms      = j.value("ts_ms", static_cast<std::int64_t>(0));
+        trace_from_json(j, s.trace);
 
         if (j.contains("top_of_book")) {
             const auto& tob = j["top_of_book"];
@@ -77,15 +86,18 @@ std::optional<MarketState> ZmqMarketSubscriber::parse_market_state_json(const st
                 for (size_t i = 0; i < 5 && i < d["ask_vol"].size(); ++i)
                     s.ask_vol[i] = d["ask_vol"][i].get<double>();
             }
+            if (d.contains("bid_px") && d["bid_px"].is_array()) {
+                for (size_t i = 0; i < 5 && i < d["bid_px"].size(); ++i)
+                    s.bid_px[i] = d["bid_px"][i].get<double>();
+            }
+            if (d.contains("ask_px") && d["ask_px"].is_array()) {
+                for (size_t i = 0; i < 5 && i < d["ask_px"].size(); ++i)
+                    s.ask_px[i] = d["ask_px"][i].get<double>();
+            }
         }
 
         // compute imbalance like you did
-        double bid_sum = 0.0, ask_sum = 0.0;
-        for (int i = 0; i < 5; ++i) {
-            bid_sum += s.bid_vol[i];
-            ask_sum += s.ask_vol[i];
-        }
-        s.imbalance = (bid_sum - ask_sum) / (bid_sum + ask_sum + 1e-9);
+        s.imbalance = depth_imbalance(s.bid_vol.data(), s.ask_vol.data());
 
         // sanity
         if (s.exchange.empty() || s.instrument.empty()) return std::nullopt;